@@ -16,6 +16,13 @@ else()
   set(QBDI_DISABLE_AVX OFF)
 endif()
 
+# Number of entries of the indirect branch target cache (power of two)
+if(QBDI_ARCH_X86_64 OR QBDI_ARCH_X86)
+  set(QBDI_INDIRECT_CACHE_SIZE
+      ""
+      CACHE STRING "Number of entries of the indirect branch target cache")
+endif()
+
 # ASAN option
 option(QBDI_ASAN
        "Enable AddressSanitizer (ASAN) for debugging (May be slow down)" OFF)
@@ -120,6 +127,9 @@ message(STATUS "QBDI_CCACHE:           ${QBDI_CCACHE}")
 
 if(QBDI_ARCH_X86_64 OR QBDI_ARCH_X86)
   message(STATUS "QBDI_DISABLE_AVX:      ${QBDI_DISABLE_AVX}")
+  if(QBDI_INDIRECT_CACHE_SIZE)
+    message(STATUS "QBDI_INDIRECT_CACHE_SIZE: ${QBDI_INDIRECT_CACHE_SIZE}")
+  endif()
 endif()
 
 message(STATUS "QBDI_ASAN:             ${QBDI_ASAN}")
@@ -18,6 +18,8 @@
 #ifndef QBDI_CALLBACK_H_
 #define QBDI_CALLBACK_H_
 
+#include <stddef.h>
+
 #include "QBDI/Bitmask.h"
 #include "QBDI/InstAnalysis.h"
 #include "QBDI/Platform.h"
@@ -67,6 +69,20 @@ typedef enum {
                               */
 } VMAction;
 
+/*! The reason of the end of a run, returned by runWithStatus
+ */
+typedef enum {
+  _QBDI_EI(RUN_NOT_EXECUTED) = 0,    /*!< No block has been executed. */
+  _QBDI_EI(RUN_STOPPED) = 1,         /*!< The stop address has been reached or
+                                      *   a callback stopped the execution.
+                                      */
+  _QBDI_EI(RUN_BUDGET_EXHAUSTED) = 2 /*!< The instruction budget or the time
+                                      *   budget of the run is exhausted. The
+                                      *   PC of the GPRState is the address of
+                                      *   the next instruction to execute.
+                                      */
+} RunStatus;
+
 typedef void *VMInstance;
 
 #ifdef __cplusplus
@@ -144,6 +160,138 @@ typedef enum {
                   *   is used in the callback */
 } CallbackPriority;
 
+/*! Type of an instruction callback
+ *
+ * A fast callback is called from the instrumented code, without leaving the
+ * ExecBlock. It must return CONTINUE and must not change the value of the
+ * program counter. The modifications of the GPRState are applied.
+ *
+ * The fast callbacks are supported on X86_64. The sequences that use the
+ * floating point registers and the other architectures use the default
+ * callback type.
+ *
+ * A once callback is only called at the first execution of each instruction
+ * written in the cache. The instrumented code then jumps over the callback
+ * on X86 and X86_64, and the callback is called again for an instruction
+ * after the cache has been cleared. It can be combined with CALLBACK_FAST.
+ *
+ * A slot callback is called through a patchable slot from its first
+ * translation: VM::setInstrumentationEnabled and VM::setInstrumentationData
+ * never clear the cache for this callback.
+ */
+typedef enum {
+  _QBDI_EI(CALLBACK_DEFAULT) = 0, /*!< The callback is called by the VM */
+  _QBDI_EI(CALLBACK_FAST) = 1,    /*!< The callback is called from the
+                                   *   instrumented code */
+  _QBDI_EI(CALLBACK_ONCE) = 2,    /*!< The callback is only called at the
+                                   *   first execution of an instruction */
+  _QBDI_EI(CALLBACK_SLOT) = 4,    /*!< The callback is called through a
+                                   *   patchable slot */
+} CallbackType;
+
+_QBDI_ENABLE_BITMASK_OPERATORS(CallbackType)
+
+/*! Value compared by the predicate of a callback
+ */
+typedef enum {
+  _QBDI_EI(PREDICATE_GPR) = 0,    /*!< The value of a GPR */
+  _QBDI_EI(PREDICATE_MEMORY) = 1, /*!< The word at the address in a GPR plus
+                                   *   an offset */
+  _QBDI_EI(PREDICATE_FLAG) = 2,   /*!< A bit of the flags register (0 or 1) */
+} PredicateSource;
+
+/*! Comparison of the predicate of a callback. The comparisons are unsigned.
+ */
+typedef enum {
+  _QBDI_EI(PREDICATE_EQ) = 0,       /*!< value == constant */
+  _QBDI_EI(PREDICATE_NE) = 1,       /*!< value != constant */
+  _QBDI_EI(PREDICATE_LT) = 2,       /*!< value < constant */
+  _QBDI_EI(PREDICATE_LE) = 3,       /*!< value <= constant */
+  _QBDI_EI(PREDICATE_GT) = 4,       /*!< value > constant */
+  _QBDI_EI(PREDICATE_GE) = 5,       /*!< value >= constant */
+  _QBDI_EI(PREDICATE_IN_RANGE) = 6, /*!< constant <= value < constantEnd */
+} PredicateOperator;
+
+/*! Condition of a predicated callback. The callback is called only when the
+ * condition holds. On X86 and X86_64, the condition is evaluated in the
+ * instrumented code and the execution doesn't leave the ExecBlock when it
+ * doesn't hold.
+ *
+ * The value is read before the instruction with PREINST, and after it with
+ * POSTINST.
+ */
+typedef struct {
+  PredicateSource source; /*!< Source of the compared value */
+  uint32_t reg;           /*!< Index of the GPR (PREDICATE_GPR and
+                           *   PREDICATE_MEMORY) or of the bit of the flags
+                           *   register (PREDICATE_FLAG)
+                           */
+  sword offset;           /*!< Offset added to the GPR (PREDICATE_MEMORY) */
+  PredicateOperator op;   /*!< Comparison with the constant */
+  rword constant;         /*!< The constant, or the start of the range */
+  rword constantEnd;      /*!< The end of the range, excluded
+                           *   (PREDICATE_IN_RANGE)
+                           */
+} CallbackPredicate;
+
+/*! Operation of an inline instrumentation. The operations work on an
+ * accumulator which is zero at the beginning of the instrumentation.
+ */
+typedef enum {
+  _QBDI_EI(INLINE_LOAD_IMM) = 0,           /*!< accumulator = value */
+  _QBDI_EI(INLINE_LOAD_REG) = 1,           /*!< accumulator = the GPR with
+                                            *   the index value
+                                            */
+  _QBDI_EI(INLINE_LOAD_OPERAND) = 2,       /*!< accumulator = the operand with
+                                            *   the index value in the
+                                            *   InstAnalysis: the immediate,
+                                            *   the whole GPR of a register,
+                                            *   or zero
+                                            */
+  _QBDI_EI(INLINE_LOAD_READ_ADDRESS) = 3,  /*!< accumulator = the address of
+                                            *   the read access, or zero
+                                            */
+  _QBDI_EI(INLINE_LOAD_WRITE_ADDRESS) = 4, /*!< accumulator = the address of
+                                            *   the write access (POSTINST
+                                            *   only), or zero
+                                            */
+  _QBDI_EI(INLINE_LOAD_MEMORY) = 5,        /*!< accumulator = the word at the
+                                            *   address value
+                                            */
+  _QBDI_EI(INLINE_ADD) = 6,                /*!< accumulator += value */
+  _QBDI_EI(INLINE_STORE) = 7,              /*!< the word at the address
+                                            *   value = accumulator
+                                            */
+  _QBDI_EI(INLINE_SKIP) = 8,               /*!< skip the next value
+                                            *   operations when the
+                                            *   comparison of the accumulator
+                                            *   holds
+                                            */
+  _QBDI_EI(INLINE_CALL) = 9,               /*!< call the callback of the
+                                            *   instrumentation (last
+                                            *   operation only)
+                                            */
+} InlineOpcode;
+
+/*! Operation of an inline instrumentation. On X86 and X86_64, the operations
+ * are compiled in the instrumented code and the execution only leaves the
+ * ExecBlock for INLINE_CALL. On the other architectures, or when an operation
+ * can't be compiled, the operations are interpreted by the host.
+ */
+typedef struct {
+  InlineOpcode opcode;   /*!< The operation */
+  rword value;           /*!< Immediate, GPR or operand index, address, or
+                          *   number of skipped operations
+                          */
+  PredicateOperator cmp; /*!< Comparison of INLINE_SKIP */
+  rword constant;        /*!< The constant of INLINE_SKIP, or the start of
+                          *   the range
+                          */
+  rword constantEnd;     /*!< The end of the range, excluded
+                          *   (PREDICATE_IN_RANGE)
+                          */
+} InlineOp;
+
 typedef enum {
   _QBDI_EI(NO_EVENT) = 0,
   _QBDI_EI(SEQUENCE_ENTRY) = 1,            /*!< Triggered when the execution
@@ -281,6 +429,40 @@ typedef struct {
   MemoryAccessFlags flags; /*!< Memory access flags */
 } MemoryAccess;
 
+/*! Execution counter of a basic block, measured with the option
+ * OPT_ENABLE_BLOCK_PROFILE.
+ */
+typedef struct {
+  rword address;  /*!< Start address of the basic block */
+  rword size;     /*!< Size of the basic block (in bytes) */
+  uint64_t count; /*!< Number of executions of the basic block */
+} BlockProfile;
+
+/*! Strategy to discover the basic blocks of a module with precacheModule
+ */
+typedef enum {
+  _QBDI_EI(PRECACHE_SYMBOLS) = 0,  /*!< Cache the entry point and the
+                                    * functions exported by the module.
+                                    */
+  _QBDI_EI(PRECACHE_RECURSIVE) = 1 /*!< Also cache the basic blocks reached by
+                                    * the direct branches and calls of the
+                                    * module, from the entry points and the
+                                    * basic blocks already in the cache.
+                                    */
+} PrecacheStrategy;
+
+/*! Memory trace callback function type.
+ *
+ * @param[in] vm        VM instance of the trace.
+ * @param[in] accesses  The memory accesses written in the buffer of the trace,
+ *                      in the order of the execution.
+ * @param[in] size      The number of memory accesses in the buffer.
+ * @param[in] data      User defined data given with the buffer of the trace.
+ */
+typedef void (*MemoryTraceCallback)(VMInstanceRef vm,
+                                    const MemoryAccess *accesses, size_t size,
+                                    void *data);
+
 #ifdef __cplusplus
 struct InstrRuleDataCBK {
   InstPosition position; /*!< Relative position of the event callback (PREINST /
@@ -296,18 +478,21 @@ struct InstrRuleDataCBK {
 
   int priority; /*!< Priority of the callback */
 
+  bool once; /*!< Only call the callback at the first execution of the
+              * instruction (see CALLBACK_ONCE) */
+
   InstrRuleDataCBK(InstPosition position, InstCallback cbk, void *data,
-                   int priority = PRIORITY_DEFAULT)
+                   int priority = PRIORITY_DEFAULT, bool once = false)
       : position(position), cbk(cbk), data(data), lambdaCbk(nullptr),
-        priority(priority) {}
+        priority(priority), once(once) {}
   InstrRuleDataCBK(InstPosition position, const InstCbLambda &cbk,
-                   int priority = PRIORITY_DEFAULT)
+                   int priority = PRIORITY_DEFAULT, bool once = false)
       : position(position), cbk(nullptr), data(nullptr), lambdaCbk(cbk),
-        priority(priority) {}
+        priority(priority), once(once) {}
   InstrRuleDataCBK(InstPosition position, InstCbLambda &&cbk,
-                   int priority = PRIORITY_DEFAULT)
+                   int priority = PRIORITY_DEFAULT, bool once = false)
       : position(position), cbk(nullptr), data(nullptr),
-        lambdaCbk(std::move(cbk)), priority(priority) {}
+        lambdaCbk(std::move(cbk)), priority(priority), once(once) {}
 };
 
 using InstrRuleDataVec = std::vector<InstrRuleDataCBK> *;
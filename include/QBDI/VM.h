@@ -62,6 +62,10 @@ private:
 
   uint32_t backupErrno;
 
+  // Instrument the memory gates again when the ranges of memCBInfos change
+  // their JIT code
+  void updateMemGates();
+
 public:
   /*! Construct a new VM for a given CPU with specific attributes
    *
@@ -234,10 +238,24 @@ public:
    * @param[in] start  Address of the first instruction to execute.
    * @param[in] stop   Stop the execution when this instruction is reached.
    *
-   * @return  True if at least one block has been executed.
+   * @return  True if at least one block has been executed. A run stopped by
+   *          its budget also returns true: use runWithStatus or
+   *          isBudgetExhausted to distinguish it.
    */
   QBDI_EXPORT bool run(rword start, rword stop);
 
+  /*! Start the execution by the DBI and return the reason of its end.
+   *  This method mustn't be called if the VM already runs.
+   *
+   * @param[in] start  Address of the first instruction to execute.
+   * @param[in] stop   Stop the execution when this instruction is reached.
+   *
+   * @return  RUN_BUDGET_EXHAUSTED if the budget of the run is exhausted,
+   *          RUN_STOPPED if at least one block has been executed, and
+   *          RUN_NOT_EXECUTED otherwise.
+   */
+  QBDI_EXPORT RunStatus runWithStatus(rword start, rword stop);
+
   /*! Call a function using the DBI (and its current state).
    *  This method mustn't be called if the VM already runs.
    *
@@ -355,6 +373,34 @@ public:
                                        uint32_t argNum, va_list ap,
                                        uint32_t stackSize = 0x20000);
 
+  /*! Stop each run after a number of instructions. The budget is decremented
+   * by the JIT code at the end of each basic block, an entry in the middle of
+   * a basic block counts the whole basic block. The run may execute a few
+   * more instructions than the budget (X86 and X86_64 only).
+   * This method mustn't be called when the VM runs.
+   *
+   * @param[in] instructions  The budget of each run, 0 for no limit.
+   *
+   * @return True if the instruction budget is supported on this architecture.
+   */
+  QBDI_EXPORT bool setInstructionBudget(uint64_t instructions);
+
+  /*! Stop each run after a delay. The time is checked when the execution
+   * returns to the host, and at least every 65536 instructions on X86 and
+   * X86_64. This method mustn't be called when the VM runs.
+   *
+   * @param[in] milliseconds  The delay of each run, 0 for no limit.
+   */
+  QBDI_EXPORT void setTimeBudget(uint64_t milliseconds);
+
+  /*! Check if the last run has been stopped because its instruction budget or
+   * its time budget was exhausted. The PC of the GPRState is the address of
+   * the next instruction to execute.
+   *
+   * @return True if the last run exhausted its budget.
+   */
+  QBDI_EXPORT bool isBudgetExhausted() const;
+
   /*! Add a custom instrumentation rule to the VM.
    *
    * @param[in] cbk       A function pointer to the callback
@@ -490,6 +536,25 @@ public:
                                      InstCbLambda &&cbk,
                                      int priority = PRIORITY_DEFAULT);
 
+  /*! Register a callback event if the instruction matches the mnemonic,
+   * called only when a predicate holds.
+   *
+   * @param[in] mnemonic   Mnemonic to match.
+   * @param[in] pos        Relative position of the event callback
+   *                       (PREINST / POSTINST).
+   * @param[in] cbk        A function pointer to the callback.
+   * @param[in] data       User defined data passed to the callback.
+   * @param[in] predicate  The condition of the callback.
+   * @param[in] priority   The priority of the callback.
+   *
+   * @return The id of the registered instrumentation (or
+   * VMError::INVALID_EVENTID in case of failure).
+   */
+  QBDI_EXPORT uint32_t addMnemonicCB(const char *mnemonic, InstPosition pos,
+                                     InstCallback cbk, void *data,
+                                     const CallbackPredicate &predicate,
+                                     int priority = PRIORITY_DEFAULT);
+
   /*! Register a callback event for every instruction executed.
    *
    * @param[in] pos        Relative position of the event callback
@@ -519,6 +584,41 @@ public:
   QBDI_EXPORT uint32_t addCodeCB(InstPosition pos, InstCbLambda &&cbk,
                                  int priority = PRIORITY_DEFAULT);
 
+  /*! Register a callback event for every instruction executed, with a
+   * callback type.
+   *
+   * @param[in] pos        Relative position of the event callback
+   *                       (PREINST / POSTINST).
+   * @param[in] cbk        A function pointer to the callback.
+   * @param[in] data       User defined data passed to the callback.
+   * @param[in] type       The type of the callback (CALLBACK_DEFAULT /
+   *                       CALLBACK_FAST, optionally with CALLBACK_ONCE).
+   * @param[in] priority   The priority of the callback.
+   *
+   * @return The id of the registered instrumentation
+   * (or VMError::INVALID_EVENTID in case of failure).
+   */
+  QBDI_EXPORT uint32_t addCodeCB(InstPosition pos, InstCallback cbk, void *data,
+                                 CallbackType type,
+                                 int priority = PRIORITY_DEFAULT);
+
+  /*! Register a callback event for every instruction executed, called only
+   * when a predicate holds.
+   *
+   * @param[in] pos        Relative position of the event callback
+   *                       (PREINST / POSTINST).
+   * @param[in] cbk        A function pointer to the callback.
+   * @param[in] data       User defined data passed to the callback.
+   * @param[in] predicate  The condition of the callback.
+   * @param[in] priority   The priority of the callback.
+   *
+   * @return The id of the registered instrumentation
+   * (or VMError::INVALID_EVENTID in case of failure).
+   */
+  QBDI_EXPORT uint32_t addCodeCB(InstPosition pos, InstCallback cbk, void *data,
+                                 const CallbackPredicate &predicate,
+                                 int priority = PRIORITY_DEFAULT);
+
   /*! Register a callback for when a specific address is executed.
    *
    * @param[in] address  Code address which will trigger the callback.
@@ -551,6 +651,44 @@ public:
                                      InstCbLambda &&cbk,
                                      int priority = PRIORITY_DEFAULT);
 
+  /*! Register a callback for when a specific address is executed, with a
+   * callback type.
+   *
+   * @param[in] address  Code address which will trigger the callback.
+   * @param[in] pos      Relative position of the callback (PREINST / POSTINST).
+   * @param[in] cbk      A function pointer to the callback.
+   * @param[in] data     User defined data passed to the callback.
+   * @param[in] type     The type of the callback (CALLBACK_DEFAULT /
+   *                     CALLBACK_FAST, optionally with CALLBACK_ONCE).
+   * @param[in] priority The priority of the callback.
+   *
+   * @return The id of the registered instrumentation (or
+   * VMError::INVALID_EVENTID in case of failure).
+   */
+  QBDI_EXPORT uint32_t addCodeAddrCB(rword address, InstPosition pos,
+                                     InstCallback cbk, void *data,
+                                     CallbackType type,
+                                     int priority = PRIORITY_DEFAULT);
+
+  /*! Register a callback for when a specific address is executed, called
+   * only when a predicate holds.
+   *
+   * @param[in] address    Code address which will trigger the callback.
+   * @param[in] pos        Relative position of the callback (PREINST /
+   *                       POSTINST).
+   * @param[in] cbk        A function pointer to the callback.
+   * @param[in] data       User defined data passed to the callback.
+   * @param[in] predicate  The condition of the callback.
+   * @param[in] priority   The priority of the callback.
+   *
+   * @return The id of the registered instrumentation (or
+   * VMError::INVALID_EVENTID in case of failure).
+   */
+  QBDI_EXPORT uint32_t addCodeAddrCB(rword address, InstPosition pos,
+                                     InstCallback cbk, void *data,
+                                     const CallbackPredicate &predicate,
+                                     int priority = PRIORITY_DEFAULT);
+
   /*! Register a callback for when a specific address range is executed.
    *
    * @param[in] start    Start of the address range which will trigger
@@ -589,6 +727,72 @@ public:
                                       InstCbLambda &&cbk,
                                       int priority = PRIORITY_DEFAULT);
 
+  /*! Register a callback for when a specific address range is executed, with
+   * a callback type.
+   *
+   * @param[in] start    Start of the address range which will trigger
+   *                     the callback.
+   * @param[in] end      End of the address range which will trigger
+   *                     the callback.
+   * @param[in] pos      Relative position of the callback (PREINST / POSTINST).
+   * @param[in] cbk      A function pointer to the callback.
+   * @param[in] data     User defined data passed to the callback.
+   * @param[in] type     The type of the callback (CALLBACK_DEFAULT /
+   *                     CALLBACK_FAST, optionally with CALLBACK_ONCE).
+   * @param[in] priority The priority of the callback.
+   *
+   * @return The id of the registered instrumentation (or
+   * VMError::INVALID_EVENTID in case of failure).
+   */
+  QBDI_EXPORT uint32_t addCodeRangeCB(rword start, rword end, InstPosition pos,
+                                      InstCallback cbk, void *data,
+                                      CallbackType type,
+                                      int priority = PRIORITY_DEFAULT);
+
+  /*! Register an inline instrumentation on every instruction. The operations
+   * are compiled in the instrumented code on X86 and X86_64, and interpreted
+   * by the host on the other architectures. The memory accesses are recorded
+   * if an operation loads the address of an access.
+   *
+   * @param[in] pos      Relative position of the instrumentation (PREINST /
+   *                     POSTINST).
+   * @param[in] ops      The operations of the instrumentation.
+   * @param[in] cbk      The callback of the INLINE_CALL operation, called as
+   *                     a fast callback when supported.
+   * @param[in] data     User defined data passed to the callback.
+   * @param[in] priority The priority of the instrumentation.
+   *
+   * @return The id of the registered instrumentation (or
+   * VMError::INVALID_EVENTID in case of failure).
+   */
+  QBDI_EXPORT uint32_t addInlineCB(InstPosition pos,
+                                   const std::vector<InlineOp> &ops,
+                                   InstCallback cbk = nullptr,
+                                   void *data = nullptr,
+                                   int priority = PRIORITY_DEFAULT);
+
+  /*! Register an inline instrumentation for a specific address range (see
+   * addInlineCB).
+   *
+   * @param[in] start    Start of the address range.
+   * @param[in] end      End of the address range.
+   * @param[in] pos      Relative position of the instrumentation (PREINST /
+   *                     POSTINST).
+   * @param[in] ops      The operations of the instrumentation.
+   * @param[in] cbk      The callback of the INLINE_CALL operation.
+   * @param[in] data     User defined data passed to the callback.
+   * @param[in] priority The priority of the instrumentation.
+   *
+   * @return The id of the registered instrumentation (or
+   * VMError::INVALID_EVENTID in case of failure).
+   */
+  QBDI_EXPORT uint32_t addInlineRangeCB(rword start, rword end,
+                                        InstPosition pos,
+                                        const std::vector<InlineOp> &ops,
+                                        InstCallback cbk = nullptr,
+                                        void *data = nullptr,
+                                        int priority = PRIORITY_DEFAULT);
+
   /*! Register a callback event for every memory access matching the type
    * bitfield made by the instructions.
    *
@@ -732,6 +936,55 @@ public:
    */
   QBDI_EXPORT bool deleteInstrumentation(uint32_t id);
 
+  /*! Call a callback once every period executions instead of each execution.
+   * The callbacks of an InstrRule share the same countdown, decremented in
+   * the JIT code when supported. Only the first call on an InstrRule flushes
+   * its range from the cache, the period can then be changed at any time.
+   * A sampled instruction callback always breaks to the host.
+   *
+   * @param[in] id          The id of an instruction callback, an InstrRule or
+   *                        a VMEvent callback.
+   * @param[in] period      Call the callback once every period executions
+   *                        (1 to disable the sampling).
+   * @param[in] randomized  Draw each period uniformly between 1 and
+   *                        (2 * period - 1) instead of a fixed period.
+   *
+   * @return True if the callback can be sampled.
+   */
+  QBDI_EXPORT bool setCallbackSampling(uint32_t id, uint32_t period,
+                                       bool randomized = false);
+
+  /*! Enable or disable an instrumentation without removing it. The callbacks
+   * added with addCodeCB, addCodeAddrCB, addCodeRangeCB and addMnemonicCB are
+   * called through a patchable slot read by the JIT code: only the first call
+   * on such a callback flushes its range from the cache, it can then be
+   * enabled, disabled or given a new data pointer at any time. A callback
+   * added with CALLBACK_SLOT has its slot from its first translation and is
+   * never flushed.
+   *
+   * @param[in] id       The id of an instruction callback or a VMEvent
+   *                     callback.
+   * @param[in] enabled  Call the callback.
+   *
+   * @return True if the instrumentation can be disabled.
+   */
+  QBDI_EXPORT bool setInstrumentationEnabled(uint32_t id, bool enabled);
+
+  /*! Change the data pointer given to the callbacks of an instrumentation.
+   * The range of the instrumentation is flushed from the cache, unless its
+   * callbacks are called through a patchable slot (see CALLBACK_SLOT and
+   * setInstrumentationEnabled). The data of an InstrRule is embedded in its
+   * instrumentation, its range is always flushed.
+   *
+   * @param[in] id    The id of an instruction callback, an InstrRule or a
+   *                  VMEvent callback.
+   * @param[in] data  The new data pointer.
+   *
+   * @return True if the data pointer has been changed. The instrumentations
+   *         with a lambda or a memory access callback are not supported.
+   */
+  QBDI_EXPORT bool setInstrumentationData(uint32_t id, void *data);
+
   /*! Remove all the registered instrumentations.
    *
    */
@@ -814,6 +1067,32 @@ public:
    */
   QBDI_EXPORT std::vector<MemoryAccess> getBBMemoryAccess() const;
 
+  /*! Write the memory accesses in a buffer with inline instrumentation
+   * (X86_64 only). The callback is called with the content of the buffer when
+   * the buffer is full and when the execution of the VM ends, and doesn't
+   * need a break to host for each access.
+   *
+   * The access of an instruction with a REP prefix is written before the
+   * instruction, with the begin address and the flags MEMORY_UNKNOWN_SIZE and
+   * MEMORY_UNKNOWN_VALUE. The cache is cleared. This method mustn't be called
+   * when the VM runs, and the memory trace isn't copied with the VM.
+   *
+   * @param[in] buffer  The buffer where the accesses are written.
+   * @param[in] size    The number of accesses of the buffer.
+   * @param[in] cbk     The callback called when the buffer must be flushed.
+   * @param[in] data    User defined data passed to the callback.
+   *
+   * @return True if the memory trace is supported, False if not or in case of
+   *         error.
+   */
+  QBDI_EXPORT bool setMemoryTrace(MemoryAccess *buffer, size_t size,
+                                  MemoryTraceCallback cbk, void *data);
+
+  /*! Flush the pending accesses of the memory trace and remove it. The cache
+   * is cleared. This method mustn't be called when the VM runs.
+   */
+  QBDI_EXPORT void removeMemoryTrace();
+
   /*! Pre-cache a known basic block
    *  This method mustn't be called if the VM already runs.
    *
@@ -835,8 +1114,9 @@ public:
    */
   QBDI_EXPORT void clearAllCache();
 
-  /*! Get the number of ExecBlock in the cache. Each block uses 2 memory pages
-   * and some heap allocations.
+  /*! Get the number of ExecBlock in the cache. Each block uses a code and a
+   * data block (one page each by default, see setExecBlockSize) and some heap
+   * allocations.
    *
    * @return  The number of ExecBlock in the cache.
    */
@@ -844,12 +1124,109 @@ public:
 
   /*! Reduce the cache to X ExecBlock. Note that this will try to purge the
    * oldest ExecBlock first, but the block may be recreate if needed by followed
-   * execution.
+   * execution. The flushed ExecBlocks are kept to be reused by the next
+   * translations, up to the largest size reached by the cache: this method
+   * also lowers this limit to X and releases the ExecBlocks above it.
    *
    * @param[in] nb The number of BasicBlock that should remains in the cache
    *               after call.
    */
   QBDI_EXPORT void reduceCacheTo(uint32_t nb);
+
+  /*! Set the size of the code and the data blocks of the ExecBlocks. Larger
+   * blocks hold more basic blocks: a large region overflows in fewer blocks,
+   * and the JIT code uses fewer pages. The cache is cleared. This method
+   * mustn't be called when the VM runs.
+   *
+   * The sizes must be multiples of the page size. The code block is at most
+   * 2 MiB, and the data block (context and shadows) is at most 256 KiB on X86
+   * and X86_64 and 32 KiB on AArch64. ARM only supports the default sizes.
+   *
+   * @param[in] codeSize   The size of the code blocks, 0 for one page.
+   * @param[in] dataSize   The size of the data blocks, 0 for the default.
+   * @param[in] hugePages  Back each code block with a 2 MiB transparent huge
+   *                       page (Linux and Android only). The code size must
+   *                       be 0 or 2 MiB.
+   *
+   * @return True if the sizes are supported, False if not.
+   */
+  QBDI_EXPORT bool setExecBlockSize(uint32_t codeSize, uint32_t dataSize = 0,
+                                    bool hugePages = false);
+
+  /*! Get the counters of the indirect branch target cache. This cache is
+   * used with the option OPT_ENABLE_BLOCK_CHAINING to resolve the target of
+   * the indirect branches (RET, JMP and CALL to a register or a memory value)
+   * without returning to the host (X86 and X86_64 only).
+   *
+   * @param[out] hits    The number of indirect branches resolved in the
+   *                     cache or in the return stack. (may be NULL)
+   * @param[out] misses  The number of indirect branches that returned to the
+   *                     host. (may be NULL)
+   */
+  QBDI_EXPORT void getIndirectCacheStats(uint64_t *hits,
+                                         uint64_t *misses) const;
+
+  /*! Get the execution counters of the basic blocks. The counters are
+   * incremented by the JIT code with the option OPT_ENABLE_BLOCK_PROFILE
+   * (X86_64 only), and are kept when the cache is cleared or the options
+   * change.
+   *
+   * A basic block is identified by the address where the execution entered
+   * it. An entry in the middle of a basic block already in the cache isn't
+   * counted.
+   *
+   * @return The counter of each basic block written with the option.
+   */
+  QBDI_EXPORT std::vector<BlockProfile> getBlockProfile() const;
+
+  /*! Pre-cache the basic blocks of a module, before its first run. The entry
+   * points are the entry point of the module and the functions of its dynamic
+   * symbol table (ELF modules only). With PRECACHE_RECURSIVE, the targets of
+   * the direct branches and calls of the module are followed, and the basic
+   * blocks of the module already in the cache are used as entry points too.
+   * The indirect branches aren't followed. Only the basic blocks in the
+   * instrumented ranges are cached.
+   *
+   * The basic blocks are translated synchronously, with the instrumentation
+   * of the VM. This method mustn't be called when the VM runs.
+   *
+   * @param[in] name      The name of the module.
+   * @param[in] strategy  The strategy to discover the basic blocks.
+   *
+   * @return The number of basic blocks inserted in the cache.
+   */
+  QBDI_EXPORT uint32_t precacheModule(
+      const std::string &name,
+      PrecacheStrategy strategy = PrecacheStrategy::PRECACHE_RECURSIVE);
+
+  /*! Write an AFL-compatible edge coverage in a bitmap. The JIT code
+   * increments the byte of the edge between the previous basic block and the
+   * current one at the beginning of each basic block:
+   *
+   *   bitmap[(prev ^ cur) & (size - 1)]++; prev = cur >> 1;
+   *
+   * with cur = ((address >> 4) ^ (address << 8)) & (size - 1), as the QEMU
+   * mode of AFL. The counters wrap, and the previous location is reset at the
+   * beginning of each run (X86 and X86_64 only). The previous location belongs
+   * to the VM: several VMs can write in the same bitmap without mixing their
+   * edges. With OPT_ENABLE_SHARED_CONTEXT, it is kept in the shared context.
+   *
+   * The cache is cleared. This method mustn't be called when the VM runs,
+   * and the bitmap isn't copied with the VM.
+   *
+   * @param[in] bitmap  The bitmap, must outlive the VM or the call to
+   *                    removeCoverageBitmap.
+   * @param[in] size    The size of the bitmap, a power of two.
+   *
+   * @return True if the edge coverage is supported, False if not or in case
+   *         of error.
+   */
+  QBDI_EXPORT bool setCoverageBitmap(uint8_t *bitmap, size_t size);
+
+  /*! Stop writing the edge coverage. The cache is cleared. This method
+   * mustn't be called when the VM runs.
+   */
+  QBDI_EXPORT void removeCoverageBitmap();
 };
 
 } // namespace QBDI
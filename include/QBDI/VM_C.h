@@ -138,10 +138,26 @@ QBDI_EXPORT void qbdi_removeAllInstrumentedRanges(VMInstanceRef instance);
  * @param[in] start     Address of the first instruction to execute.
  * @param[in] stop      Stop the execution when this instruction is reached.
  *
- * @return  True if at least one block has been executed.
+ * @return  True if at least one block has been executed. A run stopped by its
+ *          budget also returns true: use qbdi_runWithStatus or
+ *          qbdi_isBudgetExhausted to distinguish it.
  */
 QBDI_EXPORT bool qbdi_run(VMInstanceRef instance, rword start, rword stop);
 
+/*! Start the execution by the DBI and return the reason of its end.
+ *  This method mustn't be called when the VM already runs.
+ *
+ * @param[in] instance  VM instance.
+ * @param[in] start     Address of the first instruction to execute.
+ * @param[in] stop      Stop the execution when this instruction is reached.
+ *
+ * @return  RUN_BUDGET_EXHAUSTED if the budget of the run is exhausted,
+ *          RUN_STOPPED if at least one block has been executed, and
+ *          RUN_NOT_EXECUTED otherwise.
+ */
+QBDI_EXPORT RunStatus qbdi_runWithStatus(VMInstanceRef instance, rword start,
+                                         rword stop);
+
 /*! Call a function using the DBI (and its current state).
  *  This method mustn't be called when the VM already runs.
  *
@@ -268,6 +284,35 @@ QBDI_EXPORT bool qbdi_switchStackAndCallA(VMInstanceRef instance, rword *retval,
                                           rword function, uint32_t stackSize,
                                           uint32_t argNum, const rword *args);
 
+/*! Stop each run after a number of instructions. The budget is decremented
+ *  by the JIT code at the end of each basic block (X86 and X86_64 only).
+ *  This method mustn't be called when the VM runs.
+ *
+ * @param[in] instance      VM instance.
+ * @param[in] instructions  The budget of each run, 0 for no limit.
+ *
+ * @return  True if the instruction budget is supported on this architecture.
+ */
+QBDI_EXPORT bool qbdi_setInstructionBudget(VMInstanceRef instance,
+                                           uint64_t instructions);
+
+/*! Stop each run after a delay.
+ *  This method mustn't be called when the VM runs.
+ *
+ * @param[in] instance      VM instance.
+ * @param[in] milliseconds  The delay of each run, 0 for no limit.
+ */
+QBDI_EXPORT void qbdi_setTimeBudget(VMInstanceRef instance,
+                                    uint64_t milliseconds);
+
+/*! Check if the last run has been stopped by its budget.
+ *
+ * @param[in] instance  VM instance.
+ *
+ * @return  True if the last run exhausted its budget.
+ */
+QBDI_EXPORT bool qbdi_isBudgetExhausted(VMInstanceRef instance);
+
 /*! Obtain the current general purpose register state.
  *
  * @param[in] instance  VM instance.
@@ -377,6 +422,21 @@ QBDI_EXPORT void qbdi_addInstrRuleData(InstrRuleDataVec cbks,
                                        InstPosition position, InstCallback cbk,
                                        void *data, int priority);
 
+/*! Add a callback for the current instruction, only called at the first
+ * execution of the instruction (see QBDI_CALLBACK_ONCE).
+ *
+ * @param[in] cbks      InstrRuleDataVec given in argument
+ * @param[in] position  Relative position of the callback
+ *                      (QBDI_PREINST / QBDI_POSTINST).
+ * @param[in] cbk       A function pointer to the callback
+ * @param[in] data      User defined data passed to the callback.
+ * @param[in] priority  Priority of the callback
+ */
+QBDI_EXPORT void qbdi_addInstrRuleDataOnce(InstrRuleDataVec cbks,
+                                           InstPosition position,
+                                           InstCallback cbk, void *data,
+                                           int priority);
+
 /*! Register a callback event for every memory access matching the type bitfield
  * made by the instructions.
  *
@@ -453,6 +513,26 @@ QBDI_EXPORT uint32_t qbdi_addMnemonicCB(VMInstanceRef instance,
                                         InstCallback cbk, void *data,
                                         int priority);
 
+/*! Register a callback event if the instruction matches the mnemonic, called
+ * only when a predicate holds.
+ *
+ * @param[in] instance   VM instance.
+ * @param[in] mnemonic   Mnemonic to match.
+ * @param[in] pos        Relative position of the event callback
+ *                       (QBDI_PREINST / QBDI_POSTINST).
+ * @param[in] cbk        A function pointer to the callback.
+ * @param[in] data       User defined data passed to the callback.
+ * @param[in] predicate  The condition of the callback.
+ * @param[in] priority   The priority of the callback.
+ *
+ * @return The id of the registered instrumentation (or QBDI_INVALID_EVENTID
+ * in case of failure).
+ */
+QBDI_EXPORT uint32_t qbdi_addMnemonicCBWithPredicate(
+    VMInstanceRef instance, const char *mnemonic, InstPosition pos,
+    InstCallback cbk, void *data, const CallbackPredicate *predicate,
+    int priority);
+
 /*! Register a callback event for a specific instruction event.
  *
  * @param[in] instance  VM instance.
@@ -504,6 +584,157 @@ QBDI_EXPORT uint32_t qbdi_addCodeRangeCB(VMInstanceRef instance, rword start,
                                          InstCallback cbk, void *data,
                                          int priority);
 
+/*! Register a callback event for every instruction executed, with a
+ * callback type.
+ *
+ * @param[in] instance  VM instance.
+ * @param[in] pos       Relative position of the event callback
+ *                      (QBDI_PREINST / QBDI_POSTINST).
+ * @param[in] cbk       A function pointer to the callback.
+ * @param[in] data      User defined data passed to the callback.
+ * @param[in] type      The type of the callback (QBDI_CALLBACK_DEFAULT /
+ *                      QBDI_CALLBACK_FAST, optionally with
+ *                      QBDI_CALLBACK_ONCE).
+ * @param[in] priority  The priority of the callback.
+ *
+ * @return The id of the registered instrumentation (or QBDI_INVALID_EVENTID
+ * in case of failure).
+ */
+QBDI_EXPORT uint32_t qbdi_addCodeCBWithType(VMInstanceRef instance,
+                                            InstPosition pos, InstCallback cbk,
+                                            void *data, CallbackType type,
+                                            int priority);
+
+/*! Register a callback for when a specific address is executed, with a
+ * callback type.
+ *
+ * @param[in] instance  VM instance.
+ * @param[in] address   Code address which will trigger the callback.
+ * @param[in] pos       Relative position of the callback
+ *                      (QBDI_PREINST / QBDI_POSTINST).
+ * @param[in] cbk       A function pointer to the callback.
+ * @param[in] data      User defined data passed to the callback.
+ * @param[in] type      The type of the callback (QBDI_CALLBACK_DEFAULT /
+ *                      QBDI_CALLBACK_FAST, optionally with
+ *                      QBDI_CALLBACK_ONCE).
+ * @param[in] priority  The priority of the callback.
+ *
+ * @return The id of the registered instrumentation (or QBDI_INVALID_EVENTID
+ * in case of failure).
+ */
+QBDI_EXPORT uint32_t qbdi_addCodeAddrCBWithType(VMInstanceRef instance,
+                                                rword address, InstPosition pos,
+                                                InstCallback cbk, void *data,
+                                                CallbackType type,
+                                                int priority);
+
+/*! Register a callback event for every instruction executed, called only when
+ * a predicate holds.
+ *
+ * @param[in] instance   VM instance.
+ * @param[in] pos        Relative position of the event callback
+ *                       (QBDI_PREINST / QBDI_POSTINST).
+ * @param[in] cbk        A function pointer to the callback.
+ * @param[in] data       User defined data passed to the callback.
+ * @param[in] predicate  The condition of the callback.
+ * @param[in] priority   The priority of the callback.
+ *
+ * @return The id of the registered instrumentation (or QBDI_INVALID_EVENTID
+ * in case of failure).
+ */
+QBDI_EXPORT uint32_t qbdi_addCodeCBWithPredicate(
+    VMInstanceRef instance, InstPosition pos, InstCallback cbk, void *data,
+    const CallbackPredicate *predicate, int priority);
+
+/*! Register a callback for when a specific address is executed, called only
+ * when a predicate holds.
+ *
+ * @param[in] instance   VM instance.
+ * @param[in] address    Code address which will trigger the callback.
+ * @param[in] pos        Relative position of the callback
+ *                       (QBDI_PREINST / QBDI_POSTINST).
+ * @param[in] cbk        A function pointer to the callback.
+ * @param[in] data       User defined data passed to the callback.
+ * @param[in] predicate  The condition of the callback.
+ * @param[in] priority   The priority of the callback.
+ *
+ * @return The id of the registered instrumentation (or QBDI_INVALID_EVENTID
+ * in case of failure).
+ */
+QBDI_EXPORT uint32_t qbdi_addCodeAddrCBWithPredicate(
+    VMInstanceRef instance, rword address, InstPosition pos, InstCallback cbk,
+    void *data, const CallbackPredicate *predicate, int priority);
+
+/*! Register a callback for when a specific address range is executed, with a
+ * callback type.
+ *
+ * @param[in] instance  VM instance.
+ * @param[in] start  Start of the address range which will trigger the callback.
+ * @param[in] end    End of the address range which will trigger the callback.
+ * @param[in] pos    Relative position of the callback
+ *                   (QBDI_PREINST / QBDI_POSTINST).
+ * @param[in] cbk       A function pointer to the callback.
+ * @param[in] data      User defined data passed to the callback.
+ * @param[in] type      The type of the callback (QBDI_CALLBACK_DEFAULT /
+ *                      QBDI_CALLBACK_FAST, optionally with
+ *                      QBDI_CALLBACK_ONCE).
+ * @param[in] priority  The priority of the callback.
+ *
+ * @return The id of the registered instrumentation (or QBDI_INVALID_EVENTID
+ * in case of failure).
+ */
+QBDI_EXPORT uint32_t qbdi_addCodeRangeCBWithType(VMInstanceRef instance,
+                                                 rword start, rword end,
+                                                 InstPosition pos,
+                                                 InstCallback cbk, void *data,
+                                                 CallbackType type,
+                                                 int priority);
+
+/*! Register an inline instrumentation on every instruction. The operations
+ * are compiled in the instrumented code on X86 and X86_64, and interpreted by
+ * the host on the other architectures.
+ *
+ * @param[in] instance  VM instance.
+ * @param[in] pos       Relative position of the instrumentation
+ *                      (QBDI_PREINST / QBDI_POSTINST).
+ * @param[in] ops       The operations of the instrumentation.
+ * @param[in] count     The number of operations.
+ * @param[in] cbk       The callback of the QBDI_INLINE_CALL operation, or
+ *                      NULL.
+ * @param[in] data      User defined data passed to the callback.
+ * @param[in] priority  The priority of the instrumentation.
+ *
+ * @return The id of the registered instrumentation (or QBDI_INVALID_EVENTID
+ * in case of failure).
+ */
+QBDI_EXPORT uint32_t qbdi_addInlineCB(VMInstanceRef instance, InstPosition pos,
+                                      const InlineOp *ops, size_t count,
+                                      InstCallback cbk, void *data,
+                                      int priority);
+
+/*! Register an inline instrumentation for a specific address range.
+ *
+ * @param[in] instance  VM instance.
+ * @param[in] start     Start of the address range.
+ * @param[in] end       End of the address range.
+ * @param[in] pos       Relative position of the instrumentation
+ *                      (QBDI_PREINST / QBDI_POSTINST).
+ * @param[in] ops       The operations of the instrumentation.
+ * @param[in] count     The number of operations.
+ * @param[in] cbk       The callback of the QBDI_INLINE_CALL operation, or
+ *                      NULL.
+ * @param[in] data      User defined data passed to the callback.
+ * @param[in] priority  The priority of the instrumentation.
+ *
+ * @return The id of the registered instrumentation (or QBDI_INVALID_EVENTID
+ * in case of failure).
+ */
+QBDI_EXPORT uint32_t qbdi_addInlineRangeCB(VMInstanceRef instance, rword start,
+                                           rword end, InstPosition pos,
+                                           const InlineOp *ops, size_t count,
+                                           InstCallback cbk, void *data,
+                                           int priority);
+
 /*! Register a callback event for a specific VM event.
  *
  * @param[in] instance  VM instance.
@@ -527,6 +758,49 @@ QBDI_EXPORT uint32_t qbdi_addVMEventCB(VMInstanceRef instance, VMEvent mask,
 QBDI_EXPORT bool qbdi_deleteInstrumentation(VMInstanceRef instance,
                                             uint32_t id);
 
+/*! Call a callback once every period executions instead of each execution.
+ * Only the first call on an InstrRule flushes its range from the cache.
+ *
+ * @param[in] instance    VM instance.
+ * @param[in] id          The id of an instruction callback, an InstrRule or a
+ *                        VMEvent callback.
+ * @param[in] period      Call the callback once every period executions.
+ * @param[in] randomized  Draw each period uniformly between 1 and
+ *                        (2 * period - 1) instead of a fixed period.
+ *
+ * @return True if the callback can be sampled.
+ */
+QBDI_EXPORT bool qbdi_setCallbackSampling(VMInstanceRef instance, uint32_t id,
+                                          uint32_t period, bool randomized);
+
+/*! Enable or disable an instrumentation without removing it. The instruction
+ * callbacks are called through a patchable slot: only the first call on a
+ * callback flushes its range from the cache.
+ *
+ * @param[in] instance  VM instance.
+ * @param[in] id        The id of an instruction callback or a VMEvent
+ *                      callback.
+ * @param[in] enabled   Call the callback.
+ *
+ * @return True if the instrumentation can be disabled.
+ */
+QBDI_EXPORT bool qbdi_setInstrumentationEnabled(VMInstanceRef instance,
+                                                uint32_t id, bool enabled);
+
+/*! Change the data pointer given to the callbacks of an instrumentation.
+ * The range of the instrumentation is flushed from the cache, unless its
+ * callbacks are called through a patchable slot.
+ *
+ * @param[in] instance  VM instance.
+ * @param[in] id        The id of an instruction callback, an InstrRule or a
+ *                      VMEvent callback.
+ * @param[in] data      The new data pointer.
+ *
+ * @return True if the data pointer has been changed.
+ */
+QBDI_EXPORT bool qbdi_setInstrumentationData(VMInstanceRef instance,
+                                             uint32_t id, void *data);
+
 /*! Remove all the registered instrumentations.
  *
  * @param[in] instance  VM instance.
@@ -620,6 +894,32 @@ QBDI_EXPORT MemoryAccess *qbdi_getInstMemoryAccess(VMInstanceRef instance,
 QBDI_EXPORT MemoryAccess *qbdi_getBBMemoryAccess(VMInstanceRef instance,
                                                  size_t *size);
 
+/*! Write the memory accesses in a buffer with inline instrumentation
+ *  (X86_64 only). The callback is called with the content of the buffer when
+ *  the buffer is full and when the execution of the VM ends. This method
+ *  mustn't be called when the VM runs.
+ *
+ *  @param[in]  instance     VM instance.
+ *  @param[in]  buffer       The buffer where the accesses are written.
+ *  @param[in]  size         The number of accesses of the buffer.
+ *  @param[in]  cbk          The callback called when the buffer must be
+ *                           flushed.
+ *  @param[in]  data         User defined data passed to the callback.
+ *
+ * @return True if the memory trace is supported, False if not or in case of
+ *         error.
+ */
+QBDI_EXPORT bool qbdi_setMemoryTrace(VMInstanceRef instance,
+                                     MemoryAccess *buffer, size_t size,
+                                     MemoryTraceCallback cbk, void *data);
+
+/*! Flush the pending accesses of the memory trace and remove it.
+ *  This method mustn't be called when the VM runs.
+ *
+ *  @param[in]  instance     VM instance.
+ */
+QBDI_EXPORT void qbdi_removeMemoryTrace(VMInstanceRef instance);
+
 /*! Pre-cache a known basic block
  *  This method mustn't be called when the VM runs.
  *
@@ -646,8 +946,9 @@ QBDI_EXPORT void qbdi_clearCache(VMInstanceRef instance, rword start,
  */
 QBDI_EXPORT void qbdi_clearAllCache(VMInstanceRef instance);
 
-/*! Get the number of ExecBlock in the cache. Each block uses 2 memory pages
- * and some heap allocations.
+/*! Get the number of ExecBlock in the cache. Each block uses a code and a data
+ * block (one page each by default, see qbdi_setExecBlockSize) and some heap
+ * allocations.
  *
  * @param[in] instance     VM instance.
  *
@@ -665,6 +966,88 @@ QBDI_EXPORT uint32_t qbdi_getNbExecBlock(const VMInstanceRef instance);
  */
 QBDI_EXPORT void qbdi_reduceCacheTo(VMInstanceRef instance, uint32_t nb);
 
+/*! Set the size of the code and the data blocks of the ExecBlocks. The cache
+ * is cleared. This method mustn't be called when the VM runs.
+ *
+ * @param[in] instance   VM instance.
+ * @param[in] codeSize   The size of the code blocks, a multiple of the page
+ *                       size (0 for one page).
+ * @param[in] dataSize   The size of the data blocks, a multiple of the page
+ *                       size (0 for the default).
+ * @param[in] hugePages  Back each code block with a 2 MiB transparent huge
+ *                       page (Linux and Android only).
+ *
+ * @return True if the sizes are supported, False if not.
+ */
+QBDI_EXPORT bool qbdi_setExecBlockSize(VMInstanceRef instance,
+                                       uint32_t codeSize, uint32_t dataSize,
+                                       bool hugePages);
+
+/*! Get the counters of the indirect branch target cache. This cache is used
+ * with the option OPT_ENABLE_BLOCK_CHAINING to resolve the target of the
+ * indirect branches (RET, JMP and CALL to a register or a memory value)
+ * without returning to the host (X86 and X86_64 only).
+ *
+ * @param[in]  instance  VM instance.
+ * @param[out] hits      The number of indirect branches resolved in the
+ *                       cache or in the return stack. (may be NULL)
+ * @param[out] misses    The number of indirect branches that returned to the
+ *                       host. (may be NULL)
+ */
+QBDI_EXPORT void qbdi_getIndirectCacheStats(const VMInstanceRef instance,
+                                            uint64_t *hits, uint64_t *misses);
+
+/*! Get the execution counters of the basic blocks. The counters are
+ * incremented by the JIT code with the option OPT_ENABLE_BLOCK_PROFILE
+ * (X86_64 only), and are kept when the cache is cleared.
+ * Return NULL and a size of 0 if no basic block was counted.
+ *
+ * @param[in]  instance  VM instance.
+ * @param[out] size      Will be set to the number of elements in the
+ *                       returned array.
+ *
+ * @return An array with the counter of each basic block. The array must be
+ *         released with free.
+ */
+QBDI_EXPORT BlockProfile *qbdi_getBlockProfile(const VMInstanceRef instance,
+                                               size_t *size);
+
+/*! Pre-cache the basic blocks of a module, discovered from its entry point
+ * and its exported functions (ELF modules only). The basic blocks are
+ * translated synchronously. This method mustn't be called when the VM runs.
+ *
+ * @param[in] instance  VM instance.
+ * @param[in] name      The name of the module.
+ * @param[in] strategy  The strategy to discover the basic blocks.
+ *
+ * @return The number of basic blocks inserted in the cache.
+ */
+QBDI_EXPORT uint32_t qbdi_precacheModule(VMInstanceRef instance,
+                                         const char *name,
+                                         PrecacheStrategy strategy);
+
+/*! Write an AFL-compatible edge coverage in a bitmap. The JIT code increments
+ *  the byte of the edge between the previous basic block and the current one
+ *  at the beginning of each basic block (X86 and X86_64 only).
+ *  This method mustn't be called when the VM runs.
+ *
+ *  @param[in]  instance     VM instance.
+ *  @param[in]  bitmap       The bitmap.
+ *  @param[in]  size         The size of the bitmap, a power of two.
+ *
+ * @return True if the edge coverage is supported, False if not or in case of
+ *         error.
+ */
+QBDI_EXPORT bool qbdi_setCoverageBitmap(VMInstanceRef instance, uint8_t *bitmap,
+                                        size_t size);
+
+/*! Stop writing the edge coverage.
+ *  This method mustn't be called when the VM runs.
+ *
+ *  @param[in]  instance     VM instance.
+ */
+QBDI_EXPORT void qbdi_removeCoverageBitmap(VMInstanceRef instance);
+
 #ifdef __cplusplus
 } // "C"
 } // QBDI::
@@ -45,6 +45,54 @@ typedef enum {
                                                       */
   _QBDI_EI(OPT_DISABLE_ERRNO_BACKUP) = 1 << 3, /*!< Don't save and restore errno
                                                 */
+  _QBDI_EI(OPT_ENABLE_BLOCK_CHAINING) = 1 << 4, /*!< Link the cached sequences
+                                                 * together and jump directly
+                                                 * from a sequence to its
+                                                 * successor when possible.
+                                                 * Only the sequences of the
+                                                 * same ExecBlock are linked,
+                                                 * a jump to another
+                                                 * ExecBlock still returns to
+                                                 * the host.
+                                                 * Only supported on X86 and
+                                                 * X86_64, ignored otherwise.
+                                                 */
+  _QBDI_EI(OPT_ENABLE_TRACE_FORMATION) = 1 << 5, /*!< Form the hot traces
+                                                  * across the sequences and
+                                                  * write them as one
+                                                  * sequence. Needs
+                                                  * OPT_ENABLE_BLOCK_CHAINING.
+                                                  * Only supported on X86 and
+                                                  * X86_64, ignored otherwise.
+                                                  */
+  _QBDI_EI(OPT_ENABLE_SHARED_CONTEXT) = 1 << 6, /*!< Store the guest GPR and
+                                                 * FPR state in one context
+                                                 * shared by all the
+                                                 * ExecBlocks, to avoid a
+                                                 * copy of the state when the
+                                                 * execution changes of
+                                                 * ExecBlock.
+                                                 * Only supported on X86 and
+                                                 * X86_64, ignored otherwise.
+                                                 */
+  _QBDI_EI(OPT_ENABLE_BLOCK_PROFILE) = 1 << 7, /*!< Count the executions of
+                                                * each basic block with an
+                                                * inline counter. The counters
+                                                * are returned by
+                                                * VM::getBlockProfile.
+                                                * Only supported on X86_64,
+                                                * ignored otherwise.
+                                                */
+  _QBDI_EI(OPT_ENABLE_DUAL_MAPPING) = 1 << 8, /*!< Map the code of the
+                                               * ExecBlocks twice, writable
+                                               * and executable, instead of
+                                               * changing its permissions
+                                               * for each write. The code is
+                                               * shared with the forked
+                                               * processes. Only supported on
+                                               * Linux and Android, ignored
+                                               * otherwise.
+                                               */
   // architecture specific option between 24 and 31
   _QBDI_EI(OPT_ATT_SYNTAX) = 1 << 24,   /*!< Used the AT&T syntax for
                                          * instruction disassembly
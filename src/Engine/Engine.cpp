@@ -16,21 +16,33 @@
  * limitations under the License.
  */
 #include <algorithm>
+#include <chrono>
 #include <cstdint>
+#include <limits>
+#include <set>
 #include <string.h>
 
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/MC/MCInst.h"
+#include "llvm/MC/MCInstrDesc.h"
+#include "llvm/MC/MCInstrInfo.h"
 
 #include "Engine/Engine.h"
 #include "Engine/LLVMCPU.h"
+#include "Engine/ModuleEntries.h"
 
 #include "ExecBlock/Context.h"
 #include "ExecBlock/ExecBlock.h"
 #include "ExecBlock/ExecBlockManager.h"
 #include "ExecBroker/ExecBroker.h"
+#if defined(QBDI_ARCH_X86_64) || defined(QBDI_ARCH_X86)
+#include "ExecBlock/X86_64/XSave_X86_64.h"
+#endif
+#include "Patch/InstInfo.h"
 #include "Patch/InstMetadata.h"
 #include "Patch/InstrRule.h"
+#include "Patch/InstrRules.h"
+#include "Patch/MemoryAccess.h"
 #include "Patch/Patch.h"
 #include "Patch/PatchRuleAssembly.h"
 #include "Utility/LogSys.h"
@@ -49,14 +61,73 @@
 
 namespace QBDI {
 
+// Maximal number of sequences in a hot trace
+static const size_t TRACE_MAX_SEQUENCES = 16;
+
+// Number of instructions between two checks of the time budget
+static const uint64_t TIME_BUDGET_SLICE = 1 << 16;
+
+namespace {
+
+void loadBudgetSlice(RunBudget &budget) {
+  uint64_t slice = std::numeric_limits<rword>::max();
+  if (budget.milliseconds != 0) {
+    slice = TIME_BUDGET_SLICE;
+  }
+  slice = std::min(slice, budget.remaining);
+  budget.remaining -= slice;
+  budget.countdown = static_cast<rword>(slice);
+}
+
+void startBudget(RunBudget &budget) {
+  budget.exhausted = false;
+  budget.remaining = (budget.instructions != 0)
+                         ? budget.instructions
+                         : std::numeric_limits<uint64_t>::max();
+  if (budget.milliseconds != 0) {
+    budget.deadline = std::chrono::steady_clock::now() +
+                      std::chrono::milliseconds(budget.milliseconds);
+  }
+  loadBudgetSlice(budget);
+}
+
+bool isBudgetTimeout(RunBudget &budget) {
+  if (budget.milliseconds != 0 and
+      std::chrono::steady_clock::now() >= budget.deadline) {
+    budget.exhausted = true;
+  }
+  return budget.exhausted;
+}
+
+// Called by the JIT code when the countdown of the budget expires
+VMAction budgetExpiredCB(VMInstanceRef vm, GPRState *gprState,
+                         FPRState *fprState, void *data) {
+  RunBudget &budget = *static_cast<RunBudget *>(data);
+  if (budget.remaining == 0) {
+    QBDI_DEBUG("Instruction budget exhausted");
+    budget.exhausted = true;
+    return STOP;
+  }
+  if (isBudgetTimeout(budget)) {
+    QBDI_DEBUG("Time budget exhausted");
+    return STOP;
+  }
+  loadBudgetSlice(budget);
+  return CONTINUE;
+}
+
+} // namespace
+
 Engine::Engine(const std::string &_cpu, const std::vector<std::string> &_mattrs,
                Options opts, VMInstanceRef vminstance)
     : vminstance(vminstance), instrRulesCounter(0), vmCallbacksCounter(0),
       curCPUMode(CPUMode::DEFAULT), options(opts), eventMask(VMEvent::NO_EVENT),
-      running(false) {
+      running(false), traceRecording(false), traceHead(0) {
 
   llvmCPUs = std::make_unique<LLVMCPUs>(_cpu, _mattrs, opts);
+  blockCounters = std::make_unique<BlockCounters>();
   blockManager = std::make_unique<ExecBlockManager>(*llvmCPUs, vminstance);
+  blockManager->setBlockCounters(blockCounters.get());
   execBroker = blockManager->getExecBroker();
 
   // Get Patch rules Assembly for this architecture
@@ -81,11 +152,18 @@ Engine::Engine(const Engine &other)
       vmCallbacks(other.vmCallbacks),
       vmCallbacksCounter(other.vmCallbacksCounter),
       curCPUMode(CPUMode::DEFAULT), options(other.options),
-      eventMask(other.eventMask), running(false) {
+      eventMask(other.eventMask), running(false), traceRecording(false),
+      traceHead(0) {
+
+  budget.instructions = other.budget.instructions;
+  budget.milliseconds = other.budget.milliseconds;
 
   llvmCPUs = std::make_unique<LLVMCPUs>(
       other.llvmCPUs->getCPU(), other.llvmCPUs->getMattrs(), other.options);
+  blockCounters = std::make_unique<BlockCounters>();
   blockManager = std::make_unique<ExecBlockManager>(*llvmCPUs, nullptr);
+  blockManager->setExecBlockSize(other.blockManager->getExecBlockSize());
+  blockManager->setBlockCounters(blockCounters.get());
   execBroker = blockManager->getExecBroker();
   // copy instrumentation range
   execBroker->setInstrumentedRange(other.execBroker->getInstrumentedRange());
@@ -106,10 +184,13 @@ Engine::Engine(const Engine &other)
   setFPRState(other.getFPRState());
 
   curExecBlock = nullptr;
+  updateBudgetGate();
 }
 
 Engine &Engine::operator=(const Engine &other) {
   QBDI_REQUIRE_ABORT(not running, "Cannot assign a running Engine");
+  this->removeMemoryTrace();
+  this->removeCoverageBitmap();
   this->clearAllCache();
 
   if (not llvmCPUs->isSameCPU(*other.llvmCPUs)) {
@@ -119,10 +200,12 @@ Engine &Engine::operator=(const Engine &other) {
         other.llvmCPUs->getCPU(), other.llvmCPUs->getMattrs(), other.options);
 
     blockManager = std::make_unique<ExecBlockManager>(*llvmCPUs, nullptr);
+    blockManager->setBlockCounters(blockCounters.get());
     execBroker = blockManager->getExecBroker();
   }
 
   this->setOptions(other.options);
+  blockManager->setExecBlockSize(other.blockManager->getExecBlockSize());
 
   // copy the configuration
   instrRules.clear();
@@ -133,6 +216,9 @@ Engine &Engine::operator=(const Engine &other) {
   instrRulesCounter = other.instrRulesCounter;
   vmCallbacksCounter = other.vmCallbacksCounter;
   eventMask = other.eventMask;
+  budget.instructions = other.budget.instructions;
+  budget.milliseconds = other.budget.milliseconds;
+  updateBudgetGate();
 
   // copy instrumentation range
   execBroker->setInstrumentedRange(other.execBroker->getInstrumentedRange());
@@ -155,11 +241,16 @@ void Engine::setOptions(Options options) {
     if (patchRuleAssembly->changeOptions(options)) {
       const RangeSet<rword> instrumentationRange =
           execBroker->getInstrumentedRange();
+      const ExecBlockSize blockSize = blockManager->getExecBlockSize();
 
       blockManager = std::make_unique<ExecBlockManager>(*llvmCPUs, vminstance);
+      blockManager->setExecBlockSize(blockSize);
       execBroker = blockManager->getExecBroker();
 
       execBroker->setInstrumentedRange(instrumentationRange);
+      updateBudgetGate();
+      blockManager->setCoverageBitmap(coverage.get());
+      blockManager->setBlockCounters(blockCounters.get());
     }
     this->options = options;
   }
@@ -188,12 +279,18 @@ void Engine::initFPRState() {
   fprState->rsrv1 = 0x0;
   fprState->mxcsr = 0x1F80;
   fprState->mxcsrmask = 0xFFFF;
+  resetFPRStateHeader(fprState.get());
 #endif
 }
 
 GPRState *Engine::getGPRState() const { return curGPRState; }
 
-FPRState *Engine::getFPRState() const { return curFPRState; }
+FPRState *Engine::getFPRState() const {
+#if defined(QBDI_ARCH_X86_64) || defined(QBDI_ARCH_X86)
+  completeFPRState(curFPRState);
+#endif
+  return curFPRState;
+}
 
 void Engine::setGPRState(const GPRState *gprState) {
   QBDI_REQUIRE_ACTION(gprState, return);
@@ -203,6 +300,9 @@ void Engine::setGPRState(const GPRState *gprState) {
 void Engine::setFPRState(const FPRState *fprState) {
   QBDI_REQUIRE_ACTION(fprState, return);
   *(this->curFPRState) = *fprState;
+#if defined(QBDI_ARCH_X86_64) || defined(QBDI_ARCH_X86)
+  resetFPRStateHeader(this->curFPRState);
+#endif
 }
 
 bool Engine::isPreInst() const {
@@ -218,34 +318,47 @@ bool Engine::isPreInst() const {
 
 void Engine::addInstrumentedRange(rword start, rword end) {
   execBroker->addInstrumentedRange(Range<rword>(start, end, real_addr_t()));
+  blockManager->resetChains();
 }
 
 bool Engine::addInstrumentedModule(const std::string &name) {
-  return execBroker->addInstrumentedModule(name);
+  bool res = execBroker->addInstrumentedModule(name);
+  blockManager->resetChains();
+  return res;
 }
 
 bool Engine::addInstrumentedModuleFromAddr(rword addr) {
-  return execBroker->addInstrumentedModuleFromAddr(addr);
+  bool res = execBroker->addInstrumentedModuleFromAddr(addr);
+  blockManager->resetChains();
+  return res;
 }
 
 bool Engine::instrumentAllExecutableMaps() {
-  return execBroker->instrumentAllExecutableMaps();
+  bool res = execBroker->instrumentAllExecutableMaps();
+  blockManager->resetChains();
+  return res;
 }
 
 void Engine::removeInstrumentedRange(rword start, rword end) {
   execBroker->removeInstrumentedRange(Range<rword>(start, end, real_addr_t()));
+  blockManager->resetChains();
 }
 
 bool Engine::removeInstrumentedModule(const std::string &name) {
-  return execBroker->removeInstrumentedModule(name);
+  bool res = execBroker->removeInstrumentedModule(name);
+  blockManager->resetChains();
+  return res;
 }
 
 bool Engine::removeInstrumentedModuleFromAddr(rword addr) {
-  return execBroker->removeInstrumentedModuleFromAddr(addr);
+  bool res = execBroker->removeInstrumentedModuleFromAddr(addr);
+  blockManager->resetChains();
+  return res;
 }
 
 void Engine::removeAllInstrumentedRanges() {
   execBroker->removeAllInstrumentedRanges();
+  blockManager->resetChains();
 }
 
 std::vector<Patch> Engine::patch(rword start) {
@@ -344,6 +457,10 @@ void Engine::instrument(std::vector<Patch> &basicBlock, size_t patchEnd) {
         QBDI_DEBUG("Instrumentation rule {:x} applied", item.first);
       }
     }
+    for (const auto &rule : memoryTraceRules) {
+      rule->tryInstrument(patch, llvmcpu);
+    }
+    coalesceCallbacks(patch);
     patch.finalizeInstsPatch();
   }
 }
@@ -359,6 +476,50 @@ void Engine::handleNewBasicBlock(rword pc) {
   blockManager->writeBasicBlock(std::move(basicBlock), patchEnd);
 }
 
+void Engine::handleNewTrace() {
+  // disassemble and patch the sequences of the path
+  Patch::Vec trace;
+  for (const auto &seq : tracePath) {
+    Patch::Vec basicBlock = patch(seq.first);
+    for (Patch &p : basicBlock) {
+      if (p.metadata.address >= seq.second) {
+        break;
+      }
+      trace.push_back(std::move(p));
+    }
+  }
+  // Get the part of the trace in the region of its head
+  size_t patchEnd = blockManager->preWriteTrace(trace);
+  if (patchEnd == 0) {
+    return;
+  }
+  // instrument the trace
+  instrument(trace, patchEnd);
+  // Write in the cache
+  blockManager->writeTrace(std::move(trace), patchEnd);
+}
+
+void Engine::startTraceRecording(rword head, rword seqEnd) {
+  QBDI_DEBUG("Record the trace of hot address 0x{:x}", head);
+  traceRecording = true;
+  traceHead = head;
+  tracePath.clear();
+  tracePath.emplace_back(head, seqEnd);
+  // each sequence must return to the host while the path is recorded
+  updateChaining();
+}
+
+void Engine::stopTraceRecording(bool writeTrace) {
+  QBDI_DEBUG("{} the trace of 0x{:x} ({} sequences)",
+             writeTrace ? "Write" : "Drop", traceHead, tracePath.size());
+  if (writeTrace) {
+    handleNewTrace();
+  }
+  traceRecording = false;
+  tracePath.clear();
+  updateChaining();
+}
+
 bool Engine::precacheBasicBlock(rword pc) {
   QBDI_REQUIRE_ABORT(pc == strip_ptrauth(pc),
                      "Internal Error, unsupported authenticated pointer");
@@ -407,6 +568,19 @@ bool Engine::run(rword start, rword stop) {
 
   running = true;
 
+  budget.exhausted = false;
+  if (budget.instructions != 0 or budget.milliseconds != 0) {
+    startBudget(budget);
+  }
+  // each run begins a new path in the edge coverage
+  if (coverage) {
+    *coverage->prev = 0;
+  }
+
+  // The execution must return to the host at the stop address
+  blockManager->setChainStop(stop);
+  updateChaining();
+
   // Execute basic block per basic block
   do {
     VMAction action = CONTINUE;
@@ -434,6 +608,10 @@ bool Engine::run(rword start, rword stop) {
       basicBlockBeginAddr = 0;
       basicBlockEndAddr = 0;
 
+      if (traceRecording) {
+        stopTraceRecording(false);
+      }
+
       QBDI_DEBUG("Executing 0x{:x} through execBroker", currentPC);
       action = signalEvent(EXEC_TRANSFER_CALL, currentPC, nullptr, 0,
                            curGPRState, curFPRState);
@@ -481,6 +659,15 @@ bool Engine::run(rword start, rword stop) {
         blockManager->flushCommit();
       }
 
+      // The recorded path ends when it loops to its head or reaches another
+      // trace
+      if (traceRecording and
+          (currentPC == traceHead or
+           tracePath.size() >= TRACE_MAX_SEQUENCES or
+           blockManager->isTraceHead(currentPC, curCPUMode))) {
+        stopTraceRecording(true);
+      }
+
       // Test if we have it in cache
       SeqLoc currentSequence;
       curExecBlock = blockManager->getProgrammedExecBlock(currentPC, curCPUMode,
@@ -499,20 +686,27 @@ bool Engine::run(rword start, rword stop) {
                            "Fail to instrument the next basic block");
       }
 
+      if (traceRecording) {
+        tracePath.emplace_back(currentPC, currentSequence.seqEnd);
+      } else if (blockManager->countTraceHead(currentPC, curCPUMode)) {
+        startTraceRecording(currentPC, currentSequence.seqEnd);
+      }
+
       if (basicBlockEndAddr == 0) {
         event |= BASIC_BLOCK_ENTRY;
         basicBlockEndAddr = currentSequence.bbEnd;
         basicBlockBeginAddr = currentPC;
       }
 
-      // Set context if necessary
-      if (&(curExecBlock->getContext()->gprState) != curGPRState ||
-          &(curExecBlock->getContext()->fprState) != curFPRState) {
-        curExecBlock->getContext()->gprState = *curGPRState;
-        curExecBlock->getContext()->fprState = *curFPRState;
+      // Set context if necessary. The ExecBlocks that use the shared context
+      // already have the current state.
+      if (curExecBlock->getGPRState() != curGPRState ||
+          curExecBlock->getFPRState() != curFPRState) {
+        *curExecBlock->getGPRState() = *curGPRState;
+        *curExecBlock->getFPRState() = *curFPRState;
       }
-      curGPRState = &(curExecBlock->getContext()->gprState);
-      curFPRState = &(curExecBlock->getContext()->fprState);
+      curGPRState = curExecBlock->getGPRState();
+      curFPRState = curExecBlock->getFPRState();
 
       action = signalEvent(event, currentPC, &currentSequence,
                            basicBlockBeginAddr, curGPRState, curFPRState);
@@ -535,6 +729,12 @@ bool Engine::run(rword start, rword stop) {
         }
       }
     }
+    // The time budget is also checked at each return to the host
+    if (action != STOP and budget.milliseconds != 0 and
+        isBudgetTimeout(budget)) {
+      QBDI_DEBUG("Time budget exhausted");
+      action = STOP;
+    }
     if (action == STOP) {
       QBDI_DEBUG("Receive STOP Action");
       break;
@@ -543,6 +743,9 @@ bool Engine::run(rword start, rword stop) {
       basicBlockBeginAddr = 0;
       basicBlockEndAddr = 0;
       curExecBlock = nullptr;
+      if (traceRecording) {
+        stopTraceRecording(false);
+      }
     }
     // Get next block PC
     currentPC = QBDI_GPR_GET(curGPRState, REG_PC);
@@ -562,11 +765,18 @@ bool Engine::run(rword start, rword stop) {
                stop);
   } while (currentPC != stop);
 
+  if (traceRecording) {
+    stopTraceRecording(false);
+  }
+
   // Copy final context
   *gprState = *curGPRState;
   *fprState = *curFPRState;
   curGPRState = gprState.get();
   curFPRState = fprState.get();
+#if defined(QBDI_ARCH_X86_64) || defined(QBDI_ARCH_X86)
+  completeFPRState(curFPRState);
+#endif
   curExecBlock = nullptr;
   running = false;
 
@@ -574,6 +784,10 @@ bool Engine::run(rword start, rword stop) {
     blockManager->flushCommit();
   }
 
+  if (memoryTrace) {
+    flushMemoryTrace(vminstance, *memoryTrace);
+  }
+
   return hasRan;
 }
 
@@ -613,8 +827,10 @@ InstrRule *Engine::getInstrRule(uint32_t id) {
 uint32_t Engine::addVMEventCB(VMEvent mask, VMCallback cbk, void *data) {
   uint32_t id = vmCallbacksCounter++;
   QBDI_REQUIRE_ACTION(id < EVENTID_VM_MASK, return VMError::INVALID_EVENTID);
-  vmCallbacks.emplace_back(id, CallbackRegistration{mask, cbk, data});
+  vmCallbacks.emplace_back(id,
+                           CallbackRegistration{mask, cbk, data, {}, true});
   eventMask |= mask;
+  updateChaining();
   return id | EVENTID_VM_MASK;
 }
 
@@ -633,12 +849,114 @@ bool Engine::setVMEventCB(uint32_t id, VMCallback cbk, void *data) {
   }
 }
 
+bool Engine::setCallbackSampling(uint32_t id, uint32_t period,
+                                 bool randomized) {
+  if (id & EVENTID_VM_MASK) {
+    for (auto &item : vmCallbacks) {
+      if (id == (item.first | EVENTID_VM_MASK)) {
+        item.second.sampler.setPeriod(period, randomized);
+        return true;
+      }
+    }
+  } else {
+    for (auto &item : instrRules) {
+      if (item.first == id) {
+        InstrRule *rule = item.second.get();
+        bool sampled = rule->isSampled();
+        if (not rule->setSampling(period, randomized)) {
+          return false;
+        }
+        // the countdown is read by the JIT code, only the first change of
+        // the instrumentation needs to flush the cache
+        if (not sampled) {
+          this->clearCache(rule->affectedRange());
+        }
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool Engine::setInstrumentationEnabled(uint32_t id, bool enabled) {
+  if (id & EVENTID_VM_MASK) {
+    for (auto &item : vmCallbacks) {
+      if (id == (item.first | EVENTID_VM_MASK)) {
+        item.second.enabled = enabled;
+        return true;
+      }
+    }
+  } else {
+    for (auto &item : instrRules) {
+      if (item.first == id) {
+        InstrRule *rule = item.second.get();
+        bool slotted = rule->hasSlot();
+        if (not rule->setEnabled(enabled)) {
+          return false;
+        }
+        // the slot is read by the JIT code, only the first change of the
+        // instrumentation needs to flush the cache
+        if (not slotted) {
+          this->clearCache(rule->affectedRange());
+        }
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool Engine::setInstrumentationData(uint32_t id, void *data) {
+  if (id & EVENTID_VM_MASK) {
+    for (auto &item : vmCallbacks) {
+      if (id == (item.first | EVENTID_VM_MASK)) {
+        item.second.data = data;
+        return true;
+      }
+    }
+  } else {
+    for (auto &item : instrRules) {
+      if (item.first == id) {
+        InstrRule *rule = item.second.get();
+        if (not rule->changeDataPtr(data)) {
+          return false;
+        }
+        // without a slot, the data pointer is embedded in the JIT code
+        if (not rule->hasSlot()) {
+          this->clearCache(rule->affectedRange());
+        }
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void Engine::updateChaining() {
+  // The sequence events need the host to regain control at the end of each
+  // sequence
+  const VMEvent sequenceEvents =
+      VMEvent::SEQUENCE_ENTRY | VMEvent::SEQUENCE_EXIT |
+      VMEvent::BASIC_BLOCK_ENTRY | VMEvent::BASIC_BLOCK_EXIT;
+
+  const bool chaining = (options & Options::OPT_ENABLE_BLOCK_CHAINING) != 0 and
+                        (eventMask & sequenceEvents) == 0;
+
+  blockManager->setTraceFormation(
+      (is_x86_64 or is_x86) and chaining and
+      (options & Options::OPT_ENABLE_TRACE_FORMATION) != 0);
+  blockManager->setChaining(chaining and not traceRecording);
+}
+
 VMAction Engine::signalEvent(VMEvent event, rword currentPC,
                              const SeqLoc *seqLoc, rword basicBlockBegin,
                              GPRState *gprState, FPRState *fprState) {
   if ((event & eventMask) == 0) {
     return CONTINUE;
   }
+#if defined(QBDI_ARCH_X86_64) || defined(QBDI_ARCH_X86)
+  completeFPRState(fprState);
+#endif
 
   VMState vmState{event, currentPC, currentPC, currentPC, currentPC, 0};
   if (seqLoc != nullptr) {
@@ -649,9 +967,9 @@ VMAction Engine::signalEvent(VMEvent event, rword currentPC,
   }
 
   VMAction action = CONTINUE;
-  for (const auto &item : vmCallbacks) {
-    const QBDI::CallbackRegistration &r = item.second;
-    if (event & r.mask) {
+  for (auto &item : vmCallbacks) {
+    QBDI::CallbackRegistration &r = item.second;
+    if (r.enabled and (event & r.mask) and r.sampler.sample()) {
       vmState.event = event;
       VMAction res = r.cbk(vminstance, &vmState, gprState, fprState, r.data);
       if (res > action) {
@@ -683,13 +1001,11 @@ const InstAnalysis *Engine::getInstAnalysis(rword address,
 
 std::optional<std::pair<const ExecBlock *, uint16_t>>
 Engine::getPatchInfoOfJit(rword address) const {
-  rword pageAddress = address & ~(ExecBlock::getPageSize() - 1);
-  QBDI_DEBUG("Search Patch address 0x{:x} with page address 0x{:x}", address,
-             pageAddress);
-  auto *e = blockManager->getExecBlockFromJitAddress(pageAddress);
+  QBDI_DEBUG("Search Patch address 0x{:x}", address);
+  auto *e = blockManager->getExecBlockFromJitAddress(address);
 
   if (e == nullptr) {
-    QBDI_DEBUG("No ExecBlock with page address 0x{:x}", pageAddress);
+    QBDI_DEBUG("No ExecBlock with JIT address 0x{:x}", address);
     return {};
   }
   uint16_t instId = e->getPatchAddressOfJit(address);
@@ -736,6 +1052,7 @@ void Engine::deleteAllInstrumentations() {
   instrRulesCounter = 0;
   vmCallbacksCounter = 0;
   eventMask = VMEvent::NO_EVENT;
+  updateChaining();
 }
 
 void Engine::clearAllCache() { blockManager->clearCache(not running); }
@@ -765,4 +1082,209 @@ void Engine::reduceCacheTo(uint32_t nb) {
   }
 }
 
+void Engine::getIndirectCacheStats(uint64_t *hits, uint64_t *misses) const {
+  uint64_t h, m;
+  blockManager->getIndirectCacheStats(h, m);
+  if (hits != nullptr) {
+    *hits = h;
+  }
+  if (misses != nullptr) {
+    *misses = m;
+  }
+}
+
+std::vector<BlockProfile> Engine::getBlockProfile() const {
+  return blockManager->getBlockProfile();
+}
+
+bool Engine::scanBasicBlock(rword pc, std::vector<rword> &successors) const {
+#if defined(QBDI_ARCH_ARM)
+  const CPUMode cpumode = pc & 1 ? CPUMode::Thumb : CPUMode::ARM;
+  pc &= (~1);
+#else
+  const CPUMode cpumode = CPUMode::DEFAULT;
+#endif
+  const LLVMCPU &llvmcpu = llvmCPUs->getCPU(cpumode);
+  const Range<rword> *curRange =
+      execBroker->getInstrumentedRange().getElementRange(pc);
+  if (curRange == nullptr) {
+    return false;
+  }
+  const llvm::ArrayRef<uint8_t> code((uint8_t *)pc, curRange->end() - pc);
+  rword address = pc;
+  while (address < curRange->end()) {
+    llvm::MCInst inst;
+    uint64_t instSize;
+    if (not llvmcpu.getInstruction(inst, instSize, code.slice(address - pc),
+                                   address)) {
+      // the basic block ends before an invalid instruction
+      return address != pc;
+    }
+    const llvm::MCInstrDesc &desc = llvmcpu.getMCII().get(inst.getOpcode());
+    if (desc.mayAffectControlFlow(inst, llvmcpu.getMRI())) {
+      getDirectSuccessors(inst, llvmcpu, address, instSize, successors);
+      return true;
+    }
+    address += instSize;
+  }
+  return true;
+}
+
+uint32_t Engine::precacheModule(const std::string &name,
+                                PrecacheStrategy strategy) {
+  QBDI_REQUIRE_ABORT(not running, "Cannot precacheModule on a running Engine");
+  if (name.empty()) {
+    return 0;
+  }
+  const RangeSet<rword> moduleRanges = getModuleExecRanges(name);
+  std::vector<rword> pending = getModuleEntryPoints(name);
+  if (strategy == PrecacheStrategy::PRECACHE_RECURSIVE) {
+    // the basic blocks already in the cache are known entries of the module
+    const std::vector<rword> cached = blockManager->getSequenceAddresses();
+    pending.insert(pending.end(), cached.begin(), cached.end());
+  }
+
+  // The basic blocks are translated one by one: the disassembler, the
+  // PatchRules and the InstrRules of the user are shared by the Engine.
+  std::set<rword> visited;
+  std::vector<rword> successors;
+  uint32_t count = 0;
+  while (not pending.empty()) {
+    const rword address = pending.back();
+    pending.pop_back();
+    // The thumb bit is kept in the address of the basic blocks
+    const rword pc = is_arm ? (address & ~static_cast<rword>(1)) : address;
+    if (not moduleRanges.contains(pc) or not execBroker->isInstrumented(pc) or
+        not visited.insert(address).second) {
+      continue;
+    }
+    // skip the addresses that don't begin with a valid instruction
+    successors.clear();
+    if (not scanBasicBlock(address, successors)) {
+      continue;
+    }
+    if (precacheBasicBlock(address)) {
+      count++;
+    }
+    if (strategy == PrecacheStrategy::PRECACHE_RECURSIVE) {
+      pending.insert(pending.end(), successors.begin(), successors.end());
+    }
+  }
+  QBDI_DEBUG("{} basic blocks of the module {} cached", count, name);
+  return count;
+}
+
+bool Engine::setMemoryTrace(MemoryAccess *buffer, size_t size,
+                            MemoryTraceCallback cbk, void *data) {
+  QBDI_REQUIRE_ABORT(not running,
+                     "Cannot setMemoryTrace on a running Engine");
+  removeMemoryTrace();
+
+  auto trace = std::make_unique<MemoryTrace>(
+      MemoryTrace{buffer, size, buffer, size, cbk, data});
+  std::vector<std::unique_ptr<InstrRule>> rules =
+      getInstrRuleMemoryTrace(trace.get());
+  if (rules.empty()) {
+    return false;
+  }
+  memoryTrace = std::move(trace);
+  memoryTraceRules = std::move(rules);
+  clearAllCache();
+  return true;
+}
+
+void Engine::removeMemoryTrace() {
+  QBDI_REQUIRE_ABORT(not running,
+                     "Cannot removeMemoryTrace on a running Engine");
+  if (not memoryTrace) {
+    return;
+  }
+  flushMemoryTrace(vminstance, *memoryTrace);
+  // the JIT code references the trace
+  clearAllCache();
+  memoryTraceRules.clear();
+  memoryTrace.reset();
+}
+
+bool Engine::setInstructionBudget(uint64_t instructions) {
+  QBDI_REQUIRE_ABORT(not running,
+                     "Cannot setInstructionBudget on a running Engine");
+  // The budget is decremented by the JIT code
+  if constexpr (not(is_x86_64 or is_x86)) {
+    return instructions == 0;
+  }
+  budget.instructions = instructions;
+  updateBudgetGate();
+  return true;
+}
+
+void Engine::setTimeBudget(uint64_t milliseconds) {
+  QBDI_REQUIRE_ABORT(not running, "Cannot setTimeBudget on a running Engine");
+  budget.milliseconds = milliseconds;
+  updateBudgetGate();
+}
+
+void Engine::updateBudgetGate() {
+  // Without the budget gate, the time budget is only checked when the
+  // execution returns to the host
+  bool enable = (is_x86_64 or is_x86) and
+                (budget.instructions != 0 or budget.milliseconds != 0);
+  if (enable == blockManager->hasBudgetGate()) {
+    return;
+  }
+  // the gate is written in the cached code
+  clearAllCache();
+  if (enable) {
+    blockManager->setBudgetGate(&budget.countdown, budgetExpiredCB, &budget);
+  } else {
+    blockManager->setBudgetGate(nullptr, nullptr, nullptr);
+  }
+}
+
+bool Engine::setCoverageBitmap(uint8_t *bitmap, size_t size) {
+  QBDI_REQUIRE_ABORT(not running,
+                     "Cannot setCoverageBitmap on a running Engine");
+  // The edges are incremented by the JIT code
+  if constexpr (not(is_x86_64 or is_x86)) {
+    return false;
+  }
+  if (bitmap == nullptr or size == 0 or (size & (size - 1)) != 0) {
+    QBDI_ERROR("The size of the coverage bitmap must be a power of two");
+    return false;
+  }
+  // the JIT code references the bitmap
+  clearAllCache();
+  coverage = std::make_unique<CoverageBitmap>(
+      CoverageBitmap{nullptr, 0, bitmap, static_cast<rword>(size - 1)});
+  blockManager->setCoverageBitmap(coverage.get());
+  return true;
+}
+
+void Engine::removeCoverageBitmap() {
+  QBDI_REQUIRE_ABORT(not running,
+                     "Cannot removeCoverageBitmap on a running Engine");
+  if (not coverage) {
+    return;
+  }
+  clearAllCache();
+  blockManager->setCoverageBitmap(nullptr);
+  coverage.reset();
+}
+
+bool Engine::setExecBlockSize(uint32_t codeSize, uint32_t dataSize,
+                              bool hugePages) {
+  QBDI_REQUIRE_ABORT(not running,
+                     "Cannot setExecBlockSize on a running Engine");
+  ExecBlockSize size{codeSize, dataSize, hugePages};
+  if (not ExecBlock::isValidSize(size)) {
+    QBDI_ERROR("Unsupported ExecBlock size (code: {}, data: {}, huge pages: "
+               "{})",
+               codeSize, dataSize, hugePages);
+    return false;
+  }
+  clearAllCache();
+  blockManager->setExecBlockSize(size);
+  return true;
+}
+
 } // namespace QBDI
@@ -18,6 +18,7 @@
 #ifndef ENGINE_H
 #define ENGINE_H
 
+#include <chrono>
 #include <cstdlib>
 #include <memory>
 #include <optional>
@@ -26,6 +27,8 @@
 #include <utility>
 #include <vector>
 
+#include "Utility/CallbackSampler.h"
+
 #include "QBDI/Callback.h"
 #include "QBDI/InstAnalysis.h"
 #include "QBDI/Options.h"
@@ -35,10 +38,13 @@
 namespace QBDI {
 
 class LLVMCPUs;
+struct BlockCounters;
+struct CoverageBitmap;
 class ExecBlock;
 class ExecBlockManager;
 class ExecBroker;
 class InstrRule;
+struct MemoryTrace;
 class Patch;
 class PatchRuleAssembly;
 struct SeqLoc;
@@ -47,6 +53,23 @@ struct CallbackRegistration {
   VMEvent mask;
   VMCallback cbk;
   void *data;
+  CallbackSampler sampler;
+  bool enabled;
+};
+
+/*! Instruction and time budget of a run. The countdown is decremented by the
+ * JIT code at the end of each basic block and is reloaded with a slice of the
+ * budget when it expires.
+ */
+struct RunBudget {
+  // configuration, 0 if unlimited
+  uint64_t instructions = 0;
+  uint64_t milliseconds = 0;
+  // state of the current run
+  rword countdown = 0;
+  uint64_t remaining = 0;
+  std::chrono::steady_clock::time_point deadline;
+  bool exhausted = false;
 };
 
 class Engine {
@@ -70,6 +93,20 @@ private:
   Options options;
   VMEvent eventMask;
   bool running;
+  // path of the hot trace being recorded (start and end of each sequence)
+  bool traceRecording;
+  rword traceHead;
+  std::vector<std::pair<rword, rword>> tracePath;
+  // memory trace written by the JIT code, not copied with the Engine
+  std::unique_ptr<MemoryTrace> memoryTrace;
+  std::vector<std::unique_ptr<InstrRule>> memoryTraceRules;
+  // the countdown is referenced by the JIT code of the ExecBlockManager
+  RunBudget budget;
+  // edge coverage written by the JIT code, not copied with the Engine
+  std::unique_ptr<CoverageBitmap> coverage;
+  // counters of the block profile written by the JIT code, kept when the
+  // ExecBlockManager is created again and not copied with the Engine
+  std::unique_ptr<BlockCounters> blockCounters;
 
   std::vector<Patch> patch(rword start);
 
@@ -78,11 +115,23 @@ private:
 
   void instrument(std::vector<Patch> &basicBlock, size_t patchEnd);
   void handleNewBasicBlock(rword pc);
+  void handleNewTrace();
+
+  // Decode the basic block at an address without patching it and add its
+  // direct successors. Return false if the first instruction is invalid.
+  bool scanBasicBlock(rword pc, std::vector<rword> &successors) const;
+
+  void startTraceRecording(rword head, rword seqEnd);
+  void stopTraceRecording(bool writeTrace);
 
   VMAction signalEvent(VMEvent kind, rword currentPC, const SeqLoc *seqLoc,
                        rword basicBlockBegin, GPRState *gprState,
                        FPRState *fprState);
 
+  void updateChaining();
+
+  void updateBudgetGate();
+
 public:
   /*! Construct a new Engine for a given CPU with specific attributes
    *
@@ -247,6 +296,40 @@ public:
    */
   bool setVMEventCB(uint32_t id, VMCallback cbk, void *data);
 
+  /*! Call a callback once every period executions. The first call
+   * re-instruments the affected range of an InstrRule, the following calls
+   * only change the period.
+   *
+   * @param[in] id         The id of the instrumentation.
+   * @param[in] period     The period of the callback.
+   * @param[in] randomized Randomize each period around the given period.
+   *
+   * @return True if the id is valid and the callback can be sampled.
+   */
+  bool setCallbackSampling(uint32_t id, uint32_t period, bool randomized);
+
+  /*! Enable or disable an instrumentation. The first call re-instruments the
+   * affected range of an InstrRule with a patchable slot, the following calls
+   * only arm or disarm the slot.
+   *
+   * @param[in] id       The id of the instrumentation.
+   * @param[in] enabled  Call the callbacks of the instrumentation.
+   *
+   * @return True if the id is valid and the instrumentation can be disabled.
+   */
+  bool setInstrumentationEnabled(uint32_t id, bool enabled);
+
+  /*! Change the data pointer of an instrumentation. The affected range of an
+   * InstrRule is re-instrumented, unless its callbacks read the data pointer
+   * from a patchable slot.
+   *
+   * @param[in] id    The id of the instrumentation.
+   * @param[in] data  The new data pointer.
+   *
+   * @return True if the id is valid and the data pointer has been changed.
+   */
+  bool setInstrumentationData(uint32_t id, void *data);
+
   /*! Remove an instrumentation.
    *
    * @param[in] id The id of the instrumentation to remove.
@@ -335,6 +418,90 @@ public:
    *               after call.
    */
   void reduceCacheTo(uint32_t nb);
+
+  /*! Get the counters of the indirect branch target cache.
+   *
+   * @param[out] hits    The number of indirect branches resolved in the JIT.
+   * @param[out] misses  The number of indirect branches resolved by the host.
+   */
+  void getIndirectCacheStats(uint64_t *hits, uint64_t *misses) const;
+
+  /*! Get the execution counters of the basic blocks.
+   *
+   * @return The counter of each basic block written with the option
+   *         OPT_ENABLE_BLOCK_PROFILE.
+   */
+  std::vector<BlockProfile> getBlockProfile() const;
+
+  /*! Pre-cache the basic blocks of a module.
+   *
+   * @param[in] name      The name of the module.
+   * @param[in] strategy  The strategy to discover the basic blocks.
+   *
+   * @return The number of basic blocks inserted in the cache.
+   */
+  uint32_t precacheModule(const std::string &name, PrecacheStrategy strategy);
+
+  /*! Write the memory accesses in a buffer with inline instrumentation.
+   *
+   * @param[in] buffer  The buffer where the accesses are written.
+   * @param[in] size    The number of accesses of the buffer.
+   * @param[in] cbk     The callback called when the buffer must be flushed.
+   * @param[in] data    User defined data passed to the callback.
+   *
+   * @return True if the memory trace is supported on this architecture.
+   */
+  bool setMemoryTrace(MemoryAccess *buffer, size_t size,
+                      MemoryTraceCallback cbk, void *data);
+
+  /*! Flush the pending accesses of the memory trace and remove it.
+   */
+  void removeMemoryTrace();
+
+  /*! Stop each run after a number of instructions.
+   *
+   * @param[in] instructions  The number of instructions, 0 for no limit.
+   *
+   * @return True if the instruction budget is supported on this architecture.
+   */
+  bool setInstructionBudget(uint64_t instructions);
+
+  /*! Stop each run after a delay.
+   *
+   * @param[in] milliseconds  The delay, 0 for no limit.
+   */
+  void setTimeBudget(uint64_t milliseconds);
+
+  /*! Check if the last run has been stopped by its budget.
+   */
+  bool isBudgetExhausted() const { return budget.exhausted; }
+
+  /*! Write an AFL-compatible edge coverage in a bitmap with inline
+   * instrumentation.
+   *
+   * @param[in] bitmap  The bitmap of the edge counters.
+   * @param[in] size    The size of the bitmap, a power of two.
+   *
+   * @return True if the edge coverage is supported on this architecture and
+   *         the size is valid.
+   */
+  bool setCoverageBitmap(uint8_t *bitmap, size_t size);
+
+  /*! Stop writing the edge coverage.
+   */
+  void removeCoverageBitmap();
+
+  /*! Set the size of the code and the data blocks of the ExecBlocks. The
+   * cache is cleared.
+   *
+   * @param[in] codeSize   The size of the code blocks, 0 for the default.
+   * @param[in] dataSize   The size of the data blocks, 0 for the default.
+   * @param[in] hugePages  Back the code blocks with a huge page.
+   *
+   * @return True if the sizes are supported on this architecture and
+   *         platform.
+   */
+  bool setExecBlockSize(uint32_t codeSize, uint32_t dataSize, bool hugePages);
 };
 
 } // namespace QBDI
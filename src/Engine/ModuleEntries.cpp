@@ -0,0 +1,226 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2025 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+
+#include "QBDI/Config.h"
+#include "QBDI/Memory.hpp"
+#include "Engine/ModuleEntries.h"
+#include "Utility/LogSys.h"
+
+#if defined(QBDI_PLATFORM_LINUX) || defined(QBDI_PLATFORM_ANDROID)
+#include <elf.h>
+#include <link.h>
+#endif
+
+namespace QBDI {
+
+namespace {
+
+#if defined(QBDI_PLATFORM_LINUX) || defined(QBDI_PLATFORM_ANDROID)
+
+// Memory of the module that can be read
+class ModuleMemory {
+  RangeSet<rword> readable;
+
+public:
+  ModuleMemory(const std::vector<MemoryMap> &maps) {
+    for (const MemoryMap &m : maps) {
+      if (m.permission & PF_READ) {
+        readable.add(m.range);
+      }
+    }
+  }
+
+  bool contains(rword address, rword size) const {
+    return size == 0 or
+           readable.contains(Range<rword>(address, address + size,
+                                          real_addr_t()));
+  }
+};
+
+// Get the number of symbols of the dynamic symbol table with the GNU hash
+// table. The last symbol is found with the highest bucket and its chain.
+uint32_t getGnuHashNbSymbols(const ModuleMemory &memory, rword hash) {
+  if (not memory.contains(hash, 4 * sizeof(uint32_t))) {
+    return 0;
+  }
+  const auto *header = reinterpret_cast<const uint32_t *>(hash);
+  const uint32_t nbBuckets = header[0];
+  const uint32_t symOffset = header[1];
+  const uint32_t bloomSize = header[2];
+  const rword bucketsAddr =
+      hash + 4 * sizeof(uint32_t) + bloomSize * sizeof(ElfW(Addr));
+  if (not memory.contains(bucketsAddr, nbBuckets * sizeof(uint32_t))) {
+    return 0;
+  }
+  if (nbBuckets == 0) {
+    return symOffset;
+  }
+  const auto *buckets = reinterpret_cast<const uint32_t *>(bucketsAddr);
+  const uint32_t last = *std::max_element(buckets, buckets + nbBuckets);
+  if (last < symOffset) {
+    return symOffset;
+  }
+  const rword chain = bucketsAddr + nbBuckets * sizeof(uint32_t);
+  for (uint32_t i = last;; i++) {
+    const rword entry = chain + (i - symOffset) * sizeof(uint32_t);
+    if (not memory.contains(entry, sizeof(uint32_t))) {
+      return 0;
+    }
+    // the lowest bit marks the end of the chain
+    if (*reinterpret_cast<const uint32_t *>(entry) & 1) {
+      return i + 1;
+    }
+  }
+}
+
+// Read the entry point and the functions of the dynamic symbol table of an
+// ELF module from its header mapped in memory
+std::vector<rword> getElfEntryPoints(const std::vector<MemoryMap> &maps) {
+  std::vector<rword> entries;
+  const MemoryMap &header = maps[0];
+  const ModuleMemory memory(maps);
+  if (not memory.contains(header.range.start(), sizeof(ElfW(Ehdr)))) {
+    return entries;
+  }
+  const rword base = header.range.start();
+  const auto *ehdr = reinterpret_cast<const ElfW(Ehdr) *>(base);
+  if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 or
+      ehdr->e_phentsize != sizeof(ElfW(Phdr)) or
+      not memory.contains(base + ehdr->e_phoff,
+                          ehdr->e_phnum * sizeof(ElfW(Phdr)))) {
+    return entries;
+  }
+  const auto *phdrs =
+      reinterpret_cast<const ElfW(Phdr) *>(base + ehdr->e_phoff);
+  // The header is mapped by the first loaded segment
+  const ElfW(Phdr) *firstLoad = nullptr;
+  const ElfW(Phdr) *dynamic = nullptr;
+  for (unsigned i = 0; i < ehdr->e_phnum; i++) {
+    if (phdrs[i].p_type == PT_LOAD and firstLoad == nullptr) {
+      firstLoad = &phdrs[i];
+    } else if (phdrs[i].p_type == PT_DYNAMIC) {
+      dynamic = &phdrs[i];
+    }
+  }
+  if (firstLoad == nullptr or firstLoad->p_offset != 0) {
+    return entries;
+  }
+  const rword bias = base - firstLoad->p_vaddr;
+  if (ehdr->e_entry != 0) {
+    entries.push_back(bias + ehdr->e_entry);
+  }
+  if (dynamic == nullptr or
+      not memory.contains(bias + dynamic->p_vaddr, dynamic->p_memsz)) {
+    return entries;
+  }
+
+  // The loader may have relocated the pointers of the dynamic section
+  auto relocate = [&](rword ptr) {
+    return memory.contains(ptr, 1) ? ptr : ptr + bias;
+  };
+  rword symtab = 0;
+  uint32_t nbSymbols = 0;
+  const auto *dyn =
+      reinterpret_cast<const ElfW(Dyn) *>(bias + dynamic->p_vaddr);
+  const size_t nbDyn = dynamic->p_memsz / sizeof(ElfW(Dyn));
+  for (size_t i = 0; i < nbDyn and dyn[i].d_tag != DT_NULL; i++) {
+    switch (dyn[i].d_tag) {
+      case DT_SYMTAB:
+        symtab = relocate(dyn[i].d_un.d_ptr);
+        break;
+      case DT_HASH: {
+        const rword hash = relocate(dyn[i].d_un.d_ptr);
+        if (memory.contains(hash, 2 * sizeof(uint32_t))) {
+          nbSymbols = reinterpret_cast<const uint32_t *>(hash)[1];
+        }
+        break;
+      }
+      case DT_GNU_HASH:
+        if (nbSymbols == 0) {
+          nbSymbols =
+              getGnuHashNbSymbols(memory, relocate(dyn[i].d_un.d_ptr));
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  if (symtab == 0 or
+      not memory.contains(symtab, nbSymbols * sizeof(ElfW(Sym)))) {
+    return entries;
+  }
+  const auto *syms = reinterpret_cast<const ElfW(Sym) *>(symtab);
+  for (uint32_t i = 0; i < nbSymbols; i++) {
+    // ST_TYPE has the same definition for ELF32 and ELF64
+    if (ELF32_ST_TYPE(syms[i].st_info) == STT_FUNC and
+        syms[i].st_shndx != SHN_UNDEF and syms[i].st_value != 0) {
+      entries.push_back(bias + syms[i].st_value);
+    }
+  }
+  QBDI_DEBUG("Found {} entry points in the module {}", entries.size(),
+             header.name);
+  return entries;
+}
+
+#else
+
+std::vector<rword> getElfEntryPoints(const std::vector<MemoryMap> &maps) {
+  return {};
+}
+
+#endif
+
+// Get the maps of a module, sorted by address
+std::vector<MemoryMap> getModuleMaps(const std::string &name) {
+  std::vector<MemoryMap> maps;
+  for (MemoryMap &m : getCurrentProcessMaps(true)) {
+    if (m.name == name) {
+      maps.push_back(std::move(m));
+    }
+  }
+  std::sort(maps.begin(), maps.end(),
+            [](const MemoryMap &a, const MemoryMap &b) {
+              return a.range.start() < b.range.start();
+            });
+  return maps;
+}
+
+} // namespace
+
+RangeSet<rword> getModuleExecRanges(const std::string &name) {
+  RangeSet<rword> ranges;
+  for (const MemoryMap &m : getModuleMaps(name)) {
+    if (m.permission & PF_EXEC) {
+      ranges.add(m.range);
+    }
+  }
+  return ranges;
+}
+
+std::vector<rword> getModuleEntryPoints(const std::string &name) {
+  const std::vector<MemoryMap> maps = getModuleMaps(name);
+  if (name.empty() or maps.empty()) {
+    return {};
+  }
+  return getElfEntryPoints(maps);
+}
+
+} // namespace QBDI
@@ -0,0 +1,51 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2025 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MODULEENTRIES_H
+#define MODULEENTRIES_H
+
+#include <string>
+#include <vector>
+
+#include "QBDI/Range.h"
+#include "QBDI/State.h"
+
+namespace QBDI {
+
+/*! Get the executable ranges of a module loaded in the current process.
+ *
+ * @param[in] name  The name of the module.
+ *
+ * @return The executable ranges of the module.
+ */
+RangeSet<rword> getModuleExecRanges(const std::string &name);
+
+/*! Get the entry points of a module loaded in the current process: the entry
+ * point of the ELF header and the functions of the dynamic symbol table. The
+ * module is read in memory, the file isn't opened. On ARM, the thumb bit is
+ * kept in the addresses.
+ *
+ * @param[in] name  The name of the module.
+ *
+ * @return The addresses of the entry points (empty if the format of the
+ *         module isn't supported).
+ */
+std::vector<rword> getModuleEntryPoints(const std::string &name);
+
+} // namespace QBDI
+
+#endif // MODULEENTRIES_H
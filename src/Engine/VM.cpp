@@ -153,6 +153,87 @@ VMAction stopCallback(VMInstanceRef vm, GPRState *gprState, FPRState *fprState,
   return VMAction::STOP;
 }
 
+bool isValidPredicate(const CallbackPredicate &predicate) {
+  switch (predicate.source) {
+    case PREDICATE_GPR:
+    case PREDICATE_MEMORY:
+      if (predicate.reg >= NUM_GPR and predicate.reg != REG_PC) {
+        return false;
+      }
+      break;
+    case PREDICATE_FLAG:
+      if (predicate.reg >= sizeof(rword) * 8) {
+        return false;
+      }
+      break;
+    default:
+      return false;
+  }
+  switch (predicate.op) {
+    case PREDICATE_EQ:
+    case PREDICATE_NE:
+    case PREDICATE_LT:
+    case PREDICATE_LE:
+    case PREDICATE_GT:
+    case PREDICATE_GE:
+      return true;
+    case PREDICATE_IN_RANGE:
+      return predicate.constant <= predicate.constantEnd;
+    default:
+      return false;
+  }
+}
+
+bool isValidInline(const std::vector<InlineOp> &ops, InstCallback cbk) {
+  if (ops.empty()) {
+    return false;
+  }
+  for (size_t i = 0; i < ops.size(); i++) {
+    const InlineOp &op = ops[i];
+    switch (op.opcode) {
+      case INLINE_LOAD_IMM:
+      case INLINE_LOAD_OPERAND:
+      case INLINE_LOAD_READ_ADDRESS:
+      case INLINE_LOAD_WRITE_ADDRESS:
+      case INLINE_LOAD_MEMORY:
+      case INLINE_ADD:
+      case INLINE_STORE:
+        break;
+      case INLINE_LOAD_REG:
+        if (op.value >= NUM_GPR and op.value != REG_PC) {
+          return false;
+        }
+        break;
+      case INLINE_SKIP:
+        if (not isValidPredicate(CallbackPredicate{PREDICATE_GPR, 0, 0, op.cmp,
+                                                   op.constant,
+                                                   op.constantEnd})) {
+          return false;
+        }
+        break;
+      case INLINE_CALL:
+        // the execution is resumed after the instrumentation
+        if (cbk == nullptr or i + 1 != ops.size()) {
+          return false;
+        }
+        break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+void recordInlineAccesses(VM &vm, const std::vector<InlineOp> &ops) {
+  for (const InlineOp &op : ops) {
+    if (op.opcode == INLINE_LOAD_READ_ADDRESS) {
+      vm.recordMemoryAccess(MEMORY_READ);
+    } else if (op.opcode == INLINE_LOAD_WRITE_ADDRESS) {
+      vm.recordMemoryAccess(MEMORY_WRITE);
+    }
+  }
+}
+
 // constructor
 
 VM::VM(const std::string &cpu, const std::vector<std::string> &mattrs,
@@ -433,6 +514,16 @@ bool VM::run(rword start, rword stop) {
   return ret;
 }
 
+// runWithStatus
+
+RunStatus VM::runWithStatus(rword start, rword stop) {
+  bool ret = run(start, stop);
+  if (isBudgetExhausted()) {
+    return RunStatus::RUN_BUDGET_EXHAUSTED;
+  }
+  return ret ? RunStatus::RUN_STOPPED : RunStatus::RUN_NOT_EXECUTED;
+}
+
 // callA
 
 #define FAKE_RET_ADDR 42
@@ -526,6 +617,22 @@ bool VM::switchStackAndCallV(rword *retval, rword function, uint32_t argNum,
   return res;
 }
 
+// setInstructionBudget
+
+bool VM::setInstructionBudget(uint64_t instructions) {
+  return engine->setInstructionBudget(instructions);
+}
+
+// setTimeBudget
+
+void VM::setTimeBudget(uint64_t milliseconds) {
+  engine->setTimeBudget(milliseconds);
+}
+
+// isBudgetExhausted
+
+bool VM::isBudgetExhausted() const { return engine->isBudgetExhausted(); }
+
 // addInstrRule
 
 uint32_t VM::addInstrRule(InstrRuleCallback cbk, AnalysisType type,
@@ -652,14 +759,31 @@ uint32_t VM::addMnemonicCB(const char *mnemonic, InstPosition pos,
   return id;
 }
 
+uint32_t VM::addMnemonicCB(const char *mnemonic, InstPosition pos,
+                           InstCallback cbk, void *data,
+                           const CallbackPredicate &predicate, int priority) {
+  QBDI_REQUIRE_ACTION(mnemonic != nullptr, return VMError::INVALID_EVENTID);
+  QBDI_REQUIRE_ACTION(cbk != nullptr, return VMError::INVALID_EVENTID);
+  QBDI_REQUIRE_ACTION(isValidPredicate(predicate),
+                      return VMError::INVALID_EVENTID);
+  return engine->addInstrRule(InstrRulePredicateCBK::unique(
+      MnemonicIs::unique(mnemonic), predicate, cbk, data, pos, priority,
+      (pos == PREINST) ? RelocTagPreInstStdCBK : RelocTagPostInstStdCBK));
+}
+
 // addCodeCB
 
 uint32_t VM::addCodeCB(InstPosition pos, InstCallback cbk, void *data,
                        int priority) {
+  return addCodeCB(pos, cbk, data, CALLBACK_DEFAULT, priority);
+}
+
+uint32_t VM::addCodeCB(InstPosition pos, InstCallback cbk, void *data,
+                       CallbackType type, int priority) {
   QBDI_REQUIRE_ACTION(cbk != nullptr, return VMError::INVALID_EVENTID);
   return engine->addInstrRule(InstrRuleBasicCBK::unique(
       True::unique(), cbk, data, pos, true, priority,
-      (pos == PREINST) ? RelocTagPreInstStdCBK : RelocTagPostInstStdCBK));
+      (pos == PREINST) ? RelocTagPreInstStdCBK : RelocTagPostInstStdCBK, type));
 }
 
 uint32_t VM::addCodeCB(InstPosition pos, const InstCbLambda &cbk,
@@ -677,14 +801,29 @@ uint32_t VM::addCodeCB(InstPosition pos, InstCbLambda &&cbk, int priority) {
   return id;
 }
 
+uint32_t VM::addCodeCB(InstPosition pos, InstCallback cbk, void *data,
+                       const CallbackPredicate &predicate, int priority) {
+  QBDI_REQUIRE_ACTION(cbk != nullptr, return VMError::INVALID_EVENTID);
+  QBDI_REQUIRE_ACTION(isValidPredicate(predicate),
+                      return VMError::INVALID_EVENTID);
+  return engine->addInstrRule(InstrRulePredicateCBK::unique(
+      True::unique(), predicate, cbk, data, pos, priority,
+      (pos == PREINST) ? RelocTagPreInstStdCBK : RelocTagPostInstStdCBK));
+}
+
 // addCodeAddrCB
 
 uint32_t VM::addCodeAddrCB(rword address, InstPosition pos, InstCallback cbk,
                            void *data, int priority) {
+  return addCodeAddrCB(address, pos, cbk, data, CALLBACK_DEFAULT, priority);
+}
+
+uint32_t VM::addCodeAddrCB(rword address, InstPosition pos, InstCallback cbk,
+                           void *data, CallbackType type, int priority) {
   QBDI_REQUIRE_ACTION(cbk != nullptr, return VMError::INVALID_EVENTID);
   return engine->addInstrRule(InstrRuleBasicCBK::unique(
       AddressIs::unique(strip_ptrauth(address)), cbk, data, pos, true, priority,
-      (pos == PREINST) ? RelocTagPreInstStdCBK : RelocTagPostInstStdCBK));
+      (pos == PREINST) ? RelocTagPreInstStdCBK : RelocTagPostInstStdCBK, type));
 }
 
 uint32_t VM::addCodeAddrCB(rword address, InstPosition pos,
@@ -705,16 +844,35 @@ uint32_t VM::addCodeAddrCB(rword address, InstPosition pos, InstCbLambda &&cbk,
   return id;
 }
 
+uint32_t VM::addCodeAddrCB(rword address, InstPosition pos, InstCallback cbk,
+                           void *data, const CallbackPredicate &predicate,
+                           int priority) {
+  QBDI_REQUIRE_ACTION(cbk != nullptr, return VMError::INVALID_EVENTID);
+  QBDI_REQUIRE_ACTION(isValidPredicate(predicate),
+                      return VMError::INVALID_EVENTID);
+  return engine->addInstrRule(InstrRulePredicateCBK::unique(
+      AddressIs::unique(strip_ptrauth(address)), predicate, cbk, data, pos,
+      priority,
+      (pos == PREINST) ? RelocTagPreInstStdCBK : RelocTagPostInstStdCBK));
+}
+
 // addCodeRangeCB
 
 uint32_t VM::addCodeRangeCB(rword start, rword end, InstPosition pos,
                             InstCallback cbk, void *data, int priority) {
+  return addCodeRangeCB(start, end, pos, cbk, data, CALLBACK_DEFAULT,
+                        priority);
+}
+
+uint32_t VM::addCodeRangeCB(rword start, rword end, InstPosition pos,
+                            InstCallback cbk, void *data, CallbackType type,
+                            int priority) {
   QBDI_REQUIRE_ACTION(start < end, return VMError::INVALID_EVENTID);
   QBDI_REQUIRE_ACTION(cbk != nullptr, return VMError::INVALID_EVENTID);
   return engine->addInstrRule(InstrRuleBasicCBK::unique(
       InstructionInRange::unique(strip_ptrauth(start), strip_ptrauth(end)), cbk,
       data, pos, true, priority,
-      (pos == PREINST) ? RelocTagPreInstStdCBK : RelocTagPostInstStdCBK));
+      (pos == PREINST) ? RelocTagPreInstStdCBK : RelocTagPostInstStdCBK, type));
 }
 
 uint32_t VM::addCodeRangeCB(rword start, rword end, InstPosition pos,
@@ -735,6 +893,31 @@ uint32_t VM::addCodeRangeCB(rword start, rword end, InstPosition pos,
   return id;
 }
 
+// addInlineCB
+
+uint32_t VM::addInlineCB(InstPosition pos, const std::vector<InlineOp> &ops,
+                         InstCallback cbk, void *data, int priority) {
+  QBDI_REQUIRE_ACTION(isValidInline(ops, cbk),
+                      return VMError::INVALID_EVENTID);
+  recordInlineAccesses(*this, ops);
+  return engine->addInstrRule(InstrRuleInlineCBK::unique(
+      True::unique(), ops, cbk, data, pos, priority,
+      (pos == PREINST) ? RelocTagPreInstStdCBK : RelocTagPostInstStdCBK));
+}
+
+uint32_t VM::addInlineRangeCB(rword start, rword end, InstPosition pos,
+                              const std::vector<InlineOp> &ops,
+                              InstCallback cbk, void *data, int priority) {
+  QBDI_REQUIRE_ACTION(start < end, return VMError::INVALID_EVENTID);
+  QBDI_REQUIRE_ACTION(isValidInline(ops, cbk),
+                      return VMError::INVALID_EVENTID);
+  recordInlineAccesses(*this, ops);
+  return engine->addInstrRule(InstrRuleInlineCBK::unique(
+      InstructionInRange::unique(strip_ptrauth(start), strip_ptrauth(end)),
+      ops, cbk, data, pos, priority,
+      (pos == PREINST) ? RelocTagPreInstStdCBK : RelocTagPostInstStdCBK));
+}
+
 // addMemAccessCB
 
 uint32_t VM::addMemAccessCB(MemoryAccessType type, InstCallback cbk, void *data,
@@ -812,25 +995,13 @@ uint32_t VM::addMemRangeCB(rword start_, rword end_, MemoryAccessType type,
                       return VMError::INVALID_EVENTID);
   QBDI_REQUIRE_ACTION(cbk != nullptr, return VMError::INVALID_EVENTID);
   recordMemoryAccess(type);
-  if ((type == MEMORY_READ) && memReadGateCBID == VMError::INVALID_EVENTID) {
-    memReadGateCBID = engine->addInstrRule(InstrRuleBasicCBK::unique(
-        DoesReadAccess::unique(), memReadGate, memCBInfos.get(),
-        InstPosition::PREINST, true, 0, RelocTagPreInstStdCBK));
-  }
-  if ((type & MEMORY_WRITE) && memWriteGateCBID == VMError::INVALID_EVENTID) {
-    // memWriteGate manage MEMORY_WRITE and MEMORY_READ_WRITE callback
-    memWriteGateCBID = engine->addInstrRule(InstrRuleBasicCBK::unique(
-        Or::unique(conv_unique<PatchCondition>(DoesReadAccess::unique(),
-                                               DoesWriteAccess::unique())),
-        memWriteGate, memCBInfos.get(), InstPosition::POSTINST, true, 0,
-        RelocTagPostInstStdCBK));
-  }
   uint32_t id = memCBID++;
   QBDI_REQUIRE_ACTION(id < EVENTID_VIRTCB_MASK,
                       return VMError::INVALID_EVENTID);
   memCBInfos->emplace_back(
       id | EVENTID_VIRTCB_MASK,
       MemCBInfo{type, {start, end, real_addr_t()}, cbk, data});
+  updateMemGates();
   return id | EVENTID_VIRTCB_MASK;
 }
 
@@ -850,6 +1021,68 @@ uint32_t VM::addMemRangeCB(rword start, rword end, MemoryAccessType type,
   return id;
 }
 
+// updateMemGates
+
+void VM::updateMemGates() {
+  // The ranges are compared in the JIT code by the gates when possible, the
+  // gates must be instrumented again when these ranges change. The gates that
+  // compare the ranges in the host read them from memCBInfos and are kept.
+  RangeSet<rword> readRanges;
+  RangeSet<rword> writeRanges;
+  RangeSet<rword> readWriteRanges;
+  for (const auto &p : *memCBInfos) {
+    if (p.second.type == MEMORY_READ) {
+      readRanges.add(p.second.range);
+    }
+    if (p.second.type & MEMORY_WRITE) {
+      writeRanges.add(p.second.range);
+    }
+    if (p.second.type == MEMORY_READ_WRITE) {
+      readWriteRanges.add(p.second.range);
+    }
+  }
+
+  if (memReadGateCBID != VMError::INVALID_EVENTID) {
+    // memReadGateCBID is always a InstrRuleMemRangeCBK
+    auto *rule = static_cast<InstrRuleMemRangeCBK *>(
+        engine->getInstrRule(memReadGateCBID));
+    QBDI_REQUIRE_ABORT(rule != nullptr, "Memory gate internal error");
+    if (rule->hasSameCode(readRanges, RangeSet<rword>())) {
+      rule->setRanges(std::move(readRanges), RangeSet<rword>());
+      readRanges = RangeSet<rword>();
+    } else {
+      engine->deleteInstrumentation(memReadGateCBID);
+      memReadGateCBID = VMError::INVALID_EVENTID;
+    }
+  }
+  if (memWriteGateCBID != VMError::INVALID_EVENTID) {
+    // memWriteGateCBID is always a InstrRuleMemRangeCBK
+    auto *rule = static_cast<InstrRuleMemRangeCBK *>(
+        engine->getInstrRule(memWriteGateCBID));
+    QBDI_REQUIRE_ABORT(rule != nullptr, "Memory gate internal error");
+    if (rule->hasSameCode(readWriteRanges, writeRanges)) {
+      rule->setRanges(std::move(readWriteRanges), std::move(writeRanges));
+      writeRanges = RangeSet<rword>();
+    } else {
+      engine->deleteInstrumentation(memWriteGateCBID);
+      memWriteGateCBID = VMError::INVALID_EVENTID;
+    }
+  }
+
+  if (not readRanges.getRanges().empty()) {
+    memReadGateCBID = engine->addInstrRule(InstrRuleMemRangeCBK::unique(
+        memReadGate, memCBInfos.get(), InstPosition::PREINST,
+        std::move(readRanges), RangeSet<rword>(), 0, RelocTagPreInstStdCBK));
+  }
+  if (not writeRanges.getRanges().empty()) {
+    // memWriteGate manage MEMORY_WRITE and MEMORY_READ_WRITE callback
+    memWriteGateCBID = engine->addInstrRule(InstrRuleMemRangeCBK::unique(
+        memWriteGate, memCBInfos.get(), InstPosition::POSTINST,
+        std::move(readWriteRanges), std::move(writeRanges), 0,
+        RelocTagPostInstStdCBK));
+  }
+}
+
 // addVMEventCB
 
 uint32_t VM::addVMEventCB(VMEvent mask, VMCallback cbk, void *data) {
@@ -888,6 +1121,7 @@ bool VM::deleteInstrumentation(uint32_t id) {
     instCBData.remove_if([id](const std::pair<uint32_t, InstCbLambda> &x) {
       return x.first == id;
     });
+    updateMemGates();
     return true;
   } else {
     instrCBInfos->erase(
@@ -911,6 +1145,47 @@ bool VM::deleteInstrumentation(uint32_t id) {
   }
 }
 
+bool VM::setCallbackSampling(uint32_t id, uint32_t period, bool randomized) {
+  // The memory callbacks are shared by a gate
+  if (id & EVENTID_VIRTCB_MASK) {
+    return false;
+  }
+  return engine->setCallbackSampling(id, period, randomized);
+}
+
+// setInstrumentationEnabled
+
+bool VM::setInstrumentationEnabled(uint32_t id, bool enabled) {
+  // The memory callbacks are shared by a gate
+  if (id & EVENTID_VIRTCB_MASK) {
+    return false;
+  }
+  return engine->setInstrumentationEnabled(id, enabled);
+}
+
+// setInstrumentationData
+
+bool VM::setInstrumentationData(uint32_t id, void *data) {
+  // The data of the memory callbacks and of the lambdas is owned by the VM
+  if (id & EVENTID_VIRTCB_MASK) {
+    return false;
+  }
+  auto sameId = [id](const auto &x) { return x.first == id; };
+  if (std::any_of(vmCBData.begin(), vmCBData.end(), sameId) or
+      std::any_of(instCBData.begin(), instCBData.end(), sameId) or
+      std::any_of(instrRuleCBData.begin(), instrRuleCBData.end(), sameId)) {
+    return false;
+  }
+  // The C InstrRules receive their data through an InstrCBInfo
+  for (auto &info : *instrCBInfos) {
+    if (info.first == id) {
+      info.second->data = data;
+      return engine->setInstrumentationData(id, info.second.get());
+    }
+  }
+  return engine->setInstrumentationData(id, data);
+}
+
 // deleteAllInstrumentations
 
 void VM::deleteAllInstrumentations() {
@@ -1007,6 +1282,19 @@ std::vector<MemoryAccess> VM::getBBMemoryAccess() const {
   return memAccess;
 }
 
+// setMemoryTrace
+
+bool VM::setMemoryTrace(MemoryAccess *buffer, size_t size,
+                        MemoryTraceCallback cbk, void *data) {
+  QBDI_REQUIRE_ACTION(buffer != nullptr and size > 0 and cbk != nullptr,
+                      return false);
+  return engine->setMemoryTrace(buffer, size, cbk, data);
+}
+
+// removeMemoryTrace
+
+void VM::removeMemoryTrace() { engine->removeMemoryTrace(); }
+
 // precacheBasicBlock
 
 bool VM::precacheBasicBlock(rword pc) {
@@ -1031,4 +1319,40 @@ uint32_t VM::getNbExecBlock() const { return engine->getNbExecBlock(); }
 
 void VM::reduceCacheTo(uint32_t nb) { engine->reduceCacheTo(nb); }
 
+// setExecBlockSize
+
+bool VM::setExecBlockSize(uint32_t codeSize, uint32_t dataSize,
+                          bool hugePages) {
+  return engine->setExecBlockSize(codeSize, dataSize, hugePages);
+}
+
+// getIndirectCacheStats
+
+void VM::getIndirectCacheStats(uint64_t *hits, uint64_t *misses) const {
+  engine->getIndirectCacheStats(hits, misses);
+}
+
+// getBlockProfile
+
+std::vector<BlockProfile> VM::getBlockProfile() const {
+  return engine->getBlockProfile();
+}
+
+// precacheModule
+
+uint32_t VM::precacheModule(const std::string &name,
+                            PrecacheStrategy strategy) {
+  return engine->precacheModule(name, strategy);
+}
+
+// setCoverageBitmap
+
+bool VM::setCoverageBitmap(uint8_t *bitmap, size_t size) {
+  return engine->setCoverageBitmap(bitmap, size);
+}
+
+// removeCoverageBitmap
+
+void VM::removeCoverageBitmap() { engine->removeCoverageBitmap(); }
+
 } // namespace QBDI
@@ -105,6 +105,11 @@ bool qbdi_run(VMInstanceRef instance, rword start, rword stop) {
   return static_cast<VM *>(instance)->run(start, stop);
 }
 
+RunStatus qbdi_runWithStatus(VMInstanceRef instance, rword start, rword stop) {
+  QBDI_REQUIRE_ACTION(instance, return RUN_NOT_EXECUTED);
+  return static_cast<VM *>(instance)->runWithStatus(start, stop);
+}
+
 bool qbdi_call(VMInstanceRef instance, rword *retval, rword function,
                uint32_t argNum, ...) {
   QBDI_REQUIRE_ACTION(instance, return false);
@@ -155,6 +160,21 @@ bool qbdi_switchStackAndCallA(VMInstanceRef instance, rword *retval,
       retval, function, argNum, args, stackSize);
 }
 
+bool qbdi_setInstructionBudget(VMInstanceRef instance, uint64_t instructions) {
+  QBDI_REQUIRE_ACTION(instance, return false);
+  return static_cast<VM *>(instance)->setInstructionBudget(instructions);
+}
+
+void qbdi_setTimeBudget(VMInstanceRef instance, uint64_t milliseconds) {
+  QBDI_REQUIRE_ACTION(instance, return);
+  static_cast<VM *>(instance)->setTimeBudget(milliseconds);
+}
+
+bool qbdi_isBudgetExhausted(VMInstanceRef instance) {
+  QBDI_REQUIRE_ACTION(instance, return false);
+  return static_cast<VM *>(instance)->isBudgetExhausted();
+}
+
 GPRState *qbdi_getGPRState(VMInstanceRef instance) {
   QBDI_REQUIRE_ACTION(instance, return nullptr);
   return static_cast<VM *>(instance)->getGPRState();
@@ -203,6 +223,17 @@ uint32_t qbdi_addMnemonicCB(VMInstanceRef instance, const char *mnemonic,
                                                     priority);
 }
 
+uint32_t qbdi_addMnemonicCBWithPredicate(VMInstanceRef instance,
+                                         const char *mnemonic, InstPosition pos,
+                                         InstCallback cbk, void *data,
+                                         const CallbackPredicate *predicate,
+                                         int priority) {
+  QBDI_REQUIRE_ACTION(instance, return VMError::INVALID_EVENTID);
+  QBDI_REQUIRE_ACTION(predicate, return VMError::INVALID_EVENTID);
+  return static_cast<VM *>(instance)->addMnemonicCB(mnemonic, pos, cbk, data,
+                                                    *predicate, priority);
+}
+
 uint32_t qbdi_addCodeCB(VMInstanceRef instance, InstPosition pos,
                         InstCallback cbk, void *data, int priority) {
   QBDI_REQUIRE_ACTION(instance, return VMError::INVALID_EVENTID);
@@ -225,6 +256,72 @@ uint32_t qbdi_addCodeRangeCB(VMInstanceRef instance, rword start, rword end,
                                                      priority);
 }
 
+uint32_t qbdi_addCodeCBWithType(VMInstanceRef instance, InstPosition pos,
+                                InstCallback cbk, void *data, CallbackType type,
+                                int priority) {
+  QBDI_REQUIRE_ACTION(instance, return VMError::INVALID_EVENTID);
+  return static_cast<VM *>(instance)->addCodeCB(pos, cbk, data, type, priority);
+}
+
+uint32_t qbdi_addCodeAddrCBWithType(VMInstanceRef instance, rword address,
+                                    InstPosition pos, InstCallback cbk,
+                                    void *data, CallbackType type,
+                                    int priority) {
+  QBDI_REQUIRE_ACTION(instance, return VMError::INVALID_EVENTID);
+  return static_cast<VM *>(instance)->addCodeAddrCB(address, pos, cbk, data,
+                                                    type, priority);
+}
+
+uint32_t qbdi_addCodeCBWithPredicate(VMInstanceRef instance, InstPosition pos,
+                                     InstCallback cbk, void *data,
+                                     const CallbackPredicate *predicate,
+                                     int priority) {
+  QBDI_REQUIRE_ACTION(instance, return VMError::INVALID_EVENTID);
+  QBDI_REQUIRE_ACTION(predicate, return VMError::INVALID_EVENTID);
+  return static_cast<VM *>(instance)->addCodeCB(pos, cbk, data, *predicate,
+                                                priority);
+}
+
+uint32_t qbdi_addCodeAddrCBWithPredicate(VMInstanceRef instance, rword address,
+                                         InstPosition pos, InstCallback cbk,
+                                         void *data,
+                                         const CallbackPredicate *predicate,
+                                         int priority) {
+  QBDI_REQUIRE_ACTION(instance, return VMError::INVALID_EVENTID);
+  QBDI_REQUIRE_ACTION(predicate, return VMError::INVALID_EVENTID);
+  return static_cast<VM *>(instance)->addCodeAddrCB(address, pos, cbk, data,
+                                                    *predicate, priority);
+}
+
+uint32_t qbdi_addCodeRangeCBWithType(VMInstanceRef instance, rword start,
+                                     rword end, InstPosition pos,
+                                     InstCallback cbk, void *data,
+                                     CallbackType type, int priority) {
+  QBDI_REQUIRE_ACTION(instance, return VMError::INVALID_EVENTID);
+  return static_cast<VM *>(instance)->addCodeRangeCB(start, end, pos, cbk, data,
+                                                     type, priority);
+}
+
+uint32_t qbdi_addInlineCB(VMInstanceRef instance, InstPosition pos,
+                          const InlineOp *ops, size_t count, InstCallback cbk,
+                          void *data, int priority) {
+  QBDI_REQUIRE_ACTION(instance, return VMError::INVALID_EVENTID);
+  QBDI_REQUIRE_ACTION(ops, return VMError::INVALID_EVENTID);
+  return static_cast<VM *>(instance)->addInlineCB(
+      pos, std::vector<InlineOp>(ops, ops + count), cbk, data, priority);
+}
+
+uint32_t qbdi_addInlineRangeCB(VMInstanceRef instance, rword start, rword end,
+                               InstPosition pos, const InlineOp *ops,
+                               size_t count, InstCallback cbk, void *data,
+                               int priority) {
+  QBDI_REQUIRE_ACTION(instance, return VMError::INVALID_EVENTID);
+  QBDI_REQUIRE_ACTION(ops, return VMError::INVALID_EVENTID);
+  return static_cast<VM *>(instance)->addInlineRangeCB(
+      start, end, pos, std::vector<InlineOp>(ops, ops + count), cbk, data,
+      priority);
+}
+
 uint32_t qbdi_addMemAccessCB(VMInstanceRef instance, MemoryAccessType type,
                              InstCallback cbk, void *data, int priority) {
   QBDI_REQUIRE_ACTION(instance, return VMError::INVALID_EVENTID);
@@ -257,6 +354,25 @@ bool qbdi_deleteInstrumentation(VMInstanceRef instance, uint32_t id) {
   return static_cast<VM *>(instance)->deleteInstrumentation(id);
 }
 
+bool qbdi_setCallbackSampling(VMInstanceRef instance, uint32_t id,
+                              uint32_t period, bool randomized) {
+  QBDI_REQUIRE_ACTION(instance, return false);
+  return static_cast<VM *>(instance)->setCallbackSampling(id, period,
+                                                         randomized);
+}
+
+bool qbdi_setInstrumentationEnabled(VMInstanceRef instance, uint32_t id,
+                                    bool enabled) {
+  QBDI_REQUIRE_ACTION(instance, return false);
+  return static_cast<VM *>(instance)->setInstrumentationEnabled(id, enabled);
+}
+
+bool qbdi_setInstrumentationData(VMInstanceRef instance, uint32_t id,
+                                 void *data) {
+  QBDI_REQUIRE_ACTION(instance, return false);
+  return static_cast<VM *>(instance)->setInstrumentationData(id, data);
+}
+
 void qbdi_deleteAllInstrumentations(VMInstanceRef instance) {
   QBDI_REQUIRE_ACTION(instance, return);
   static_cast<VM *>(instance)->deleteAllInstrumentations();
@@ -327,6 +443,17 @@ MemoryAccess *qbdi_getBBMemoryAccess(VMInstanceRef instance, size_t *size) {
   return ma_arr;
 }
 
+bool qbdi_setMemoryTrace(VMInstanceRef instance, MemoryAccess *buffer,
+                         size_t size, MemoryTraceCallback cbk, void *data) {
+  QBDI_REQUIRE_ACTION(instance, return false);
+  return static_cast<VM *>(instance)->setMemoryTrace(buffer, size, cbk, data);
+}
+
+void qbdi_removeMemoryTrace(VMInstanceRef instance) {
+  QBDI_REQUIRE_ACTION(instance, return);
+  static_cast<VM *>(instance)->removeMemoryTrace();
+}
+
 bool qbdi_precacheBasicBlock(VMInstanceRef instance, rword pc) {
   QBDI_REQUIRE_ACTION(instance, return false);
   return static_cast<VM *>(instance)->precacheBasicBlock(pc);
@@ -348,6 +475,55 @@ void qbdi_reduceCacheTo(VMInstanceRef instance, uint32_t nb) {
   static_cast<VM *>(instance)->reduceCacheTo(nb);
 }
 
+bool qbdi_setExecBlockSize(VMInstanceRef instance, uint32_t codeSize,
+                           uint32_t dataSize, bool hugePages) {
+  QBDI_REQUIRE_ACTION(instance, return false);
+  return static_cast<VM *>(instance)->setExecBlockSize(codeSize, dataSize,
+                                                       hugePages);
+}
+
+void qbdi_getIndirectCacheStats(const VMInstanceRef instance, uint64_t *hits,
+                                uint64_t *misses) {
+  static_cast<const VM *>(instance)->getIndirectCacheStats(hits, misses);
+}
+
+BlockProfile *qbdi_getBlockProfile(const VMInstanceRef instance,
+                                   size_t *size) {
+  QBDI_REQUIRE_ACTION(instance, return nullptr);
+  QBDI_REQUIRE_ACTION(size, return nullptr);
+  *size = 0;
+  std::vector<BlockProfile> profile =
+      static_cast<const VM *>(instance)->getBlockProfile();
+  if (profile.size() == 0) {
+    return NULL;
+  }
+  *size = profile.size();
+  BlockProfile *profile_arr =
+      static_cast<BlockProfile *>(malloc(*size * sizeof(BlockProfile)));
+  for (size_t i = 0; i < *size; i++) {
+    profile_arr[i] = profile[i];
+  }
+  return profile_arr;
+}
+
+uint32_t qbdi_precacheModule(VMInstanceRef instance, const char *name,
+                             PrecacheStrategy strategy) {
+  QBDI_REQUIRE_ACTION(instance, return 0);
+  QBDI_REQUIRE_ACTION(name, return 0);
+  return static_cast<VM *>(instance)->precacheModule(name, strategy);
+}
+
+bool qbdi_setCoverageBitmap(VMInstanceRef instance, uint8_t *bitmap,
+                            size_t size) {
+  QBDI_REQUIRE_ACTION(instance, return false);
+  return static_cast<VM *>(instance)->setCoverageBitmap(bitmap, size);
+}
+
+void qbdi_removeCoverageBitmap(VMInstanceRef instance) {
+  QBDI_REQUIRE_ACTION(instance, return);
+  static_cast<VM *>(instance)->removeCoverageBitmap();
+}
+
 uint32_t qbdi_addInstrRule(VMInstanceRef instance, InstrRuleCallbackC cbk,
                            AnalysisType type, void *data) {
   QBDI_REQUIRE_ACTION(instance, return VMError::INVALID_EVENTID);
@@ -368,4 +544,10 @@ void qbdi_addInstrRuleData(InstrRuleDataVec cbks, InstPosition position,
   cbks->emplace_back(position, cbk, data, priority);
 }
 
+void qbdi_addInstrRuleDataOnce(InstrRuleDataVec cbks, InstPosition position,
+                               InstCallback cbk, void *data, int priority) {
+  QBDI_REQUIRE_ACTION(cbks, return);
+  cbks->emplace_back(position, cbk, data, priority, true);
+}
+
 } // namespace QBDI
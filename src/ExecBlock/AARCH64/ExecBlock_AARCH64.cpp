@@ -44,6 +44,9 @@ extern void qbdi_runCodeBlock(void *codeBlock,
 namespace QBDI {
 
 static const uint32_t MINIMAL_BLOCK_SIZE = 0xc;
+// shadows reserved for the end of the sequence, the code block may be larger
+// than the data block
+static const uint32_t MINIMAL_SHADOW_AVAILABLE = 16;
 
 void ExecBlock::selectSeq(uint16_t seqID) {
   QBDI_REQUIRE(seqID < seqRegistry.size());
@@ -103,7 +106,9 @@ bool ExecBlock::writePatch(std::vector<Patch>::const_iterator seqCurrent,
 
   QBDI_REQUIRE(p.finalize);
 
-  if (getEpilogueOffset() <= MINIMAL_BLOCK_SIZE) {
+  if (getEpilogueOffset() <= MINIMAL_BLOCK_SIZE or
+      shadowIdx + MINIMAL_SHADOW_AVAILABLE >=
+          (dataBlock.allocatedSize() - sizeof(Context)) / sizeof(rword)) {
     isFull = true;
     return false;
   }
@@ -212,4 +217,24 @@ void ExecBlock::finalizeScratchRegisterForPatch() {
       getGPRPosition(srInfo.writeScratchRegister);
 }
 
+void ExecBlock::initIndirectCache(const LLVMCPU &llvmcpu) {}
+
+bool ExecBlock::initFastCallStub(std::vector<Patch>::const_iterator seqStart,
+                                 std::vector<Patch>::const_iterator seqEnd,
+                                 const LLVMCPU &llvmcpu) {
+  return true;
+}
+
+void ExecBlock::cacheIndirectTarget(uint16_t seqID) {}
+
+void ExecBlock::clearIndirectCache() {}
+
+void ExecBlock::getIndirectCacheStats(rword &hits, rword &misses) const {
+  // No indirect branch cache on this architecture
+  hits = 0;
+  misses = 0;
+}
+
+void ExecBlock::recycleContext() {}
+
 } // namespace QBDI
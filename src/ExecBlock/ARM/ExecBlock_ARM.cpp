@@ -243,4 +243,24 @@ void ExecBlock::finalizeScratchRegisterForPatch() {
       getGPRPosition(srInfo.thumbScratchRegister);
 }
 
+void ExecBlock::initIndirectCache(const LLVMCPU &llvmcpu) {}
+
+bool ExecBlock::initFastCallStub(std::vector<Patch>::const_iterator seqStart,
+                                 std::vector<Patch>::const_iterator seqEnd,
+                                 const LLVMCPU &llvmcpu) {
+  return true;
+}
+
+void ExecBlock::cacheIndirectTarget(uint16_t seqID) {}
+
+void ExecBlock::clearIndirectCache() {}
+
+void ExecBlock::getIndirectCacheStats(rword &hits, rword &misses) const {
+  // No indirect branch cache on this architecture
+  hits = 0;
+  misses = 0;
+}
+
+void ExecBlock::recycleContext() {}
+
 } // namespace QBDI
@@ -17,12 +17,15 @@
  */
 #include <algorithm>
 #include <iterator>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string>
 #include <system_error>
 
 #include "llvm/MC/MCInst.h"
+#include "llvm/MC/MCInstrDesc.h"
+#include "llvm/MC/MCInstrInfo.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/Process.h"
 
@@ -30,6 +33,9 @@
 #include "Engine/LLVMCPU.h"
 #include "ExecBlock/Context.h"
 #include "ExecBlock/ExecBlock.h"
+#if defined(QBDI_ARCH_X86_64) || defined(QBDI_ARCH_X86)
+#include "ExecBlock/X86_64/XSave_X86_64.h"
+#endif
 #include "Patch/ExecBlockFlags.h"
 #include "Patch/ExecBlockPatch.h"
 #include "Patch/Patch.h"
@@ -56,13 +62,17 @@ ExecBlock::ExecBlock(
     const LLVMCPUs &llvmCPUs, VMInstanceRef vminstance,
     const std::vector<std::unique_ptr<RelocatableInst>> *execBlockPrologue,
     const std::vector<std::unique_ptr<RelocatableInst>> *execBlockEpilogue,
-    uint32_t epilogueSize_)
+    uint32_t epilogueSize_, Context *sharedContext, const ExecBlockSize &size)
     : vminstance(vminstance), llvmCPUs(llvmCPUs), epilogueSize(epilogueSize_),
       isFull(false) {
 
   // Allocate memory blocks
   std::error_code ec;
   uint64_t pageSize = getPageSize();
+  uint64_t codeSize = (size.code != 0) ? size.code : pageSize;
+  if (size.hugePages) {
+    codeSize = EXEC_BLOCK_HUGE_PAGE_SIZE;
+  }
   unsigned mflags = PF::MF_READ | PF::MF_WRITE;
 
   if constexpr (is_ios) {
@@ -72,8 +82,42 @@ ExecBlock::ExecBlock(
     }
   }
 
-  // Allocate 2 pages block
-  codeBlock = QBDI::allocateMappedMemory(2 * pageSize, nullptr, mflags, ec);
+  // The dataBlock holds the context and the shadows, keep at least the size
+  // of the context for the shadows.
+  uint64_t dataSize = (size.data != 0) ? size.data : pageSize;
+  while (dataSize < 2 * sizeof(Context)) {
+    dataSize += pageSize;
+  }
+
+  // Allocate the block, near the shared context if any
+  llvm::sys::MemoryBlock sharedBlock(sharedContext, sizeof(Context));
+  if (size.hugePages) {
+    // the huge pages are only accepted by isValidSize on Linux and Android
+    if constexpr (is_linux or is_android) {
+      codeBlock = QBDI::allocateHugeMappedMemory(
+          codeSize + dataSize, codeSize,
+          sharedContext != nullptr ? &sharedBlock : nullptr, mflags, ec);
+    }
+  } else if ((is_linux or is_android) and
+             llvmCPUs.hasOptions(Options::OPT_ENABLE_DUAL_MAPPING)) {
+    if constexpr (is_linux or is_android) {
+      codeBlock = QBDI::allocateDualMappedMemory(
+          codeSize + dataSize, codeSize,
+          sharedContext != nullptr ? &sharedBlock : nullptr, codeWriteBlock,
+          ec);
+    }
+    // The memfd may be forbidden by a sandbox, fallback to a single mapping
+    if (codeBlock.base() == nullptr) {
+      QBDI_WARN("Fail to map the ExecBlock twice, use a single mapping");
+      codeBlock = QBDI::allocateMappedMemory(
+          codeSize + dataSize,
+          sharedContext != nullptr ? &sharedBlock : nullptr, mflags, ec);
+    }
+  } else {
+    codeBlock = QBDI::allocateMappedMemory(
+        codeSize + dataSize, sharedContext != nullptr ? &sharedBlock : nullptr,
+        mflags, ec);
+  }
   QBDI_REQUIRE_ABORT(codeBlock.base() != nullptr, "allocation fail");
   QBDI_REQUIRE_ABORT(
       codeBlock.base() == strip_ptrauth(codeBlock.base()),
@@ -81,15 +125,31 @@ ExecBlock::ExecBlock(
   // Split it in two blocks
   dataBlock = llvm::sys::MemoryBlock(
       reinterpret_cast<void *>(reinterpret_cast<uint64_t>(codeBlock.base()) +
-                               pageSize),
-      pageSize);
-  codeBlock = llvm::sys::MemoryBlock(codeBlock.base(), pageSize);
-  QBDI_DEBUG("codeBlock @ 0x{:x} | dataBlock @ 0x{:x} | pageSize {} bytes",
-             reinterpret_cast<rword>(codeBlock.base()),
-             reinterpret_cast<rword>(dataBlock.base()), pageSize);
+                               codeSize),
+      dataSize);
+  codeBlock = llvm::sys::MemoryBlock(codeBlock.base(), codeSize);
+  QBDI_DEBUG("codeBlock @ 0x{:x} ({} bytes) | dataBlock @ 0x{:x} ({} bytes)",
+             reinterpret_cast<rword>(codeBlock.base()), codeSize,
+             reinterpret_cast<rword>(dataBlock.base()), dataSize);
 
   // Other initializations
   context = static_cast<Context *>(dataBlock.base());
+  stateContext = context;
+  if (sharedContext != nullptr) {
+    // On X86_64, the shared context is accessed with a pc relative offset
+    // and must be in the range of a 32 bits displacement.
+    rword low = std::min(reinterpret_cast<rword>(codeBlock.base()),
+                         reinterpret_cast<rword>(sharedContext));
+    rword high = std::max(reinterpret_cast<rword>(dataBlock.base()) +
+                              static_cast<rword>(dataSize),
+                          reinterpret_cast<rword>(sharedContext + 1));
+    if (is_x86 or high - low < 0x7fff0000) {
+      stateContext = sharedContext;
+    } else {
+      QBDI_DEBUG("Shared context out of range, use the context of the "
+                 "dataBlock");
+    }
+  }
   shadows = reinterpret_cast<rword *>(
       reinterpret_cast<rword>(dataBlock.base()) + sizeof(Context));
   shadowIdx = 0;
@@ -132,19 +192,84 @@ ExecBlock::ExecBlock(
 
   QBDI_REQUIRE_ABORT(applyRelocatedInst(*execBlockPrologue, nullptr, llvmcpu),
                      "Fail to write Prologue");
+
+  initIndirectCache(llvmcpu);
+  codeBlockStart = codeBlockPosition;
+}
+
+bool ExecBlock::isValidSize(const ExecBlockSize &size) {
+  uint64_t pageSize = getPageSize();
+  if (size.code % pageSize != 0 or size.data % pageSize != 0 or
+      size.code > EXEC_BLOCK_HUGE_PAGE_SIZE) {
+    return false;
+  }
+  if (size.hugePages) {
+    // A transparent huge page must be aligned and changed as a whole
+    if ((not(is_linux or is_android)) or
+        (size.code != 0 and size.code != EXEC_BLOCK_HUGE_PAGE_SIZE)) {
+      return false;
+    }
+  }
+  if constexpr (is_arm) {
+    // The data block is accessed with 12 bits offsets from the code block
+    return size.code <= pageSize and size.data == 0 and not size.hugePages;
+  } else if constexpr (is_aarch64) {
+    // The shadows are loaded with a 12 bits scaled offset from the data block
+    return size.data <= 0x8000;
+  } else {
+    // The shadows are indexed on 16 bits
+    return size.data <= 0x40000;
+  }
 }
 
 ExecBlock::~ExecBlock() {
+  if (isDualMapped()) {
+    QBDI::releaseMappedMemory(codeWriteBlock);
+  }
   // Reunite the 2 blocks before freeing them
   codeBlock = llvm::sys::MemoryBlock(
       codeBlock.base(), codeBlock.allocatedSize() + dataBlock.allocatedSize());
   QBDI::releaseMappedMemory(codeBlock);
 }
 
+GPRState *ExecBlock::getGPRState() const { return &stateContext->gprState; }
+
+FPRState *ExecBlock::getFPRState() const { return &stateContext->fprState; }
+
+rword ExecBlock::getDataBlockAddress(rword offset) const {
+  if (stateContext != context and
+      ((offset >= offsetof(Context, gprState) and
+        offset < offsetof(Context, gprState) + sizeof(GPRState)) or
+       (offset >= offsetof(Context, fprState) and
+        offset < offsetof(Context, fprState) + sizeof(FPRState)))) {
+    return reinterpret_cast<rword>(stateContext) + offset;
+  }
+  return getDataBlockBase() + offset;
+}
+
 void ExecBlock::changeVMInstanceRef(VMInstanceRef vminstance) {
   this->vminstance = vminstance;
 }
 
+void ExecBlock::recycle() {
+  QBDI_DEBUG("Recycle ExecBlock 0x{:x}", reinterpret_cast<uintptr_t>(this));
+  shadowRegistry.clear();
+  tagRegistry.clear();
+  instMetadata.clear();
+  instRegistry.clear();
+  seqRegistry.clear();
+  chainRegistry.clear();
+  traceRegistry.clear();
+  shadowIdx = 0;
+  currentSeq = 0;
+  currentInst = 0;
+  isFull = false;
+  // The prologue and the dispatcher are at the beginning of the code block,
+  // the epilogue at its end.
+  codeBlockPosition = codeBlockStart;
+  recycleContext();
+}
+
 void ExecBlock::show() const {
   rword i;
   uint64_t instSize;
@@ -178,7 +303,7 @@ void ExecBlock::show() const {
   for (i = 0; i < NUM_GPR; i++) {
     fprintf(stderr, "%s=0x%016" PRIRWORD " ",
             llvmcpu->getRegisterName(GPR_ID[i]),
-            QBDI_GPR_GET(&context->gprState, i));
+            QBDI_GPR_GET(getGPRState(), i));
     if (i % 4 == 0)
       fprintf(stderr, "\n");
   }
@@ -206,32 +331,45 @@ VMAction ExecBlock::execute() {
 
     if (context->hostState.callback != 0) {
       currentInst = context->hostState.origin;
-      rword currentPC = QBDI_GPR_GET(&context->gprState, REG_PC);
+      rword currentPC = QBDI_GPR_GET(getGPRState(), REG_PC);
 
       QBDI_DEBUG("Callback request by ExecBlock 0x{:x} for callback 0x{:x}",
                  reinterpret_cast<uintptr_t>(this),
                  context->hostState.callback);
       QBDI_REQUIRE(currentInst < instMetadata.size());
 
+      // With block chaining, the callback may be requested by a sequence
+      // reached from the programmed one
+      if (currentInst < seqRegistry[currentSeq].startInstID or
+          currentInst > seqRegistry[currentSeq].endInstID) {
+        currentSeq = instRegistry[currentInst].seqID;
+      }
+#if defined(QBDI_ARCH_X86_64) || defined(QBDI_ARCH_X86)
+      completeFPRState(getFPRState());
+#endif
+      // A once callback is skipped from now on
+      skipOnceSlot(currentInst, context->hostState.selector);
+
       VMAction r =
           (reinterpret_cast<InstCallback>(context->hostState.callback))(
-              vminstance, &context->gprState, &context->fprState,
+              vminstance, getGPRState(), getFPRState(),
               (void *)context->hostState.data);
 
       switch (r) {
         case CONTINUE:
           QBDI_DEBUG("Callback 0x{:x} returned CONTINUE",
                      context->hostState.callback);
-          if (QBDI_GPR_GET(&context->gprState, REG_PC) != currentPC) {
+          if (QBDI_GPR_GET(getGPRState(), REG_PC) != currentPC) {
             QBDI_WARN(
                 "Callback returned CONTINUE but change PC: Ignore new value");
+            resetChainExit(currentInst);
           }
           break;
         case SKIP_INST:
           QBDI_DEBUG("Callback 0x{:x} returned SKIP_INST",
                      context->hostState.callback);
           if (not instMetadata[currentInst].modifyPC and
-              QBDI_GPR_GET(&context->gprState, REG_PC) != currentPC) {
+              QBDI_GPR_GET(getGPRState(), REG_PC) != currentPC) {
             QBDI_WARN(
                 "Callback returned SKIP_INST but change PC: Ignore new value");
           }
@@ -239,6 +377,8 @@ VMAction ExecBlock::execute() {
             context->hostState.selector =
                 reinterpret_cast<rword>(codeBlock.base()) +
                 static_cast<rword>(instRegistry[currentInst].offsetSkip);
+            // the chain exit of the instruction may not be computed
+            resetChainExit(currentInst);
           } else {
             QBDI_WARN(
                 "POSTINST callback returned SKIP_INST: Use CONTINUE instead");
@@ -248,7 +388,7 @@ VMAction ExecBlock::execute() {
           QBDI_DEBUG("Callback 0x{:x} returned SKIP_PATCH",
                      context->hostState.callback);
           if (not instMetadata[currentInst].modifyPC and
-              QBDI_GPR_GET(&context->gprState, REG_PC) != currentPC) {
+              QBDI_GPR_GET(getGPRState(), REG_PC) != currentPC) {
             QBDI_WARN(
                 "Callback returned SKIP_PATCH but change PC: Ignore new value");
           }
@@ -265,7 +405,7 @@ VMAction ExecBlock::execute() {
               next_address |= 1;
             }
 #endif
-            QBDI_GPR_SET(&context->gprState, REG_PC, next_address);
+            QBDI_GPR_SET(getGPRState(), REG_PC, next_address);
             return BREAK_TO_VM;
           } else {
             // go to currentInst + 1
@@ -302,8 +442,10 @@ bool ExecBlock::writeCodeByte(const llvm::ArrayRef<char> &array) {
     return false;
   }
 
-  memcpy(static_cast<char *>(codeBlock.base()) + codeBlockPosition,
-         array.data(), array.size());
+  // Write through the writable view of a dual mapped code block
+  char *codeBase = static_cast<char *>(isDualMapped() ? codeWriteBlock.base()
+                                                      : codeBlock.base());
+  memcpy(codeBase + codeBlockPosition, array.data(), array.size());
   codeBlockPosition += array.size();
   return true;
 }
@@ -317,7 +459,7 @@ bool ExecBlock::applyRelocatedInst(
       QBDI_DEBUG("RelocTag 0x{:x}", inst->getTag());
       if (tags != nullptr) {
         tags->push_back(TagInfo{static_cast<uint16_t>(inst->getTag()),
-                                static_cast<uint16_t>(codeBlockPosition)});
+                                static_cast<uint32_t>(codeBlockPosition)});
       }
       continue;
     } else {
@@ -347,12 +489,18 @@ bool ExecBlock::applyRelocatedInst(
 
 SeqWriteResult
 ExecBlock::writeSequence(std::vector<Patch>::const_iterator seqIt,
-                         std::vector<Patch>::const_iterator seqEnd) {
+                         std::vector<Patch>::const_iterator seqEnd,
+                         bool trace) {
   unsigned startOffset = codeBlockPosition;
   uint16_t startInstID = getNextInstID();
   uint16_t seqID = getNextSeqID();
-  uint8_t executeFlags = 0;
+  uint32_t executeFlags = 0;
   unsigned patchWritten = 0;
+  uint16_t startShadowIdx = shadowIdx;
+  size_t startShadowRegistry = shadowRegistry.size();
+  size_t startTagRegistry = tagRegistry.size();
+  size_t startChainRegistry = chainRegistry.size();
+  TraceInfo traceInfo{seqID, {}};
 
   // Check if there's enough space left
   if (isFull) {
@@ -378,16 +526,26 @@ ExecBlock::writeSequence(std::vector<Patch>::const_iterator seqIt,
   } else if (isRWRXSupported()) {
     makeRW();
   }
+  // The stub of the fast callbacks is written before the first sequence that
+  // uses it
+  if (not initFastCallStub(seqIt, seqEnd, llvmcpu)) {
+    QBDI_DEBUG("No space left for the fast callbacks stub in ExecBlock 0x{:x}",
+               reinterpret_cast<uintptr_t>(this));
+    isFull = true;
+    return {EXEC_BLOCK_FULL, 0, 0};
+  }
+  startOffset = codeBlockPosition;
   initScratchRegisterForPatch(seqIt, seqEnd);
   bool needTerminator = true;
   // JIT the basic block instructions patch per patch
   // A patch correspond to an original instruction and should be written in its
-  // entierty
+  // entirety
   while (seqIt != seqEnd) {
     unsigned rollbackOffset = codeBlockPosition;
     uint32_t rollbackShadowIdx = shadowIdx;
     size_t rollbackShadowRegistry = shadowRegistry.size();
     size_t rollbackTagRegistry = tagRegistry.size();
+    size_t rollbackChainRegistry = chainRegistry.size();
 
     QBDI_DEBUG_BLOCK({
       std::string disass =
@@ -399,9 +557,15 @@ ExecBlock::writeSequence(std::vector<Patch>::const_iterator seqIt,
           seqIt->metadata.address, disass.c_str());
     });
 
+    // The instructions are indexed on 16 bits, and the last ID is
+    // EXEC_BLOCK_FULL
+    if (getNextInstID() >= EXEC_BLOCK_FULL - 1) {
+      isFull = true;
+    }
+
     // Attempt to write a complete patch. If not, rollback to the last complete
     // patch written
-    if (not writePatch(seqIt, seqEnd, llvmcpu)) {
+    if (isFull or not writePatch(seqIt, seqEnd, llvmcpu)) {
 
       QBDI_DEBUG("Rolling back to offset 0x{:x}", rollbackOffset);
 
@@ -415,12 +579,28 @@ ExecBlock::writeSequence(std::vector<Patch>::const_iterator seqIt,
       shadowIdx = rollbackShadowIdx;
       shadowRegistry.resize(rollbackShadowRegistry);
       tagRegistry.resize(rollbackTagRegistry);
+      chainRegistry.resize(rollbackChainRegistry);
       // It's a NULL rollback, don't terminate it
       if (rollbackOffset == startOffset) {
         QBDI_DEBUG("NULL rollback, nothing written to ExecBlock 0x{:x}",
                    reinterpret_cast<uintptr_t>(this));
         return {EXEC_BLOCK_FULL, 0, 0};
       }
+      // A trace is written in its entirety: drop the written patches
+      if (trace) {
+        QBDI_DEBUG("Trace doesn't fit in ExecBlock 0x{:x}",
+                   reinterpret_cast<uintptr_t>(this));
+        codeBlockPosition = startOffset;
+        shadowIdx = startShadowIdx;
+        shadowRegistry.resize(startShadowRegistry);
+        tagRegistry.resize(startTagRegistry);
+        chainRegistry.resize(startChainRegistry);
+        instMetadata.erase(instMetadata.begin() + startInstID,
+                           instMetadata.end());
+        instRegistry.erase(instRegistry.begin() + startInstID,
+                           instRegistry.end());
+        return {EXEC_BLOCK_FULL, 0, 0};
+      }
       needTerminator = true;
       break;
     } else {
@@ -432,7 +612,7 @@ ExecBlock::writeSequence(std::vector<Patch>::const_iterator seqIt,
       instRegistry.push_back(InstInfo{
           seqID, 0, 0, static_cast<uint16_t>(rollbackShadowRegistry),
           static_cast<uint16_t>(shadowRegistry.size() - rollbackShadowRegistry),
-          static_cast<uint16_t>(rollbackTagRegistry),
+          static_cast<uint32_t>(rollbackTagRegistry),
           static_cast<uint16_t>(tagRegistry.size() - rollbackTagRegistry)});
       // compute begin of the new instruction (writePatch can add extra data
       // to perform the transition from the previous instruction, and we should
@@ -455,8 +635,19 @@ ExecBlock::writeSequence(std::vector<Patch>::const_iterator seqIt,
       executeFlags |= seqIt->metadata.execblockFlags;
       seqIt++;
       patchWritten += 1;
+      // In a trace, the branch continues to the next patch
+      if (trace and not needTerminator and seqIt != seqEnd and
+          not linkTraceBranch(*std::prev(seqIt), seqIt->metadata.address,
+                              rollbackChainRegistry, traceInfo, llvmcpu)) {
+        QBDI_DEBUG("End the trace at 0x{:x}", seqIt->metadata.address);
+        break;
+      }
     }
   }
+  // Block chaining is only supported on X86 and X86_64
+  bool chaining = (is_x86_64 or is_x86) and
+                  llvmcpu.hasOptions(Options::OPT_ENABLE_BLOCK_CHAINING);
+  RelocatableInst::UniquePtrVec jmpEpilogue;
   // The last instruction of the sequence doesn't end with a change of RIP/PC,
   // add a Terminator
   if (needTerminator) {
@@ -467,9 +658,27 @@ ExecBlock::writeSequence(std::vector<Patch>::const_iterator seqIt,
         getTerminator(llvmcpu, instMetadata.back().endAddress());
     QBDI_REQUIRE_ABORT(applyRelocatedInst(terminator, nullptr, llvmcpu),
                        "Fail to write Terminator");
+    if (chaining) {
+      uint16_t slot = newChainSlot(instMetadata.back().endAddress());
+      jmpEpilogue = getChainJump(llvmcpu, getShadowOffset(slot));
+    }
+  } else if (chaining) {
+    // the patch of the last instruction may have computed the chain exit
+    for (const ShadowInfo &shadow : getShadowByInst(getNextInstID() - 1)) {
+      if (shadow.tag == ShadowReservedTag::CHAIN_EXIT_TAG) {
+        setShadow(shadow.shadowID, getEpilogueAddress());
+        jmpEpilogue = getChainJump(llvmcpu, getShadowOffset(shadow.shadowID));
+      }
+    }
+    // indirect branch: lookup the target in the indirect branch cache
+    if (jmpEpilogue.empty()) {
+      jmpEpilogue = getIndirectCacheJump(llvmcpu);
+    }
   }
   // JIT the jump to epilogue
-  RelocatableInst::UniquePtrVec jmpEpilogue = JmpEpilogue().genReloc(llvmcpu);
+  if (jmpEpilogue.empty()) {
+    jmpEpilogue = JmpEpilogue().genReloc(llvmcpu);
+  }
   QBDI_REQUIRE_ABORT(applyRelocatedInst(jmpEpilogue, nullptr, llvmcpu),
                      "Fail to write jmpEpilogue");
   // change the flag of the basicblock
@@ -482,6 +691,9 @@ ExecBlock::writeSequence(std::vector<Patch>::const_iterator seqIt,
   uint16_t endInstID = getNextInstID() - 1;
   seqRegistry.push_back(SeqInfo{startInstID, endInstID, executeFlags, cpuMode,
                                 instRegistry[startInstID].sr});
+  if (trace) {
+    traceRegistry.push_back(std::move(traceInfo));
+  }
   // Return write results
   unsigned bytesWritten = codeBlockPosition - startOffset;
   QBDI_REQUIRE_ABORT(codeBlockPosition <=
@@ -502,7 +714,13 @@ uint16_t ExecBlock::splitSequence(uint16_t instID) {
 }
 
 void ExecBlock::makeRX() {
-  if (not isRX()) {
+  if (not isRX() and isDualMapped()) {
+    // The code written through the writable view must be visible in the
+    // instruction cache
+    llvm::sys::Memory::InvalidateInstructionCache(codeBlock.base(),
+                                                  codeBlock.allocatedSize());
+    pageState = RX;
+  } else if (not isRX()) {
     QBDI_DEBUG("Making ExecBlock 0x{:x} RX", reinterpret_cast<uintptr_t>(this));
     QBDI_REQUIRE_ABORT(!llvm::sys::Memory::protectMappedMemory(
                            codeBlock, PF::MF_READ | PF::MF_EXEC),
@@ -512,7 +730,9 @@ void ExecBlock::makeRX() {
 }
 
 void ExecBlock::makeRW() {
-  if (not isRW()) {
+  if (not isRW() and isDualMapped()) {
+    pageState = RW;
+  } else if (not isRW()) {
     QBDI_DEBUG("Making ExecBlock 0x{:x} RW", reinterpret_cast<uintptr_t>(this));
     QBDI_REQUIRE_ABORT(!llvm::sys::Memory::protectMappedMemory(
                            codeBlock, PF::MF_READ | PF::MF_WRITE),
@@ -534,6 +754,193 @@ uint16_t ExecBlock::newShadow(uint16_t tag) {
   return id;
 }
 
+uint16_t ExecBlock::newChainSlot(rword target) {
+  uint16_t id = newShadow();
+  setShadow(id, getEpilogueAddress());
+  chainRegistry.push_back({getNextSeqID(), id, target, false, NOT_FOUND});
+  return id;
+}
+
+uint16_t ExecBlock::newOnceSlot(rword stub, rword skip) {
+  uint16_t id = newShadow(ShadowReservedTag::ONCE_SLOT_TAG);
+  setShadow(id, stub);
+  // the address after the stub is kept in the next shadow
+  setShadow(newShadow(ShadowReservedTag::ONCE_SKIP_TAG), skip);
+  return id;
+}
+
+void ExecBlock::skipOnceSlot(uint16_t instID, rword resume) {
+  llvm::ArrayRef<ShadowInfo> shadows = getShadowByInst(instID);
+  for (size_t i = 1; i < shadows.size(); i++) {
+    if (shadows[i].tag == ShadowReservedTag::ONCE_SKIP_TAG and
+        getShadow(shadows[i].shadowID) == resume) {
+      QBDI_REQUIRE_ACTION(
+          shadows[i - 1].tag == ShadowReservedTag::ONCE_SLOT_TAG, return);
+      QBDI_DEBUG("Skip the once callback of instID {:x}", instID);
+      setShadow(shadows[i - 1].shadowID, resume);
+      return;
+    }
+  }
+}
+
+void ExecBlock::linkChainSlot(ChainSlotInfo &slot,
+                              const ChainFilter &canChain) {
+  if (slot.linked or slot.seqID >= seqRegistry.size()) {
+    return;
+  }
+  const SeqInfo &source = seqRegistry[slot.seqID];
+  // Branch inside a trace: continue with the next instruction of the trace
+  if (slot.traceInstID != NOT_FOUND) {
+    if (not canChain(slot.target, false)) {
+      return;
+    }
+    QBDI_DEBUG("Link chain slot {} of trace {:x} to instID {:x} (0x{:x})",
+               slot.shadowID, slot.seqID, slot.traceInstID, slot.target);
+    setShadow(slot.shadowID,
+              getBaseCodeBlock() + instRegistry[slot.traceInstID].offset);
+    slot.linked = true;
+    return;
+  }
+  if (not canChain(slot.target,
+                   slot.target <= instMetadata[source.startInstID].address)) {
+    return;
+  }
+  uint16_t targetSeq = NOT_FOUND;
+  for (const TraceInfo &trace : traceRegistry) {
+    const SeqInfo &seq = seqRegistry[trace.seqID];
+    if (instMetadata[seq.startInstID].address == slot.target and
+        seq.cpuMode == source.cpuMode and
+        (seq.executeFlags & ~source.executeFlags) == 0 and
+        isTraceUsable(trace.seqID, canChain)) {
+      targetSeq = trace.seqID;
+      break;
+    }
+  }
+  if (targetSeq == NOT_FOUND) {
+    targetSeq = getSeqID(slot.target, source.cpuMode);
+  }
+  if (targetSeq == NOT_FOUND) {
+    return;
+  }
+  const SeqInfo &target = seqRegistry[targetSeq];
+  // The context switch of the prologue was done for the source sequence. The
+  // target must not need more than that.
+  if ((target.executeFlags & ~source.executeFlags) != 0) {
+    return;
+  }
+  QBDI_DEBUG("Link chain slot {} of seqID {:x} to seqID {:x} (0x{:x})",
+             slot.shadowID, slot.seqID, targetSeq, slot.target);
+  setShadow(slot.shadowID,
+            getBaseCodeBlock() + instRegistry[target.startInstID].offset);
+  slot.linked = true;
+}
+
+void ExecBlock::linkSeqChains(uint16_t seqID, const ChainFilter &canChain) {
+  QBDI_REQUIRE(seqID < seqRegistry.size());
+  rword seqAddress = instMetadata[seqRegistry[seqID].startInstID].address;
+
+  for (ChainSlotInfo &slot : chainRegistry) {
+    if (slot.seqID == seqID or slot.target == seqAddress) {
+      linkChainSlot(slot, canChain);
+    }
+  }
+}
+
+void ExecBlock::linkAllChains(const ChainFilter &canChain) {
+  for (ChainSlotInfo &slot : chainRegistry) {
+    linkChainSlot(slot, canChain);
+  }
+}
+
+bool ExecBlock::linkTraceBranch(const Patch &patch, rword next,
+                                size_t firstSlot, TraceInfo &trace,
+                                const LLVMCPU &llvmcpu) {
+  uint16_t instID = getNextInstID() - 1;
+  uint16_t exitShadow = NOT_FOUND;
+  for (const ShadowInfo &shadow : getShadowByInst(instID)) {
+    if (shadow.tag == ShadowReservedTag::CHAIN_EXIT_TAG) {
+      exitShadow = shadow.shadowID;
+    }
+  }
+  // an indirect branch has no chain slot
+  bool found = false;
+  if (exitShadow != NOT_FOUND) {
+    for (size_t i = firstSlot; i < chainRegistry.size(); i++) {
+      if (chainRegistry[i].target == next) {
+        chainRegistry[i].traceInstID = getNextInstID();
+        found = true;
+      }
+    }
+  }
+  if (not found) {
+    return false;
+  }
+  // A direct jump always continues with the next instruction of the trace. It
+  // is removed if no callback can change the control flow.
+  const llvm::MCInstrDesc &desc =
+      llvmcpu.getMCII().get(patch.metadata.inst.getOpcode());
+  if (desc.isUnconditionalBranch() and
+      queryTagByInst(instID, RelocTagPreInstStdCBK).empty() and
+      queryTagByInst(instID, RelocTagPostInstStdCBK).empty()) {
+    QBDI_DEBUG("Remove the jump to 0x{:x} in the trace", next);
+    trace.elidedTargets.push_back(next);
+    return true;
+  }
+  // Else, jump to the computed exit: the next instruction when the slot is
+  // linked, or a side exit.
+  setShadow(exitShadow, getEpilogueAddress());
+  QBDI_REQUIRE_ABORT(
+      applyRelocatedInst(getChainJump(llvmcpu, getShadowOffset(exitShadow)),
+                         nullptr, llvmcpu),
+      "Fail to write the trace branch");
+  return true;
+}
+
+const TraceInfo *ExecBlock::getTrace(uint16_t seqID) const {
+  for (const TraceInfo &trace : traceRegistry) {
+    if (trace.seqID == seqID) {
+      return &trace;
+    }
+  }
+  return nullptr;
+}
+
+bool ExecBlock::isTraceUsable(uint16_t seqID,
+                              const ChainFilter &canChain) const {
+  const TraceInfo *trace = getTrace(seqID);
+  if (trace == nullptr) {
+    return false;
+  }
+  for (rword target : trace->elidedTargets) {
+    if (not canChain(target, false)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ExecBlock::unlinkAllChains() {
+  rword epilogue = getEpilogueAddress();
+  for (ChainSlotInfo &slot : chainRegistry) {
+    if (slot.linked) {
+      setShadow(slot.shadowID, epilogue);
+      slot.linked = false;
+    }
+  }
+  clearIndirectCache();
+}
+
+void ExecBlock::resetChainExit(uint16_t instID) {
+  if (chainRegistry.empty()) {
+    return;
+  }
+  for (const ShadowInfo &shadow : getShadowByInst(instID)) {
+    if (shadow.tag == ShadowReservedTag::CHAIN_EXIT_TAG) {
+      setShadow(shadow.shadowID, getEpilogueAddress());
+    }
+  }
+}
+
 uint16_t ExecBlock::getLastShadow(uint16_t tag) {
   uint16_t nextInstID = getNextInstID();
 
@@ -569,7 +976,8 @@ rword ExecBlock::getShadowOffset(uint16_t id) const {
 uint16_t ExecBlock::getInstID(rword address, CPUMode cpuMode) const {
   for (size_t i = 0; i < instMetadata.size(); i++) {
     if (instMetadata[i].address == address and
-        instMetadata[i].cpuMode == cpuMode) {
+        instMetadata[i].cpuMode == cpuMode and
+        getTrace(instRegistry[i].seqID) == nullptr) {
       return (uint16_t)i;
     }
   }
@@ -634,7 +1042,8 @@ const InstAnalysis *ExecBlock::getInstAnalysis(uint16_t instID,
 uint16_t ExecBlock::getSeqID(rword address, CPUMode cpuMode) const {
   for (size_t i = 0; i < seqRegistry.size(); i++) {
     if (instMetadata[seqRegistry[i].startInstID].address == address and
-        instMetadata[seqRegistry[i].startInstID].cpuMode == cpuMode) {
+        instMetadata[seqRegistry[i].startInstID].cpuMode == cpuMode and
+        getTrace(i) == nullptr) {
       return (uint16_t)i;
     }
   }
@@ -762,11 +1171,11 @@ uint16_t ExecBlock::getPatchAddressOfJit(rword address) const {
     // address outside of this Execblock, or in the prologue
     return NOT_FOUND;
   }
-  uint16_t targetOffset = static_cast<uint16_t>(address - getBaseCodeBlock());
+  uint32_t targetOffset = static_cast<uint32_t>(address - getBaseCodeBlock());
 
   auto it =
       std::lower_bound(instRegistry.cbegin(), instRegistry.cend(), targetOffset,
-                       [](const InstInfo &info, uint16_t value) {
+                       [](const InstInfo &info, uint32_t value) {
                          return info.offset <= value;
                        });
 
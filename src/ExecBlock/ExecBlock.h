@@ -18,6 +18,7 @@
 #ifndef EXECBLOCK_H
 #define EXECBLOCK_H
 
+#include <functional>
 #include <memory>
 #include <stdint.h>
 #include <vector>
@@ -58,11 +59,11 @@ struct Context;
 
 struct InstInfo {
   uint16_t seqID;
-  uint16_t offset;
-  uint16_t offsetSkip;
+  uint32_t offset;
+  uint32_t offsetSkip;
   uint16_t shadowOffset;
   uint16_t shadowSize;
-  uint16_t tagOffset;
+  uint32_t tagOffset;
   uint16_t tagSize;
   ScratchRegisterSeqInfo sr;
 };
@@ -70,7 +71,7 @@ struct InstInfo {
 struct SeqInfo {
   uint16_t startInstID;
   uint16_t endInstID;
-  uint8_t executeFlags;
+  uint32_t executeFlags;
   CPUMode cpuMode;
   ScratchRegisterSeqInfo sr;
 };
@@ -89,11 +90,46 @@ struct ShadowInfo {
 
 struct TagInfo {
   uint16_t tag;
-  uint16_t offset;
+  uint32_t offset;
 };
 
+struct ChainSlotInfo {
+  uint16_t seqID;
+  uint16_t shadowID;
+  rword target;
+  bool linked;
+  // For a link inside a trace, the instruction to jump to (or NOT_FOUND)
+  uint16_t traceInstID;
+};
+
+struct TraceInfo {
+  uint16_t seqID;
+  // targets of the branches removed from the trace
+  std::vector<rword> elidedTargets;
+};
+
+/*! Filter on the target of a chain slot. The second argument is true when the
+ * target is at or before the start of the sequence that owns the slot.
+ */
+using ChainFilter = std::function<bool(rword target, bool backward)>;
+
 static const uint16_t EXEC_BLOCK_FULL = 0xFFFF;
 
+// Size of the code block of an ExecBlock backed by a huge page, and the
+// largest code block
+static const uint32_t EXEC_BLOCK_HUGE_PAGE_SIZE = 0x200000;
+
+/*! Size of the code block and the data block of the ExecBlocks of a VM. A
+ * size of zero uses the default: one page for the code, and the pages needed
+ * by two contexts for the data.
+ */
+struct ExecBlockSize {
+  uint32_t code = 0;
+  uint32_t data = 0;
+  // back the code block with a transparent huge page (Linux and Android)
+  bool hugePages = false;
+};
+
 /*! Manages the concept of an exec block made of two contiguous memory blocks
  * (one for the code, the other for the data) used to store and execute
  * instrumented basic blocks.
@@ -107,10 +143,19 @@ private:
   VMInstanceRef vminstance;
   llvm::sys::MemoryBlock codeBlock;
   llvm::sys::MemoryBlock dataBlock;
+  // Writable view of the codeBlock with OPT_ENABLE_DUAL_MAPPING. The codeBlock
+  // stays read execute and its permissions are never changed.
+  llvm::sys::MemoryBlock codeWriteBlock;
   unsigned codeBlockPosition;
   unsigned codeBlockMaxSize;
+  // Position after the prologue and the indirect cache dispatcher, where the
+  // first sequence is written
+  unsigned codeBlockStart;
   const LLVMCPUs &llvmCPUs;
   Context *context;
+  // Context that holds the guest GPRState and FPRState. It is either the
+  // context of the data block or the context shared by the ExecBlocks of a VM.
+  Context *stateContext;
   rword *shadows;
   std::vector<ShadowInfo> shadowRegistry;
   std::vector<TagInfo> tagRegistry;
@@ -118,6 +163,8 @@ private:
   std::vector<InstMetadata> instMetadata;
   std::vector<InstInfo> instRegistry;
   std::vector<SeqInfo> seqRegistry;
+  std::vector<ChainSlotInfo> chainRegistry;
+  std::vector<TraceInfo> traceRegistry;
   PageState pageState;
   uint16_t currentSeq;
   uint16_t currentInst;
@@ -137,11 +184,19 @@ private:
    */
   inline bool isRW() const { return pageState == RW; }
 
-  /*! Changes the code block permissions to RX.
+  /*! Verify if the code block is mapped twice.
+   *
+   * @return Return true if the code is written through codeWriteBlock.
+   */
+  inline bool isDualMapped() const { return codeWriteBlock.base() != nullptr; }
+
+  /*! Changes the code block permissions to RX. A dual mapped code block only
+   * needs the instruction cache to be invalidated.
    */
   void makeRX();
 
-  /*! Changes the code block permissions to RW.
+  /*! Changes the code block permissions to RW. A dual mapped code block is
+   * always writable through codeWriteBlock.
    */
   void makeRW();
 
@@ -161,6 +216,87 @@ private:
 
   void finalizeScratchRegisterForPatch();
 
+  /*! Get the JIT address of the epilogue, used as the value of an unlinked
+   * chain slot.
+   *
+   * @return The address of the epilogue.
+   */
+  rword getEpilogueAddress() const {
+    return reinterpret_cast<rword>(codeBlock.base()) +
+           codeBlock.allocatedSize() - epilogueSize;
+  }
+
+  /*! Try to link a chain slot to the sequence of this ExecBlock that starts at
+   * its target. A usable trace is preferred to the sequence.
+   *
+   * @param[in] slot       The chain slot to link.
+   * @param[in] canChain   Filter on the target address.
+   */
+  void linkChainSlot(ChainSlotInfo &slot, const ChainFilter &canChain);
+
+  /*! Link the branch of a trace to the next instruction of the trace. Called
+   * after the patch of the branch has been written.
+   *
+   * @param[in] patch       The patch of the branch.
+   * @param[in] next        The address of the next instruction of the trace.
+   * @param[in] firstSlot   The first chain slot allocated by the patch.
+   * @param[in] trace       The trace being written.
+   * @param[in] llvmcpu     LLVMCPU used to assemble the jump.
+   *
+   * @return False if the branch cannot reach the next instruction. The trace
+   *         must end after the branch.
+   */
+  bool linkTraceBranch(const Patch &patch, rword next, size_t firstSlot,
+                       TraceInfo &trace, const LLVMCPU &llvmcpu);
+
+  /*! Get the trace registered for a sequence.
+   *
+   * @param[in] seqID  The sequence ID.
+   *
+   * @return The trace or nullptr if the sequence isn't a trace.
+   */
+  const TraceInfo *getTrace(uint16_t seqID) const;
+
+  /*! Reset the chain exit of an instruction to the epilogue. Used when a
+   * callback changes the control flow after the exit has been computed.
+   *
+   * @param[in] instID  The instruction ID.
+   */
+  void resetChainExit(uint16_t instID);
+
+  /*! Write the dispatcher of the indirect branch target cache, if supported by
+   * the architecture and enabled in the options.
+   *
+   * @param[in] llvmcpu  LLVMCPU used to assemble the dispatcher.
+   */
+  void initIndirectCache(const LLVMCPU &llvmcpu);
+
+  /*! Reset the architecture specific fields of the context of the data block
+   * (indirect branch cache, fast callbacks stub) when the ExecBlock is
+   * recycled.
+   */
+  void recycleContext();
+
+  /*! Write the stub of the fast callbacks if a patch of the sequence calls a
+   * fast callback and the stub isn't written yet. Only supported on X86_64.
+   *
+   * @param[in] seqStart  Iterator to the first patch of the sequence.
+   * @param[in] seqEnd    Iterator after the last patch of the sequence.
+   * @param[in] llvmcpu   LLVMCPU used to assemble the stub.
+   *
+   * @return False if there isn't enough space left for the stub.
+   */
+  bool initFastCallStub(std::vector<Patch>::const_iterator seqStart,
+                        std::vector<Patch>::const_iterator seqEnd,
+                        const LLVMCPU &llvmcpu);
+
+  /*! Call the fast callback requested by the JIT code. Called by the stub of
+   * the fast callbacks on the host stack.
+   *
+   * @param[in] execBlock  The ExecBlock that requests the callback.
+   */
+  static void fastCallback(ExecBlock *execBlock);
+
 public:
   /*! Construct a new ExecBlock
    *
@@ -170,6 +306,10 @@ public:
    * @param[in] execBlockPrologue  cached prologue of ExecManager
    * @param[in] execBlockEpilogue  cached epilogue of ExecManager
    * @param[in] epilogueSize       size in bytes of the epilogue (0 is not know)
+   * @param[in] sharedContext      context shared by the ExecBlocks for the
+   *                               guest state (nullptr to use the context of
+   *                               the data block)
+   * @param[in] size               size of the code and the data blocks
    */
   ExecBlock(
       const LLVMCPUs &llvmCPUs, VMInstanceRef vminstance,
@@ -177,7 +317,8 @@ public:
           nullptr,
       const std::vector<std::unique_ptr<RelocatableInst>> *execBlockEpilogue =
           nullptr,
-      uint32_t epilogueSize = 0);
+      uint32_t epilogueSize = 0, Context *sharedContext = nullptr,
+      const ExecBlockSize &size = {});
 
   ~ExecBlock();
 
@@ -188,6 +329,13 @@ public:
    */
   void changeVMInstanceRef(VMInstanceRef vminstance);
 
+  /*! Remove all the sequences of the ExecBlock to reuse it for another region.
+   * The memory, the prologue, the epilogue and the dispatcher of the indirect
+   * branch cache are kept. The ExecBlock must not be referenced by any chain
+   * slot of another ExecBlock.
+   */
+  void recycle();
+
   /*! Display the content of an exec block to stderr.
    */
   void show() const;
@@ -198,23 +346,41 @@ public:
 
   static uint64_t getPageSize();
 
+  /*! Check if the code and the data blocks of an ExecBlock can have a size
+   * on this architecture and platform. The sizes must be multiples of the
+   * page size, and the JIT code must reach the data block and the shadows.
+   *
+   * @param[in] size  The size of the code and the data blocks.
+   *
+   * @return True if the size is supported.
+   */
+  static bool isValidSize(const ExecBlockSize &size);
+
   /*! Execute the sequence currently programmed in the selector of the exec
    * block. Take care of the callbacks handling.
    */
   VMAction execute();
 
   /*! Write a new sequence in the exec block. This function does not guarantee
-   * that the sequence will be written in its entierty and might stop before the
+   * that the sequence will be written in its entirety and might stop before the
    * end using an architecture specific terminator. Return 0 if the exec block
    * was full and no instruction was written.
    *
+   * When trace is true, the patches are the basic blocks of a hot path. The
+   * branches between them are linked to the next patch of the trace and the
+   * others directions become side exits. The trace is written in its entirety
+   * or not at all, but it ends at the first branch that cannot reach the next
+   * patch. A trace is never returned by getSeqID or getInstID.
+   *
    * @param seqStart [in] Iterator to the start of a list of patches.
    * @param seqEnd   [in] Iterator to the end of a list of patches.
+   * @param trace    [in] Write the patches as a trace.
    *
    * @return A structure detailling the write operation result.
    */
   SeqWriteResult writeSequence(std::vector<Patch>::const_iterator seqStart,
-                               std::vector<Patch>::const_iterator seqEnd);
+                               std::vector<Patch>::const_iterator seqEnd,
+                               bool trace = false);
 
   /*! Split an existing sequence at instruction instID to create a new sequence.
    *
@@ -242,6 +408,16 @@ public:
     return reinterpret_cast<rword>(dataBlock.base());
   }
 
+  /*! Get the address of a field of the data block. The fields of the guest
+   * GPRState and FPRState are in the shared context when the ExecBlock uses
+   * one.
+   *
+   * @param[in] offset  The offset of the field in the data block.
+   *
+   * @return The address of the field.
+   */
+  rword getDataBlockAddress(rword offset) const;
+
   /*! Compute the offset between the current code stream position and the start
    * of the data block. Used for pc relative memory access to the data block.
    *
@@ -284,6 +460,12 @@ public:
     return reinterpret_cast<rword>(codeBlock.base());
   }
 
+  /*! Get the size of the codeBlock
+   *
+   * @return The size of the codeBlock, including the epilogue
+   */
+  rword getCodeBlockSize() const { return codeBlock.allocatedSize(); }
+
   /*! Obtain the current instruction ID.
    *
    * @return The current instruction ID.
@@ -413,6 +595,107 @@ public:
    */
   Context *getContext() const { return context; }
 
+  /*! Get a pointer to the guest GPRState used by the ExecBlock.
+   *
+   * @return The GPRState pointer.
+   */
+  GPRState *getGPRState() const;
+
+  /*! Get a pointer to the guest FPRState used by the ExecBlock.
+   *
+   * @return The FPRState pointer.
+   */
+  FPRState *getFPRState() const;
+
+  /*! Verify if the guest state is stored in a context shared with the other
+   * ExecBlocks.
+   *
+   * @return True if the ExecBlock uses the shared context.
+   */
+  bool hasSharedContext() const { return stateContext != context; }
+
+  /*! Allocate a new chain slot for the current sequence. A chain slot is a
+   * shadow which holds the JIT address to jump to in order to reach the guest
+   * address target. It initially holds the address of the epilogue and is
+   * updated when a sequence for the target is available in this ExecBlock.
+   *
+   * @param[in] target  The guest address of the successor.
+   *
+   * @return The shadow id of the slot.
+   */
+  uint16_t newChainSlot(rword target);
+
+  /*! Allocate a once slot for the current instruction. A once slot is a
+   * shadow which holds the JIT address jumped to before the stub of a once
+   * callback. It initially holds the address of the stub and is set to the
+   * address after the stub when the callback is called.
+   *
+   * @param[in] stub  The JIT address of the stub.
+   * @param[in] skip  The JIT address after the stub, where the execution is
+   *                  resumed after the callback.
+   *
+   * @return The shadow id of the slot.
+   */
+  uint16_t newOnceSlot(rword stub, rword skip);
+
+  /*! Skip the stub of a once callback of an instruction, if the callback
+   * resumes the execution at an address.
+   *
+   * @param[in] instID  The instruction ID.
+   * @param[in] resume  The JIT address where the execution is resumed after
+   *                    the callback.
+   */
+  void skipOnceSlot(uint16_t instID, rword resume);
+
+  /*! Link the chain slots of a sequence to their targets and the unlinked
+   * chain slots that target the start of this sequence.
+   *
+   * @param[in] seqID      The sequence ID.
+   * @param[in] canChain   Filter on the target address. A slot is only linked
+   *                       if the filter returns true.
+   */
+  void linkSeqChains(uint16_t seqID, const ChainFilter &canChain);
+
+  /*! Link every chain slot of the ExecBlock when the target is available.
+   *
+   * @param[in] canChain   Filter on the target address.
+   */
+  void linkAllChains(const ChainFilter &canChain);
+
+  /*! Verify if a trace can be executed. The branches removed from the trace
+   * must target addresses accepted by the filter.
+   *
+   * @param[in] seqID      The sequence ID of the trace.
+   * @param[in] canChain   Filter on the target address.
+   *
+   * @return True if the sequence is a trace that can be executed.
+   */
+  bool isTraceUsable(uint16_t seqID, const ChainFilter &canChain) const;
+
+  /*! Unlink every chain slot of the ExecBlock and empty the indirect branch
+   * target cache. Every sequence will return to the epilogue at its end.
+   */
+  void unlinkAllChains();
+
+  /*! Add the sequence in the indirect branch target cache. The sequence must
+   * be the programmed one.
+   *
+   * @param[in] seqID  The sequence ID.
+   */
+  void cacheIndirectTarget(uint16_t seqID);
+
+  /*! Remove all the entries of the indirect branch target cache and of the
+   * return stack.
+   */
+  void clearIndirectCache();
+
+  /*! Get the counters of the indirect branch target cache.
+   *
+   * @param[out] hits    The number of lookups that found their target.
+   * @param[out] misses  The number of lookups that returned to the host.
+   */
+  void getIndirectCacheStats(rword &hits, rword &misses) const;
+
   /*! Allocate a new shadow within the data block. Used by relocation to load or
    * store data from the instrumented code.
    *
@@ -18,20 +18,36 @@
 #include <algorithm>
 #include <iterator>
 #include <stdlib.h>
+#include <system_error>
 #include <utility>
 
 #include "Engine/LLVMCPU.h"
+#include "ExecBlock/Context.h"
 #include "ExecBlock/ExecBlock.h"
 #include "ExecBlock/ExecBlockManager.h"
 #include "ExecBroker/ExecBroker.h"
 #include "Patch/ExecBlockPatch.h"
 #include "Patch/InstMetadata.h"
+#include "Patch/InstrRules.h"
 #include "Patch/Patch.h"
+#include "Patch/PatchGenerator.h"
+#include "Patch/PatchUtils.h"
 #include "Patch/RelocatableInst.h"
+#include "Patch/TempManager.h"
 #include "Utility/LogSys.h"
+#include "Utility/System.h"
+
+#include "QBDI/Options.h"
 
 namespace QBDI {
 
+// Number of entries of the host in a sequence before it becomes the head of a
+// hot trace
+static const uint32_t TRACE_HEAD_THRESHOLD = 32;
+
+// Number of counters of the block profile allocated at once in the arena
+static const size_t COUNTER_ARENA_CHUNK = 512;
+
 namespace {
 
 inline rword getExecRegionKey(rword address, CPUMode cpumode) {
@@ -45,19 +61,47 @@ inline rword getExecRegionKey(rword address, CPUMode cpumode) {
   return address;
 }
 
+// Generate the inline instrumentation of a basic block at the beginning of a
+// patch
+void insertGeneratorsAtBegin(Patch &patch,
+                             const PatchGenerator::UniquePtrVec &generators) {
+  RelocatableInst::UniquePtrVec insts;
+  TempManager tempManager(patch);
+  for (const PatchGenerator::UniquePtr &g : generators) {
+    append(insts, g->generate(patch, tempManager));
+  }
+  patch.insertAtBegin(std::move(insts));
+}
+
 } // namespace
 
 ExecBlockManager::ExecBlockManager(const LLVMCPUs &llvmCPUs,
                                    VMInstanceRef vminstance)
-    : total_translated_size(1), total_translation_size(1),
-      vminstance(vminstance), llvmCPUs(llvmCPUs),
+    : total_translated_size(1), total_translation_size(1), needFlush(false),
+      chainEnabled(false), traceEnabled(false), chainStop(0),
+      indirectCacheHits(0), indirectCacheMisses(0), vminstance(vminstance),
+      llvmCPUs(llvmCPUs), blockCounters(nullptr), budgetCountdown(nullptr),
+      budgetCB(nullptr), budgetData(nullptr), coverage(nullptr),
+      maxExecBlocks(0),
       execBlockPrologue(
           getExecBlockPrologue(llvmCPUs.getCPU(CPUMode::DEFAULT))),
       execBlockEpilogue(
           getExecBlockEpilogue(llvmCPUs.getCPU(CPUMode::DEFAULT))) {
 
-  auto execBrokerBlock = std::make_unique<ExecBlock>(
-      llvmCPUs, vminstance, &execBlockPrologue, &execBlockEpilogue, 0);
+  if constexpr (is_x86_64 or is_x86) {
+    if (llvmCPUs.hasOptions(Options::OPT_ENABLE_SHARED_CONTEXT)) {
+      std::error_code ec;
+      sharedContextBlock = QBDI::allocateMappedMemory(
+          sizeof(Context), nullptr,
+          llvm::sys::Memory::MF_READ | llvm::sys::Memory::MF_WRITE, ec);
+      QBDI_REQUIRE_ABORT(sharedContextBlock.base() != nullptr,
+                         "allocation fail");
+    }
+  }
+
+  auto execBrokerBlock =
+      std::make_unique<ExecBlock>(llvmCPUs, vminstance, &execBlockPrologue,
+                                  &execBlockEpilogue, 0, getSharedContext());
   epilogueSize = execBrokerBlock->getEpilogueSize();
   execBroker = std::make_unique<ExecBroker>(std::move(execBrokerBlock),
                                             llvmCPUs, vminstance);
@@ -66,6 +110,11 @@ ExecBlockManager::ExecBlockManager(const LLVMCPUs &llvmCPUs,
 ExecBlockManager::~ExecBlockManager() {
   QBDI_DEBUG_BLOCK({ this->printCacheStatistics(); });
   clearCache();
+  // The ExecBlock of the ExecBroker is destroyed later, but doesn't access the
+  // shared context anymore.
+  if (sharedContextBlock.base() != nullptr) {
+    QBDI::releaseMappedMemory(sharedContextBlock);
+  }
 }
 
 void ExecBlockManager::changeVMInstanceRef(VMInstanceRef vminstance) {
@@ -76,6 +125,9 @@ void ExecBlockManager::changeVMInstanceRef(VMInstanceRef vminstance) {
       block->changeVMInstanceRef(vminstance);
     }
   }
+  for (auto &block : freeBlocks) {
+    block->changeVMInstanceRef(vminstance);
+  }
 }
 
 float ExecBlockManager::getExpansionRatio() const {
@@ -109,6 +161,7 @@ void ExecBlockManager::printCacheStatistics() const {QBDI_DEBUG_BLOCK({
   }
   QBDI_DEBUG("\tMean occupation ratio: {}", mean_occupation);
   QBDI_DEBUG("\tRegion overflow count: {}", region_overflow);
+  QBDI_DEBUG("\tRecycled ExecBlock: {}", freeBlocks.size());
 })}
 
 ExecBlock *ExecBlockManager::getProgrammedExecBlock(rword address,
@@ -116,12 +169,58 @@ ExecBlock *ExecBlockManager::getProgrammedExecBlock(rword address,
                                                     SeqLoc *programmedSeqLock) {
   QBDI_DEBUG("Looking up sequence at address {:x} mode {}", address, cpumode);
 
+  // Attempting index resolution. The index can only be used when no region
+  // waits to be flushed, as the sequences of these regions mustn't be linked.
+  if (not needFlush) {
+    const auto target = getExecRegionKey(address, cpumode);
+    if (chainEnabled and traceEnabled) {
+      const SeqIndexEntry *trace = traceIndex.find(target);
+      if (trace != nullptr and
+          trace->block->isTraceUsable(trace->seqLoc.seqID,
+                                      [this](rword target, bool backward) {
+                                        return this->canChainTo(target,
+                                                                backward);
+                                      })) {
+        return selectIndexedSeq(address, *trace, programmedSeqLock);
+      }
+    }
+    const SeqIndexEntry *seq = seqIndex.find(target);
+    if (seq != nullptr) {
+      return selectIndexedSeq(address, *seq, programmedSeqLock);
+    }
+  }
+
   size_t r = searchRegion(address);
 
   if (r < regions.size() && regions[r].covered.contains(address)) {
     ExecRegion &region = regions[r];
     const auto target = getExecRegionKey(address, cpumode);
 
+    // Attempting traceCache resolution
+    if (chainEnabled and traceEnabled and not region.toFlush) {
+      const auto traceLoc = region.traceCache.find(target);
+      if (traceLoc != region.traceCache.end()) {
+        ExecBlock *block = region.blocks[traceLoc->second.blockIdx].get();
+        if (block->isTraceUsable(traceLoc->second.seqID,
+                                 [this](rword target, bool backward) {
+                                   return this->canChainTo(target, backward);
+                                 })) {
+          QBDI_DEBUG(
+              "Found trace 0x{:x} ({}) in ExecBlock 0x{:x} as seqID {:x}",
+              address, cpumode, reinterpret_cast<uintptr_t>(block),
+              traceLoc->second.seqID);
+          if (programmedSeqLock != nullptr) {
+            *programmedSeqLock = traceLoc->second;
+          }
+          block->selectSeq(traceLoc->second.seqID);
+          if (canChainTo(address)) {
+            block->cacheIndirectTarget(traceLoc->second.seqID);
+          }
+          return block;
+        }
+      }
+    }
+
     // Attempting sequenceCache resolution
     const auto seqLoc = region.sequenceCache.find(target);
     if (seqLoc != region.sequenceCache.end()) {
@@ -135,8 +234,12 @@ ExecBlock *ExecBlockManager::getProgrammedExecBlock(rword address,
         *programmedSeqLock = seqLoc->second;
       }
       // Select sequence and return execBlock
-      region.blocks[seqLoc->second.blockIdx]->selectSeq(seqLoc->second.seqID);
-      return region.blocks[seqLoc->second.blockIdx].get();
+      ExecBlock *block = region.blocks[seqLoc->second.blockIdx].get();
+      block->selectSeq(seqLoc->second.seqID);
+      if (chainEnabled and not region.toFlush and canChainTo(address)) {
+        block->cacheIndirectTarget(seqLoc->second.seqID);
+      }
+      return block;
     }
 
     // Attempting instCache resolution
@@ -151,10 +254,17 @@ ExecBlock *ExecBlockManager::getProgrammedExecBlock(rword address,
       // Creating a new sequence at that instruction and
       // saving it in the sequenceCache
       uint16_t newSeqID = block->splitSequence(instLoc->second.instID);
+      if (chainEnabled and not region.toFlush) {
+        block->linkSeqChains(newSeqID, [this](rword target, bool backward) {
+          return this->canChainTo(target, backward);
+        });
+      }
       region.sequenceCache[target] = SeqLoc{
           instLoc->second.blockIdx, newSeqID, existingSeqLoc.bbEnd, address,
           existingSeqLoc.seqEnd,
       };
+      seqIndex.insert(target,
+                      SeqIndexEntry{block, region.sequenceCache[target]});
       QBDI_DEBUG(
           "Splitted seqID {:x} at instID {:x} in ExecBlock 0x{:x} as new "
           "sequence with seqID {:x}",
@@ -165,6 +275,9 @@ ExecBlock *ExecBlockManager::getProgrammedExecBlock(rword address,
         *programmedSeqLock = regions[r].sequenceCache[target];
       }
       block->selectSeq(newSeqID);
+      if (chainEnabled and not region.toFlush and canChainTo(address)) {
+        block->cacheIndirectTarget(newSeqID);
+      }
       return block;
     }
   }
@@ -172,6 +285,23 @@ ExecBlock *ExecBlockManager::getProgrammedExecBlock(rword address,
   return nullptr;
 }
 
+ExecBlock *ExecBlockManager::selectIndexedSeq(rword address,
+                                              const SeqIndexEntry &entry,
+                                              SeqLoc *programmedSeqLock) {
+  QBDI_DEBUG("Found sequence 0x{:x} in ExecBlock 0x{:x} as seqID {:x}",
+             address, reinterpret_cast<uintptr_t>(entry.block),
+             entry.seqLoc.seqID);
+  // copy current sequence info
+  if (programmedSeqLock != nullptr) {
+    *programmedSeqLock = entry.seqLoc;
+  }
+  entry.block->selectSeq(entry.seqLoc.seqID);
+  if (chainEnabled and canChainTo(address)) {
+    entry.block->cacheIndirectTarget(entry.seqLoc.seqID);
+  }
+  return entry.block;
+}
+
 const ExecBlock *ExecBlockManager::getExecBlock(rword address,
                                                 CPUMode cpumode) const {
   QBDI_DEBUG("Looking up address {:x} ({})", address, cpumode);
@@ -259,6 +389,9 @@ void ExecBlockManager::writeBasicBlock(std::vector<Patch> &&basicBlock,
     return;
   }
   QBDI_DEBUG("Writting new basic block 0x{:x}", firstPatch.metadata.address);
+  insertBlockCounter(basicBlock.front(), bbEnd);
+  insertCoverageEdge(basicBlock.front());
+  insertBudgetGate(basicBlock[patchEnd - 1], patchEnd);
 
   // Writing the basic block as one or more sequences
   while (patchIdx < patchEnd) {
@@ -270,27 +403,33 @@ void ExecBlockManager::writeBasicBlock(std::vector<Patch> &&basicBlock,
       if (i >= region.blocks.size()) {
         QBDI_REQUIRE_ABORT(i < (1 << 16),
                            "Too many ExecBlock in the same region");
-        region.blocks.emplace_back(std::make_unique<ExecBlock>(
-            llvmCPUs, vminstance, &execBlockPrologue, &execBlockEpilogue,
-            epilogueSize));
-        codeBlockMap[region.blocks.back()->getBaseCodeBlock()] =
-            region.blocks.back().get();
+        addExecBlock(region);
       }
       // Write sequence
       SeqWriteResult res = region.blocks[i]->writeSequence(
           basicBlock.begin() + patchIdx, basicBlock.begin() + patchEnd);
       // Successful write
       if (res.seqID != EXEC_BLOCK_FULL) {
+        if (chainEnabled and not region.toFlush) {
+          region.blocks[i]->linkSeqChains(
+              res.seqID, [this](rword target, bool backward) {
+                return this->canChainTo(target, backward);
+              });
+        }
         // Saving sequence in the sequence cache
-        regions[r].sequenceCache[getExecRegionKey(
-            basicBlock[patchIdx].metadata.address,
-            basicBlock[patchIdx].metadata.cpuMode)] = SeqLoc{
+        const rword seqKey =
+            getExecRegionKey(basicBlock[patchIdx].metadata.address,
+                             basicBlock[patchIdx].metadata.cpuMode);
+        const SeqLoc seqLoc{
             static_cast<uint16_t>(i),
             res.seqID,
             bbEnd,
             basicBlock[patchIdx].metadata.address,
             basicBlock[patchIdx + res.patchWritten - 1].metadata.endAddress(),
         };
+        regions[r].sequenceCache[seqKey] = seqLoc;
+        seqIndex.insert(seqKey,
+                        SeqIndexEntry{region.blocks[i].get(), seqLoc});
         // Generate instruction mapping cache
         uint16_t startID = region.blocks[i]->getSeqStart(res.seqID);
         for (size_t j = 0; j < res.patchWritten; j++) {
@@ -324,6 +463,118 @@ void ExecBlockManager::writeBasicBlock(std::vector<Patch> &&basicBlock,
   updateRegionStat(r, translated);
 }
 
+bool ExecBlockManager::countTraceHead(rword address, CPUMode cpumode) {
+  if (not chainEnabled or not traceEnabled) {
+    return false;
+  }
+  size_t r = searchRegion(address);
+  if (r >= regions.size() or not regions[r].covered.contains(address) or
+      regions[r].toFlush) {
+    return false;
+  }
+  uint32_t &counter =
+      regions[r].traceCounters[getExecRegionKey(address, cpumode)];
+  if (counter >= TRACE_HEAD_THRESHOLD) {
+    return false;
+  }
+  counter++;
+  return counter == TRACE_HEAD_THRESHOLD;
+}
+
+bool ExecBlockManager::isTraceHead(rword address, CPUMode cpumode) const {
+  size_t r = searchRegion(address);
+  if (r >= regions.size() or not regions[r].covered.contains(address)) {
+    return false;
+  }
+  const auto it =
+      regions[r].traceCounters.find(getExecRegionKey(address, cpumode));
+  return it != regions[r].traceCounters.end() and
+         it->second >= TRACE_HEAD_THRESHOLD;
+}
+
+size_t ExecBlockManager::preWriteTrace(const std::vector<Patch> &trace) const {
+  if (trace.empty()) {
+    return 0;
+  }
+  size_t r = searchRegion(trace.front().metadata.address);
+  if (r >= regions.size() or
+      not regions[r].covered.contains(trace.front().metadata.address) or
+      regions[r].toFlush) {
+    return 0;
+  }
+  size_t patchEnd = 0;
+  while (patchEnd < trace.size() and
+         regions[r].covered.contains(
+             Range<rword>{trace[patchEnd].metadata.address,
+                          trace[patchEnd].metadata.endAddress(),
+                          real_addr_t()})) {
+    patchEnd++;
+  }
+  return patchEnd;
+}
+
+void ExecBlockManager::writeTrace(std::vector<Patch> &&trace,
+                                  size_t patchEnd) {
+  QBDI_REQUIRE_ACTION(patchEnd > 0 and patchEnd <= trace.size(), return);
+  rword head = trace.front().metadata.address;
+  size_t r = searchRegion(head);
+  QBDI_REQUIRE_ACTION(r < regions.size() and regions[r].covered.contains(head),
+                      return);
+  ExecRegion &region = regions[r];
+
+  // Each basic block of the trace increments its own counter and edge, and
+  // decrements the budget
+  size_t blockStart = 0;
+  for (size_t j = 0; j < patchEnd; j++) {
+    if (trace[j].metadata.modifyPC or j + 1 == patchEnd) {
+      insertBlockCounter(trace[blockStart], trace[j].metadata.endAddress());
+      insertCoverageEdge(trace[blockStart]);
+      insertBudgetGate(trace[j], j + 1 - blockStart);
+      blockStart = j + 1;
+    }
+  }
+
+  // The trace is written in one ExecBlock. A new ExecBlock is only added if
+  // the trace doesn't fit in the existing ones.
+  size_t nbBlocks = region.blocks.size();
+  for (size_t i = 0; i <= nbBlocks; i++) {
+    if (i == nbBlocks) {
+      QBDI_REQUIRE_ACTION(i < (1 << 16), return);
+      addExecBlock(region);
+    }
+    SeqWriteResult res = region.blocks[i]->writeSequence(
+        trace.begin(), trace.begin() + patchEnd, true);
+    if (res.seqID == EXEC_BLOCK_FULL) {
+      continue;
+    }
+    rword traceEnd = trace[res.patchWritten - 1].metadata.endAddress();
+    const rword traceKey =
+        getExecRegionKey(head, trace.front().metadata.cpuMode);
+    const SeqLoc traceLoc{static_cast<uint16_t>(i), res.seqID, traceEnd, head,
+                          traceEnd};
+    region.traceCache[traceKey] = traceLoc;
+    traceIndex.insert(traceKey,
+                      SeqIndexEntry{region.blocks[i].get(), traceLoc});
+    for (size_t j = 0; j < res.patchWritten; j++) {
+      std::move(trace[j].userInstCB.begin(), trace[j].userInstCB.end(),
+                std::back_inserter(region.userInstCB));
+      trace[j].userInstCB.clear();
+    }
+    QBDI_DEBUG("Trace 0x{:x}-0x{:x} of {} instructions written in ExecBlock "
+               "0x{:x} as seqID {:x}",
+               head, traceEnd, res.patchWritten,
+               reinterpret_cast<uintptr_t>(region.blocks[i].get()), res.seqID);
+    if (chainEnabled and not region.toFlush) {
+      region.blocks[i]->linkAllChains([this](rword target, bool backward) {
+        return this->canChainTo(target, backward);
+      });
+    }
+    updateRegionStat(r, 0);
+    return;
+  }
+  QBDI_DEBUG("Fail to write the trace 0x{:x}", head);
+}
+
 size_t ExecBlockManager::searchRegion(rword address) const {
   size_t low = 0;
   size_t high = regions.size();
@@ -364,6 +615,10 @@ void ExecBlockManager::mergeRegion(size_t i) {
     regions[i].sequenceCache[it.first] = SeqLoc{
         static_cast<uint16_t>(it.second.blockIdx + regions[i].blocks.size()),
         it.second.seqID, it.second.bbEnd, it.second.seqStart, it.second.seqEnd};
+    SeqIndexEntry *entry = seqIndex.find(it.first);
+    if (entry != nullptr) {
+      entry->seqLoc = regions[i].sequenceCache[it.first];
+    }
   }
   // InstLoc
   for (const auto &it : regions[i + 1].instCache) {
@@ -372,6 +627,18 @@ void ExecBlockManager::mergeRegion(size_t i) {
         it.second.instID,
     };
   }
+  // Trace
+  for (const auto &it : regions[i + 1].traceCache) {
+    regions[i].traceCache[it.first] = SeqLoc{
+        static_cast<uint16_t>(it.second.blockIdx + regions[i].blocks.size()),
+        it.second.seqID, it.second.bbEnd, it.second.seqStart, it.second.seqEnd};
+    SeqIndexEntry *entry = traceIndex.find(it.first);
+    if (entry != nullptr) {
+      entry->seqLoc = regions[i].traceCache[it.first];
+    }
+  }
+  regions[i].traceCounters.insert(regions[i + 1].traceCounters.begin(),
+                                  regions[i + 1].traceCounters.end());
 
   // range
   regions[i].covered.setEnd(regions[i + 1].covered.end());
@@ -522,6 +789,230 @@ void ExecBlockManager::updateRegionStat(size_t r, rword translated) {
   }
 }
 
+bool ExecBlockManager::canChainTo(rword address, bool backward) const {
+  if (address == chainStop or not execBroker->isInstrumented(address)) {
+    return false;
+  }
+  // With the trace formation, a loop returns to the host until its head is
+  // hot, so the host can count its iterations and record its trace.
+  return not backward or not traceEnabled or
+         isTraceHead(address, CPUMode::DEFAULT);
+}
+
+void ExecBlockManager::linkRegionChains(ExecRegion &region) {
+  if (region.toFlush) {
+    return;
+  }
+  for (auto &block : region.blocks) {
+    block->linkAllChains([this](rword target, bool backward) {
+      return this->canChainTo(target, backward);
+    });
+  }
+}
+
+void ExecBlockManager::unlinkRegionChains(ExecRegion &region) {
+  for (auto &block : region.blocks) {
+    block->unlinkAllChains();
+  }
+}
+
+void ExecBlockManager::saveIndirectCacheStats(const ExecBlock &block) {
+  rword hits, misses;
+  block.getIndirectCacheStats(hits, misses);
+  indirectCacheHits += hits;
+  indirectCacheMisses += misses;
+}
+
+void ExecBlockManager::addExecBlock(ExecRegion &region) {
+  if (freeBlocks.empty()) {
+    region.blocks.emplace_back(std::make_unique<ExecBlock>(
+        llvmCPUs, vminstance, &execBlockPrologue, &execBlockEpilogue,
+        epilogueSize, getSharedContext(), blockSize));
+  } else {
+    region.blocks.emplace_back(std::move(freeBlocks.back()));
+    freeBlocks.pop_back();
+  }
+  codeBlockMap[region.blocks.back()->getBaseCodeBlock()] =
+      region.blocks.back().get();
+  maxExecBlocks = std::max(maxExecBlocks, codeBlockMap.size());
+}
+
+void ExecBlockManager::releaseExecBlocks(ExecRegion &region) {
+  for (auto &block : region.blocks) {
+    codeBlockMap.erase(block->getBaseCodeBlock());
+    saveIndirectCacheStats(*block);
+    if (freeBlocks.size() < maxExecBlocks) {
+      block->recycle();
+      freeBlocks.emplace_back(std::move(block));
+    }
+  }
+  region.blocks.clear();
+}
+
+void ExecBlockManager::getIndirectCacheStats(uint64_t &hits,
+                                             uint64_t &misses) const {
+  hits = indirectCacheHits;
+  misses = indirectCacheMisses;
+  for (const auto &r : regions) {
+    for (const auto &block : r.blocks) {
+      rword blockHits, blockMisses;
+      block->getIndirectCacheStats(blockHits, blockMisses);
+      hits += blockHits;
+      misses += blockMisses;
+    }
+  }
+}
+
+void ExecBlockManager::insertBlockCounter(Patch &patch, rword end) {
+  // The block profile is only supported on X86_64
+  if constexpr (not is_x86_64) {
+    return;
+  }
+  if (blockCounters == nullptr or
+      not llvmCPUs.hasOptions(Options::OPT_ENABLE_BLOCK_PROFILE)) {
+    return;
+  }
+  const rword key =
+      getExecRegionKey(patch.metadata.address, patch.metadata.cpuMode);
+  auto it = blockCounters->counters.find(key);
+  if (it == blockCounters->counters.end()) {
+    if (blockCounters->arena.empty() or
+        blockCounters->arenaUsed == COUNTER_ARENA_CHUNK) {
+      blockCounters->arena.push_back(
+          std::make_unique<uint64_t[]>(COUNTER_ARENA_CHUNK));
+      blockCounters->arenaUsed = 0;
+    }
+    uint64_t *counter =
+        &blockCounters->arena.back()[blockCounters->arenaUsed++];
+    it = blockCounters->counters
+             .emplace(key, BlockCounter{patch.metadata.address,
+                                        end - patch.metadata.address, counter})
+             .first;
+  }
+  QBDI_DEBUG("Insert the counter of the basic block 0x{:x}",
+             patch.metadata.address);
+  patch.insertAtBegin(
+      getBlockCounter(llvmCPUs.getCPU(patch.metadata.cpuMode),
+                      reinterpret_cast<rword>(it->second.counter)));
+}
+
+void ExecBlockManager::insertBudgetGate(Patch &patch, rword count) {
+  if (budgetCountdown == nullptr) {
+    return;
+  }
+  PatchGenerator::UniquePtrVec gate =
+      getCountdownGate(patch, InstPosition::PREINST, budgetCountdown, count,
+                       budgetCB, budgetData);
+  if (gate.empty()) {
+    return;
+  }
+  QBDI_DEBUG("Insert the budget gate of {} instructions at 0x{:x}", count,
+             patch.metadata.address);
+  insertGeneratorsAtBegin(patch, gate);
+}
+
+void ExecBlockManager::insertCoverageEdge(Patch &patch) {
+  if (coverage == nullptr) {
+    return;
+  }
+  PatchGenerator::UniquePtrVec edge = getCoverageEdge(patch, coverage);
+  if (edge.empty()) {
+    return;
+  }
+  QBDI_DEBUG("Insert the coverage edge of the basic block 0x{:x}",
+             patch.metadata.address);
+  insertGeneratorsAtBegin(patch, edge);
+}
+
+void ExecBlockManager::setBudgetGate(rword *countdown, InstCallback cbk,
+                                     void *data) {
+  budgetCountdown = countdown;
+  budgetCB = cbk;
+  budgetData = data;
+}
+
+void ExecBlockManager::setCoverageBitmap(CoverageBitmap *coverage) {
+  this->coverage = coverage;
+  if (coverage == nullptr) {
+    return;
+  }
+  coverage->prev = &coverage->hostPrev;
+#if defined(QBDI_ARCH_X86_64) || defined(QBDI_ARCH_X86)
+  if (getSharedContext() != nullptr) {
+    coverage->prev = &getSharedContext()->hostState.coveragePrev;
+  }
+#endif
+  *coverage->prev = 0;
+}
+
+std::vector<BlockProfile> ExecBlockManager::getBlockProfile() const {
+  std::vector<BlockProfile> profile;
+  if (blockCounters == nullptr) {
+    return profile;
+  }
+  profile.reserve(blockCounters->counters.size());
+  for (const auto &it : blockCounters->counters) {
+    profile.push_back(
+        BlockProfile{it.second.address, it.second.size, *it.second.counter});
+  }
+  return profile;
+}
+
+std::vector<rword> ExecBlockManager::getSequenceAddresses() const {
+  std::vector<rword> addresses;
+  for (const auto &r : regions) {
+    if (r.toFlush) {
+      continue;
+    }
+    for (const auto &it : r.sequenceCache) {
+      addresses.push_back(it.first);
+    }
+  }
+  return addresses;
+}
+
+void ExecBlockManager::setChaining(bool enable) {
+  if (enable == chainEnabled) {
+    return;
+  }
+  QBDI_DEBUG("{} block chaining", enable ? "Enable" : "Disable");
+  chainEnabled = enable;
+  for (auto &r : regions) {
+    if (enable) {
+      linkRegionChains(r);
+    } else {
+      unlinkRegionChains(r);
+    }
+  }
+}
+
+void ExecBlockManager::setTraceFormation(bool enable) {
+  if (enable == traceEnabled) {
+    return;
+  }
+  QBDI_DEBUG("{} trace formation", enable ? "Enable" : "Disable");
+  traceEnabled = enable;
+  resetChains();
+}
+
+void ExecBlockManager::setChainStop(rword stop) {
+  if (stop == chainStop) {
+    return;
+  }
+  chainStop = stop;
+  resetChains();
+}
+
+void ExecBlockManager::resetChains() {
+  if (not chainEnabled) {
+    return;
+  }
+  for (auto &r : regions) {
+    unlinkRegionChains(r);
+    linkRegionChains(r);
+  }
+}
+
 void ExecBlockManager::clearCache(RangeSet<rword> rangeSet) {
   const std::vector<Range<rword>> &ranges = rangeSet.getRanges();
   for (Range<rword> r : ranges) {
@@ -536,16 +1027,20 @@ void ExecBlockManager::flushCommit() {
   // It needs to be erased from last to first to preserve index validity
   if (needFlush) {
     QBDI_DEBUG("Flushing analysis caches");
-    auto delFunc = [&](const ExecRegion &r) -> bool {
+    for (auto &r : regions) {
       if (r.toFlush) {
         QBDI_DEBUG("Erasing region [0x{:x}, 0x{:x}]", r.covered.start(),
                    r.covered.end());
-        for (const auto &block : r.blocks) {
-          codeBlockMap.erase(block->getBaseCodeBlock());
+        for (const auto &it : r.sequenceCache) {
+          seqIndex.erase(it.first);
         }
+        for (const auto &it : r.traceCache) {
+          traceIndex.erase(it.first);
+        }
+        releaseExecBlocks(r);
       }
-      return r.toFlush;
-    };
+    }
+    auto delFunc = [](const ExecRegion &r) -> bool { return r.toFlush; };
 
     regions.erase(std::remove_if(regions.begin(), regions.end(), delFunc),
                   regions.end());
@@ -560,6 +1055,7 @@ void ExecBlockManager::clearCache(Range<rword> range) {
     if (regions[i].covered.overlaps(range)) {
       regions[i].toFlush = true;
       needFlush = true;
+      unlinkRegionChains(regions[i]);
     }
   }
 }
@@ -567,7 +1063,12 @@ void ExecBlockManager::clearCache(Range<rword> range) {
 void ExecBlockManager::clearCache(bool flushNow) {
   QBDI_DEBUG("Erasing all cache");
   if (flushNow) {
+    for (auto &r : regions) {
+      releaseExecBlocks(r);
+    }
     regions.clear();
+    seqIndex.clear();
+    traceIndex.clear();
     total_translated_size = 1;
     total_translation_size = 1;
     needFlush = false;
@@ -575,11 +1076,18 @@ void ExecBlockManager::clearCache(bool flushNow) {
     for (auto &r : regions) {
       r.toFlush = true;
       needFlush = true;
+      unlinkRegionChains(r);
     }
   }
 }
 
 void ExecBlockManager::reduceCacheTo(uint32_t nb) {
+  // The cache won't grow over nb again before a new allocation, the free
+  // list doesn't need to keep more ExecBlocks
+  maxExecBlocks = std::min(maxExecBlocks, static_cast<size_t>(nb));
+  if (freeBlocks.size() > maxExecBlocks) {
+    freeBlocks.resize(maxExecBlocks);
+  }
   uint32_t nbBlock = getNbExecBlock();
   if (nb >= nbBlock) {
     return;
@@ -589,6 +1097,7 @@ void ExecBlockManager::reduceCacheTo(uint32_t nb) {
 
   for (auto &r : regionsReduceList) {
     r.toFlush = true;
+    unlinkRegionChains(r);
 
     if (target <= r.blocks.size()) {
       return;
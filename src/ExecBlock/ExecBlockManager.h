@@ -25,15 +25,20 @@
 #include <stdint.h>
 #include <vector>
 
+#include "llvm/Support/Memory.h"
+
 #include "QBDI/Callback.h"
 #include "QBDI/Range.h"
 #include "QBDI/State.h"
 
+#include "ExecBlock/ExecBlock.h"
+#include "Utility/AddressHashMap.h"
 #include "Utility/MovableDoubleLinkedList.h"
 
 namespace QBDI {
 
-class ExecBlock;
+struct Context;
+struct CoverageBitmap;
 class ExecBroker;
 class LLVMCPUs;
 class Patch;
@@ -52,6 +57,28 @@ struct SeqLoc {
   rword seqEnd;
 };
 
+struct SeqIndexEntry {
+  ExecBlock *block;
+  SeqLoc seqLoc;
+};
+
+struct BlockCounter {
+  rword address;
+  rword size;
+  uint64_t *counter;
+};
+
+// Counters of the basic blocks with OPT_ENABLE_BLOCK_PROFILE. The key must be
+// generate with getExecRegionKey. The counters are allocated in an arena that
+// isn't released with the cache: a basic block written again keeps its
+// counter. They are owned by the Engine and kept when the ExecBlockManager is
+// created again.
+struct BlockCounters {
+  std::map<rword, BlockCounter> counters;
+  std::vector<std::unique_ptr<uint64_t[]>> arena;
+  size_t arenaUsed = 0;
+};
+
 class ExecRegion : public MovableDoubleLinkedListElement<ExecRegion> {
 public:
   Range<rword> covered;
@@ -62,6 +89,10 @@ public:
   // The key must be generate with getExecRegionKey
   std::map<rword, SeqLoc> sequenceCache;
   std::map<rword, InstLoc> instCache;
+  // Note for traceCache and traceCounters
+  // The key must be generate with getExecRegionKey
+  std::map<rword, SeqLoc> traceCache;
+  std::map<rword, uint32_t> traceCounters;
   bool toFlush = false;
 
   // lambda ptr for user callback set with addInstrRule
@@ -80,14 +111,51 @@ private:
   std::unique_ptr<ExecBroker> execBroker;
   std::vector<ExecRegion> regions;
   std::map<rword, ExecBlock *> codeBlockMap;
+  // Global index of the sequences and the traces of all the regions. The key
+  // must be generate with getExecRegionKey. The entries of the regions to
+  // flush are kept until flushCommit.
+  AddressHashMap<SeqIndexEntry> seqIndex;
+  AddressHashMap<SeqIndexEntry> traceIndex;
   MovableDoubleLinkedList<ExecRegion> regionsReduceList;
   rword total_translated_size;
   rword total_translation_size;
   bool needFlush;
+  bool chainEnabled;
+  bool traceEnabled;
+  rword chainStop;
+  uint64_t indirectCacheHits;
+  uint64_t indirectCacheMisses;
 
   VMInstanceRef vminstance;
   const LLVMCPUs &llvmCPUs;
 
+  // Guest state shared by the ExecBlocks with OPT_ENABLE_SHARED_CONTEXT
+  llvm::sys::MemoryBlock sharedContextBlock;
+
+  // Counters of the basic blocks with OPT_ENABLE_BLOCK_PROFILE
+  BlockCounters *blockCounters;
+
+  // Countdown of the instruction budget, decremented by the JIT code at the
+  // end of each basic block. The callback is called when it expires.
+  rword *budgetCountdown;
+  InstCallback budgetCB;
+  void *budgetData;
+
+  // Edge coverage incremented by the JIT code at the beginning of each basic
+  // block
+  CoverageBitmap *coverage;
+
+  // Size of the ExecBlocks of the regions
+  ExecBlockSize blockSize;
+
+  // ExecBlocks of the flushed regions, reused by the next regions instead of
+  // allocating new ones. Their prologue and epilogue are already written.
+  std::vector<std::unique_ptr<ExecBlock>> freeBlocks;
+
+  // Largest number of ExecBlocks used by the regions, bound of freeBlocks. It
+  // is lowered by reduceCacheTo.
+  size_t maxExecBlocks;
+
   // cache ExecBlock prologue and epilogue
   uint32_t epilogueSize;
   const std::vector<std::unique_ptr<RelocatableInst>> execBlockPrologue;
@@ -95,6 +163,10 @@ private:
 
   size_t searchRegion(rword start) const;
 
+  Context *getSharedContext() const {
+    return static_cast<Context *>(sharedContextBlock.base());
+  }
+
   void mergeRegion(size_t i);
 
   size_t findRegion(const Range<rword> &codeRange);
@@ -103,6 +175,56 @@ private:
 
   float getExpansionRatio() const;
 
+  ExecBlock *selectIndexedSeq(rword address, const SeqIndexEntry &entry,
+                              SeqLoc *programmedSeqLock);
+
+  bool canChainTo(rword address, bool backward = false) const;
+
+  void linkRegionChains(ExecRegion &region);
+
+  void unlinkRegionChains(ExecRegion &region);
+
+  void saveIndirectCacheStats(const ExecBlock &block);
+
+  /*! Add an ExecBlock at the end of a region, either a recycled one or a new
+   * one.
+   *
+   * @param[in] region  The region.
+   */
+  void addExecBlock(ExecRegion &region);
+
+  /*! Remove the ExecBlocks of a region from the cache. The ExecBlocks are
+   * recycled while the free list isn't full, and destroyed otherwise.
+   *
+   * @param[in] region  The region.
+   */
+  void releaseExecBlocks(ExecRegion &region);
+
+  /*! Insert the increment of the counter of a basic block at the beginning of
+   * its first patch, when the block profile is enabled.
+   *
+   * @param[in] patch  The first patch of the basic block.
+   * @param[in] end    The end address of the basic block.
+   */
+  void insertBlockCounter(Patch &patch, rword end);
+
+  /*! Insert the decrement of the instruction budget at the beginning of the
+   * last patch of a basic block, when the budget is enabled. The budget is
+   * decremented before the last instruction, so an entry in the middle of the
+   * basic block is counted as a whole basic block.
+   *
+   * @param[in] patch  The last patch of the basic block.
+   * @param[in] count  The number of instructions of the basic block.
+   */
+  void insertBudgetGate(Patch &patch, rword count);
+
+  /*! Insert the increment of the edge of a basic block at the beginning of
+   * its first patch, when the edge coverage is enabled.
+   *
+   * @param[in] patch  The first patch of the basic block.
+   */
+  void insertCoverageEdge(Patch &patch);
+
 public:
   ExecBlockManager(const LLVMCPUs &llvmCPUs, VMInstanceRef vminstance);
 
@@ -125,6 +247,46 @@ public:
 
   void writeBasicBlock(std::vector<Patch> &&basicBlock, size_t patchEnd);
 
+  /*! Count an entry of the host in the sequence at an address, when the trace
+   * formation is enabled.
+   *
+   * @param[in] address  The address of the sequence.
+   * @param[in] cpumode  The mode of the sequence.
+   *
+   * @return True if the address just became the head of a hot trace. The path
+   *         executed from this address should be given to writeTrace.
+   */
+  bool countTraceHead(rword address, CPUMode cpumode);
+
+  /*! Verify if an address is the head of a hot trace, either already written
+   * or being recorded.
+   *
+   * @param[in] address  The address.
+   * @param[in] cpumode  The mode of the address.
+   *
+   * @return True if the address is the head of a hot trace.
+   */
+  bool isTraceHead(rword address, CPUMode cpumode) const;
+
+  /*! Get the number of patches of a trace that can be written. A trace is
+   * written in the region of its head and is truncated at the first patch
+   * outside of this region.
+   *
+   * @param[in] trace  The patches of the trace.
+   *
+   * @return The number of patches to instrument and write.
+   */
+  size_t preWriteTrace(const std::vector<Patch> &trace) const;
+
+  /*! Write a trace in the ExecBlock of the region of its head. The trace is
+   * used instead of the sequence of the head while the block chaining is
+   * enabled. Its instructions aren't added in the instruction cache.
+   *
+   * @param[in] trace     The patches of the trace.
+   * @param[in] patchEnd  The number of patches to write.
+   */
+  void writeTrace(std::vector<Patch> &&trace, size_t patchEnd);
+
   bool isFlushPending() { return needFlush; }
 
   void flushCommit();
@@ -137,15 +299,116 @@ public:
 
   uint32_t getNbExecBlock() const { return codeBlockMap.size(); }
 
+  /*! Enable or disable the links between the cached sequences. When the
+   * chaining is disabled, every sequence returns to the host at its end.
+   *
+   * @param[in] enable  True to link the sequences.
+   */
+  void setChaining(bool enable);
+
+  /*! Enable or disable the trace formation. When enabled, a loop returns to
+   * the host until its head is hot, and the hot traces are used instead of
+   * the sequences of their head.
+   *
+   * @param[in] enable  True to enable the trace formation.
+   */
+  void setTraceFormation(bool enable);
+
+  /*! Set the address where the execution must return to the host. A sequence
+   * is never linked to this address.
+   *
+   * @param[in] stop  The stop address of the current run.
+   */
+  void setChainStop(rword stop);
+
+  /*! Recompute all the links between the cached sequences. Must be called when
+   * the instrumented range changes.
+   */
+  void resetChains();
+
+  /*! Get the counters of the indirect branch target caches of all the
+   * ExecBlocks, including the ones already removed from the cache.
+   *
+   * @param[out] hits    The number of lookups that found their target.
+   * @param[out] misses  The number of lookups that returned to the host.
+   */
+  void getIndirectCacheStats(uint64_t &hits, uint64_t &misses) const;
+
+  /*! Get the execution counters of the basic blocks written with the option
+   * OPT_ENABLE_BLOCK_PROFILE, including the ones removed from the cache.
+   *
+   * @return The counter of each basic block.
+   */
+  std::vector<BlockProfile> getBlockProfile() const;
+
+  /*! Get the addresses of the sequences in the cache, excluding the traces
+   * and the regions to flush. On ARM, the address of a Thumb sequence has its
+   * lowest bit set.
+   *
+   * @return The address of each sequence.
+   */
+  std::vector<rword> getSequenceAddresses() const;
+
+  /*! Set the countdown of the instruction budget, decremented by the basic
+   * blocks written after this call. The cache must be cleared when the
+   * countdown changes.
+   *
+   * @param[in] countdown  The countdown, or nullptr to disable the budget.
+   * @param[in] cbk        The callback called when the countdown expires.
+   * @param[in] data       The data pointer to give to the callback.
+   */
+  void setBudgetGate(rword *countdown, InstCallback cbk, void *data);
+
+  bool hasBudgetGate() const { return budgetCountdown != nullptr; }
+
+  /*! Set the edge coverage incremented by the basic blocks written after this
+   * call. The cache must be cleared when the edge coverage changes. With
+   * OPT_ENABLE_SHARED_CONTEXT, the previous location is kept in the shared
+   * context.
+   *
+   * @param[in] coverage  The edge coverage, or nullptr to disable it.
+   */
+  void setCoverageBitmap(CoverageBitmap *coverage);
+
+  /*! Set the counters of the block profile. The basic blocks are only counted
+   * when the counters are set.
+   *
+   * @param[in] counters  The counters, or nullptr to disable the profile.
+   */
+  void setBlockCounters(BlockCounters *counters) { blockCounters = counters; }
+
+  /*! Set the size of the ExecBlocks created after this call. The cache must be
+   * cleared when the size changes, and the recycled ExecBlocks are released.
+   * The ExecBlock of the ExecBroker keeps the default size.
+   *
+   * @param[in] size  The size of the code and the data blocks.
+   */
+  void setExecBlockSize(const ExecBlockSize &size) {
+    blockSize = size;
+    freeBlocks.clear();
+  }
+
+  const ExecBlockSize &getExecBlockSize() const { return blockSize; }
+
   void reduceCacheTo(uint32_t nb);
 
+  /*! Get the ExecBlock whose codeBlock holds a JIT address.
+   *
+   * @param[in] address  The JIT address.
+   *
+   * @return The ExecBlock, or nullptr.
+   */
   const ExecBlock *getExecBlockFromJitAddress(rword address) const {
-    auto it = codeBlockMap.find(address);
-    if (it == codeBlockMap.end()) {
+    // the codeBlocks may be larger than a page
+    auto it = codeBlockMap.upper_bound(address);
+    if (it == codeBlockMap.begin()) {
+      return nullptr;
+    }
+    --it;
+    if (address - it->first >= it->second->getCodeBlockSize()) {
       return nullptr;
-    } else {
-      return it->second;
     }
+    return it->second;
   }
 };
 
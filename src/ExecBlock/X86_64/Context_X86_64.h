@@ -33,6 +33,56 @@ struct QBDI_ALIGNED(8) HostState {
   rword data;
   rword origin;
   rword executeFlags;
+  rword fastCallStub;
+  rword coveragePrev;
+};
+
+/*! Number of entries of the indirect branch target cache. It can be changed
+ * at compile time with the CMake option QBDI_INDIRECT_CACHE_SIZE, and must be
+ * a power of two: the index is the hash masked with INDIRECT_CACHE_SIZE - 1.
+ */
+#ifdef QBDI_INDIRECT_CACHE_SIZE
+static constexpr unsigned INDIRECT_CACHE_SIZE = QBDI_INDIRECT_CACHE_SIZE;
+#else
+static constexpr unsigned INDIRECT_CACHE_SIZE = 256 / (2 * sizeof(rword));
+#endif
+static_assert(INDIRECT_CACHE_SIZE >= 2 and
+                  (INDIRECT_CACHE_SIZE & (INDIRECT_CACHE_SIZE - 1)) == 0,
+              "INDIRECT_CACHE_SIZE must be a power of two");
+
+/*! X86_64 indirect branch target cache, probed by the dispatcher of the
+ * ExecBlock at the end of the sequences without a chain slot.
+ */
+struct QBDI_ALIGNED(8) IndirectCache {
+  rword dispatcher;
+  rword base;
+  rword eflags;
+  rword target;
+  rword hits;
+  rword misses;
+  struct {
+    rword address;
+    rword selector;
+  } entries[INDIRECT_CACHE_SIZE];
+};
+
+/*! Number of entries of the return stack. The stack uses 256 bytes, and the
+ * offset of the top entry is kept in the lower byte of ReturnStack::top.
+ */
+static constexpr unsigned RETURN_STACK_SIZE = 256 / (2 * sizeof(rword));
+
+/*! X86_64 return stack. The calls push the return address with the address of
+ * its chain slot, the returns pop the top entry and the dispatcher of the
+ * ExecBlock uses it before the indirect branch cache.
+ */
+struct QBDI_ALIGNED(8) ReturnStack {
+  rword top;
+  rword entry;
+  rword epilogue;
+  struct {
+    rword address;
+    rword slot;
+  } entries[RETURN_STACK_SIZE];
 };
 
 /*! X86_64 Execution context.
@@ -44,6 +94,8 @@ public:
   FPRState fprState;
   GPRState gprState;
   HostState hostState;
+  IndirectCache indirectCache;
+  ReturnStack returnStack;
 };
 
 } // namespace QBDI
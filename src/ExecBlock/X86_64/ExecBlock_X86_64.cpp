@@ -16,6 +16,7 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <algorithm>
 #include <errno.h>
 #include <memory>
 #include <stdint.h>
@@ -29,6 +30,9 @@
 #include "Engine/LLVMCPU.h"
 #include "ExecBlock/ExecBlock.h"
 #include "ExecBlock/X86_64/Context_X86_64.h"
+#include "ExecBlock/X86_64/XSave_X86_64.h"
+#include "Patch/ExecBlockFlags.h"
+#include "Patch/ExecBlockPatch.h"
 #include "Patch/Patch.h"
 #include "Patch/RelocatableInst.h"
 #include "Utility/LogSys.h"
@@ -42,6 +46,8 @@ extern void qbdi_runCodeBlock(void *codeBlock,
 #endif
 
 static const uint32_t MINIMAL_BLOCK_SIZE = 64;
+// shadows reserved for the end of the sequence (chain slot)
+static const uint32_t MINIMAL_SHADOW_AVAILABLE = 16;
 
 namespace QBDI {
 
@@ -52,6 +58,12 @@ void ExecBlock::selectSeq(uint16_t seqID) {
   context->hostState.selector =
       reinterpret_cast<rword>(codeBlock.base()) +
       static_cast<rword>(instRegistry[currentInst].offset);
+  // The entries of the indirect cache must not need more context switch than
+  // the programmed sequence
+  if ((context->hostState.executeFlags &
+       ~static_cast<rword>(seqRegistry[currentSeq].executeFlags)) != 0) {
+    clearIndirectCache();
+  }
   context->hostState.executeFlags = seqRegistry[currentSeq].executeFlags;
 }
 
@@ -71,6 +83,13 @@ void ExecBlock::run() {
       makeRX();
     }
   }
+  // The XMM registers switched one by one are loaded from the FPRState, the
+  // components left in their initial state by XSAVEOPT must be written first.
+  if ((context->hostState.executeFlags &
+       (ExecBlockFlags::needFullFPU | ExecBlockFlags::needFPU)) ==
+      ExecBlockFlags::needFPU) {
+    completeFPRState(getFPRState());
+  }
   if (not llvmCPUs.hasOptions(Options::OPT_DISABLE_ERRNO_BACKUP)) {
     errno = vminstance->getErrno();
     qbdi_runCodeBlock(codeBlock.base(), context->hostState.executeFlags);
@@ -87,7 +106,9 @@ bool ExecBlock::writePatch(std::vector<Patch>::const_iterator seqCurrent,
 
   QBDI_REQUIRE(p.finalize);
 
-  if (getEpilogueOffset() <= MINIMAL_BLOCK_SIZE) {
+  if (getEpilogueOffset() <= MINIMAL_BLOCK_SIZE or
+      shadowIdx + MINIMAL_SHADOW_AVAILABLE >=
+          (dataBlock.allocatedSize() - sizeof(Context)) / sizeof(rword)) {
     isFull = true;
     return false;
   }
@@ -106,4 +127,144 @@ void ExecBlock::initScratchRegisterForPatch(
 
 void ExecBlock::finalizeScratchRegisterForPatch() {}
 
+void ExecBlock::initIndirectCache(const LLVMCPU &llvmcpu) {
+  // The indirect branch cache is used with the block chaining
+  if (not llvmcpu.hasOptions(Options::OPT_ENABLE_BLOCK_CHAINING)) {
+    return;
+  }
+  context->indirectCache.dispatcher = getCurrentPC();
+  context->indirectCache.base =
+      reinterpret_cast<rword>(&context->indirectCache.entries[0]);
+  QBDI_REQUIRE_ABORT(
+      applyRelocatedInst(getIndirectCacheDispatcher(llvmcpu), nullptr, llvmcpu),
+      "Fail to write the indirect cache dispatcher");
+  clearIndirectCache();
+}
+
+bool ExecBlock::initFastCallStub(std::vector<Patch>::const_iterator seqStart,
+                                 std::vector<Patch>::const_iterator seqEnd,
+                                 const LLVMCPU &llvmcpu) {
+  // X86 use a break to host for the fast callbacks
+  if constexpr (is_x86) {
+    return true;
+  }
+  if (context->hostState.fastCallStub != 0 or
+      std::none_of(seqStart, seqEnd,
+                   [](const Patch &p) { return p.fastCall; })) {
+    return true;
+  }
+  unsigned rollbackOffset = codeBlockPosition;
+  rword stub = getCurrentPC();
+  if (not applyRelocatedInst(
+          getFastCallStub(llvmcpu,
+                          reinterpret_cast<rword>(&ExecBlock::fastCallback),
+                          reinterpret_cast<rword>(this)),
+          nullptr, llvmcpu, MINIMAL_BLOCK_SIZE)) {
+    codeBlockPosition = rollbackOffset;
+    return false;
+  }
+  QBDI_DEBUG("Fast callbacks stub of ExecBlock 0x{:x} at 0x{:x}",
+             reinterpret_cast<uintptr_t>(this), stub);
+  context->hostState.fastCallStub = stub;
+  return true;
+}
+
+void ExecBlock::fastCallback(ExecBlock *execBlock) {
+  // The errno of the guest is in the thread during the execution
+  int guestErrno = errno;
+  Context *context = execBlock->context;
+  uint16_t instID = static_cast<uint16_t>(context->hostState.origin);
+  InstCallback cbk =
+      reinterpret_cast<InstCallback>(context->hostState.callback);
+  void *data = reinterpret_cast<void *>(context->hostState.data);
+
+  QBDI_DEBUG("Fast callback request by ExecBlock 0x{:x} for callback 0x{:x}",
+             reinterpret_cast<uintptr_t>(execBlock),
+             context->hostState.callback);
+  QBDI_REQUIRE(instID < execBlock->instMetadata.size());
+
+  // The callback is handled here, the epilogue must not request it again
+  context->hostState.callback = static_cast<rword>(0);
+  context->hostState.data = static_cast<rword>(0);
+
+  execBlock->currentInst = instID;
+  const SeqInfo &seq = execBlock->seqRegistry[execBlock->currentSeq];
+  if (instID < seq.startInstID or instID > seq.endInstID) {
+    execBlock->currentSeq = execBlock->instRegistry[instID].seqID;
+  }
+  completeFPRState(execBlock->getFPRState());
+  // A once callback is skipped from now on
+  execBlock->skipOnceSlot(instID, context->hostState.selector);
+
+  GPRState *gprState = execBlock->getGPRState();
+  rword currentPC = QBDI_GPR_GET(gprState, REG_PC);
+  VMAction r =
+      cbk(execBlock->vminstance, gprState, execBlock->getFPRState(), data);
+  if (r != CONTINUE) {
+    QBDI_WARN("Fast callback returned {}: Use CONTINUE instead",
+              static_cast<int>(r));
+  }
+  if (QBDI_GPR_GET(gprState, REG_PC) != currentPC) {
+    QBDI_WARN("Fast callback changed PC: Ignore new value");
+    execBlock->resetChainExit(instID);
+  }
+  errno = guestErrno;
+}
+
+void ExecBlock::cacheIndirectTarget(uint16_t seqID) {
+  QBDI_REQUIRE(seqID < seqRegistry.size());
+  if (context->indirectCache.dispatcher == 0) {
+    return;
+  }
+  const SeqInfo &seq = seqRegistry[seqID];
+  if ((seq.executeFlags & ~context->hostState.executeFlags) != 0) {
+    return;
+  }
+  rword address = instMetadata[seq.startInstID].address;
+  // same hash as the dispatcher
+  size_t index = (address ^ (address >> 4)) % INDIRECT_CACHE_SIZE;
+
+  QBDI_DEBUG("Add 0x{:x} in the indirect cache of ExecBlock 0x{:x} (entry {})",
+             address, reinterpret_cast<uintptr_t>(this), index);
+  context->indirectCache.entries[index].address = address;
+  context->indirectCache.entries[index].selector =
+      getBaseCodeBlock() + instRegistry[seq.startInstID].offset;
+}
+
+void ExecBlock::clearIndirectCache() {
+  if (context->indirectCache.dispatcher == 0) {
+    return;
+  }
+  // An empty entry returns to the epilogue, whatever the target.
+  for (auto &entry : context->indirectCache.entries) {
+    entry.address = 0;
+    entry.selector = getEpilogueAddress();
+  }
+  // The return stack is emptied too: the entries keep the address of a chain
+  // slot, that may have been linked with more execute flags than the current
+  // ones.
+  ReturnStack &returnStack = context->returnStack;
+  returnStack.epilogue = getEpilogueAddress();
+  returnStack.top = 0;
+  returnStack.entry = reinterpret_cast<rword>(&returnStack.entries[0]);
+  for (auto &entry : returnStack.entries) {
+    entry.address = 0;
+    entry.slot = reinterpret_cast<rword>(&returnStack.epilogue);
+  }
+}
+
+void ExecBlock::getIndirectCacheStats(rword &hits, rword &misses) const {
+  hits = context->indirectCache.hits;
+  misses = context->indirectCache.misses;
+}
+
+void ExecBlock::recycleContext() {
+  // The stub of the fast callbacks was written after the dispatcher
+  context->hostState.fastCallStub = 0;
+  // The counters are saved by the ExecBlockManager before the recycling
+  context->indirectCache.hits = 0;
+  context->indirectCache.misses = 0;
+  clearIndirectCache();
+}
+
 } // namespace QBDI
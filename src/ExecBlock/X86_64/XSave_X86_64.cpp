@@ -0,0 +1,138 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2025 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#include "QBDI/State.h"
+#include "ExecBlock/X86_64/XSave_X86_64.h"
+#include "Utility/LogSys.h"
+#include "Utility/System.h"
+
+namespace QBDI {
+namespace {
+
+// The FPRState uses the standard format of the XSAVE area
+static_assert(offsetof(FPRState, xstate_bv) == 512, "Wrong XSAVE header");
+static_assert(offsetof(FPRState, ymm0) == 576, "Wrong AVX state offset");
+static_assert(offsetof(FPRState, k0) == 1088, "Wrong opmask state offset");
+static_assert(offsetof(FPRState, zmm0) == 1152, "Wrong ZMM_Hi256 offset");
+static_assert(offsetof(FPRState, zmm16) == 1664, "Wrong Hi16_ZMM offset");
+
+bool fxsaveForced = false;
+
+uint32_t getXSaveComponentOffset(unsigned component) {
+#if defined(_MSC_VER)
+  int regs[4];
+  __cpuidex(regs, 0xd, component);
+  return static_cast<uint32_t>(regs[1]);
+#else
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid_count(0xd, component, &eax, &ebx, &ecx, &edx) == 0) {
+    return 0;
+  }
+  return ebx;
+#endif
+}
+
+uint64_t computeXSaveMask() {
+  if (not isHostCPUFeaturePresent("xsave")) {
+    return 0;
+  }
+  uint64_t mask = XSaveX87 | XSaveSSE;
+  if (not isHostCPUFeaturePresent("avx")) {
+    return mask;
+  }
+  if (getXSaveComponentOffset(2) != offsetof(FPRState, ymm0)) {
+    QBDI_WARN("Unexpected layout of the XSAVE area, use FXSAVE");
+    return 0;
+  }
+  mask |= XSaveAVX;
+  if (isHostCPUFeaturePresent("avx512f")) {
+    if (getXSaveComponentOffset(5) == offsetof(FPRState, k0) and
+        getXSaveComponentOffset(6) == offsetof(FPRState, zmm0) and
+        getXSaveComponentOffset(7) == offsetof(FPRState, zmm16)) {
+      mask |= XSaveOpmask | XSaveZMMHi256 | XSaveHi16ZMM;
+    } else {
+      QBDI_WARN("Unexpected layout of the XSAVE area, AVX-512 not supported");
+    }
+  }
+  return mask;
+}
+
+} // namespace
+
+uint64_t getXSaveMask() {
+  static const uint64_t mask = computeXSaveMask();
+  return fxsaveForced ? 0 : mask;
+}
+
+void forceFXSave(bool force) { fxsaveForced = force; }
+
+void completeFPRState(FPRState *fprState) {
+  uint64_t missing = getXSaveMask() & ~fprState->xstate_bv;
+  if (missing == 0) {
+    return;
+  }
+  if ((missing & XSaveX87) != 0) {
+    fprState->rfcw = 0x37F;
+    fprState->rfsw = 0;
+    fprState->ftw = 0;
+    fprState->fop = 0;
+    fprState->ip = 0;
+    fprState->cs = 0;
+    fprState->dp = 0;
+    fprState->ds = 0;
+    memset(&fprState->stmm0, 0, 8 * sizeof(MMSTReg));
+  }
+  if ((missing & XSaveSSE) != 0) {
+    memset(fprState->xmm0, 0, 16 * sizeof(fprState->xmm0));
+  }
+  if ((missing & XSaveAVX) != 0) {
+    memset(fprState->ymm0, 0, 16 * sizeof(fprState->ymm0));
+  }
+  if ((missing & XSaveOpmask) != 0) {
+    memset(&fprState->k0, 0, 8 * sizeof(fprState->k0));
+  }
+  if ((missing & XSaveZMMHi256) != 0) {
+    memset(fprState->zmm0, 0, 16 * sizeof(fprState->zmm0));
+  }
+  if ((missing & XSaveHi16ZMM) != 0) {
+    memset(fprState->zmm16, 0, 16 * sizeof(fprState->zmm16));
+  }
+  fprState->xstate_bv |= missing;
+}
+
+void resetFPRStateHeader(FPRState *fprState) {
+  uint64_t mask = getXSaveMask();
+  if (mask == 0) {
+    return;
+  }
+  // XRSTOR faults on a compacted or malformed header
+  fprState->xstate_bv = mask;
+  fprState->xcomp_bv = 0;
+  memset(fprState->rsrv4, 0, sizeof(fprState->rsrv4));
+}
+
+} // namespace QBDI
@@ -0,0 +1,87 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2025 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef XSAVE_X86_64_H
+#define XSAVE_X86_64_H
+
+#include <stdint.h>
+
+#include "QBDI/Config.h"
+#include "QBDI/State.h"
+
+namespace QBDI {
+
+/*! State components of the XSAVE area switched by the ExecBlocks.
+ */
+typedef enum : uint64_t {
+  XSaveX87 = 1 << 0,
+  XSaveSSE = 1 << 1,
+  XSaveAVX = 1 << 2,
+  XSaveOpmask = 1 << 5,
+  XSaveZMMHi256 = 1 << 6,
+  XSaveHi16ZMM = 1 << 7,
+} XSaveComponent;
+
+#if defined(QBDI_ARCH_X86_64)
+
+/*! Get the state components switched by the ExecBlocks with XSAVE.
+ *
+ * @return The mask of the components, or 0 if the host doesn't support XSAVE
+ *         and the ExecBlocks use FXSAVE.
+ */
+uint64_t getXSaveMask();
+
+/*! Force the ExecBlocks created after this call to use FXSAVE, even if the
+ * host supports XSAVE. Used by the benchmarks to compare both context
+ * switches on the same host. This function mustn't be called when a VM runs.
+ *
+ * @param[in] force  True to use FXSAVE, false to follow the host.
+ */
+void forceFXSave(bool force);
+
+/*! Write the initial value of the components missing from the XSAVE header of
+ * a FPRState. XSAVEOPT doesn't write the components in their initial state,
+ * the FPRState must be completed before being exposed to the user.
+ *
+ * @param[in] fprState  The FPRState saved by an ExecBlock.
+ */
+void completeFPRState(FPRState *fprState);
+
+/*! Reset the XSAVE header of a FPRState given by the user. All the components
+ * are loaded from the FPRState by the next context switch.
+ *
+ * @param[in] fprState  The FPRState given by the user.
+ */
+void resetFPRStateHeader(FPRState *fprState);
+
+#else // QBDI_ARCH_X86
+
+// The FPRState of X86 doesn't follow the layout of the XSAVE area, the
+// ExecBlocks always use FXSAVE.
+inline uint64_t getXSaveMask() { return 0; }
+
+inline void forceFXSave(bool force) {}
+
+inline void completeFPRState(FPRState *fprState) {}
+
+inline void resetFPRStateHeader(FPRState *fprState) {}
+
+#endif // QBDI_ARCH_X86_64
+
+} // namespace QBDI
+
+#endif // XSAVE_X86_64_H
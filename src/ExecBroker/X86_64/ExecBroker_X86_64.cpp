@@ -59,9 +59,14 @@ bool ExecBroker::transferExecution(rword addr, GPRState *gprState,
       "0x{:06x}",
       reinterpret_cast<void *>(ptr), hookedAddress, hook);
 
-  // Write transfer state
-  transferBlock->getContext()->gprState = *gprState;
-  transferBlock->getContext()->fprState = *fprState;
+  // Write transfer state. With a shared context, the state may already be in
+  // the transferBlock.
+  if (transferBlock->getGPRState() != gprState) {
+    *transferBlock->getGPRState() = *gprState;
+  }
+  if (transferBlock->getFPRState() != fprState) {
+    *transferBlock->getFPRState() = *fprState;
+  }
   transferBlock->getContext()->hostState.selector = addr;
   transferBlock->getContext()->hostState.executeFlags = defaultExecuteFlags;
   // Execute transfer
@@ -71,8 +76,12 @@ bool ExecBroker::transferExecution(rword addr, GPRState *gprState,
   transferBlock->run();
 
   // Read transfer result
-  *gprState = transferBlock->getContext()->gprState;
-  *fprState = transferBlock->getContext()->fprState;
+  if (transferBlock->getGPRState() != gprState) {
+    *gprState = *transferBlock->getGPRState();
+  }
+  if (transferBlock->getFPRState() != fprState) {
+    *fprState = *transferBlock->getFPRState();
+  }
 
   // Restore original return
   QBDI_GPR_SET(gprState, REG_PC, hookedAddress);
@@ -222,6 +222,29 @@ RelocatableInst::UniquePtrVec getTerminator(const LLVMCPU &llvmcpu,
   return terminator;
 }
 
+RelocatableInst::UniquePtrVec getChainJump(const LLVMCPU &llvmcpu,
+                                           rword slotOffset) {
+  // Block chaining isn't supported on this architecture, always return to the
+  // epilogue
+  return JmpEpilogue().genReloc(llvmcpu);
+}
+
+RelocatableInst::UniquePtrVec
+getIndirectCacheDispatcher(const LLVMCPU &llvmcpu) {
+  // No indirect branch cache on this architecture
+  return {};
+}
+
+RelocatableInst::UniquePtrVec getBlockCounter(const LLVMCPU &llvmcpu,
+                                              rword counter) {
+  // The block profile isn't supported on this architecture
+  return {};
+}
+
+RelocatableInst::UniquePtrVec getIndirectCacheJump(const LLVMCPU &llvmcpu) {
+  return JmpEpilogue().genReloc(llvmcpu);
+}
+
 // Change ScratchRegister
 RelocatableInst::UniquePtrVec
 changeScratchRegister(const LLVMCPU &llvmcpu, RegLLVM oldSR, RegLLVM nextSR_) {
@@ -21,8 +21,10 @@
 
 #include "AArch64InstrInfo.h"
 #include "llvm/MC/MCInst.h"
+#include "llvm/MC/MCInstrDesc.h"
 
 #include "devVariable.h"
+#include "Engine/LLVMCPU.h"
 #include "Patch/AARCH64/InstInfo_AARCH64.h"
 #include "Patch/InstInfo.h"
 #include "Utility/LogSys.h"
@@ -1982,4 +1984,25 @@ bool isMOPSPrologue(const llvm::MCInst &inst) {
   }
 }
 
+void getDirectSuccessors(const llvm::MCInst &inst, const LLVMCPU &llvmcpu,
+                         rword address, rword size,
+                         std::vector<rword> &successors) {
+  const llvm::MCInstrDesc &desc = llvmcpu.getMCII().get(inst.getOpcode());
+  if (not desc.isBarrier() and not desc.isReturn()) {
+    successors.push_back(address + size);
+  }
+  if (not desc.isBranch() and not desc.isCall()) {
+    return;
+  }
+  for (unsigned i = 0; i < desc.getNumOperands(); i++) {
+    if (desc.operands()[i].OperandType == llvm::MCOI::OPERAND_PCREL and
+        inst.getOperand(i).isImm()) {
+      // The offset of B, BL, Bcc, CBZ and TBZ is a number of instructions
+      successors.push_back(address +
+                           static_cast<rword>(inst.getOperand(i).getImm() * 4));
+      return;
+    }
+  }
+}
+
 } // namespace QBDI
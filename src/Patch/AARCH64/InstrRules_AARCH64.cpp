@@ -63,4 +63,44 @@ RelocatableInst::UniquePtrVec getBreakToHost(Reg temp, const Patch &patch,
   return breakToHost;
 }
 
+// The fast callbacks aren't supported, the callback is called by the VM
+RelocatableInst::UniquePtrVec getFastCallToHost(Reg temp, const Patch &patch,
+                                                bool restore) {
+  return getBreakToHost(temp, patch, restore);
+}
+
+// The predicates are evaluated by the host
+PatchGenerator::UniquePtrVec
+getPredicateGate(const Patch &patch, InstPosition position,
+                 const CallbackPredicate &predicate, InstCallback cbk,
+                 void *data) {
+  return {};
+}
+
+// The countdowns are decremented by the host
+PatchGenerator::UniquePtrVec
+getCountdownGate(const Patch &patch, InstPosition position, rword *countdown,
+                 rword step, InstCallback cbk, void *data) {
+  return {};
+}
+
+// The slots are read by the host
+PatchGenerator::UniquePtrVec getSlotGate(const Patch &patch,
+                                         InstPosition position, rword *armed,
+                                         InstCallback cbk, void *data) {
+  return {};
+}
+
+// The edge coverage isn't supported
+PatchGenerator::UniquePtrVec getCoverageEdge(const Patch &patch,
+                                             CoverageBitmap *coverage) {
+  return {};
+}
+
+// The once callbacks are filtered by the host
+RelocatableInst::UniquePtrVec
+getOnceSkip(const Patch &patch, const RelocatableInst::UniquePtrVec &stub) {
+  return {};
+}
+
 } // namespace QBDI
@@ -1945,6 +1945,30 @@ std::vector<std::unique_ptr<InstrRule>> getInstrRuleMemAccessWrite() {
           PREINST, false, PRIORITY_MEMACCESS_LIMIT, RelocTagPreInstMemAccess));
 }
 
+// The memory trace isn't supported on this architecture
+std::vector<std::unique_ptr<InstrRule>>
+getInstrRuleMemoryTrace(MemoryTrace *trace) {
+  return {};
+}
+
+// The memory gates compare the ranges in the host on this architecture
+PatchGenerator::UniquePtrVec
+getMemRangeGate(const Patch &patch, const LLVMCPU &llvmcpu,
+                InstPosition position, const RangeSet<rword> &readRanges,
+                const RangeSet<rword> &writeRanges, InstCallback cbk,
+                void *data) {
+  return {};
+}
+
+// The inline instrumentations are interpreted by the host on this
+// architecture
+PatchGenerator::UniquePtrVec
+getInlineGate(const Patch &patch, const LLVMCPU &llvmcpu,
+              InstPosition position, const std::vector<InlineOp> &ops,
+              InstCallback cbk, void *data) {
+  return {};
+}
+
 // Analyse MemoryAccess from Shadow
 // ================================
 
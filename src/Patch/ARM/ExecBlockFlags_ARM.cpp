@@ -20,10 +20,10 @@
 
 namespace QBDI {
 
-const uint8_t defaultExecuteFlags = ExecBlockFlags::Default;
+const uint32_t defaultExecuteFlags = ExecBlockFlags::Default;
 
-uint8_t getExecBlockFlags(const llvm::MCInst &inst,
-                          const QBDI::LLVMCPU &llvmcpu) {
+uint32_t getExecBlockFlags(const llvm::MCInst &inst,
+                           const QBDI::LLVMCPU &llvmcpu) {
   return defaultExecuteFlags;
 }
 
@@ -1521,4 +1521,54 @@ sword getFixedOperandValue(const llvm::MCInst &inst, const LLVMCPU &llvmcpu,
   return static_cast<rword>(value);
 }
 
+void getDirectSuccessors(const llvm::MCInst &inst, const LLVMCPU &llvmcpu,
+                         rword address, rword size,
+                         std::vector<rword> &successors) {
+  const llvm::MCInstrDesc &desc = llvmcpu.getMCII().get(inst.getOpcode());
+  const bool thumb = llvmcpu.getCPUMode() == CPUMode::Thumb;
+  const rword thumbBit = thumb ? 1 : 0;
+
+  // LLVM describes B as a conditional branch with the predicate AL. The next
+  // instruction may be a literal pool: it is only followed after a call or a
+  // conditional instruction.
+  bool conditional;
+  switch (inst.getOpcode()) {
+    case llvm::ARM::tCBNZ:
+    case llvm::ARM::tCBZ:
+      conditional = true;
+      break;
+    default:
+      conditional = getCondition(inst, llvmcpu) != llvm::ARMCC::AL;
+      break;
+  }
+  if (desc.isCall() or conditional) {
+    successors.push_back((address + size) | thumbBit);
+  }
+  if (not desc.isBranch() and not desc.isCall()) {
+    return;
+  }
+  for (unsigned i = 0; i < desc.getNumOperands(); i++) {
+    if (desc.operands()[i].OperandType != llvm::MCOI::OPERAND_PCREL or
+        not inst.getOperand(i).isImm()) {
+      continue;
+    }
+    const rword imm = static_cast<rword>(inst.getOperand(i).getImm());
+    const rword pc = address + (thumb ? 4 : 8);
+    switch (inst.getOpcode()) {
+      case llvm::ARM::BLXi:
+        // switch to Thumb
+        successors.push_back((pc + imm) | 1);
+        break;
+      case llvm::ARM::tBLXi:
+        // switch to ARM, the target is relative to Align(PC, 4)
+        successors.push_back((pc & ~static_cast<rword>(3)) + imm);
+        break;
+      default:
+        successors.push_back((pc + imm) | thumbBit);
+        break;
+    }
+    return;
+  }
+}
+
 } // namespace QBDI
@@ -38,9 +38,9 @@ class MCInst;
 namespace QBDI {
 class LLVMCPU;
 
-uint8_t getExecBlockFlags(const llvm::MCInst &inst, const LLVMCPU &llvmcpu);
+uint32_t getExecBlockFlags(const llvm::MCInst &inst, const LLVMCPU &llvmcpu);
 
-extern const uint8_t defaultExecuteFlags;
+extern const uint32_t defaultExecuteFlags;
 
 } // namespace QBDI
 
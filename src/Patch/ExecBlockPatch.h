@@ -38,6 +38,21 @@ getExecBlockEpilogue(const LLVMCPU &llvmcpu);
 std::vector<std::unique_ptr<RelocatableInst>>
 getTerminator(const LLVMCPU &llvmcpu, rword address);
 
+std::vector<std::unique_ptr<RelocatableInst>>
+getChainJump(const LLVMCPU &llvmcpu, rword slotOffset);
+
+std::vector<std::unique_ptr<RelocatableInst>>
+getIndirectCacheDispatcher(const LLVMCPU &llvmcpu);
+
+std::vector<std::unique_ptr<RelocatableInst>>
+getIndirectCacheJump(const LLVMCPU &llvmcpu);
+
+std::vector<std::unique_ptr<RelocatableInst>>
+getFastCallStub(const LLVMCPU &llvmcpu, rword proxy, rword arg);
+
+std::vector<std::unique_ptr<RelocatableInst>>
+getBlockCounter(const LLVMCPU &llvmcpu, rword counter);
+
 } // namespace QBDI
 
 #endif
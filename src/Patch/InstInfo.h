@@ -19,6 +19,8 @@
 #define INSTINFO_H
 
 #include <stdint.h>
+#include <vector>
+
 #include "QBDI/State.h"
 
 namespace llvm {
@@ -40,6 +42,14 @@ bool unsupportedWrite(const llvm::MCInst &inst);
 
 bool variadicOpsIsWrite(const llvm::MCInst &inst);
 
+// Add the successors known without executing an instruction that ends a basic
+// block: the target of a direct branch or call, and the next instruction when
+// the execution can continue after it. On ARM, the thumb bit is set in the
+// successors executed in Thumb mode.
+void getDirectSuccessors(const llvm::MCInst &inst, const LLVMCPU &llvmcpu,
+                         rword address, rword size,
+                         std::vector<rword> &successors);
+
 }; // namespace QBDI
 
 #endif // INSTCLASSES_H
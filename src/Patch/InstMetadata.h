@@ -42,7 +42,7 @@ public:
   uint32_t patchSize;
   CPUMode cpuMode;
   bool modifyPC;
-  uint8_t execblockFlags;
+  uint32_t execblockFlags;
   mutable InstAnalysisPtr analysis;
   InstMetadataArch archMetadata;
 #if defined(QBDI_ARCH_X86_64) || defined(QBDI_ARCH_X86)
@@ -52,13 +52,13 @@ public:
 
   InstMetadata(const llvm::MCInst &inst, rword address, uint32_t instSize,
                uint32_t patchSize, CPUMode cpuMode, bool modifyPC,
-               uint8_t execblockFlags, InstAnalysisPtr analysis)
+               uint32_t execblockFlags, InstAnalysisPtr analysis)
       : inst(inst), address(address), instSize(instSize), patchSize(patchSize),
         cpuMode(cpuMode), modifyPC(modifyPC), execblockFlags(execblockFlags),
         analysis(std::move(analysis)) {}
 
   InstMetadata(const llvm::MCInst &inst, rword address, uint32_t instSize,
-               CPUMode cpuMode, uint8_t execblockFlags)
+               CPUMode cpuMode, uint32_t execblockFlags)
       : inst(inst), address(address), instSize(instSize), patchSize(0),
         cpuMode(cpuMode), modifyPC(false), execblockFlags(execblockFlags),
         analysis(nullptr) {}
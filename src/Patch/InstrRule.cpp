@@ -15,14 +15,18 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <algorithm>
+#include <memory>
 #include <stdint.h>
 #include <stdlib.h>
 #include <utility>
+#include <vector>
 
 #include "Engine/VM_internal.h"
 #include "Patch/InstMetadata.h"
 #include "Patch/InstrRule.h"
 #include "Patch/InstrRules.h"
+#include "Patch/MemoryAccess.h"
 #include "Patch/Patch.h"
 #include "Patch/PatchCondition.h"
 #include "Patch/PatchGenerator.h"
@@ -37,15 +41,43 @@ namespace QBDI {
 // InstrRule
 // =========
 
-void InstrRule::instrument(Patch &patch,
-                           const PatchGenerator::UniquePtrVec &patchGen,
-                           bool breakToHost, InstPosition position,
-                           int priority, RelocatableInstTag tag) const {
+InstrRule::InstrRule(const InstrRule &other) : priority(other.priority) {
+  other.copySampler(*this);
+  other.copySlot(*this);
+}
 
-  if (patchGen.size() == 0 && breakToHost == false) {
-    QBDI_DEBUG("Empty patch Generator");
-    return;
+void InstrRule::copySampler(InstrRule &rule) const {
+  if (sampler) {
+    rule.sampler = std::make_unique<CallbackSampler>(*sampler);
+  } else {
+    rule.sampler.reset();
   }
+}
+
+void InstrRule::copySlot(InstrRule &rule) const {
+  if (slot) {
+    rule.slot = std::make_unique<CallbackSlot>(*slot);
+  } else {
+    rule.slot.reset();
+  }
+}
+
+namespace {
+
+VMAction callbackSlotProxy(VMInstanceRef vm, GPRState *gprState,
+                           FPRState *fprState, void *data) {
+  const CallbackSlot *slot = static_cast<const CallbackSlot *>(data);
+  if (slot->armed == 0) {
+    return CONTINUE;
+  }
+  return slot->cbk(vm, gprState, fprState, slot->data);
+}
+
+RelocatableInst::UniquePtrVec
+generateInstrumentation(Patch &patch,
+                        const PatchGenerator::UniquePtrVec &patchGen,
+                        bool breakToHost, InstPosition position,
+                        bool fastCall) {
 
   /* The instrument function needs to handle several different cases. An
    * instrumentation can be either prepended or appended to the patch and, in
@@ -110,8 +142,16 @@ void InstrRule::instrument(Patch &patch,
 
     prepend(instru, std::move(saveReg));
     append(instru, std::move(restoreReg));
-    append(instru, getBreakToHost(unrestoredReg[0], patch,
-                                  tempManager.shouldRestore(unrestoredReg[0])));
+    if (fastCall) {
+      append(instru,
+             getFastCallToHost(unrestoredReg[0], patch,
+                               tempManager.shouldRestore(unrestoredReg[0])));
+      patch.fastCall = true;
+    } else {
+      append(instru,
+             getBreakToHost(unrestoredReg[0], patch,
+                            tempManager.shouldRestore(unrestoredReg[0])));
+    }
   }
   // Normal case where we append the temporary register restoration code to the
   // instrumentation
@@ -122,6 +162,25 @@ void InstrRule::instrument(Patch &patch,
     append(instru, std::move(restoreReg));
   }
 
+  return instru;
+}
+
+} // namespace
+
+void InstrRule::instrument(Patch &patch,
+                           const PatchGenerator::UniquePtrVec &patchGen,
+                           bool breakToHost, InstPosition position,
+                           int priority, RelocatableInstTag tag,
+                           bool fastCall) const {
+
+  if (patchGen.size() == 0 && breakToHost == false) {
+    QBDI_DEBUG("Empty patch Generator");
+    return;
+  }
+
+  RelocatableInst::UniquePtrVec instru = generateInstrumentation(
+      patch, patchGen, breakToHost, position, fastCall);
+
   // add Tag
   instru.insert(instru.begin(), RelocTag::unique(tag));
 
@@ -138,17 +197,145 @@ void InstrRule::instrument(Patch &patch,
   patch.addInstsPatch(position, priority, std::move(instru));
 }
 
+void InstrRule::instrumentCallback(Patch &patch, InstCallback cbk, void *data,
+                                   InstPosition position, int priority,
+                                   RelocatableInstTag tag, bool fastCall,
+                                   bool once) const {
+  QBDI_DEBUG("Insert callback {} with priority {}, position {} and tag 0x{:x}",
+             reinterpret_cast<void *>(cbk), priority, position, tag);
+
+  if (slot) {
+    // The callback is called through the slot. A disarmed slot is skipped by
+    // a gate in the JIT code if the architecture supports it, otherwise the
+    // proxy returns without calling the callback.
+    cbk = callbackSlotProxy;
+    data = slot.get();
+    if (not once and not sampler) {
+      PatchGenerator::UniquePtrVec gate =
+          getSlotGate(patch, position, &slot->armed, cbk, data);
+      if (not gate.empty()) {
+        instrument(patch, gate, false, position, priority, tag);
+        return;
+      }
+    }
+  }
+
+  if (once) {
+    // The once callbacks aren't coalesced. The JIT code jumps over their
+    // break to host after the first call if the architecture supports it,
+    // otherwise the lambda only calls them once.
+    RelocatableInst::UniquePtrVec instru = generateInstrumentation(
+        patch, getCallbackGenerator(cbk, data), true, position, fastCall);
+    RelocatableInst::UniquePtrVec skip = getOnceSkip(patch, instru);
+    if (not skip.empty()) {
+      prepend(instru, std::move(skip));
+      instru.insert(instru.begin(), RelocTag::unique(tag));
+      patch.addInstsPatch(position, priority, std::move(instru));
+      return;
+    }
+    patch.userInstCB.emplace_back(std::make_unique<InstCbLambda>(
+        [cbk, data, called = false](VMInstanceRef vm, GPRState *gprState,
+                                    FPRState *fprState) mutable {
+          if (called) {
+            return CONTINUE;
+          }
+          called = true;
+          return cbk(vm, gprState, fprState, data);
+        }));
+    patch.addCallbackPatch(position, priority,
+                           InstrCallback{InstCBLambdaProxy,
+                                         patch.userInstCB.back().get(), tag,
+                                         fastCall});
+    return;
+  }
+
+  if (sampler) {
+    // The sampled callbacks always break to the host. The countdown is
+    // decremented by a gate in the JIT code if the architecture supports it,
+    // otherwise by the lambda.
+    CallbackSampler *s = sampler.get();
+    patch.userInstCB.emplace_back(std::make_unique<InstCbLambda>(
+        [s, cbk, data](VMInstanceRef vm, GPRState *gprState,
+                       FPRState *fprState) {
+          if (not s->sample()) {
+            return CONTINUE;
+          }
+          return cbk(vm, gprState, fprState, data);
+        }));
+    void *lambda = patch.userInstCB.back().get();
+    PatchGenerator::UniquePtrVec gate = getCountdownGate(
+        patch, position, &s->countdown, 1, InstCBLambdaProxy, lambda);
+    if (gate.empty()) {
+      patch.addCallbackPatch(
+          position, priority,
+          InstrCallback{InstCBLambdaProxy, lambda, tag, false});
+    } else {
+      instrument(patch, gate, false, position, priority, tag);
+    }
+    return;
+  }
+
+  patch.addCallbackPatch(position, priority,
+                         InstrCallback{cbk, data, tag, fastCall});
+}
+
+void coalesceCallbacks(Patch &patch) {
+  patch.coalesceCallbacks([&patch](InstPosition position,
+                                   const std::vector<InstrCallback> &cbks) {
+    bool fastCall =
+        std::all_of(cbks.begin(), cbks.end(),
+                    [](const InstrCallback &c) { return c.fastCall; });
+    RelocatableInst::UniquePtrVec instru;
+
+    if (cbks.size() == 1) {
+      instru = generateInstrumentation(
+          patch, getCallbackGenerator(cbks[0].cbk, cbks[0].data), true,
+          position, fastCall);
+    } else {
+      QBDI_DEBUG("Coalesce {} callbacks at position {} of {}", cbks.size(),
+                 position, patch);
+      // The callbacks are called by priority order until one of them doesn't
+      // return CONTINUE, as with a break to host for each callback.
+      patch.userInstCB.emplace_back(std::make_unique<InstCbLambda>(
+          [cbks](VMInstanceRef vm, GPRState *gprState, FPRState *fprState) {
+            for (const InstrCallback &c : cbks) {
+              VMAction action = c.cbk(vm, gprState, fprState, c.data);
+              if (action != CONTINUE) {
+                return action;
+              }
+            }
+            return CONTINUE;
+          }));
+      instru = generateInstrumentation(
+          patch,
+          getCallbackGenerator(InstCBLambdaProxy,
+                               patch.userInstCB.back().get()),
+          true, position, fastCall);
+    }
+
+    instru.insert(instru.begin(), RelocTag::unique(cbks[0].tag));
+    return instru;
+  });
+}
+
 // InstrRuleBasicCBK
 // =================
 
 InstrRuleBasicCBK::InstrRuleBasicCBK(PatchConditionUniquePtr &&condition,
                                      InstCallback cbk, void *data,
                                      InstPosition position, bool breakToHost,
-                                     int priority, RelocatableInstTag tag)
+                                     int priority, RelocatableInstTag tag,
+                                     CallbackType type)
     : AutoUnique<InstrRule, InstrRuleBasicCBK>(priority),
       condition(std::forward<PatchConditionUniquePtr>(condition)),
       patchGen(getCallbackGenerator(cbk, data)), position(position),
-      breakToHost(breakToHost), tag(tag), cbk(cbk), data(data) {}
+      breakToHost(breakToHost), tag(tag), cbk(cbk), data(data), type(type) {
+  // The slot is written with the first translation, the callback can then be
+  // enabled or retargeted without clearing the cache
+  if ((type & CALLBACK_SLOT) != 0 and breakToHost) {
+    slot = std::make_unique<CallbackSlot>(CallbackSlot{1, cbk, data});
+  }
+}
 
 InstrRuleBasicCBK::~InstrRuleBasicCBK() = default;
 
@@ -160,14 +347,44 @@ bool InstrRuleBasicCBK::canBeApplied(const Patch &patch,
 bool InstrRuleBasicCBK::changeDataPtr(void *new_data) {
   data = new_data;
   patchGen = getCallbackGenerator(cbk, data);
+  if (slot) {
+    slot->data = new_data;
+  }
   return true;
 }
 
 std::unique_ptr<InstrRule> InstrRuleBasicCBK::clone() const {
-  return InstrRuleBasicCBK::unique(condition->clone(), cbk, data, position,
-                                   breakToHost, priority);
+  std::unique_ptr<InstrRule> rule = InstrRuleBasicCBK::unique(
+      condition->clone(), cbk, data, position, breakToHost, priority, tag,
+      type);
+  copySampler(*rule);
+  copySlot(*rule);
+  return rule;
 };
 
+bool InstrRuleBasicCBK::setSampling(uint32_t period, bool randomized) {
+  // only the callbacks can be sampled, and a once callback isn't sampled
+  if (not breakToHost or (type & CALLBACK_ONCE) != 0) {
+    return false;
+  }
+  if (not sampler) {
+    sampler = std::make_unique<CallbackSampler>();
+  }
+  sampler->setPeriod(period, randomized);
+  return true;
+}
+
+bool InstrRuleBasicCBK::setEnabled(bool enabled) {
+  if (not breakToHost) {
+    return false;
+  }
+  if (not slot) {
+    slot = std::make_unique<CallbackSlot>(CallbackSlot{1, cbk, data});
+  }
+  slot->armed = enabled ? 1 : 0;
+  return true;
+}
+
 RangeSet<rword> InstrRuleBasicCBK::affectedRange() const {
   return condition->affectedRange();
 }
@@ -200,6 +417,348 @@ RangeSet<rword> InstrRuleDynamic::affectedRange() const {
   return condition->affectedRange();
 }
 
+// InstrRuleMemRangeCBK
+// ====================
+
+InstrRuleMemRangeCBK::InstrRuleMemRangeCBK(InstCallback cbk, void *data,
+                                           InstPosition position,
+                                           RangeSet<rword> readRanges,
+                                           RangeSet<rword> writeRanges,
+                                           int priority,
+                                           RelocatableInstTag tag)
+    : AutoUnique<InstrRule, InstrRuleMemRangeCBK>(priority), cbk(cbk),
+      data(data), position(position), tag(tag),
+      readRanges(std::move(readRanges)), writeRanges(std::move(writeRanges)) {}
+
+InstrRuleMemRangeCBK::~InstrRuleMemRangeCBK() = default;
+
+std::unique_ptr<InstrRule> InstrRuleMemRangeCBK::clone() const {
+  return InstrRuleMemRangeCBK::unique(cbk, data, position, readRanges,
+                                      writeRanges, priority, tag);
+}
+
+RangeSet<rword> InstrRuleMemRangeCBK::affectedRange() const {
+  RangeSet<rword> r;
+  r.add(Range<rword>(0, (rword)-1, real_addr_t()));
+  return r;
+}
+
+bool InstrRuleMemRangeCBK::changeDataPtr(void *new_data) {
+  data = new_data;
+  return true;
+}
+
+bool InstrRuleMemRangeCBK::hasSameCode(
+    const RangeSet<rword> &newReadRanges,
+    const RangeSet<rword> &newWriteRanges) const {
+  auto sameCode = [](const RangeSet<rword> &a, const RangeSet<rword> &b) {
+    const size_t sizeA = a.getRanges().size();
+    const size_t sizeB = b.getRanges().size();
+    if (sizeA == 0 or sizeB == 0) {
+      return sizeA == sizeB;
+    }
+    // ARM and AARCH64 always compare the ranges in the host, as the gates
+    // with too many ranges
+    if (is_arm or is_aarch64 or (sizeA > MEMORY_GATE_INLINE_RANGES and
+                                 sizeB > MEMORY_GATE_INLINE_RANGES)) {
+      return true;
+    }
+    return a == b;
+  };
+  return sameCode(readRanges, newReadRanges) and
+         sameCode(writeRanges, newWriteRanges);
+}
+
+bool InstrRuleMemRangeCBK::tryInstrument(Patch &patch,
+                                         const LLVMCPU &llvmcpu) const {
+  bool read = not readRanges.getRanges().empty() and
+              DoesReadAccess().test(patch, llvmcpu);
+  bool write = position == POSTINST and not writeRanges.getRanges().empty() and
+               DoesWriteAccess().test(patch, llvmcpu);
+  if (not read and not write) {
+    return false;
+  }
+
+  PatchGenerator::UniquePtrVec gate =
+      getMemRangeGate(patch, llvmcpu, position, readRanges,
+                      write ? writeRanges : RangeSet<rword>(), cbk, data);
+  if (gate.empty()) {
+    // the gate compares the ranges with the accesses in the host
+    instrumentCallback(patch, cbk, data, position, priority, tag);
+  } else {
+    instrument(patch, gate, false, position, priority, tag);
+  }
+  return true;
+}
+
+// InstrRulePredicateCBK
+// =====================
+
+namespace {
+
+rword getPredicateValue(const CallbackPredicate &predicate,
+                        const GPRState *gprState) {
+  switch (predicate.source) {
+    case PREDICATE_FLAG:
+      return (QBDI_GPR_GET(gprState, REG_FLAG) >> predicate.reg) & 1;
+    case PREDICATE_MEMORY:
+      return *reinterpret_cast<const rword *>(
+          QBDI_GPR_GET(gprState, predicate.reg) + predicate.offset);
+    default:
+      return QBDI_GPR_GET(gprState, predicate.reg);
+  }
+}
+
+bool predicateHolds(const CallbackPredicate &predicate, rword value) {
+  switch (predicate.op) {
+    case PREDICATE_EQ:
+      return value == predicate.constant;
+    case PREDICATE_NE:
+      return value != predicate.constant;
+    case PREDICATE_LT:
+      return value < predicate.constant;
+    case PREDICATE_LE:
+      return value <= predicate.constant;
+    case PREDICATE_GT:
+      return value > predicate.constant;
+    case PREDICATE_GE:
+      return value >= predicate.constant;
+    case PREDICATE_IN_RANGE:
+      return predicate.constant <= value and value < predicate.constantEnd;
+    default:
+      return false;
+  }
+}
+
+VMAction predicateCBK(VMInstanceRef vm, GPRState *gprState,
+                      FPRState *fprState, void *data) {
+  const PredicateCBKData *cbkData = static_cast<PredicateCBKData *>(data);
+  if (not predicateHolds(cbkData->predicate,
+                         getPredicateValue(cbkData->predicate, gprState))) {
+    return VMAction::CONTINUE;
+  }
+  return cbkData->cbk(vm, gprState, fprState, cbkData->data);
+}
+
+} // namespace
+
+InstrRulePredicateCBK::InstrRulePredicateCBK(
+    PatchConditionUniquePtr &&condition, const CallbackPredicate &predicate,
+    InstCallback cbk, void *data, InstPosition position, int priority,
+    RelocatableInstTag tag)
+    : AutoUnique<InstrRule, InstrRulePredicateCBK>(priority),
+      condition(std::forward<PatchConditionUniquePtr>(condition)),
+      position(position), tag(tag),
+      cbkData(std::make_unique<PredicateCBKData>(
+          PredicateCBKData{predicate, cbk, data})) {}
+
+InstrRulePredicateCBK::~InstrRulePredicateCBK() = default;
+
+std::unique_ptr<InstrRule> InstrRulePredicateCBK::clone() const {
+  return InstrRulePredicateCBK::unique(condition->clone(), cbkData->predicate,
+                                       cbkData->cbk, cbkData->data, position,
+                                       priority, tag);
+}
+
+RangeSet<rword> InstrRulePredicateCBK::affectedRange() const {
+  return condition->affectedRange();
+}
+
+bool InstrRulePredicateCBK::changeDataPtr(void *new_data) {
+  cbkData->data = new_data;
+  return true;
+}
+
+bool InstrRulePredicateCBK::tryInstrument(Patch &patch,
+                                          const LLVMCPU &llvmcpu) const {
+  if (not condition->test(patch, llvmcpu)) {
+    return false;
+  }
+
+  PatchGenerator::UniquePtrVec gate =
+      getPredicateGate(patch, position, cbkData->predicate, cbkData->cbk,
+                       cbkData->data);
+  if (gate.empty()) {
+    instrumentCallback(patch, predicateCBK, cbkData.get(), position, priority,
+                       tag);
+  } else {
+    instrument(patch, gate, false, position, priority, tag);
+  }
+  return true;
+}
+
+// InstrRuleInlineCBK
+// ==================
+
+namespace {
+
+/* Replace the operations that only depend on the instruction with constant
+ * loads: the operands, the PC when it is known and the accesses that the
+ * instruction doesn't do.
+ */
+std::vector<InlineOp> resolveInlineOps(const Patch &patch,
+                                       const LLVMCPU &llvmcpu,
+                                       InstPosition position,
+                                       const std::vector<InlineOp> &ops) {
+  std::vector<InlineOp> resolved;
+  const InstAnalysis *ana = nullptr;
+  for (InlineOp op : ops) {
+    if (op.opcode == INLINE_LOAD_OPERAND) {
+      if (ana == nullptr) {
+        ana = analyzeInstMetadata(patch.metadata, ANALYSIS_OPERANDS, llvmcpu);
+      }
+      const OperandAnalysis *operand = nullptr;
+      if (op.value < ana->numOperands) {
+        operand = &ana->operands[op.value];
+      }
+      if (operand != nullptr and operand->type == OPERAND_GPR and
+          operand->regCtxIdx >= 0) {
+        op.opcode = INLINE_LOAD_REG;
+        op.value = operand->regCtxIdx;
+      } else if (operand != nullptr and operand->type == OPERAND_IMM) {
+        op.opcode = INLINE_LOAD_IMM;
+        op.value = operand->value;
+      } else {
+        op.opcode = INLINE_LOAD_IMM;
+        op.value = 0;
+      }
+    }
+    if (op.opcode == INLINE_LOAD_REG and op.value == REG_PC and
+        (position == PREINST or not patch.metadata.modifyPC)) {
+      op.opcode = INLINE_LOAD_IMM;
+      op.value = (position == PREINST) ? patch.metadata.address
+                                       : patch.metadata.endAddress();
+    }
+    if ((op.opcode == INLINE_LOAD_READ_ADDRESS and
+         not DoesReadAccess().test(patch, llvmcpu)) or
+        (op.opcode == INLINE_LOAD_WRITE_ADDRESS and
+         (position == PREINST or not DoesWriteAccess().test(patch, llvmcpu)))) {
+      op.opcode = INLINE_LOAD_IMM;
+      op.value = 0;
+    }
+    resolved.push_back(op);
+  }
+  return resolved;
+}
+
+rword getAccessAddress(VMInstanceRef vm, MemoryAccessType type) {
+  for (const MemoryAccess &access :
+       static_cast<VM *>(vm)->getInstMemoryAccess()) {
+    if (access.type & type) {
+      return access.accessAddress;
+    }
+  }
+  return 0;
+}
+
+VMAction runInlineOps(const std::vector<InlineOp> &ops, VMInstanceRef vm,
+                      GPRState *gprState, FPRState *fprState,
+                      const InlineCBKData &cbkData) {
+  rword acc = 0;
+  for (size_t i = 0; i < ops.size(); i++) {
+    const InlineOp &op = ops[i];
+    switch (op.opcode) {
+      case INLINE_LOAD_IMM:
+        acc = op.value;
+        break;
+      case INLINE_LOAD_REG:
+        acc = QBDI_GPR_GET(gprState, op.value);
+        break;
+      case INLINE_LOAD_READ_ADDRESS:
+        acc = getAccessAddress(vm, MEMORY_READ);
+        break;
+      case INLINE_LOAD_WRITE_ADDRESS:
+        acc = getAccessAddress(vm, MEMORY_WRITE);
+        break;
+      case INLINE_LOAD_MEMORY:
+        acc = *reinterpret_cast<const rword *>(op.value);
+        break;
+      case INLINE_ADD:
+        acc += op.value;
+        break;
+      case INLINE_STORE:
+        *reinterpret_cast<rword *>(op.value) = acc;
+        break;
+      case INLINE_SKIP:
+        if (predicateHolds(CallbackPredicate{PREDICATE_GPR, 0, 0, op.cmp,
+                                             op.constant, op.constantEnd},
+                           acc)) {
+          if (op.value >= ops.size() - i - 1) {
+            // skip the remaining operations
+            return VMAction::CONTINUE;
+          }
+          i += op.value;
+        }
+        break;
+      case INLINE_CALL:
+        return cbkData.cbk(vm, gprState, fprState, cbkData.data);
+      default:
+        QBDI_ABORT("Unexpected inline operation {}",
+                   static_cast<int>(op.opcode));
+    }
+  }
+  return VMAction::CONTINUE;
+}
+
+} // namespace
+
+InstrRuleInlineCBK::InstrRuleInlineCBK(PatchConditionUniquePtr &&condition,
+                                       const std::vector<InlineOp> &ops,
+                                       InstCallback cbk, void *data,
+                                       InstPosition position, int priority,
+                                       RelocatableInstTag tag)
+    : AutoUnique<InstrRule, InstrRuleInlineCBK>(priority),
+      condition(std::forward<PatchConditionUniquePtr>(condition)),
+      position(position), tag(tag),
+      cbkData(std::make_unique<InlineCBKData>(InlineCBKData{ops, cbk, data})) {
+}
+
+InstrRuleInlineCBK::~InstrRuleInlineCBK() = default;
+
+std::unique_ptr<InstrRule> InstrRuleInlineCBK::clone() const {
+  return InstrRuleInlineCBK::unique(condition->clone(), cbkData->ops,
+                                    cbkData->cbk, cbkData->data, position,
+                                    priority, tag);
+}
+
+RangeSet<rword> InstrRuleInlineCBK::affectedRange() const {
+  return condition->affectedRange();
+}
+
+bool InstrRuleInlineCBK::changeDataPtr(void *new_data) {
+  cbkData->data = new_data;
+  return true;
+}
+
+bool InstrRuleInlineCBK::tryInstrument(Patch &patch,
+                                       const LLVMCPU &llvmcpu) const {
+  if (not condition->test(patch, llvmcpu)) {
+    return false;
+  }
+
+  std::vector<InlineOp> ops =
+      resolveInlineOps(patch, llvmcpu, position, cbkData->ops);
+  PatchGenerator::UniquePtrVec gate = getInlineGate(
+      patch, llvmcpu, position, ops, cbkData->cbk, cbkData->data);
+  if (gate.empty()) {
+    const InlineCBKData *d = cbkData.get();
+    patch.userInstCB.emplace_back(std::make_unique<InstCbLambda>(
+        [d, ops = std::move(ops)](VMInstanceRef vm, GPRState *gprState,
+                                  FPRState *fprState) {
+          return runInlineOps(ops, vm, gprState, fprState, *d);
+        }));
+    instrumentCallback(patch, InstCBLambdaProxy, patch.userInstCB.back().get(),
+                       position, priority, tag);
+  } else {
+    if (ops.back().opcode == INLINE_CALL) {
+      // the gate calls the callback with the stub of the fast callbacks
+      patch.fastCall = true;
+    }
+    instrument(patch, gate, false, position, priority, tag);
+  }
+  return true;
+}
+
 // InstrRuleUser
 // =============
 
@@ -218,6 +777,14 @@ InstrRuleUser::InstrRuleUser(InstrRuleCallback cbk, AnalysisType analysisType_,
 
 InstrRuleUser::~InstrRuleUser() = default;
 
+bool InstrRuleUser::setSampling(uint32_t period, bool randomized) {
+  if (not sampler) {
+    sampler = std::make_unique<CallbackSampler>();
+  }
+  sampler->setPeriod(period, randomized);
+  return true;
+}
+
 bool InstrRuleUser::tryInstrument(Patch &patch, const LLVMCPU &llvmcpu) const {
   if (!range.contains(Range<rword>(
           patch.metadata.address,
@@ -241,19 +808,22 @@ bool InstrRuleUser::tryInstrument(Patch &patch, const LLVMCPU &llvmcpu) const {
 
   for (const InstrRuleDataCBK &cbkToAdd : vec) {
     if (cbkToAdd.lambdaCbk == nullptr) {
-      instrument(patch, getCallbackGenerator(cbkToAdd.cbk, cbkToAdd.data), true,
-                 cbkToAdd.position, cbkToAdd.priority,
-                 (cbkToAdd.position == PREINST) ? RelocTagPreInstStdCBK
-                                                : RelocTagPostInstStdCBK);
+      instrumentCallback(patch, cbkToAdd.cbk, cbkToAdd.data, cbkToAdd.position,
+                         cbkToAdd.priority,
+                         (cbkToAdd.position == PREINST)
+                             ? RelocTagPreInstStdCBK
+                             : RelocTagPostInstStdCBK,
+                         false, cbkToAdd.once);
     } else {
       patch.userInstCB.emplace_back(
           std::make_unique<InstCbLambda>(cbkToAdd.lambdaCbk));
-      instrument(patch,
-                 getCallbackGenerator(InstCBLambdaProxy,
-                                      patch.userInstCB.back().get()),
-                 true, cbkToAdd.position, cbkToAdd.priority,
-                 (cbkToAdd.position == PREINST) ? RelocTagPreInstStdCBK
-                                                : RelocTagPostInstStdCBK);
+      instrumentCallback(patch, InstCBLambdaProxy,
+                         patch.userInstCB.back().get(), cbkToAdd.position,
+                         cbkToAdd.priority,
+                         (cbkToAdd.position == PREINST)
+                             ? RelocTagPreInstStdCBK
+                             : RelocTagPostInstStdCBK,
+                         false, cbkToAdd.once);
     }
   }
 
@@ -24,6 +24,7 @@
 
 #include "Patch/PatchUtils.h"
 #include "Patch/Types.h"
+#include "Utility/CallbackSampler.h"
 
 #include "QBDI/Callback.h"
 #include "QBDI/InstAnalysis.h"
@@ -40,6 +41,16 @@ class PatchGenerator;
 using PatchConditionUniquePtr = std::unique_ptr<PatchCondition>;
 using PatchGeneratorUniquePtrVec = std::vector<std::unique_ptr<PatchGenerator>>;
 
+/*! The patchable slot of the callbacks of a rule. The slot is read at each
+ * execution of the instrumentation: the callbacks can be armed, disarmed or
+ * retargeted without clearing the cache.
+ */
+struct CallbackSlot {
+  rword armed;
+  InstCallback cbk;
+  void *data;
+};
+
 /*! An instrumentation rule written in PatchDSL.
  */
 class InstrRule {
@@ -49,9 +60,21 @@ protected:
   // The rule with the lesser priority will be applied first
   int priority;
 
+  // sampling of the callbacks added with instrumentCallback, if enabled
+  std::unique_ptr<CallbackSampler> sampler;
+
+  void copySampler(InstrRule &rule) const;
+
+  // patchable slot of the callbacks added with instrumentCallback, if enabled
+  std::unique_ptr<CallbackSlot> slot;
+
+  void copySlot(InstrRule &rule) const;
+
 public:
   InstrRule(int priority = PRIORITY_DEFAULT) : priority(priority) {}
 
+  InstrRule(const InstrRule &other);
+
   virtual ~InstrRule() = default;
 
   // virtual copy constructor used to duplicate the object
@@ -67,6 +90,34 @@ public:
 
   inline virtual bool changeDataPtr(void *data) { return false; };
 
+  /*! Sample the callbacks of the rule. Enabling the sampling changes the
+   * instrumentation, the cache of the affected range must be cleared. The
+   * following changes of the period are applied without clearing the cache.
+   *
+   * @param[in] period      Call the callback once every period executions.
+   * @param[in] randomized  Randomize each period around the given period.
+   *
+   * @return False if the rule doesn't support the sampling.
+   */
+  inline virtual bool setSampling(uint32_t period, bool randomized) {
+    return false;
+  };
+
+  inline bool isSampled() const { return sampler != nullptr; };
+
+  /*! Arm or disarm the callbacks of the rule through a patchable slot. The
+   * first call changes the instrumentation, the cache of the affected range
+   * must be cleared. The following calls and the changes of the data pointer
+   * are applied without clearing the cache.
+   *
+   * @param[in] enabled  Call the callbacks of the rule.
+   *
+   * @return False if the rule doesn't support the slots.
+   */
+  inline virtual bool setEnabled(bool enabled) { return false; };
+
+  inline bool hasSlot() const { return slot != nullptr; };
+
   /*! Determine wheter this rule have to be apply on this Path and instrument if
    * needed.
    *
@@ -84,12 +135,46 @@ public:
    * @param[in] position    Add the patch before or after the instruction
    * @param[in] priority    The priority of this patch
    * @param[in] tag         The tag for this patch
+   * @param[in] fastCall    Call the callback from the JIT code instead of
+   *                        breaking to the host (with breakToHost)
    */
   void instrument(Patch &patch, const PatchGeneratorUniquePtrVec &patchGen,
                   bool breakToHost, InstPosition position, int priority,
-                  RelocatableInstTag tag) const;
+                  RelocatableInstTag tag, bool fastCall = false) const;
+
+  /*! Add a callback to a patch. The instrumentation is generated by
+   * coalesceCallbacks, with a single break to host for the consecutive
+   * callbacks of a position. When the rule is sampled, the callback has its
+   * own countdown gate and is called by the host. A once callback has its own
+   * break to host, skipped by the JIT code after the first call. When the
+   * rule has a slot, the callback and its data are read from the slot, and
+   * the slot is checked by a gate when the architecture supports it.
+   *
+   * @param[in] patch       The current patch to instrument.
+   * @param[in] cbk         The callback to call
+   * @param[in] data        The data pointer to give to the callback
+   * @param[in] position    Add the callback before or after the instruction
+   * @param[in] priority    The priority of this callback
+   * @param[in] tag         The tag for this callback
+   * @param[in] fastCall    Call the callback from the JIT code instead of
+   *                        breaking to the host
+   * @param[in] once        Only call the callback at the first execution of
+   *                        the patch
+   */
+  void instrumentCallback(Patch &patch, InstCallback cbk, void *data,
+                          InstPosition position, int priority,
+                          RelocatableInstTag tag, bool fastCall = false,
+                          bool once = false) const;
 };
 
+/*! Generate the instrumentation of the callbacks added to a patch by the
+ * InstrRules. The consecutive callbacks with the same position share a single
+ * break to host, where they are called by priority order.
+ *
+ * @param[in] patch   The patch to instrument.
+ */
+void coalesceCallbacks(Patch &patch);
+
 class InstrRuleBasicCBK : public AutoUnique<InstrRule, InstrRuleBasicCBK> {
 
   PatchConditionUniquePtr condition;
@@ -99,6 +184,7 @@ class InstrRuleBasicCBK : public AutoUnique<InstrRule, InstrRuleBasicCBK> {
   RelocatableInstTag tag;
   InstCallback cbk;
   void *data;
+  CallbackType type;
 
 public:
   /*! Allocate a new instrumentation rule with a condition, a list of
@@ -116,11 +202,13 @@ public:
    *                         callback for example).
    * @param[in] priority     Priority of the callback
    * @param[in] tag          A tag for the callback
+   * @param[in] type         The type of the callback
    */
   InstrRuleBasicCBK(PatchConditionUniquePtr &&condition, InstCallback cbk,
                     void *data, InstPosition position, bool breakToHost,
                     int priority = PRIORITY_DEFAULT,
-                    RelocatableInstTag tag = RelocTagInvalid);
+                    RelocatableInstTag tag = RelocTagInvalid,
+                    CallbackType type = CALLBACK_DEFAULT);
 
   ~InstrRuleBasicCBK() override;
 
@@ -143,10 +231,20 @@ public:
 
   bool changeDataPtr(void *data) override;
 
+  bool setSampling(uint32_t period, bool randomized) override;
+
+  bool setEnabled(bool enabled) override;
+
   inline bool tryInstrument(Patch &patch,
                             const LLVMCPU &llvmcpu) const override {
     if (canBeApplied(patch, llvmcpu)) {
-      instrument(patch, patchGen, breakToHost, position, priority, tag);
+      if (breakToHost) {
+        instrumentCallback(patch, cbk, data, position, priority, tag,
+                           (type & CALLBACK_FAST) != 0,
+                           (type & CALLBACK_ONCE) != 0);
+      } else {
+        instrument(patch, patchGen, breakToHost, position, priority, tag);
+      }
       return true;
     }
     return false;
@@ -216,6 +314,165 @@ public:
   }
 };
 
+class InstrRuleMemRangeCBK
+    : public AutoUnique<InstrRule, InstrRuleMemRangeCBK> {
+
+  InstCallback cbk;
+  void *data;
+  InstPosition position;
+  RelocatableInstTag tag;
+  RangeSet<rword> readRanges;
+  RangeSet<rword> writeRanges;
+
+public:
+  /*! Allocate a rule calling a memory gate when an access of an instruction
+   * overlaps a range. The ranges are compared in the JIT code when possible,
+   * otherwise the gate is called for each instruction with an access and must
+   * compare the ranges itself.
+   *
+   * @param[in] cbk          The gate to call
+   * @param[in] data         The data pointer to give to the gate
+   * @param[in] position     Call the gate before or after the instruction
+   * @param[in] readRanges   The ranges compared with the read accesses
+   * @param[in] writeRanges  The ranges compared with the write accesses
+   *                         (POSTINST only)
+   * @param[in] priority     Priority of the gate
+   * @param[in] tag          A tag for the gate
+   */
+  InstrRuleMemRangeCBK(InstCallback cbk, void *data, InstPosition position,
+                       RangeSet<rword> readRanges,
+                       RangeSet<rword> writeRanges,
+                       int priority = PRIORITY_DEFAULT,
+                       RelocatableInstTag tag = RelocTagInvalid);
+
+  ~InstrRuleMemRangeCBK() override;
+
+  std::unique_ptr<InstrRule> clone() const override;
+
+  RangeSet<rword> affectedRange() const override;
+
+  bool changeDataPtr(void *data) override;
+
+  bool tryInstrument(Patch &patch, const LLVMCPU &llvmcpu) const override;
+
+  /*! Check if the gate writes the same JIT code with other ranges. The ranges
+   * are only part of the JIT code when they are compared inline.
+   *
+   * @param[in] readRanges   The new ranges compared with the read accesses
+   * @param[in] writeRanges  The new ranges compared with the write accesses
+   */
+  bool hasSameCode(const RangeSet<rword> &readRanges,
+                   const RangeSet<rword> &writeRanges) const;
+
+  /*! Replace the ranges of the gate. The JIT code already written isn't
+   * updated: hasSameCode must be true for the new ranges.
+   *
+   * @param[in] readRanges   The new ranges compared with the read accesses
+   * @param[in] writeRanges  The new ranges compared with the write accesses
+   */
+  void setRanges(RangeSet<rword> readRanges, RangeSet<rword> writeRanges) {
+    this->readRanges = std::move(readRanges);
+    this->writeRanges = std::move(writeRanges);
+  }
+};
+
+/*! The callback of a predicated callback evaluated by the host
+ */
+struct PredicateCBKData {
+  CallbackPredicate predicate;
+  InstCallback cbk;
+  void *data;
+};
+
+class InstrRulePredicateCBK
+    : public AutoUnique<InstrRule, InstrRulePredicateCBK> {
+
+  PatchConditionUniquePtr condition;
+  InstPosition position;
+  RelocatableInstTag tag;
+  // allocated to keep its address when the predicate is evaluated by the host
+  std::unique_ptr<PredicateCBKData> cbkData;
+
+public:
+  /*! Allocate a rule calling a callback when a predicate holds. The predicate
+   * is evaluated in the JIT code when possible, otherwise by the host before
+   * the callback.
+   *
+   * @param[in] condition  A PatchCondition which determine wheter or not this
+   *                       PatchRule applies.
+   * @param[in] predicate  The predicate of the callback
+   * @param[in] cbk        The callback to call
+   * @param[in] data       The data pointer to give to the callback
+   * @param[in] position   Call the callback before or after the instruction
+   * @param[in] priority   Priority of the callback
+   * @param[in] tag        A tag for the callback
+   */
+  InstrRulePredicateCBK(PatchConditionUniquePtr &&condition,
+                        const CallbackPredicate &predicate, InstCallback cbk,
+                        void *data, InstPosition position,
+                        int priority = PRIORITY_DEFAULT,
+                        RelocatableInstTag tag = RelocTagInvalid);
+
+  ~InstrRulePredicateCBK() override;
+
+  std::unique_ptr<InstrRule> clone() const override;
+
+  RangeSet<rword> affectedRange() const override;
+
+  bool changeDataPtr(void *data) override;
+
+  bool tryInstrument(Patch &patch, const LLVMCPU &llvmcpu) const override;
+};
+
+/*! The operations of an inline instrumentation and the callback of its
+ * INLINE_CALL
+ */
+struct InlineCBKData {
+  std::vector<InlineOp> ops;
+  InstCallback cbk;
+  void *data;
+};
+
+class InstrRuleInlineCBK : public AutoUnique<InstrRule, InstrRuleInlineCBK> {
+
+  PatchConditionUniquePtr condition;
+  InstPosition position;
+  RelocatableInstTag tag;
+  // allocated to keep its address when the operations are interpreted by the
+  // host
+  std::unique_ptr<InlineCBKData> cbkData;
+
+public:
+  /*! Allocate a rule running the operations of an inline instrumentation.
+   * The operations are compiled in the JIT code when possible, otherwise they
+   * are interpreted by the host.
+   *
+   * @param[in] condition  A PatchCondition which determine wheter or not this
+   *                       PatchRule applies.
+   * @param[in] ops        The operations of the instrumentation
+   * @param[in] cbk        The callback of INLINE_CALL
+   * @param[in] data       The data pointer to give to the callback
+   * @param[in] position   Run the operations before or after the instruction
+   * @param[in] priority   Priority of the instrumentation
+   * @param[in] tag        A tag for the instrumentation
+   */
+  InstrRuleInlineCBK(PatchConditionUniquePtr &&condition,
+                     const std::vector<InlineOp> &ops, InstCallback cbk,
+                     void *data, InstPosition position,
+                     int priority = PRIORITY_DEFAULT,
+                     RelocatableInstTag tag = RelocTagInvalid);
+
+  ~InstrRuleInlineCBK() override;
+
+  std::unique_ptr<InstrRule> clone() const override;
+
+  RangeSet<rword> affectedRange() const override;
+
+  bool changeDataPtr(void *data) override;
+
+  bool tryInstrument(Patch &patch, const LLVMCPU &llvmcpu) const override;
+};
+
 class InstrRuleUser : public AutoClone<InstrRule, InstrRuleUser> {
 
   InstrRuleCallback cbk;
@@ -242,6 +499,8 @@ public:
 
   inline RangeSet<rword> affectedRange() const override { return range; }
 
+  bool setSampling(uint32_t period, bool randomized) override;
+
   bool tryInstrument(Patch &patch, const LLVMCPU &llvmcpu) const override;
 };
 
@@ -19,6 +19,7 @@
 #define INSTRRULES_H
 
 #include <memory>
+#include <stdint.h>
 #include <vector>
 
 #include "Patch/Types.h"
@@ -30,6 +31,20 @@ class Patch;
 class PatchGenerator;
 class RelocatableInst;
 
+/*! AFL-compatible edge coverage. The JIT code increments the counter of the
+ * edge (prev ^ cur) in the bitmap and stores (cur >> 1) in prev at the
+ * beginning of each basic block. Each Engine has its own CoverageBitmap, even
+ * when several VMs write in the same bitmap.
+ */
+struct CoverageBitmap {
+  // The previous location. It points to the shared Context of the
+  // ExecBlockManager with OPT_ENABLE_SHARED_CONTEXT, and to hostPrev otherwise.
+  rword *prev;
+  rword hostPrev;
+  uint8_t *bitmap;
+  rword mask;
+};
+
 /*
  * Setup a user callback in the host state
  *
@@ -43,6 +58,61 @@ getCallbackGenerator(InstCallback cbk, void *data);
 
 std::vector<std::unique_ptr<RelocatableInst>>
 getBreakToHost(Reg temp, const Patch &patch, bool restore);
+
+/*
+ * Call the user callback set in the host state from the JIT code, and resume
+ * the execution after the call. Fallback to a break to host on the
+ * architectures without fast callbacks.
+ */
+std::vector<std::unique_ptr<RelocatableInst>>
+getFastCallToHost(Reg temp, const Patch &patch, bool restore);
+
+/*
+ * Call a user callback when a predicate holds. The predicate is evaluated in
+ * the JIT code. Return an empty vector if the predicate must be evaluated by
+ * the host, on the architectures without inline predicates or when a value
+ * isn't available in the JIT code.
+ */
+std::vector<std::unique_ptr<PatchGenerator>>
+getPredicateGate(const Patch &patch, InstPosition position,
+                 const CallbackPredicate &predicate, InstCallback cbk,
+                 void *data);
+
+/*
+ * Subtract step from a countdown and call a user callback when it reaches zero
+ * or wraps. The countdown is decremented in the JIT code and must be reloaded
+ * by the callback. Return an empty vector if the countdown must be
+ * decremented by the host.
+ */
+std::vector<std::unique_ptr<PatchGenerator>>
+getCountdownGate(const Patch &patch, InstPosition position, rword *countdown,
+                 rword step, InstCallback cbk, void *data);
+
+/*
+ * Call a user callback when a slot is armed. The slot is read in the JIT code.
+ * Return an empty vector if the slot must be read by the host.
+ */
+std::vector<std::unique_ptr<PatchGenerator>>
+getSlotGate(const Patch &patch, InstPosition position, rword *armed,
+            InstCallback cbk, void *data);
+
+/*
+ * Increment the edge of the basic block that begins with the patch in the
+ * bitmap of the edge coverage. Return an empty vector on the architectures
+ * without inline edge coverage.
+ */
+std::vector<std::unique_ptr<PatchGenerator>>
+getCoverageEdge(const Patch &patch, CoverageBitmap *coverage);
+
+/*
+ * Jump over the instrumentation of a once callback after its first call. The
+ * target of the jump is a once slot of the data block, updated by the
+ * ExecBlock when the callback is called. Return an empty vector on the
+ * architectures without once slots.
+ */
+std::vector<std::unique_ptr<RelocatableInst>>
+getOnceSkip(const Patch &patch,
+            const std::vector<std::unique_ptr<RelocatableInst>> &stub);
 } // namespace QBDI
 
 #endif
@@ -0,0 +1,47 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2025 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stddef.h>
+
+#include "Patch/MemoryAccess.h"
+#include "Utility/LogSys.h"
+
+#include "QBDI/Callback.h"
+#include "QBDI/State.h"
+
+namespace QBDI {
+
+void flushMemoryTrace(VMInstanceRef vm, MemoryTrace &trace) {
+  size_t pending = trace.size - trace.remaining;
+  QBDI_REQUIRE_ACTION(trace.cursor == trace.buffer + pending, return);
+
+  // the buffer can be reused by the callback
+  trace.cursor = trace.buffer;
+  trace.remaining = trace.size;
+  if (pending > 0) {
+    QBDI_DEBUG("Flush {} accesses of the memory trace", pending);
+    trace.cbk(vm, trace.buffer, pending, trace.data);
+  }
+}
+
+VMAction memoryTraceFullCB(VMInstanceRef vm, GPRState *gprState,
+                           FPRState *fprState, void *data) {
+  flushMemoryTrace(vm, *static_cast<MemoryTrace *>(data));
+  return VMAction::CONTINUE;
+}
+
+} // namespace QBDI
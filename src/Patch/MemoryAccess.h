@@ -21,11 +21,29 @@
 #include "Patch/InstrRule.h"
 
 #include "QBDI/Callback.h"
+#include "QBDI/Range.h"
 
 namespace QBDI {
 
 class ExecBlock;
 class LLVMCPU;
+class Patch;
+
+// Maximal number of ranges compared in the JIT code by a memory gate
+static constexpr size_t MEMORY_GATE_INLINE_RANGES = 4;
+
+/*! Buffer of a memory trace. The cursor and the number of free accesses are
+ * updated by the JIT code, and the buffer is flushed with a break to host
+ * when it is full.
+ */
+struct MemoryTrace {
+  MemoryAccess *cursor;
+  rword remaining;
+  MemoryAccess *buffer;
+  size_t size;
+  MemoryTraceCallback cbk;
+  void *data;
+};
 
 void analyseMemoryAccess(const ExecBlock &currentExecBlock, uint16_t instID,
                          bool afterInst, std::vector<MemoryAccess> &dest);
@@ -34,6 +52,73 @@ std::vector<std::unique_ptr<InstrRule>> getInstrRuleMemAccessRead();
 
 std::vector<std::unique_ptr<InstrRule>> getInstrRuleMemAccessWrite();
 
+/*! Get the rules that write the memory accesses in a memory trace.
+ *
+ * @param[in] trace  The memory trace, must outlive the rules and the cache.
+ *
+ * @return The rules, or an empty vector if the memory trace isn't supported.
+ */
+std::vector<std::unique_ptr<InstrRule>>
+getInstrRuleMemoryTrace(MemoryTrace *trace);
+
+/*! Get the generators of a memory gate that compares the accesses of an
+ * instruction with the ranges in the JIT code, and breaks to the host only
+ * when an access overlaps a range. The address shadows of the accesses must
+ * have been written by the rules of getInstrRuleMemAccessRead and
+ * getInstrRuleMemAccessWrite.
+ *
+ * @param[in] patch        The patch of the instruction.
+ * @param[in] llvmcpu      LLVMCPU object
+ * @param[in] position     The position of the gate.
+ * @param[in] readRanges   The ranges compared with the read accesses.
+ * @param[in] writeRanges  The ranges compared with the write accesses
+ *                         (POSTINST only).
+ * @param[in] cbk          The gate called on a hit.
+ * @param[in] data         The data pointer to give to the gate.
+ *
+ * @return The generators, or an empty vector if the comparison can't be done
+ *         in the JIT code and the gate must be called for each instruction.
+ */
+PatchGeneratorUniquePtrVec
+getMemRangeGate(const Patch &patch, const LLVMCPU &llvmcpu,
+                InstPosition position, const RangeSet<rword> &readRanges,
+                const RangeSet<rword> &writeRanges, InstCallback cbk,
+                void *data);
+
+/*! Get the generators of an inline instrumentation compiled in the JIT code.
+ * The address shadows of the accesses loaded by the operations must have been
+ * written by the rules of getInstrRuleMemAccessRead and
+ * getInstrRuleMemAccessWrite.
+ *
+ * @param[in] patch     The patch of the instruction.
+ * @param[in] llvmcpu   LLVMCPU object
+ * @param[in] position  The position of the instrumentation.
+ * @param[in] ops       The operations, without INLINE_LOAD_OPERAND.
+ * @param[in] cbk       The callback of INLINE_CALL.
+ * @param[in] data      The data pointer to give to the callback.
+ *
+ * @return The generators, or an empty vector if the operations must be
+ *         interpreted by the host.
+ */
+PatchGeneratorUniquePtrVec
+getInlineGate(const Patch &patch, const LLVMCPU &llvmcpu,
+              InstPosition position, const std::vector<InlineOp> &ops,
+              InstCallback cbk, void *data);
+
+/*! Call the callback of a memory trace with the pending accesses, and reset
+ * the cursor at the begin of the buffer.
+ *
+ * @param[in] vm     The VM instance given to the callback.
+ * @param[in] trace  The memory trace to flush.
+ */
+void flushMemoryTrace(VMInstanceRef vm, MemoryTrace &trace);
+
+/*! InstCallback called by the JIT code when the buffer of a memory trace is
+ * full. The data is the MemoryTrace.
+ */
+VMAction memoryTraceFullCB(VMInstanceRef vm, GPRState *gprState,
+                           FPRState *fprState, void *data);
+
 } // namespace QBDI
 
 #endif
@@ -95,11 +95,22 @@ void Patch::insertAt(unsigned position, RelocatableInst::UniquePtrVec v) {
   }
 }
 
+void Patch::insertAtBegin(RelocatableInst::UniquePtrVec v) {
+  QBDI_REQUIRE(finalize);
+  if (not v.empty()) {
+    metadata.patchSize += v.size();
+    patchGenFlagsOffset += v.size();
+    // the first instruction of a finalized patch is the tag
+    // RelocTagPatchBegin
+    std::move(v.begin(), v.end(), std::inserter(insts, insts.begin() + 1));
+  }
+}
+
 void Patch::addInstsPatch(InstPosition position, int priority,
                           std::vector<std::unique_ptr<RelocatableInst>> v) {
   QBDI_REQUIRE(not finalize);
 
-  InstrPatch el{position, priority, std::move(v)};
+  InstrPatch el{position, priority, std::move(v), {}};
 
   auto it = std::upper_bound(instsPatchs.begin(), instsPatchs.end(), el,
                              [](const InstrPatch &a, const InstrPatch &b) {
@@ -108,8 +119,59 @@ void Patch::addInstsPatch(InstPosition position, int priority,
   instsPatchs.insert(it, std::move(el));
 }
 
+void Patch::addCallbackPatch(InstPosition position, int priority,
+                             const InstrCallback &callback) {
+  QBDI_REQUIRE(not finalize);
+
+  InstrPatch el{position, priority, {}, {callback}};
+
+  auto it = std::upper_bound(instsPatchs.begin(), instsPatchs.end(), el,
+                             [](const InstrPatch &a, const InstrPatch &b) {
+                               return a.priority > b.priority;
+                             });
+  instsPatchs.insert(it, std::move(el));
+}
+
+void Patch::coalesceCallbacks(
+    const std::function<RelocatableInst::UniquePtrVec(
+        InstPosition, const std::vector<InstrCallback> &)> &generator) {
+  QBDI_REQUIRE(not finalize);
+
+  // The PREINST and POSTINST instrumentations are interleaved in instsPatchs.
+  // A callback is merged in the previous instrumentation of its position if
+  // this one is also a callback with the same tag.
+  std::vector<InstrPatch> merged;
+  std::map<InstPosition, size_t> lastIndex;
+  for (InstrPatch &el : instsPatchs) {
+    auto last = lastIndex.find(el.position);
+    if (not el.callbacks.empty() and last != lastIndex.end()) {
+      InstrPatch &prev = merged[last->second];
+      if (not prev.callbacks.empty() and
+          prev.callbacks.front().tag == el.callbacks.front().tag) {
+        std::move(el.callbacks.begin(), el.callbacks.end(),
+                  std::back_inserter(prev.callbacks));
+        continue;
+      }
+    }
+    lastIndex[el.position] = merged.size();
+    merged.push_back(std::move(el));
+  }
+
+  for (InstrPatch &el : merged) {
+    if (not el.callbacks.empty()) {
+      el.insts = generator(el.position, el.callbacks);
+      el.callbacks.clear();
+    }
+  }
+  instsPatchs.swap(merged);
+}
+
 void Patch::finalizeInstsPatch() {
   QBDI_REQUIRE(not finalize);
+  QBDI_REQUIRE_ABORT(
+      std::all_of(instsPatchs.begin(), instsPatchs.end(),
+                  [](const InstrPatch &el) { return el.callbacks.empty(); }),
+      "Callbacks not coalesced {}", *this);
   // avoid to used prepend
   RelocatableInst::UniquePtrVec prePatch;
   // add the tag RelocTagPatchInstBegin
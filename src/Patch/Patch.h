@@ -19,6 +19,7 @@
 #define PATCH_H
 
 #include <array>
+#include <functional>
 #include <map>
 #include <memory>
 #include <set>
@@ -39,10 +40,19 @@ namespace QBDI {
 class LLVMCPU;
 class RelocatableInst;
 
+struct InstrCallback {
+  InstCallback cbk;
+  void *data;
+  RelocatableInstTag tag;
+  bool fastCall;
+};
+
 struct InstrPatch {
   InstPosition position;
   int priority;
   std::vector<std::unique_ptr<RelocatableInst>> insts;
+  // callbacks waiting for their break to host (see coalesceCallbacks)
+  std::vector<InstrCallback> callbacks;
 };
 
 class Patch {
@@ -64,6 +74,8 @@ public:
   std::set<RegLLVM> tempReg;
   const LLVMCPU *llvmcpu;
   bool finalize = false;
+  // The patch calls a callback from the JIT code (CALLBACK_FAST)
+  bool fastCall = false;
 
   using Vec = std::vector<Patch>;
 
@@ -86,9 +98,29 @@ public:
   void insertAt(unsigned position,
                 std::vector<std::unique_ptr<RelocatableInst>> v);
 
+  /*! Insert instructions at the beginning of a finalized patch, after the tag
+   * RelocTagPatchBegin. They are executed at each entry in the patch.
+   *
+   * @param[in] v  The instructions to insert
+   */
+  void insertAtBegin(std::vector<std::unique_ptr<RelocatableInst>> v);
+
   void addInstsPatch(InstPosition position, int priority,
                      std::vector<std::unique_ptr<RelocatableInst>> v);
 
+  void addCallbackPatch(InstPosition position, int priority,
+                        const InstrCallback &callback);
+
+  /*! Merge the consecutive callbacks with the same position and tag. Each
+   * group of callbacks is given once to the generator, that returns the
+   * instrumentation of the group.
+   *
+   * @param[in] generator  The generator of the instrumentation of a group
+   */
+  void coalesceCallbacks(
+      const std::function<std::vector<std::unique_ptr<RelocatableInst>>(
+          InstPosition, const std::vector<InstrCallback> &)> &generator);
+
   void finalizeInstsPatch();
 };
 
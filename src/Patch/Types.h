@@ -151,6 +151,13 @@ enum ShadowReservedTag : uint16_t {
   MEMORY_TAG_BEGIN = 0xffe0,
   MEMORY_TAG_END = 0xfff0,
 
+  // Block chaining Tag
+  CHAIN_EXIT_TAG = 0xfff3,
+
+  // Once callback Tags
+  ONCE_SLOT_TAG = 0xfff1,
+  ONCE_SKIP_TAG = 0xfff2,
+
   // also defined in Callback.h
   Untagged = 0xffff,
 };
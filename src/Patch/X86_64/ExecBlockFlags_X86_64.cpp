@@ -34,17 +34,26 @@ namespace QBDI {
 namespace {
 
 struct ExecBlockFlagsArray {
-  uint8_t arr[llvm::X86::NUM_TARGET_REGS];
+  uint32_t arr[llvm::X86::NUM_TARGET_REGS];
 
   constexpr ExecBlockFlagsArray() : arr() {
     for (unsigned i = 0; i < llvm::X86::NUM_TARGET_REGS; i++) {
-      if (llvm::X86::YMM0 <= i && i <= llvm::X86::YMM15) {
-        arr[i] = ExecBlockFlags::needAVX | ExecBlockFlags::needFPU;
-      } else if ((llvm::X86::XMM0 <= i && i <= llvm::X86::XMM15) ||
-                 (llvm::X86::ST0 <= i && i <= llvm::X86::ST7) ||
+      if ((llvm::X86::YMM0 <= i && i <= llvm::X86::YMM31) ||
+          (llvm::X86::ZMM0 <= i && i <= llvm::X86::ZMM31) ||
+          (llvm::X86::XMM16 <= i && i <= llvm::X86::XMM31) ||
+          (llvm::X86::K0 <= i && i <= llvm::X86::K7)) {
+        arr[i] = ExecBlockFlags::needAVX | ExecBlockFlags::needFullFPU |
+                 ExecBlockFlags::needFPU;
+      } else if (llvm::X86::XMM0 <= i && i <= llvm::X86::XMM15) {
+        arr[i] = (ExecBlockFlags::needXMM0 << (i - llvm::X86::XMM0)) |
+                 ExecBlockFlags::needFPU;
+      } else if (llvm::X86::MXCSR == i) {
+        // MXCSR is switched with the XMM registers
+        arr[i] = ExecBlockFlags::needFPU;
+      } else if ((llvm::X86::ST0 <= i && i <= llvm::X86::ST7) ||
                  (llvm::X86::MM0 <= i && i <= llvm::X86::MM7) ||
                  llvm::X86::FPSW == i || llvm::X86::FPCW == i) {
-        arr[i] = ExecBlockFlags::needFPU;
+        arr[i] = ExecBlockFlags::needFullFPU | ExecBlockFlags::needFPU;
       } else if (i == llvm::X86::FS || i == llvm::X86::GS) {
         arr[i] = ExecBlockFlags::needFSGS;
       } else {
@@ -53,7 +62,7 @@ struct ExecBlockFlagsArray {
     }
   }
 
-  inline uint8_t get(RegLLVM reg_) const {
+  inline uint32_t get(RegLLVM reg_) const {
     size_t reg = reg_.getValue();
     if (reg < llvm::X86::NUM_TARGET_REGS)
       return arr[reg];
@@ -65,16 +74,17 @@ struct ExecBlockFlagsArray {
 
 } // namespace
 
-const uint8_t defaultExecuteFlags = ExecBlockFlags::needAVX |
-                                    ExecBlockFlags::needFPU |
-                                    ExecBlockFlags::needFSGS;
+const uint32_t defaultExecuteFlags =
+    ExecBlockFlags::needAVX | ExecBlockFlags::needFPU |
+    ExecBlockFlags::needFSGS | ExecBlockFlags::needFullFPU |
+    ExecBlockFlags::needAllXMM;
 
-uint8_t getExecBlockFlags(const llvm::MCInst &inst,
-                          const QBDI::LLVMCPU &llvmcpu) {
+uint32_t getExecBlockFlags(const llvm::MCInst &inst,
+                           const QBDI::LLVMCPU &llvmcpu) {
   static constexpr ExecBlockFlagsArray cache;
 
   const llvm::MCInstrDesc &desc = llvmcpu.getMCII().get(inst.getOpcode());
-  uint8_t flags = 0;
+  uint32_t flags = 0;
 
   // register flag
   for (size_t i = 0; i < inst.getNumOperands(); i++) {
@@ -95,12 +105,46 @@ uint8_t getExecBlockFlags(const llvm::MCInst &inst,
   if ((desc.TSFlags & llvm::X86II::FPTypeMask) != 0) {
     if ((desc.TSFlags & llvm::X86II::FPTypeMask) != llvm::X86II::SpecialFP or
         ((not desc.isReturn()) and (not desc.isCall()))) {
-      flags |= ExecBlockFlags::needFPU;
+      flags |= ExecBlockFlags::needFullFPU | ExecBlockFlags::needFPU;
     }
   }
 
+  // instructions that read or write the whole FPU state
+  switch (inst.getOpcode()) {
+    case llvm::X86::FXSAVE:
+    case llvm::X86::FXSAVE64:
+    case llvm::X86::FXRSTOR:
+    case llvm::X86::FXRSTOR64:
+    case llvm::X86::XSAVE:
+    case llvm::X86::XSAVE64:
+    case llvm::X86::XSAVEC:
+    case llvm::X86::XSAVEC64:
+    case llvm::X86::XSAVEOPT:
+    case llvm::X86::XSAVEOPT64:
+    case llvm::X86::XRSTOR:
+    case llvm::X86::XRSTOR64:
+      flags |= ExecBlockFlags::needAVX | ExecBlockFlags::needFPU;
+      break;
+    default:
+      break;
+  }
+
+  // VEX and EVEX instructions on the XMM registers clear the upper bits of
+  // the destination register
+  if ((flags & ExecBlockFlags::needFPU) != 0 and
+      ((desc.TSFlags & llvm::X86II::EncodingMask) == llvm::X86II::VEX or
+       (desc.TSFlags & llvm::X86II::EncodingMask) == llvm::X86II::EVEX)) {
+    flags |= ExecBlockFlags::needAVX;
+  }
+
   if ((flags & ExecBlockFlags::needAVX) != 0) {
-    flags |= ExecBlockFlags::needFPU;
+    flags |= ExecBlockFlags::needFullFPU | ExecBlockFlags::needFPU;
+  }
+
+  // The full switch includes all the XMM registers. A sequence with the
+  // full switch can be chained to a sequence with only some XMM registers.
+  if ((flags & ExecBlockFlags::needFullFPU) != 0) {
+    flags |= ExecBlockFlags::needAllXMM;
   }
 
   // enable needFSGS for SYSCALL
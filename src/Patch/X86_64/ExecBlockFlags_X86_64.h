@@ -22,10 +22,17 @@
 
 namespace QBDI {
 
-typedef enum : uint8_t {
+typedef enum : uint32_t {
   needAVX = 1 << 0,
+  // the sequence uses a FPU register, the host control words are saved
   needFPU = 1 << 1,
   needFSGS = 1 << 2,
+  // the whole FPU state is switched (x87, MMX, AVX or untracked state).
+  // Otherwise, only the XMM registers of the sequence and MXCSR are switched.
+  needFullFPU = 1 << 3,
+  // one bit by XMM register, needXMM0 << n for XMMn
+  needXMM0 = 1 << 8,
+  needAllXMM = 0xffff << 8,
 } ExecBlockFlags;
 
 }
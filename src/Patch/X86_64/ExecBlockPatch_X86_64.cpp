@@ -26,6 +26,7 @@
 #include "QBDI/State.h"
 #include "Engine/LLVMCPU.h"
 #include "ExecBlock/Context.h"
+#include "ExecBlock/X86_64/XSave_X86_64.h"
 #include "Patch/ExecBlockPatch.h"
 #include "Patch/PatchGenerator.h"
 #include "Patch/PatchUtils.h"
@@ -38,6 +39,139 @@
 
 namespace QBDI {
 
+namespace {
+
+static constexpr unsigned NUM_XMM = (is_x86_64) ? 16 : 8;
+
+// Switch the FPR with a XSAVE instruction. EDX:EAX selects the components of
+// the XSAVE area, the AVX and AVX-512 states are only switched for the
+// sequences that need them.
+RelocatableInst::UniquePtrVec
+getXSaveSwitch(RelocatableInst::UniquePtr xsaveInst, const LLVMCPU &llvmcpu,
+               uint64_t mask) {
+  const uint64_t legacyMask = mask & (XSaveX87 | XSaveSSE);
+  RelocatableInst::UniquePtrVec xsave;
+
+  if (not llvmcpu.hasOptions(Options::OPT_DISABLE_OPTIONAL_FPR) and
+      mask != legacyMask) {
+    xsave.push_back(Test(Reg(0), ExecBlockFlags::needAVX));
+    xsave.push_back(Mov32ri(llvm::X86::EAX, mask & 0xffffffff));
+    xsave.push_back(Jne(5 + 4));
+    xsave.push_back(Mov32ri(llvm::X86::EAX, legacyMask));
+  } else {
+    xsave.push_back(Mov32ri(llvm::X86::EAX, mask & 0xffffffff));
+  }
+  xsave.push_back(Mov32ri(llvm::X86::EDX, mask >> 32));
+  xsave.push_back(std::move(xsaveInst));
+
+  return xsave;
+}
+
+// Switch the FPR with FXSAVE, and the upper halves of the YMM registers with
+// VINSERTF128 and VEXTRACTF128
+RelocatableInst::UniquePtrVec getFXSaveSwitch(const LLVMCPU &llvmcpu,
+                                              bool restore) {
+  RelocatableInst::UniquePtrVec fxsave;
+
+  if (restore) {
+    fxsave.push_back(Fxrstor(Offset(offsetof(Context, fprState))));
+  } else {
+    fxsave.push_back(Fxsave(Offset(offsetof(Context, fprState))));
+  }
+  if (isHostCPUFeaturePresent("avx")) {
+    QBDI_DEBUG("AVX support enabled in guest context switches");
+    // don't switch if not needed
+    if (not llvmcpu.hasOptions(Options::OPT_DISABLE_OPTIONAL_FPR)) {
+      fxsave.push_back(Test(Reg(0), ExecBlockFlags::needAVX));
+      fxsave.push_back(Je(NUM_XMM * 10 + 4));
+    }
+    for (unsigned i = 0; i < NUM_XMM; i++) {
+      Offset offset(offsetof(Context, fprState) + offsetof(FPRState, ymm0) +
+                    16 * i);
+      if (restore) {
+        fxsave.push_back(Vinsertf128(llvm::X86::YMM0 + i, offset, 1));
+      } else {
+        fxsave.push_back(Vextractf128(offset, llvm::X86::YMM0 + i, 1));
+      }
+    }
+    // target je needAVX
+  }
+  return fxsave;
+}
+
+// Switch only the XMM registers used by the sequence, and MXCSR. The other
+// registers are not modified by the sequence and keep their value in the
+// FPRState.
+RelocatableInst::UniquePtrVec getXMMSwitch(const LLVMCPU &llvmcpu,
+                                           bool restore) {
+  RelocatableInst::UniquePtrVec xmm;
+
+  if (restore) {
+    xmm.push_back(Ldmxcsr(Offset(offsetof(Context, fprState) +
+                                 offsetof(FPRState, mxcsr))));
+  } else {
+    xmm.push_back(Stmxcsr(Offset(offsetof(Context, fprState) +
+                                 offsetof(FPRState, mxcsr))));
+  }
+  for (unsigned i = 0; i < NUM_XMM; i++) {
+    Offset offset(offsetof(Context, fprState) + offsetof(FPRState, xmm0) +
+                  16 * i);
+    RelocatableInst::UniquePtr mov;
+    if (restore) {
+      mov = Movupsrm(llvm::X86::XMM0 + i, offset);
+    } else {
+      mov = Movupsmr(offset, llvm::X86::XMM0 + i);
+    }
+    xmm.push_back(Test(Reg(0), ExecBlockFlags::needXMM0 << i));
+    xmm.push_back(Je(mov->getSize(llvmcpu) + 4));
+    xmm.push_back(std::move(mov));
+    // target je needXMMn
+  }
+  return xmm;
+}
+
+// Append the FPR context switch. The full switch is done for the sequences
+// with needFullFPU, the switch of the XMM registers for the other sequences
+// that use a FPU register.
+void appendFPRSwitch(RelocatableInst::UniquePtrVec &vec,
+                     RelocatableInst::UniquePtrVec fullSwitch,
+                     RelocatableInst::UniquePtrVec xmmSwitch,
+                     const LLVMCPU &llvmcpu) {
+  if (llvmcpu.hasOptions(Options::OPT_DISABLE_OPTIONAL_FPR)) {
+    append(vec, std::move(fullSwitch));
+    return;
+  }
+  RelocatableInst::UniquePtrVec xmmBlock;
+  uint32_t xmmSize = 0;
+  for (const auto &inst : xmmSwitch) {
+    xmmSize += inst->getSize(llvmcpu);
+  }
+  xmmBlock.push_back(Test(Reg(0), ExecBlockFlags::needFPU));
+  xmmBlock.push_back(Je(xmmSize + 4));
+  append(xmmBlock, std::move(xmmSwitch));
+
+  uint32_t fullSize = 0;
+  for (const auto &inst : fullSwitch) {
+    fullSize += inst->getSize(llvmcpu);
+  }
+  uint32_t xmmBlockSize = 0;
+  for (const auto &inst : xmmBlock) {
+    xmmBlockSize += inst->getSize(llvmcpu);
+  }
+  append(vec,
+         LoadReg(Reg(0), Offset(offsetof(Context, hostState.executeFlags)))
+             .genReloc(llvmcpu));
+  vec.push_back(Test(Reg(0), ExecBlockFlags::needFullFPU));
+  vec.push_back(Je(fullSize + 5 + 4));
+  append(vec, std::move(fullSwitch));
+  vec.push_back(Jmp(xmmBlockSize + 4));
+  // target je needFullFPU
+  append(vec, std::move(xmmBlock));
+  // target je needFPU and jmp
+}
+
+} // namespace
+
 RelocatableInst::UniquePtrVec getExecBlockPrologue(const LLVMCPU &llvmcpu) {
   RelocatableInst::UniquePtrVec prologue;
 
@@ -46,77 +180,17 @@ RelocatableInst::UniquePtrVec getExecBlockPrologue(const LLVMCPU &llvmcpu) {
                        .genReloc(llvmcpu));
   // Restore FPR
   if (not llvmcpu.hasOptions(Options::OPT_DISABLE_FPR)) {
-    if (not llvmcpu.hasOptions(Options::OPT_DISABLE_OPTIONAL_FPR)) {
-      append(prologue,
-             LoadReg(Reg(0), Offset(offsetof(Context, hostState.executeFlags)))
-                 .genReloc(llvmcpu));
-      prologue.push_back(Test(Reg(0), ExecBlockFlags::needFPU));
-      prologue.push_back(Je(7 + 4));
-    }
-    prologue.push_back(Fxrstor(Offset(offsetof(Context, fprState))));
-    // target je needFPU
-    if (isHostCPUFeaturePresent("avx")) {
-      QBDI_DEBUG("AVX support enabled in guest context switches");
-      // don't restore if not needed
-      if (not llvmcpu.hasOptions(Options::OPT_DISABLE_OPTIONAL_FPR)) {
-        prologue.push_back(Test(Reg(0), ExecBlockFlags::needAVX));
-        if constexpr (is_x86_64)
-          prologue.push_back(Je(16 * 10 + 4));
-        else
-          prologue.push_back(Je(8 * 10 + 4));
-      }
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM0,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm0)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM1,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm1)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM2,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm2)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM3,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm3)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM4,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm4)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM5,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm5)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM6,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm6)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM7,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm7)), 1));
-#if defined(QBDI_ARCH_X86_64)
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM8,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm8)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM9,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm9)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM10,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm10)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM11,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm11)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM12,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm12)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM13,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm13)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM14,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm14)), 1));
-      prologue.push_back(Vinsertf128(
-          llvm::X86::YMM15,
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm15)), 1));
-#endif // QBDI_ARCH_X86_64
-       // target je needAVX
+    RelocatableInst::UniquePtrVec fullSwitch;
+    if (getXSaveMask() != 0) {
+      QBDI_DEBUG("XSAVE support enabled in guest context switches (0x{:x})",
+                 getXSaveMask());
+      fullSwitch = getXSaveSwitch(Xrstor(Offset(offsetof(Context, fprState))),
+                                  llvmcpu, getXSaveMask());
+    } else {
+      fullSwitch = getFXSaveSwitch(llvmcpu, true);
     }
+    appendFPRSwitch(prologue, std::move(fullSwitch),
+                    getXMMSwitch(llvmcpu, true), llvmcpu);
   }
 #if defined(QBDI_ARCH_X86_64)
   // if enable FS GS
@@ -200,77 +274,19 @@ RelocatableInst::UniquePtrVec getExecBlockEpilogue(const LLVMCPU &llvmcpu) {
 #endif // QBDI_ARCH_X86_64
   // Save FPR
   if (not llvmcpu.hasOptions(Options::OPT_DISABLE_FPR)) {
-    if (not llvmcpu.hasOptions(Options::OPT_DISABLE_OPTIONAL_FPR)) {
-      append(epilogue,
-             LoadReg(Reg(0), Offset(offsetof(Context, hostState.executeFlags)))
-                 .genReloc(llvmcpu));
-      epilogue.push_back(Test(Reg(0), ExecBlockFlags::needFPU));
-      epilogue.push_back(Je(7 + 4));
-    }
-    epilogue.push_back(Fxsave(Offset(offsetof(Context, fprState))));
-    // target je needFPU
-    if (isHostCPUFeaturePresent("avx")) {
-      QBDI_DEBUG("AVX support enabled in guest context switches");
-      // don't save if not needed
-      if (not llvmcpu.hasOptions(Options::OPT_DISABLE_OPTIONAL_FPR)) {
-        epilogue.push_back(Test(Reg(0), ExecBlockFlags::needAVX));
-        if constexpr (is_x86_64)
-          epilogue.push_back(Je(16 * 10 + 4));
-        else
-          epilogue.push_back(Je(8 * 10 + 4));
-      }
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm0)),
-          llvm::X86::YMM0, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm1)),
-          llvm::X86::YMM1, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm2)),
-          llvm::X86::YMM2, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm3)),
-          llvm::X86::YMM3, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm4)),
-          llvm::X86::YMM4, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm5)),
-          llvm::X86::YMM5, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm6)),
-          llvm::X86::YMM6, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm7)),
-          llvm::X86::YMM7, 1));
-#if defined(QBDI_ARCH_X86_64)
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm8)),
-          llvm::X86::YMM8, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm9)),
-          llvm::X86::YMM9, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm10)),
-          llvm::X86::YMM10, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm11)),
-          llvm::X86::YMM11, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm12)),
-          llvm::X86::YMM12, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm13)),
-          llvm::X86::YMM13, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm14)),
-          llvm::X86::YMM14, 1));
-      epilogue.push_back(Vextractf128(
-          Offset(offsetof(Context, fprState) + offsetof(FPRState, ymm15)),
-          llvm::X86::YMM15, 1));
-#endif // QBDI_ARCH_X86_64
-       // target je needAVX
+    RelocatableInst::UniquePtrVec fullSwitch;
+    if (getXSaveMask() != 0 and isHostCPUFeaturePresent("xsaveopt")) {
+      fullSwitch =
+          getXSaveSwitch(Xsaveopt(Offset(offsetof(Context, fprState))),
+                         llvmcpu, getXSaveMask());
+    } else if (getXSaveMask() != 0) {
+      fullSwitch = getXSaveSwitch(Xsave(Offset(offsetof(Context, fprState))),
+                                  llvmcpu, getXSaveMask());
+    } else {
+      fullSwitch = getFXSaveSwitch(llvmcpu, false);
     }
+    appendFPRSwitch(epilogue, std::move(fullSwitch),
+                    getXMMSwitch(llvmcpu, false), llvmcpu);
   }
   // return to host
   epilogue.push_back(Ret());
@@ -292,4 +308,218 @@ RelocatableInst::UniquePtrVec getTerminator(const LLVMCPU &llvmcpu,
   return terminator;
 }
 
+RelocatableInst::UniquePtrVec getChainJump(const LLVMCPU &llvmcpu,
+                                           rword slotOffset) {
+  // jump to the address stored in the chain slot (the next sequence or the
+  // epilogue)
+  return conv_unique<RelocatableInst>(JmpM(Offset(slotOffset)));
+}
+
+// Lookup of DataBlock[Offset(RIP)] in the last entry popped from the return
+// stack, then in the indirect branch target cache. The guest EFLAGS are kept
+// in AH:AL (LAHF and SETO) during the lookup, RAX and RCX are saved in the
+// GPRState, as the epilogue saves them again on a miss.
+RelocatableInst::UniquePtrVec
+getIndirectCacheDispatcher(const LLVMCPU &llvmcpu) {
+  RelocatableInst::UniquePtrVec dispatcher;
+  RelocatableInst::UniquePtrVec restore;
+  RelocatableInst::UniquePtrVec returnHit;
+  RelocatableInst::UniquePtrVec hit;
+  static constexpr unsigned entryShift = (is_x86_64) ? 4 : 3;
+  static_assert(sizeof(IndirectCache::entries[0]) == (1 << entryShift));
+
+  // Restore EFLAGS, RAX and RCX
+  append(restore,
+         LoadReg(Reg(0), Offset(offsetof(Context, indirectCache.eflags)))
+             .genReloc(llvmcpu));
+  restore.push_back(AddALi8(0x7f));
+  restore.push_back(Sahf());
+  append(restore, LoadReg(Reg(0), Offset(Reg(0))).genReloc(llvmcpu));
+  append(restore, LoadReg(Reg(2), Offset(Reg(2))).genReloc(llvmcpu));
+
+  // Save RAX, RCX and EFLAGS
+  append(dispatcher, SaveReg(Reg(0), Offset(Reg(0))).genReloc(llvmcpu));
+  append(dispatcher, SaveReg(Reg(2), Offset(Reg(2))).genReloc(llvmcpu));
+  dispatcher.push_back(SetoAL());
+  dispatcher.push_back(Lahf());
+  append(dispatcher,
+         SaveReg(Reg(0), Offset(offsetof(Context, indirectCache.eflags)))
+             .genReloc(llvmcpu));
+  append(dispatcher, LoadReg(Reg(0), Offset(Reg(REG_PC))).genReloc(llvmcpu));
+
+  // Return stack hit: jump to the value of the chain slot of the entry
+  returnHit.push_back(IncM(Offset(offsetof(Context, indirectCache.hits))));
+  returnHit.push_back(Add(Reg(2), Reg(2), Constant(sizeof(rword))));
+  for (int i = 0; i < 2; i++) {
+    if constexpr (is_x86_64) {
+      returnHit.push_back(Mov64rm(Reg(2), Reg(2), 0));
+    } else {
+      returnHit.push_back(Mov32rm(Reg(2), Reg(2), 0));
+    }
+  }
+  append(returnHit,
+         SaveReg(Reg(2), Offset(offsetof(Context, indirectCache.target)))
+             .genReloc(llvmcpu));
+  for (const auto &inst : restore) {
+    returnHit.push_back(inst->clone());
+  }
+  returnHit.push_back(JmpM(Offset(offsetof(Context, indirectCache.target))));
+
+  int returnHitSize = 0;
+  for (const auto &inst : returnHit) {
+    returnHitSize += inst->getSize(llvmcpu);
+  }
+
+  append(dispatcher,
+         LoadReg(Reg(2), Offset(offsetof(Context, returnStack.entry)))
+             .genReloc(llvmcpu));
+  dispatcher.push_back(Cmp(Reg(0), Reg(2)));
+  dispatcher.push_back(Jne(returnHitSize + 4));
+  append(dispatcher, std::move(returnHit));
+
+  // RCX := &entries[(RIP ^ (RIP >> 4)) % INDIRECT_CACHE_SIZE]
+  dispatcher.push_back(MovReg::unique(Reg(2), Reg(0)));
+  dispatcher.push_back(Shr(Reg(2), Constant(4)));
+  dispatcher.push_back(Xorrr(Reg(2), Reg(0)));
+  if constexpr (INDIRECT_CACHE_SIZE <= 128) {
+    dispatcher.push_back(Andri8(Reg(2), Constant(INDIRECT_CACHE_SIZE - 1)));
+  } else {
+    dispatcher.push_back(Andri(Reg(2), Constant(INDIRECT_CACHE_SIZE - 1)));
+  }
+  dispatcher.push_back(Shl(Reg(2), Constant(entryShift)));
+  dispatcher.push_back(
+      AddM(Reg(2), Offset(offsetof(Context, indirectCache.base))));
+
+  // Hit: jump to the selector of the entry
+  hit.push_back(IncM(Offset(offsetof(Context, indirectCache.hits))));
+  hit.push_back(Add(Reg(2), Reg(2), Constant(sizeof(rword))));
+  if constexpr (is_x86_64) {
+    hit.push_back(Mov64rm(Reg(2), Reg(2), 0));
+  } else {
+    hit.push_back(Mov32rm(Reg(2), Reg(2), 0));
+  }
+  append(hit, SaveReg(Reg(2), Offset(offsetof(Context, indirectCache.target)))
+                  .genReloc(llvmcpu));
+  for (const auto &inst : restore) {
+    hit.push_back(inst->clone());
+  }
+  hit.push_back(JmpM(Offset(offsetof(Context, indirectCache.target))));
+
+  int hitSize = 0;
+  for (const auto &inst : hit) {
+    hitSize += inst->getSize(llvmcpu);
+  }
+
+  dispatcher.push_back(Cmp(Reg(0), Reg(2)));
+  dispatcher.push_back(Jne(hitSize + 4));
+  append(dispatcher, std::move(hit));
+  // Miss: return to the host
+  dispatcher.push_back(IncM(Offset(offsetof(Context, indirectCache.misses))));
+  append(dispatcher, std::move(restore));
+  append(dispatcher, JmpEpilogue().genReloc(llvmcpu));
+
+  return dispatcher;
+}
+
+RelocatableInst::UniquePtrVec getIndirectCacheJump(const LLVMCPU &llvmcpu) {
+  return conv_unique<RelocatableInst>(
+      JmpM(Offset(offsetof(Context, indirectCache.dispatcher))));
+}
+
+// Stub of the fast callbacks (X86_64 only). The guest state is saved in the
+// context, and the proxy is called on the host stack with one argument. The
+// FPU registers aren't switched: the sequences that use them, or the guest
+// FS/GS bases, fallback to the epilogue and the callback is called by the VM.
+RelocatableInst::UniquePtrVec getFastCallStub(const LLVMCPU &llvmcpu,
+                                              rword proxy, rword arg) {
+  RelocatableInst::UniquePtrVec stub;
+  RelocatableInst::UniquePtrVec call;
+
+  // Save GPR
+  for (unsigned int i = 0; i < NUM_GPR - 1; i++)
+    append(stub, SaveReg(Reg(i), Offset(Reg(i))).genReloc(llvmcpu));
+  // Restore host SP
+  append(stub, LoadReg(Reg(REG_SP), Offset(offsetof(Context, hostState.sp)))
+                   .genReloc(llvmcpu));
+  // Save EFLAGS
+  stub.push_back(Pushf());
+  stub.push_back(Popr(Reg(0)));
+  append(stub, SaveReg(Reg(0), Offset(offsetof(Context, gprState.eflags)))
+                   .genReloc(llvmcpu));
+
+  // Call the proxy with the direction flag cleared, an aligned stack and the
+  // shadow space of Windows
+#if defined(QBDI_PLATFORM_WINDOWS)
+  static constexpr unsigned argReg = 2; // RCX
+#else
+  static constexpr unsigned argReg = 5; // RDI
+#endif
+  call.push_back(Cld());
+  call.push_back(Andri8(Reg(REG_SP), Constant(-16)));
+  call.push_back(Add(Reg(REG_SP), Reg(REG_SP), Constant(-32)));
+  call.push_back(LoadImm::unique(Reg(argReg), arg));
+  call.push_back(LoadImm::unique(Reg(0), proxy));
+  call.push_back(CallR(Reg(0)));
+  // Restore EFLAGS
+  append(call, LoadReg(Reg(0), Offset(offsetof(Context, gprState.eflags)))
+                   .genReloc(llvmcpu));
+  call.push_back(Pushr(Reg(0)));
+  call.push_back(Popf());
+  // Restore GPR, that may have been changed by the callback
+  for (unsigned int i = 0; i < NUM_GPR - 1; i++)
+    append(call, LoadReg(Reg(i), Offset(Reg(i))).genReloc(llvmcpu));
+  // Resume after the callsite
+  call.push_back(JmpM(Offset(offsetof(Context, hostState.selector))));
+
+  int callSize = 0;
+  for (const auto &inst : call) {
+    callSize += inst->getSize(llvmcpu);
+  }
+
+  uint32_t fallbackFlags = ExecBlockFlags::needFPU;
+  if (llvmcpu.hasOptions(Options::OPT_ENABLE_FS_GS)) {
+    fallbackFlags |= ExecBlockFlags::needFSGS;
+  }
+  append(stub,
+         LoadReg(Reg(0), Offset(offsetof(Context, hostState.executeFlags)))
+             .genReloc(llvmcpu));
+  stub.push_back(Test(Reg(0), fallbackFlags));
+  stub.push_back(Jne(callSize + 4));
+  append(stub, std::move(call));
+  // target jne fallbackFlags
+
+  // Fallback: restore EFLAGS, RAX and the guest SP, and break to the host.
+  // The epilogue saves the GPR again.
+  append(stub, LoadReg(Reg(0), Offset(offsetof(Context, gprState.eflags)))
+                   .genReloc(llvmcpu));
+  stub.push_back(Pushr(Reg(0)));
+  stub.push_back(Popf());
+  append(stub, LoadReg(Reg(0), Offset(Reg(0))).genReloc(llvmcpu));
+  append(stub, LoadReg(Reg(REG_SP), Offset(Reg(REG_SP))).genReloc(llvmcpu));
+  append(stub, JmpEpilogue().genReloc(llvmcpu));
+
+  return stub;
+}
+
+// Increment of a 64 bits counter of the block profile (X86_64 only). The
+// counter is incremented with LEA to keep EFLAGS.
+RelocatableInst::UniquePtrVec getBlockCounter(const LLVMCPU &llvmcpu,
+                                              rword counter) {
+  if constexpr (is_x86) {
+    return {};
+  }
+  RelocatableInst::UniquePtrVec increment;
+
+  append(increment, SaveReg(Reg(0), Offset(Reg(0))).genReloc(llvmcpu));
+  append(increment, SaveReg(Reg(2), Offset(Reg(2))).genReloc(llvmcpu));
+  increment.push_back(LoadImm::unique(Reg(0), counter));
+  increment.push_back(Mov64rm(Reg(2), Reg(0), 0));
+  increment.push_back(Lea(Reg(2), Reg(2), 1, 0, 1, 0));
+  increment.push_back(Movmr(Reg(0), 0, Reg(2)));
+  append(increment, LoadReg(Reg(0), Offset(Reg(0))).genReloc(llvmcpu));
+  append(increment, LoadReg(Reg(2), Offset(Reg(2))).genReloc(llvmcpu));
+
+  return increment;
+}
+
 } // namespace QBDI
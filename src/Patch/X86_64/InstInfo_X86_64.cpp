@@ -4520,4 +4520,21 @@ unsigned getInstSize(const llvm::MCInst &inst, const LLVMCPU &llvmcpu) {
 // - CFCMOV32mr
 // - CFCMOV64mr
 
+void getDirectSuccessors(const llvm::MCInst &inst, const LLVMCPU &llvmcpu,
+                         rword address, rword size,
+                         std::vector<rword> &successors) {
+  const llvm::MCInstrDesc &desc = llvmcpu.getMCII().get(inst.getOpcode());
+  const rword next = address + size;
+  if (not desc.isBarrier() and not desc.isReturn()) {
+    successors.push_back(next);
+  }
+  // The target of JMP, Jcc, LOOP or CALL is relative to the next instruction
+  if ((desc.isBranch() or desc.isCall()) and desc.getNumOperands() > 0 and
+      desc.operands()[0].OperandType == llvm::MCOI::OPERAND_PCREL and
+      inst.getOperand(0).isImm()) {
+    successors.push_back(next +
+                         static_cast<rword>(inst.getOperand(0).getImm()));
+  }
+}
+
 }; // namespace QBDI
@@ -16,6 +16,7 @@
  * limitations under the License.
  */
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "ExecBlock/Context.h"
@@ -25,6 +26,7 @@
 #include "Patch/RelocatableInst.h"
 #include "Patch/Types.h"
 #include "Patch/X86_64/Layer2_X86_64.h"
+#include "Patch/X86_64/PatchGenerator_X86_64.h"
 #include "Patch/X86_64/RelocatableInst_X86_64.h"
 
 #include "QBDI/Config.h"
@@ -65,4 +67,98 @@ RelocatableInst::UniquePtrVec getBreakToHost(Reg temp, const Patch &patch,
   return breakToHost;
 }
 
+/* Generate a series of RelocatableInst which call the callback set in the host
+ * state with the stub of the ExecBlock, then resume the execution after the
+ * patch. X86 use a break to host.
+ */
+RelocatableInst::UniquePtrVec getFastCallToHost(Reg temp, const Patch &patch,
+                                                bool restore) {
+  if constexpr (is_x86) {
+    return getBreakToHost(temp, patch, restore);
+  } else {
+    RelocatableInst::UniquePtrVec fastCall;
+
+    QBDI_REQUIRE_ABORT(restore,
+                       "The fast call needs to restore its temporary register");
+
+    // The execution is resumed after the jump to the stub, as for a break to
+    // host
+    fastCall.push_back(Add(temp, Reg(REG_PC), 20));
+    append(fastCall,
+           SaveReg(temp, Offset(offsetof(Context, hostState.selector)))
+               .genReloc(*patch.llvmcpu));
+    // Restore the temporary register
+    append(fastCall, LoadReg(temp, Offset(temp)).genReloc(*patch.llvmcpu));
+    // Jump to the stub of the fast callbacks
+    fastCall.push_back(JmpM(Offset(offsetof(Context, hostState.fastCallStub))));
+
+    // the stub may fallback to a break to host
+    append(fastCall, TargetPrologue().genReloc(patch));
+
+    return fastCall;
+  }
+}
+
+/* Compare the value of the predicate in the JIT code with a PredicateGate.
+ * The other flags than the ones saved by LAHF and SETO, the PC after an
+ * instruction that modifies it and the offsets larger than 32 bits are
+ * compared by the host.
+ */
+PatchGenerator::UniquePtrVec
+getPredicateGate(const Patch &patch, InstPosition position,
+                 const CallbackPredicate &predicate, InstCallback cbk,
+                 void *data) {
+  if (predicate.source == PREDICATE_FLAG) {
+    // CF, PF, AF, ZF, SF and OF
+    if (predicate.reg >= 8 and predicate.reg != 11) {
+      return {};
+    }
+  } else {
+    if (predicate.source == PREDICATE_MEMORY and
+        predicate.offset != static_cast<int32_t>(predicate.offset)) {
+      return {};
+    }
+    if (predicate.reg == REG_PC and position == InstPosition::POSTINST and
+        patch.metadata.modifyPC) {
+      return {};
+    }
+  }
+  return conv_unique<PatchGenerator>(
+      PredicateGate::unique(predicate, cbk, data, position));
+}
+
+// Decrement the countdown in the JIT code with a CountdownGate
+PatchGenerator::UniquePtrVec
+getCountdownGate(const Patch &patch, InstPosition position, rword *countdown,
+                 rword step, InstCallback cbk, void *data) {
+  return conv_unique<PatchGenerator>(
+      CountdownGate::unique(countdown, step, cbk, data, position));
+}
+
+// Read the slot in the JIT code with a SlotGate
+PatchGenerator::UniquePtrVec getSlotGate(const Patch &patch,
+                                         InstPosition position, rword *armed,
+                                         InstCallback cbk, void *data) {
+  return conv_unique<PatchGenerator>(
+      SlotGate::unique(armed, cbk, data, position));
+}
+
+// Compute the location of the basic block as AFL in QEMU mode
+PatchGenerator::UniquePtrVec getCoverageEdge(const Patch &patch,
+                                             CoverageBitmap *coverage) {
+  rword address = patch.metadata.address;
+  rword cur = ((address >> 4) ^ (address << 8)) & coverage->mask;
+  return conv_unique<PatchGenerator>(CoverageEdge::unique(coverage, cur));
+}
+
+// Jump through a once slot to the instrumentation, or after it
+RelocatableInst::UniquePtrVec
+getOnceSkip(const Patch &patch, const RelocatableInst::UniquePtrVec &stub) {
+  rword stubSize = 0;
+  for (const RelocatableInst::UniquePtr &inst : stub) {
+    stubSize += inst->getSize(*patch.llvmcpu);
+  }
+  return conv_unique<RelocatableInst>(OnceSlotJump::unique(stubSize));
+}
+
 } // namespace QBDI
@@ -191,6 +191,21 @@ llvm::MCInst movzx64rr8(RegLLVM dst, RegLLVM src) {
   return inst;
 }
 
+llvm::MCInst movzx64rm8(RegLLVM dst, RegLLVM base, rword scale,
+                        RegLLVM offset, rword displacement, RegLLVM seg) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::MOVZX64rm8);
+  inst.addOperand(llvm::MCOperand::createReg(dst.getValue()));
+  inst.addOperand(llvm::MCOperand::createReg(base.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(scale));
+  inst.addOperand(llvm::MCOperand::createReg(offset.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(displacement));
+  inst.addOperand(llvm::MCOperand::createReg(seg.getValue()));
+
+  return inst;
+}
+
 llvm::MCInst test32ri(RegLLVM base, uint32_t imm) {
   llvm::MCInst inst;
 
@@ -257,6 +272,26 @@ llvm::MCInst jne(int32_t offset) {
   return inst;
 }
 
+llvm::MCInst jb(int32_t offset) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::JCC_4);
+  inst.addOperand(llvm::MCOperand::createImm(offset));
+  inst.addOperand(llvm::MCOperand::createImm(llvm::X86::CondCode::COND_B));
+
+  return inst;
+}
+
+llvm::MCInst jae(int32_t offset) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::JCC_4);
+  inst.addOperand(llvm::MCOperand::createImm(offset));
+  inst.addOperand(llvm::MCOperand::createImm(llvm::X86::CondCode::COND_AE));
+
+  return inst;
+}
+
 llvm::MCInst jmp(rword offset) {
   llvm::MCInst inst;
 
@@ -266,6 +301,15 @@ llvm::MCInst jmp(rword offset) {
   return inst;
 }
 
+llvm::MCInst jrcxz(int32_t offset) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::JRCXZ);
+  inst.addOperand(llvm::MCOperand::createImm(offset));
+
+  return inst;
+}
+
 llvm::MCInst fxsave(RegLLVM base, rword offset) {
   llvm::MCInst inst;
 
@@ -292,6 +336,45 @@ llvm::MCInst fxrstor(RegLLVM base, rword offset) {
   return inst;
 }
 
+llvm::MCInst xsave(RegLLVM base, rword offset) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::XSAVE);
+  inst.addOperand(llvm::MCOperand::createReg(base.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(1));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+  inst.addOperand(llvm::MCOperand::createImm(offset));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+
+  return inst;
+}
+
+llvm::MCInst xsaveopt(RegLLVM base, rword offset) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::XSAVEOPT);
+  inst.addOperand(llvm::MCOperand::createReg(base.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(1));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+  inst.addOperand(llvm::MCOperand::createImm(offset));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+
+  return inst;
+}
+
+llvm::MCInst xrstor(RegLLVM base, rword offset) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::XRSTOR);
+  inst.addOperand(llvm::MCOperand::createReg(base.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(1));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+  inst.addOperand(llvm::MCOperand::createImm(offset));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+
+  return inst;
+}
+
 llvm::MCInst vextractf128(RegLLVM base, rword offset, RegLLVM src,
                           uint8_t regoffset) {
   llvm::MCInst inst;
@@ -325,6 +408,60 @@ llvm::MCInst vinsertf128(RegLLVM dst, RegLLVM base, rword offset,
   return inst;
 }
 
+llvm::MCInst movupsrm(RegLLVM dst, RegLLVM base, rword offset) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::MOVUPSrm);
+  inst.addOperand(llvm::MCOperand::createReg(dst.getValue()));
+  inst.addOperand(llvm::MCOperand::createReg(base.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(1));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+  inst.addOperand(llvm::MCOperand::createImm(offset));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+
+  return inst;
+}
+
+llvm::MCInst movupsmr(RegLLVM base, rword offset, RegLLVM src) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::MOVUPSmr);
+  inst.addOperand(llvm::MCOperand::createReg(base.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(1));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+  inst.addOperand(llvm::MCOperand::createImm(offset));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+  inst.addOperand(llvm::MCOperand::createReg(src.getValue()));
+
+  return inst;
+}
+
+llvm::MCInst ldmxcsr(RegLLVM base, rword offset) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::LDMXCSR);
+  inst.addOperand(llvm::MCOperand::createReg(base.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(1));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+  inst.addOperand(llvm::MCOperand::createImm(offset));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+
+  return inst;
+}
+
+llvm::MCInst stmxcsr(RegLLVM base, rword offset) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::STMXCSR);
+  inst.addOperand(llvm::MCOperand::createReg(base.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(1));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+  inst.addOperand(llvm::MCOperand::createImm(offset));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+
+  return inst;
+}
+
 llvm::MCInst push32r(RegLLVM reg) {
   llvm::MCInst inst;
 
@@ -509,6 +646,272 @@ llvm::MCInst xor64rr(RegLLVM dst, RegLLVM src) {
   return inst;
 }
 
+llvm::MCInst shr32ri(RegLLVM reg, rword imm) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::SHR32ri);
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(imm));
+
+  return inst;
+}
+
+llvm::MCInst shr64ri(RegLLVM reg, rword imm) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::SHR64ri);
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(imm));
+
+  return inst;
+}
+
+llvm::MCInst shl32ri(RegLLVM reg, rword imm) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::SHL32ri);
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(imm));
+
+  return inst;
+}
+
+llvm::MCInst shl64ri(RegLLVM reg, rword imm) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::SHL64ri);
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(imm));
+
+  return inst;
+}
+
+llvm::MCInst and32ri8(RegLLVM reg, rword imm) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::AND32ri8);
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(imm));
+
+  return inst;
+}
+
+llvm::MCInst and64ri8(RegLLVM reg, rword imm) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::AND64ri8);
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(imm));
+
+  return inst;
+}
+
+llvm::MCInst and32ri(RegLLVM reg, rword imm) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::AND32ri);
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(imm));
+
+  return inst;
+}
+
+llvm::MCInst and64ri32(RegLLVM reg, rword imm) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::AND64ri32);
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(imm));
+
+  return inst;
+}
+
+llvm::MCInst call32r(RegLLVM reg) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::CALL32r);
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+
+  return inst;
+}
+
+llvm::MCInst call64r(RegLLVM reg) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::CALL64r);
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+
+  return inst;
+}
+
+llvm::MCInst cld() {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::CLD);
+
+  return inst;
+}
+
+llvm::MCInst add32rm(RegLLVM dst, RegLLVM base, rword offset) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::ADD32rm);
+  inst.addOperand(llvm::MCOperand::createReg(dst.getValue()));
+  inst.addOperand(llvm::MCOperand::createReg(dst.getValue()));
+  inst.addOperand(llvm::MCOperand::createReg(base.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(1));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+  inst.addOperand(llvm::MCOperand::createImm(offset));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+
+  return inst;
+}
+
+llvm::MCInst add64rm(RegLLVM dst, RegLLVM base, rword offset) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::ADD64rm);
+  inst.addOperand(llvm::MCOperand::createReg(dst.getValue()));
+  inst.addOperand(llvm::MCOperand::createReg(dst.getValue()));
+  inst.addOperand(llvm::MCOperand::createReg(base.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(1));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+  inst.addOperand(llvm::MCOperand::createImm(offset));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+
+  return inst;
+}
+
+llvm::MCInst cmp32rm(RegLLVM reg, RegLLVM base, rword offset) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::CMP32rm);
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createReg(base.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(1));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+  inst.addOperand(llvm::MCOperand::createImm(offset));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+
+  return inst;
+}
+
+llvm::MCInst cmp64rm(RegLLVM reg, RegLLVM base, rword offset) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::CMP64rm);
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createReg(base.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(1));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+  inst.addOperand(llvm::MCOperand::createImm(offset));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+
+  return inst;
+}
+
+llvm::MCInst cmp32rr(RegLLVM reg1, RegLLVM reg2) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::CMP32rr);
+  inst.addOperand(llvm::MCOperand::createReg(reg1.getValue()));
+  inst.addOperand(llvm::MCOperand::createReg(reg2.getValue()));
+
+  return inst;
+}
+
+llvm::MCInst cmp64rr(RegLLVM reg1, RegLLVM reg2) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::CMP64rr);
+  inst.addOperand(llvm::MCOperand::createReg(reg1.getValue()));
+  inst.addOperand(llvm::MCOperand::createReg(reg2.getValue()));
+
+  return inst;
+}
+
+llvm::MCInst inc32m(RegLLVM base, rword offset) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::INC32m);
+  inst.addOperand(llvm::MCOperand::createReg(base.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(1));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+  inst.addOperand(llvm::MCOperand::createImm(offset));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+
+  return inst;
+}
+
+llvm::MCInst inc64m(RegLLVM base, rword offset) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::INC64m);
+  inst.addOperand(llvm::MCOperand::createReg(base.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(1));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+  inst.addOperand(llvm::MCOperand::createImm(offset));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+
+  return inst;
+}
+
+llvm::MCInst inc8m(RegLLVM base, RegLLVM index) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::INC8m);
+  inst.addOperand(llvm::MCOperand::createReg(base.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(1));
+  inst.addOperand(llvm::MCOperand::createReg(index.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(0));
+  inst.addOperand(llvm::MCOperand::createReg(0));
+
+  return inst;
+}
+
+llvm::MCInst seto(RegLLVM reg) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::SETCCr);
+  inst.addOperand(llvm::MCOperand::createReg(reg.getValue()));
+  inst.addOperand(llvm::MCOperand::createImm(llvm::X86::CondCode::COND_O));
+
+  return inst;
+}
+
+llvm::MCInst add8i8(uint8_t imm) {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::ADD8i8);
+  inst.addOperand(llvm::MCOperand::createImm(imm));
+
+  return inst;
+}
+
+llvm::MCInst lahf() {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::LAHF);
+
+  return inst;
+}
+
+llvm::MCInst sahf() {
+  llvm::MCInst inst;
+
+  inst.setOpcode(llvm::X86::SAHF);
+
+  return inst;
+}
+
 // high level layer 2
 
 [[maybe_unused]] static bool isr8_15Reg(RegLLVM r) {
@@ -590,6 +993,18 @@ RelocatableInst::UniquePtr Fxrstor(Offset offset) {
   return DataBlockRelx86(fxrstor(0, 0), 0, offset, 7, 7);
 }
 
+RelocatableInst::UniquePtr Xsave(Offset offset) {
+  return DataBlockRelx86(xsave(0, 0), 0, offset, 7, 7);
+}
+
+RelocatableInst::UniquePtr Xsaveopt(Offset offset) {
+  return DataBlockRelx86(xsaveopt(0, 0), 0, offset, 7, 7);
+}
+
+RelocatableInst::UniquePtr Xrstor(Offset offset) {
+  return DataBlockRelx86(xrstor(0, 0), 0, offset, 7, 7);
+}
+
 RelocatableInst::UniquePtr Vextractf128(Offset offset, RegLLVM src,
                                         Constant regoffset) {
   return DataBlockRelx86(vextractf128(0, 0, src, regoffset), 0, offset, 10, 10);
@@ -600,6 +1015,32 @@ RelocatableInst::UniquePtr Vinsertf128(RegLLVM dst, Offset offset,
   return DataBlockRelx86(vinsertf128(dst, 0, 0, regoffset), 2, offset, 10, 10);
 }
 
+RelocatableInst::UniquePtr Movupsrm(RegLLVM dst, Offset offset) {
+  // XMM8 to XMM15 need a REX prefix
+  unsigned size64 =
+      (llvm::X86::XMM8 <= dst.getValue() && dst.getValue() <= llvm::X86::XMM15)
+          ? 8
+          : 7;
+  return DataBlockRelx86(movupsrm(dst, 0, 0), 1, offset, size64, 7);
+}
+
+RelocatableInst::UniquePtr Movupsmr(Offset offset, RegLLVM src) {
+  // XMM8 to XMM15 need a REX prefix
+  unsigned size64 =
+      (llvm::X86::XMM8 <= src.getValue() && src.getValue() <= llvm::X86::XMM15)
+          ? 8
+          : 7;
+  return DataBlockRelx86(movupsmr(0, 0, src), 0, offset, size64, 7);
+}
+
+RelocatableInst::UniquePtr Ldmxcsr(Offset offset) {
+  return DataBlockRelx86(ldmxcsr(0, 0), 0, offset, 7, 7);
+}
+
+RelocatableInst::UniquePtr Stmxcsr(Offset offset) {
+  return DataBlockRelx86(stmxcsr(0, 0), 0, offset, 7, 7);
+}
+
 RelocatableInst::UniquePtr Pushr(Reg reg) {
   if constexpr (is_x86_64)
     return NoRelocSized::unique(push64r(reg), isr8_15Reg(reg) ? 2 : 1);
@@ -654,6 +1095,22 @@ RelocatableInst::UniquePtr Jne(int32_t offset) {
   return NoRelocSized::unique(jne(offset), 6);
 }
 
+RelocatableInst::UniquePtr Jb(int32_t offset) {
+  return NoRelocSized::unique(jb(offset), 6);
+}
+
+RelocatableInst::UniquePtr Jae(int32_t offset) {
+  return NoRelocSized::unique(jae(offset), 6);
+}
+
+RelocatableInst::UniquePtr Jmp(int32_t offset) {
+  return NoRelocSized::unique(jmp(offset), 5);
+}
+
+RelocatableInst::UniquePtr Jrcxz(int32_t offset) {
+  return NoRelocSized::unique(jrcxz(offset), 2);
+}
+
 RelocatableInst::UniquePtr Rdfsbase(Reg reg) {
   return NoRelocSized::unique(rdfsbase64(reg), 5);
 }
@@ -698,6 +1155,133 @@ RelocatableInst::UniquePtr MovzxrAL(Reg dst) {
     return NoRelocSized::unique(movzx32rr8(dst, llvm::X86::AL), 3);
 }
 
+RelocatableInst::UniquePtr Mov32ri(RegLLVM dst, Constant cst) {
+  // only used with the legacy registers (no REX prefix)
+  return NoRelocSized::unique(mov32ri(dst, cst), 5);
+}
+
+RelocatableInst::UniquePtr Movzxrr8(RegLLVM dst, RegLLVM src) {
+  // only used with the legacy registers (no REX prefix)
+  return NoRelocSized::unique(movzx32rr8(dst, src), 3);
+}
+
+RelocatableInst::UniquePtr Shr(Reg reg, Constant cst) {
+  if constexpr (is_x86_64)
+    return NoRelocSized::unique(shr64ri(reg, cst), 4);
+  else
+    return NoRelocSized::unique(shr32ri(reg, cst), 3);
+}
+
+RelocatableInst::UniquePtr Shl(Reg reg, Constant cst) {
+  if constexpr (is_x86_64)
+    return NoRelocSized::unique(shl64ri(reg, cst), 4);
+  else
+    return NoRelocSized::unique(shl32ri(reg, cst), 3);
+}
+
+RelocatableInst::UniquePtr Andri8(Reg reg, Constant cst) {
+  if constexpr (is_x86_64)
+    return NoRelocSized::unique(and64ri8(reg, cst), 4);
+  else
+    return NoRelocSized::unique(and32ri8(reg, cst), 3);
+}
+
+RelocatableInst::UniquePtr Andri(Reg reg, Constant cst) {
+  if constexpr (is_x86_64)
+    return NoRelocSized::unique(and64ri32(reg, cst), 7);
+  else
+    return NoRelocSized::unique(and32ri(reg, cst), 6);
+}
+
+RelocatableInst::UniquePtr CallR(Reg reg) {
+  if constexpr (is_x86_64)
+    return NoRelocSized::unique(call64r(reg), isr8_15Reg(reg) ? 3 : 2);
+  else
+    return NoRelocSized::unique(call32r(reg), 2);
+}
+
+RelocatableInst::UniquePtr Cld() { return NoRelocSized::unique(cld(), 1); }
+
+RelocatableInst::UniquePtr AddM(Reg dst, Offset offset) {
+  if constexpr (is_x86_64)
+    return DataBlockRelx86(add64rm(dst, 0, 0), 2, offset, 7, 6);
+  else
+    return DataBlockRelx86(add32rm(dst, 0, 0), 2, offset, 7, 6);
+}
+
+RelocatableInst::UniquePtr Cmp(Reg reg, Reg base) {
+  if constexpr (is_x86_64)
+    return NoRelocSized::unique(cmp64rm(reg, base, 0),
+                                lenInstLEAtype(base, 0, 0, 0));
+  else
+    return NoRelocSized::unique(cmp32rm(reg, base, 0),
+                                lenInstLEAtype(base, 0, 0, 0));
+}
+
+RelocatableInst::UniquePtr Cmprr(RegLLVM reg1, RegLLVM reg2) {
+  if constexpr (is_x86_64)
+    return NoRelocSized::unique(cmp64rr(reg1, reg2), 3);
+  else
+    return NoRelocSized::unique(cmp32rr(reg1, reg2), 2);
+}
+
+RelocatableInst::UniquePtr IncM(Offset offset) {
+  if constexpr (is_x86_64)
+    return DataBlockRelx86(inc64m(0, 0), 0, offset, 7, 6);
+  else
+    return DataBlockRelx86(inc32m(0, 0), 0, offset, 7, 6);
+}
+
+RelocatableInst::UniquePtr Inc8m(RegLLVM base, RegLLVM index) {
+  // only used with the legacy registers (no REX prefix), and a base other
+  // than EBP (no displacement)
+  return NoRelocSized::unique(inc8m(base, index), 3);
+}
+
+RelocatableInst::UniquePtr SetoAL() {
+  return NoRelocSized::unique(seto(llvm::X86::AL), 3);
+}
+
+RelocatableInst::UniquePtr AddALi8(uint8_t imm) {
+  return NoRelocSized::unique(add8i8(imm), 2);
+}
+
+RelocatableInst::UniquePtr Lahf() { return NoRelocSized::unique(lahf(), 1); }
+
+RelocatableInst::UniquePtr Sahf() { return NoRelocSized::unique(sahf(), 1); }
+
+RelocatableInst::UniquePtr MovzxM8(RegLLVM dst, Offset offset) {
+  if constexpr (is_x86_64)
+    return DataBlockRelx86(movzx64rm8(dst, 0, 1, 0, 0, 0), 1, offset, 8, 7);
+  else
+    return DataBlockRelx86(mov32rm8(dst, 0, 1, 0, 0, 0), 1, offset, 8, 7);
+}
+
+RelocatableInst::UniquePtr LeaM(RegLLVM dst, Offset offset) {
+  if constexpr (is_x86_64)
+    return DataBlockRelx86(lea64(dst, 0, 1, 0, 0, 0), 1, offset, 7, 6);
+  else
+    return DataBlockRelx86(lea32(dst, 0, 1, 0, 0, 0), 1, offset, 7, 6);
+}
+
+RelocatableInst::UniquePtr Movmr(RegLLVM addr, rword disp, RegLLVM src) {
+  if constexpr (is_x86_64)
+    return NoRelocSized::unique(mov64mr(addr, 1, 0, disp, 0, src),
+                                lenInstLEAtype(addr, 0, disp, 0));
+  else
+    return NoRelocSized::unique(mov32mr(addr, 1, 0, disp, 0, src),
+                                lenInstLEAtype(addr, 0, disp, 0));
+}
+
+RelocatableInst::UniquePtr Movrm(RegLLVM dst, RegLLVM addr, rword disp) {
+  if constexpr (is_x86_64)
+    return NoRelocSized::unique(mov64rm(dst, addr, 1, 0, disp, 0),
+                                lenInstLEAtype(addr, 0, disp, 0));
+  else
+    return NoRelocSized::unique(mov32rm(dst, addr, 1, 0, disp, 0),
+                                lenInstLEAtype(addr, 0, disp, 0));
+}
+
 RelocatableInst::UniquePtr Mov64rm(RegLLVM dst, RegLLVM addr, RegLLVM seg) {
   return NoRelocSized::unique(mov64rm(dst, addr, 1, 0, 0, seg),
                               lenInstLEAtype(addr, 0, 0, seg));
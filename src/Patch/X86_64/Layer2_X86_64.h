@@ -64,6 +64,9 @@ llvm::MCInst mov64rm(RegLLVM dst, RegLLVM base, rword scale, RegLLVM offset,
 
 llvm::MCInst movzx64rr8(RegLLVM dst, RegLLVM src);
 
+llvm::MCInst movzx64rm8(RegLLVM dst, RegLLVM base, rword scale,
+                        RegLLVM offset, rword displacement, RegLLVM seg);
+
 llvm::MCInst test32ri(RegLLVM base, uint32_t imm);
 
 llvm::MCInst test64ri32(RegLLVM base, uint32_t imm);
@@ -72,22 +75,42 @@ llvm::MCInst je(int32_t offset);
 
 llvm::MCInst jne(int32_t offset);
 
+llvm::MCInst jb(int32_t offset);
+
+llvm::MCInst jae(int32_t offset);
+
 llvm::MCInst jmp32m(RegLLVM base, rword offset);
 
 llvm::MCInst jmp64m(RegLLVM base, rword offset);
 
 llvm::MCInst jmp(rword offset);
 
+llvm::MCInst jrcxz(int32_t offset);
+
 llvm::MCInst fxsave(RegLLVM base, rword offset);
 
 llvm::MCInst fxrstor(RegLLVM base, rword offset);
 
+llvm::MCInst xsave(RegLLVM base, rword offset);
+
+llvm::MCInst xsaveopt(RegLLVM base, rword offset);
+
+llvm::MCInst xrstor(RegLLVM base, rword offset);
+
 llvm::MCInst vextractf128(RegLLVM base, rword offset, RegLLVM src,
                           uint8_t regoffset);
 
 llvm::MCInst vinsertf128(RegLLVM dst, RegLLVM base, rword offset,
                          uint8_t regoffset);
 
+llvm::MCInst movupsrm(RegLLVM dst, RegLLVM base, rword offset);
+
+llvm::MCInst movupsmr(RegLLVM base, rword offset, RegLLVM src);
+
+llvm::MCInst ldmxcsr(RegLLVM base, rword offset);
+
+llvm::MCInst stmxcsr(RegLLVM base, rword offset);
+
 llvm::MCInst push32r(RegLLVM reg);
 
 llvm::MCInst push64r(RegLLVM reg);
@@ -130,6 +153,54 @@ llvm::MCInst xor32rr(RegLLVM dst, RegLLVM src);
 
 llvm::MCInst xor64rr(RegLLVM dst, RegLLVM src);
 
+llvm::MCInst shr32ri(RegLLVM reg, rword imm);
+
+llvm::MCInst shr64ri(RegLLVM reg, rword imm);
+
+llvm::MCInst shl32ri(RegLLVM reg, rword imm);
+
+llvm::MCInst shl64ri(RegLLVM reg, rword imm);
+
+llvm::MCInst and32ri8(RegLLVM reg, rword imm);
+
+llvm::MCInst and64ri8(RegLLVM reg, rword imm);
+
+llvm::MCInst and32ri(RegLLVM reg, rword imm);
+
+llvm::MCInst and64ri32(RegLLVM reg, rword imm);
+
+llvm::MCInst call32r(RegLLVM reg);
+
+llvm::MCInst call64r(RegLLVM reg);
+
+llvm::MCInst cld();
+
+llvm::MCInst add32rm(RegLLVM dst, RegLLVM base, rword offset);
+
+llvm::MCInst add64rm(RegLLVM dst, RegLLVM base, rword offset);
+
+llvm::MCInst cmp32rm(RegLLVM reg, RegLLVM base, rword offset);
+
+llvm::MCInst cmp64rm(RegLLVM reg, RegLLVM base, rword offset);
+
+llvm::MCInst cmp32rr(RegLLVM reg1, RegLLVM reg2);
+
+llvm::MCInst cmp64rr(RegLLVM reg1, RegLLVM reg2);
+
+llvm::MCInst inc32m(RegLLVM base, rword offset);
+
+llvm::MCInst inc64m(RegLLVM base, rword offset);
+
+llvm::MCInst inc8m(RegLLVM base, RegLLVM index);
+
+llvm::MCInst seto(RegLLVM reg);
+
+llvm::MCInst add8i8(uint8_t imm);
+
+llvm::MCInst lahf();
+
+llvm::MCInst sahf();
+
 // high level layer 2
 
 std::unique_ptr<RelocatableInst> JmpM(Offset offset);
@@ -138,12 +209,26 @@ std::unique_ptr<RelocatableInst> Fxsave(Offset offset);
 
 std::unique_ptr<RelocatableInst> Fxrstor(Offset offset);
 
+std::unique_ptr<RelocatableInst> Xsave(Offset offset);
+
+std::unique_ptr<RelocatableInst> Xsaveopt(Offset offset);
+
+std::unique_ptr<RelocatableInst> Xrstor(Offset offset);
+
 std::unique_ptr<RelocatableInst> Vextractf128(Offset offset, RegLLVM src,
                                               Constant regoffset);
 
 std::unique_ptr<RelocatableInst> Vinsertf128(RegLLVM dst, Offset offset,
                                              Constant regoffset);
 
+std::unique_ptr<RelocatableInst> Movupsrm(RegLLVM dst, Offset offset);
+
+std::unique_ptr<RelocatableInst> Movupsmr(Offset offset, RegLLVM src);
+
+std::unique_ptr<RelocatableInst> Ldmxcsr(Offset offset);
+
+std::unique_ptr<RelocatableInst> Stmxcsr(Offset offset);
+
 std::unique_ptr<RelocatableInst> Pushr(Reg reg);
 
 std::unique_ptr<RelocatableInst> Popr(Reg reg);
@@ -162,6 +247,14 @@ std::unique_ptr<RelocatableInst> Je(int32_t offset);
 
 std::unique_ptr<RelocatableInst> Jne(int32_t offset);
 
+std::unique_ptr<RelocatableInst> Jb(int32_t offset);
+
+std::unique_ptr<RelocatableInst> Jae(int32_t offset);
+
+std::unique_ptr<RelocatableInst> Jmp(int32_t offset);
+
+std::unique_ptr<RelocatableInst> Jrcxz(int32_t offset);
+
 std::unique_ptr<RelocatableInst> Rdfsbase(Reg reg);
 
 std::unique_ptr<RelocatableInst> Rdgsbase(Reg reg);
@@ -177,6 +270,48 @@ std::unique_ptr<RelocatableInst> Lea(RegLLVM dst, RegLLVM base, rword scale,
 
 std::unique_ptr<RelocatableInst> MovzxrAL(Reg dst);
 
+std::unique_ptr<RelocatableInst> Mov32ri(RegLLVM dst, Constant cst);
+
+std::unique_ptr<RelocatableInst> Movzxrr8(RegLLVM dst, RegLLVM src);
+
+std::unique_ptr<RelocatableInst> Shr(Reg reg, Constant cst);
+
+std::unique_ptr<RelocatableInst> Shl(Reg reg, Constant cst);
+
+std::unique_ptr<RelocatableInst> Andri8(Reg reg, Constant cst);
+
+std::unique_ptr<RelocatableInst> Andri(Reg reg, Constant cst);
+
+std::unique_ptr<RelocatableInst> CallR(Reg reg);
+
+std::unique_ptr<RelocatableInst> Cld();
+
+std::unique_ptr<RelocatableInst> AddM(Reg dst, Offset offset);
+
+std::unique_ptr<RelocatableInst> Cmp(Reg reg, Reg base);
+
+std::unique_ptr<RelocatableInst> Cmprr(RegLLVM reg1, RegLLVM reg2);
+
+std::unique_ptr<RelocatableInst> IncM(Offset offset);
+
+std::unique_ptr<RelocatableInst> Inc8m(RegLLVM base, RegLLVM index);
+
+std::unique_ptr<RelocatableInst> SetoAL();
+
+std::unique_ptr<RelocatableInst> AddALi8(uint8_t imm);
+
+std::unique_ptr<RelocatableInst> Lahf();
+
+std::unique_ptr<RelocatableInst> Sahf();
+
+std::unique_ptr<RelocatableInst> MovzxM8(RegLLVM dst, Offset offset);
+
+std::unique_ptr<RelocatableInst> LeaM(RegLLVM dst, Offset offset);
+
+std::unique_ptr<RelocatableInst> Movmr(RegLLVM addr, rword disp, RegLLVM src);
+
+std::unique_ptr<RelocatableInst> Movrm(RegLLVM dst, RegLLVM addr, rword disp);
+
 std::unique_ptr<RelocatableInst> Mov64rm(RegLLVM dst, RegLLVM addr,
                                          RegLLVM seg);
 
@@ -65,6 +65,8 @@ enum MemoryTag : uint16_t {
   MEM_READ_0_END_ADDRESS_TAG = MEMORY_TAG_BEGIN + 7,
   MEM_READ_1_END_ADDRESS_TAG = MEMORY_TAG_BEGIN + 8,
   MEM_WRITE_END_ADDRESS_TAG = MEMORY_TAG_BEGIN + 9,
+
+  MEM_TRACE_WRITE_ADDRESS_TAG = MEMORY_TAG_BEGIN + 10,
 };
 
 void analyseMemoryAccessAddrValue(const ExecBlock &curExecBlock,
@@ -418,4 +420,204 @@ std::vector<std::unique_ptr<InstrRule>> getInstrRuleMemAccessWrite() {
           false, PRIORITY_MEMACCESS_LIMIT, RelocTagPostInstMemAccess));
 }
 
+namespace {
+
+class InstrRuleMemoryTrace
+    : public AutoUnique<InstrRule, InstrRuleMemoryTrace> {
+
+  MemoryTrace *trace;
+
+  void instrumentAccess(Patch &patch, PatchGenerator::UniquePtrVec &&patchGen,
+                        InstPosition position, RelocatableInstTag tag) const {
+    // The flush is a separated patch, after the restoration of the temporary
+    // registers of the access
+    instrument(patch, patchGen, false, position, priority, tag);
+    instrument(patch,
+               conv_unique<PatchGenerator>(FlushMemoryTrace::unique(trace)),
+               false, position, priority, tag);
+  }
+
+public:
+  InstrRuleMemoryTrace(MemoryTrace *trace)
+      : AutoUnique<InstrRule, InstrRuleMemoryTrace>(PRIORITY_MEMACCESS_LIMIT +
+                                                    2),
+        trace(trace) {}
+
+  RangeSet<rword> affectedRange() const override {
+    RangeSet<rword> r;
+    r.add(Range<rword>(0, (rword)-1, real_addr_t()));
+    return r;
+  }
+
+  bool tryInstrument(Patch &patch, const LLVMCPU &llvmcpu) const override {
+    const llvm::MCInst &inst = patch.metadata.inst;
+    uint16_t readSize = getReadSize(inst, llvmcpu);
+    uint16_t writeSize = getWriteSize(inst, llvmcpu);
+    bool noValue = llvmcpu.hasOptions(Options::OPT_DISABLE_MEMORYACCESS_VALUE);
+
+    if (readSize == 0 and writeSize == 0) {
+      return false;
+    }
+
+    if (readSize > 0) {
+      MemoryAccessFlags flags = MEMORY_NO_FLAGS;
+      if (hasREPPrefix(inst)) {
+        flags = MEMORY_UNKNOWN_SIZE | MEMORY_UNKNOWN_VALUE;
+        readSize = 0;
+      } else {
+        if (readSize > sizeof(rword) or noValue) {
+          flags |= MEMORY_UNKNOWN_VALUE;
+        }
+        if (isMinSizeRead(inst)) {
+          flags |= MEMORY_MINIMUM_SIZE;
+        }
+      }
+      size_t nbRead = isDoubleRead(inst) ? 2 : 1;
+      for (size_t i = 0; i < nbRead; i++) {
+        PatchGenerator::UniquePtrVec patchGen;
+        patchGen.push_back(GetReadAddress::unique(Temp(0), i));
+        if ((flags & MEMORY_UNKNOWN_VALUE) == 0) {
+          patchGen.push_back(GetReadValue::unique(Temp(1), Temp(0)));
+        }
+        patchGen.push_back(WriteMemoryTrace::unique(
+            Temp(0), Temp(1), Temp(2), trace, readSize, MEMORY_READ, flags));
+        instrumentAccess(patch, std::move(patchGen), PREINST,
+                         RelocTagPreInstMemAccess);
+      }
+    }
+
+    if (writeSize > 0) {
+      const llvm::MCInstrDesc &desc = llvmcpu.getMCII().get(inst.getOpcode());
+      MemoryAccessFlags flags = MEMORY_NO_FLAGS;
+      PatchGenerator::UniquePtrVec patchGen;
+
+      if (hasREPPrefix(inst)) {
+        patchGen.push_back(GetWriteAddress::unique(Temp(0)));
+        patchGen.push_back(WriteMemoryTrace::unique(
+            Temp(0), Temp(1), Temp(2), trace, 0, MEMORY_WRITE,
+            MEMORY_UNKNOWN_SIZE | MEMORY_UNKNOWN_VALUE));
+        instrumentAccess(patch, std::move(patchGen), PREINST,
+                         RelocTagPreInstMemAccess);
+        return true;
+      }
+
+      if (writeSize > sizeof(rword) or noValue) {
+        flags |= MEMORY_UNKNOWN_VALUE;
+      }
+      if (isMinSizeRead(inst)) {
+        flags |= MEMORY_MINIMUM_SIZE;
+      }
+      // Some instruction need to have the address get before the instruction
+      if (mayChangeWriteAddr(inst, desc) and not isStackWrite(inst)) {
+        instrument(patch,
+                   conv_unique<PatchGenerator>(
+                       GetWriteAddress::unique(Temp(0)),
+                       WriteTemp::unique(
+                           Temp(0), Shadow(MEM_TRACE_WRITE_ADDRESS_TAG))),
+                   false, PREINST, priority, RelocTagPreInstMemAccess);
+        patchGen.push_back(
+            ReadTemp::unique(Temp(0), Shadow(MEM_TRACE_WRITE_ADDRESS_TAG)));
+      } else {
+        patchGen.push_back(GetWriteAddress::unique(Temp(0)));
+      }
+      if ((flags & MEMORY_UNKNOWN_VALUE) == 0) {
+        patchGen.push_back(GetWriteValue::unique(Temp(1), Temp(0)));
+      }
+      patchGen.push_back(WriteMemoryTrace::unique(
+          Temp(0), Temp(1), Temp(2), trace, writeSize, MEMORY_WRITE, flags));
+      instrumentAccess(patch, std::move(patchGen), POSTINST,
+                       RelocTagPostInstMemAccess);
+    }
+    return true;
+  }
+};
+
+} // namespace
+
+std::vector<std::unique_ptr<InstrRule>>
+getInstrRuleMemoryTrace(MemoryTrace *trace) {
+  if constexpr (is_x86) {
+    // The memory trace isn't supported on this architecture
+    return {};
+  } else {
+    return conv_unique<InstrRule>(InstrRuleMemoryTrace::unique(trace));
+  }
+}
+
+PatchGenerator::UniquePtrVec
+getMemRangeGate(const Patch &patch, const LLVMCPU &llvmcpu,
+                InstPosition position, const RangeSet<rword> &readRanges,
+                const RangeSet<rword> &writeRanges, InstCallback cbk,
+                void *data) {
+  const llvm::MCInst &inst = patch.metadata.inst;
+  // The size of these accesses isn't known before the execution
+  if (hasREPPrefix(inst) or isMinSizeRead(inst)) {
+    return {};
+  }
+
+  std::vector<MemRangeCheck> checks;
+  uint16_t readSize = getReadSize(inst, llvmcpu);
+  if (readSize > 0 and not readRanges.getRanges().empty()) {
+    // the two reads of a double read share the tag of their shadows
+    if (isDoubleRead(inst) or
+        readRanges.getRanges().size() > MEMORY_GATE_INLINE_RANGES) {
+      return {};
+    }
+    checks.push_back(
+        {MEM_READ_ADDRESS_TAG, readSize, readRanges.getRanges()});
+  }
+  uint16_t writeSize = getWriteSize(inst, llvmcpu);
+  if (writeSize > 0 and position == POSTINST and
+      not writeRanges.getRanges().empty()) {
+    if (writeRanges.getRanges().size() > MEMORY_GATE_INLINE_RANGES) {
+      return {};
+    }
+    checks.push_back(
+        {MEM_WRITE_ADDRESS_TAG, writeSize, writeRanges.getRanges()});
+  }
+  if (checks.empty()) {
+    return {};
+  }
+
+  return conv_unique<PatchGenerator>(
+      MemRangeGate::unique(std::move(checks), cbk, data, position));
+}
+
+// Compile the operations of an inline instrumentation with an InlineGate. The
+// addresses of the accesses whose shadows aren't tagged as a single access,
+// and the registers after the GPR (PC, flags, FS and GS) are read by the host.
+PatchGenerator::UniquePtrVec
+getInlineGate(const Patch &patch, const LLVMCPU &llvmcpu,
+              InstPosition position, const std::vector<InlineOp> &ops,
+              InstCallback cbk, void *data) {
+  const llvm::MCInst &inst = patch.metadata.inst;
+  for (const InlineOp &op : ops) {
+    switch (op.opcode) {
+      case INLINE_LOAD_OPERAND:
+        return {};
+      case INLINE_LOAD_REG:
+        if (op.value >= REG_PC) {
+          return {};
+        }
+        break;
+      case INLINE_LOAD_READ_ADDRESS:
+        if (hasREPPrefix(inst) or isMinSizeRead(inst) or isDoubleRead(inst)) {
+          return {};
+        }
+        break;
+      case INLINE_LOAD_WRITE_ADDRESS:
+        if (hasREPPrefix(inst)) {
+          return {};
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  return conv_unique<PatchGenerator>(
+      InlineGate::unique(ops, MEM_READ_ADDRESS_TAG, MEM_WRITE_ADDRESS_TAG, cbk,
+                         data, position));
+}
+
 } // namespace QBDI
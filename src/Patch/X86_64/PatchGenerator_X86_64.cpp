@@ -15,6 +15,7 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <utility>
@@ -25,11 +26,15 @@
 #include "llvm/MC/MCInstrDesc.h"
 #include "llvm/MC/MCInstrInfo.h"
 
+#include "QBDI/Callback.h"
 #include "QBDI/Config.h"
 #include "QBDI/Options.h"
 #include "QBDI/Platform.h"
 #include "Engine/LLVMCPU.h"
+#include "ExecBlock/Context.h"
 #include "Patch/InstInfo.h"
+#include "Patch/InstrRules.h"
+#include "Patch/MemoryAccess.h"
 #include "Patch/Patch.h"
 #include "Patch/RelocatableInst.h"
 #include "Patch/TempManager.h"
@@ -87,6 +92,28 @@ GetPCOffset::generate(const Patch &patch, TempManager &temp_manager) const {
   _QBDI_UNREACHABLE();
 }
 
+// GetChainSlot
+// ============
+
+RelocatableInst::UniquePtrVec
+GetChainSlot::generate(const Patch &patch, TempManager &temp_manager) const {
+  if (type == ConstantType) {
+    return conv_unique<RelocatableInst>(
+        LoadChainSlot::unique(temp_manager.getRegForTemp(temp),
+                              patch.metadata.endAddress() + cst));
+  } else if (type == OperandType) {
+    QBDI_REQUIRE_ABORT(op < patch.metadata.inst.getNumOperands(),
+                       "Invalid operand {} {}", op, patch);
+    QBDI_REQUIRE_ABORT(patch.metadata.inst.getOperand(op).isImm(),
+                       "Unexpected operand type {}", patch);
+    return conv_unique<RelocatableInst>(LoadChainSlot::unique(
+        temp_manager.getRegForTemp(temp),
+        patch.metadata.endAddress() +
+            patch.metadata.inst.getOperand(op).getImm()));
+  }
+  _QBDI_UNREACHABLE();
+}
+
 // SimulateCall
 // ============
 
@@ -119,6 +146,50 @@ SimulateRet::generate(const Patch &patch, TempManager &temp_manager) const {
   return p;
 }
 
+// ReturnStackPush
+// ===============
+
+RelocatableInst::UniquePtrVec
+ReturnStackPush::generate(const Patch &patch, TempManager &temp_manager) const {
+  static constexpr rword entrySize = sizeof(ReturnStack::entries[0]);
+  static_assert(RETURN_STACK_SIZE * entrySize == 256);
+  Reg reg1 = temp_manager.getRegForTemp(temp1);
+  Reg reg2 = temp_manager.getRegForTemp(temp2);
+  rword returnAddress = patch.metadata.endAddress();
+
+  // Only LEA and MOV are used to keep the flags of the guest. The offset of the
+  // top entry wraps around with the 8 bits load.
+  return conv_unique<RelocatableInst>(
+      MovzxM8(reg1, Offset(offsetof(Context, returnStack.top))),
+      Lea(reg1, reg1, 1, 0, entrySize, 0),
+      StoreDataBlock::unique(reg1, Offset(offsetof(Context, returnStack.top))),
+      LeaM(reg2, Offset(offsetof(Context, returnStack.entries))),
+      Lea(reg2, reg2, 1, reg1, 0, 0), LoadImm::unique(reg1, returnAddress),
+      Movmr(reg2, 0, reg1), LoadChainSlotAddress::unique(reg1, returnAddress),
+      Movmr(reg2, sizeof(rword), reg1));
+}
+
+// ReturnStackPop
+// ==============
+
+RelocatableInst::UniquePtrVec
+ReturnStackPop::generate(const Patch &patch, TempManager &temp_manager) const {
+  static constexpr rword entrySize = sizeof(ReturnStack::entries[0]);
+  Reg reg1 = temp_manager.getRegForTemp(temp1);
+  Reg reg2 = temp_manager.getRegForTemp(temp2);
+
+  // The previous offset is computed with an addition, as only the lower byte is
+  // loaded by the next access.
+  return conv_unique<RelocatableInst>(
+      MovzxM8(reg1, Offset(offsetof(Context, returnStack.top))),
+      Lea(reg2, reg1, 1, 0, 256 - entrySize, 0),
+      StoreDataBlock::unique(reg2, Offset(offsetof(Context, returnStack.top))),
+      LeaM(reg2, Offset(offsetof(Context, returnStack.entries))),
+      Lea(reg2, reg2, 1, reg1, 0, 0),
+      StoreDataBlock::unique(reg2,
+                             Offset(offsetof(Context, returnStack.entry))));
+}
+
 // GetReadAddress
 // ==============
 
@@ -451,4 +522,585 @@ GetWriteValue::generate(const Patch &patch, TempManager &temp_manager) const {
   }
 }
 
+// WriteMemoryTrace
+// ================
+
+#if defined(QBDI_ARCH_X86_64)
+// The accesses are written with 64 bits stores
+static_assert(offsetof(MemoryAccess, instAddress) == 0);
+static_assert(offsetof(MemoryAccess, accessAddress) == 8);
+static_assert(offsetof(MemoryAccess, value) == 16);
+static_assert(offsetof(MemoryAccess, size) == 24);
+static_assert(offsetof(MemoryAccess, type) == 28);
+static_assert(offsetof(MemoryAccess, flags) == 32);
+static_assert(sizeof(MemoryAccess) == 40);
+static_assert(offsetof(MemoryTrace, remaining) ==
+              offsetof(MemoryTrace, cursor) + sizeof(rword));
+#endif
+
+RelocatableInst::UniquePtrVec
+WriteMemoryTrace::generate(const Patch &patch,
+                           TempManager &temp_manager) const {
+  QBDI_REQUIRE_ABORT(is_x86_64, "The memory trace is only supported on X86_64");
+  Reg addrReg = temp_manager.getRegForTemp(address);
+  Reg valueReg = temp_manager.getRegForTemp(value);
+  Reg cursorReg = temp_manager.getRegForTemp(temp);
+  rword cursorAddr = reinterpret_cast<rword>(&trace->cursor);
+
+  RelocatableInst::UniquePtrVec write;
+  write.push_back(LoadImm::unique(cursorReg, cursorAddr));
+  write.push_back(Mov64rm(cursorReg, cursorReg, 0));
+  write.push_back(
+      Movmr(cursorReg, offsetof(MemoryAccess, accessAddress), addrReg));
+  if ((flags & MEMORY_UNKNOWN_VALUE) != 0) {
+    write.push_back(LoadImm::unique(valueReg, 0));
+  }
+  write.push_back(Movmr(cursorReg, offsetof(MemoryAccess, value), valueReg));
+  write.push_back(LoadImm::unique(valueReg, patch.metadata.address));
+  write.push_back(
+      Movmr(cursorReg, offsetof(MemoryAccess, instAddress), valueReg));
+  write.push_back(LoadImm::unique(
+      valueReg, static_cast<rword>(size) | (static_cast<rword>(type) << 32)));
+  write.push_back(Movmr(cursorReg, offsetof(MemoryAccess, size), valueReg));
+  write.push_back(LoadImm::unique(valueReg, static_cast<rword>(flags)));
+  write.push_back(Movmr(cursorReg, offsetof(MemoryAccess, flags), valueReg));
+
+  // Only LEA and MOV are used to keep the flags of the guest
+  write.push_back(Lea(cursorReg, cursorReg, 1, 0, sizeof(MemoryAccess), 0));
+  write.push_back(LoadImm::unique(valueReg, cursorAddr));
+  write.push_back(Movmr(valueReg, 0, cursorReg));
+  write.push_back(Lea(valueReg, valueReg, 1, 0, sizeof(rword), 0));
+  write.push_back(Mov64rm(cursorReg, valueReg, 0));
+  write.push_back(Lea(cursorReg, cursorReg, 1, 0, static_cast<rword>(-1), 0));
+  write.push_back(Movmr(valueReg, 0, cursorReg));
+
+  return write;
+}
+
+// FlushMemoryTrace
+// ================
+
+RelocatableInst::UniquePtrVec
+FlushMemoryTrace::generate(const Patch &patch,
+                           TempManager &temp_manager) const {
+  QBDI_REQUIRE_ABORT(is_x86_64, "The memory trace is only supported on X86_64");
+  const LLVMCPU &llvmcpu = *patch.llvmcpu;
+  // JRCXZ only tests RCX
+  static const Reg rcx = Reg(2);
+
+  RelocatableInst::UniquePtrVec flush;
+  RelocatableInst::UniquePtrVec notFull;
+  RelocatableInst::UniquePtrVec full;
+
+  // Buffer full: call memoryTraceFullCB in the host
+  full.push_back(
+      LoadImm::unique(rcx, reinterpret_cast<rword>(memoryTraceFullCB)));
+  append(full, SaveReg(rcx, Offset(offsetof(Context, hostState.callback)))
+                   .genReloc(llvmcpu));
+  full.push_back(LoadImm::unique(rcx, reinterpret_cast<rword>(trace)));
+  append(full, SaveReg(rcx, Offset(offsetof(Context, hostState.data)))
+                   .genReloc(llvmcpu));
+  full.push_back(InstId::unique(rcx));
+  append(full, SaveReg(rcx, Offset(offsetof(Context, hostState.origin)))
+                   .genReloc(llvmcpu));
+  append(full, getBreakToHost(rcx, patch, true));
+
+  int fullSize = 0;
+  for (const auto &inst : full) {
+    fullSize += inst->getSize(llvmcpu);
+  }
+
+  // Free accesses remain: restore RCX and skip the break to host
+  append(notFull, LoadReg(rcx, Offset(rcx)).genReloc(llvmcpu));
+  notFull.push_back(Jmp(fullSize + 4));
+
+  int notFullSize = 0;
+  for (const auto &inst : notFull) {
+    notFullSize += inst->getSize(llvmcpu);
+  }
+
+  append(flush, SaveReg(rcx, Offset(rcx)).genReloc(llvmcpu));
+  flush.push_back(
+      LoadImm::unique(rcx, reinterpret_cast<rword>(&trace->remaining)));
+  flush.push_back(Mov64rm(rcx, rcx, 0));
+  flush.push_back(Jrcxz(notFullSize + 1));
+  append(flush, std::move(notFull));
+  // target jrcxz
+  append(flush, std::move(full));
+
+  return flush;
+}
+
+// MemRangeGate
+// ============
+
+// LAHF and SETO use AH and AL
+static const Reg gateRAX = Reg(0);
+static const Reg gateRCX = Reg(2);
+static const Reg gateRDX = Reg(3);
+
+// The exits of a gate: the miss restores the flags and the registers and
+// skips the hit, the hit calls the callback in the host, or with the stub of
+// the fast callbacks.
+static void genGateExits(const Patch &patch, InstCallback cbk, void *data,
+                         InstPosition position,
+                         RelocatableInst::UniquePtrVec &miss,
+                         RelocatableInst::UniquePtrVec &hit,
+                         bool fastCall = false) {
+  const LLVMCPU &llvmcpu = *patch.llvmcpu;
+
+  hit.push_back(AddALi8(0x7f));
+  hit.push_back(Sahf());
+  append(hit, LoadReg(gateRAX, Offset(gateRAX)).genReloc(llvmcpu));
+  append(hit, LoadReg(gateRDX, Offset(gateRDX)).genReloc(llvmcpu));
+  // The callback may use the PC, as with getBreakToHost
+  if (position == InstPosition::PREINST or patch.metadata.modifyPC == false) {
+    rword address = (position == InstPosition::PREINST)
+                        ? patch.metadata.address
+                        : patch.metadata.endAddress();
+    hit.push_back(LoadImm::unique(gateRCX, address));
+    append(hit, SaveReg(gateRCX, Offset(Reg(REG_PC))).genReloc(llvmcpu));
+  }
+  hit.push_back(LoadImm::unique(gateRCX, reinterpret_cast<rword>(cbk)));
+  append(hit, SaveReg(gateRCX, Offset(offsetof(Context, hostState.callback)))
+                  .genReloc(llvmcpu));
+  hit.push_back(LoadImm::unique(gateRCX, reinterpret_cast<rword>(data)));
+  append(hit, SaveReg(gateRCX, Offset(offsetof(Context, hostState.data)))
+                  .genReloc(llvmcpu));
+  hit.push_back(InstId::unique(gateRCX));
+  append(hit, SaveReg(gateRCX, Offset(offsetof(Context, hostState.origin)))
+                  .genReloc(llvmcpu));
+  if (fastCall) {
+    append(hit, getFastCallToHost(gateRCX, patch, true));
+  } else {
+    append(hit, getBreakToHost(gateRCX, patch, true));
+  }
+
+  int hitSize = 0;
+  for (const auto &inst : hit) {
+    hitSize += inst->getSize(llvmcpu);
+  }
+
+  miss.push_back(AddALi8(0x7f));
+  miss.push_back(Sahf());
+  append(miss, LoadReg(gateRAX, Offset(gateRAX)).genReloc(llvmcpu));
+  append(miss, LoadReg(gateRCX, Offset(gateRCX)).genReloc(llvmcpu));
+  append(miss, LoadReg(gateRDX, Offset(gateRDX)).genReloc(llvmcpu));
+  miss.push_back(Jmp(hitSize + 4));
+}
+
+// Save RAX, RCX, RDX and the flags
+static void genGateEntry(const LLVMCPU &llvmcpu,
+                         RelocatableInst::UniquePtrVec &gate) {
+  append(gate, SaveReg(gateRAX, Offset(gateRAX)).genReloc(llvmcpu));
+  append(gate, SaveReg(gateRCX, Offset(gateRCX)).genReloc(llvmcpu));
+  append(gate, SaveReg(gateRDX, Offset(gateRDX)).genReloc(llvmcpu));
+  gate.push_back(SetoAL());
+  gate.push_back(Lahf());
+}
+
+RelocatableInst::UniquePtrVec
+MemRangeGate::generate(const Patch &patch, TempManager &temp_manager) const {
+  const LLVMCPU &llvmcpu = *patch.llvmcpu;
+  const Reg rcx = gateRCX;
+  const Reg rdx = gateRDX;
+
+  RelocatableInst::UniquePtrVec gate;
+  RelocatableInst::UniquePtrVec miss;
+  RelocatableInst::UniquePtrVec hit;
+  genGateExits(patch, cbk, data, position, miss, hit);
+
+  int missSize = 0;
+  for (const auto &inst : miss) {
+    missSize += inst->getSize(llvmcpu);
+  }
+
+  // Comparisons: the access [address, address + size) overlaps the range
+  // [start, end) if (address + size - 1 - start) < (end - start + size - 1)
+  std::vector<RelocatableInst::UniquePtrVec> comparisons;
+  for (const MemRangeCheck &check : checks) {
+    for (const Range<rword> &range : check.ranges) {
+      RelocatableInst::UniquePtrVec comparison;
+      comparison.push_back(LoadShadow::unique(rcx, Shadow(check.tag)));
+      comparison.push_back(LoadImm::unique(
+          rdx, static_cast<rword>(check.size) - 1 - range.start()));
+      comparison.push_back(Lea(rcx, rcx, 1, rdx, 0, 0));
+      comparison.push_back(
+          LoadImm::unique(rdx, range.end() - range.start() + check.size - 1));
+      comparison.push_back(Cmprr(rcx, rdx));
+      comparisons.push_back(std::move(comparison));
+    }
+  }
+
+  // offset of each JB to the hit
+  int toHit = missSize;
+  std::vector<int> jumpOffsets(comparisons.size());
+  for (size_t i = comparisons.size(); i > 0; i--) {
+    jumpOffsets[i - 1] = toHit;
+    toHit += 6;
+    for (const auto &inst : comparisons[i - 1]) {
+      toHit += inst->getSize(llvmcpu);
+    }
+  }
+
+  genGateEntry(llvmcpu, gate);
+  for (size_t i = 0; i < comparisons.size(); i++) {
+    append(gate, std::move(comparisons[i]));
+    gate.push_back(Jb(jumpOffsets[i] + 4));
+  }
+  append(gate, std::move(miss));
+  // target of the JB
+  append(gate, std::move(hit));
+
+  return gate;
+}
+
+// PredicateGate
+// =============
+
+// The comparison of a predicate holds if (value - start) < size, or if it is
+// greater or equal when the range is excluded.
+static void getPredicateRange(PredicateOperator op, rword constant,
+                              rword constantEnd, rword &start, rword &size,
+                              bool &inside) {
+  start = constant;
+  size = 1;
+  inside = true;
+  switch (op) {
+    case PREDICATE_EQ:
+      break;
+    case PREDICATE_NE:
+      inside = false;
+      break;
+    case PREDICATE_LT:
+      start = 0;
+      size = constant;
+      break;
+    case PREDICATE_GE:
+      start = 0;
+      size = constant;
+      inside = false;
+      break;
+    case PREDICATE_GT:
+      start = constant + 1;
+      size = -start;
+      break;
+    case PREDICATE_LE:
+      start = constant + 1;
+      size = -start;
+      inside = false;
+      break;
+    case PREDICATE_IN_RANGE:
+      size = constantEnd - constant;
+      break;
+    default:
+      QBDI_ABORT("Unexpected predicate operator {}", static_cast<int>(op));
+  }
+}
+
+RelocatableInst::UniquePtrVec
+PredicateGate::generate(const Patch &patch, TempManager &temp_manager) const {
+  const LLVMCPU &llvmcpu = *patch.llvmcpu;
+  const Reg rcx = gateRCX;
+  const Reg rdx = gateRDX;
+
+  rword start, size;
+  bool inside;
+  getPredicateRange(predicate.op, predicate.constant, predicate.constantEnd,
+                    start, size, inside);
+
+  RelocatableInst::UniquePtrVec gate;
+  RelocatableInst::UniquePtrVec miss;
+  RelocatableInst::UniquePtrVec hit;
+  genGateExits(patch, cbk, data, position, miss, hit);
+
+  int missSize = 0;
+  for (const auto &inst : miss) {
+    missSize += inst->getSize(llvmcpu);
+  }
+
+  genGateEntry(llvmcpu, gate);
+  if (predicate.source == PREDICATE_FLAG) {
+    // AH holds the low byte of EFLAGS and AL holds OF
+    if (predicate.reg == 11) {
+      gate.push_back(Movzxrr8(llvm::X86::ECX, llvm::X86::AL));
+    } else {
+      gate.push_back(Movzxrr8(llvm::X86::ECX, llvm::X86::AH));
+      if (predicate.reg != 0) {
+        gate.push_back(Shr(rcx, predicate.reg));
+      }
+      gate.push_back(Andri8(rcx, 1));
+    }
+  } else {
+    Reg reg = Reg(predicate.reg);
+    if (predicate.reg == REG_PC) {
+      rword address = (position == InstPosition::PREINST)
+                          ? patch.metadata.address
+                          : patch.metadata.endAddress();
+      gate.push_back(LoadImm::unique(rcx, address));
+    } else if (reg == gateRAX or reg == gateRCX or reg == gateRDX) {
+      append(gate, LoadReg(rcx, Offset(reg)).genReloc(llvmcpu));
+    } else {
+      gate.push_back(MovReg::unique(rcx, reg));
+    }
+    if (predicate.source == PREDICATE_MEMORY) {
+      gate.push_back(Movrm(rcx, rcx, predicate.offset));
+    }
+  }
+  if (start != 0) {
+    gate.push_back(LoadImm::unique(rdx, -start));
+    gate.push_back(Lea(rcx, rcx, 1, rdx, 0, 0));
+  }
+  gate.push_back(LoadImm::unique(rdx, size));
+  gate.push_back(Cmprr(rcx, rdx));
+  if (inside) {
+    gate.push_back(Jb(missSize + 4));
+  } else {
+    gate.push_back(Jae(missSize + 4));
+  }
+  append(gate, std::move(miss));
+  // target of the JB or JAE
+  append(gate, std::move(hit));
+
+  return gate;
+}
+
+// CountdownGate
+// =============
+
+RelocatableInst::UniquePtrVec
+CountdownGate::generate(const Patch &patch, TempManager &temp_manager) const {
+  const LLVMCPU &llvmcpu = *patch.llvmcpu;
+  const Reg rcx = gateRCX;
+  const Reg rdx = gateRDX;
+
+  RelocatableInst::UniquePtrVec gate;
+  RelocatableInst::UniquePtrVec miss;
+  RelocatableInst::UniquePtrVec hit;
+  genGateExits(patch, cbk, data, position, miss, hit);
+
+  int missSize = 0;
+  for (const auto &inst : miss) {
+    missSize += inst->getSize(llvmcpu);
+  }
+
+  genGateEntry(llvmcpu, gate);
+  gate.push_back(LoadImm::unique(rdx, reinterpret_cast<rword>(countdown)));
+  gate.push_back(Movrm(rcx, rdx, 0));
+  gate.push_back(Lea(rcx, rcx, 1, 0, -step, 0));
+  gate.push_back(Movmr(rdx, 0, rcx));
+  // The countdown expired if it is zero or if it wrapped
+  gate.push_back(Lea(rcx, rcx, 1, 0, -1, 0));
+  gate.push_back(LoadImm::unique(rdx, -(step + 1)));
+  gate.push_back(Cmprr(rcx, rdx));
+  gate.push_back(Jae(missSize + 4));
+  append(gate, std::move(miss));
+  // target of the JAE
+  append(gate, std::move(hit));
+
+  return gate;
+}
+
+// SlotGate
+// ========
+
+RelocatableInst::UniquePtrVec
+SlotGate::generate(const Patch &patch, TempManager &temp_manager) const {
+  const LLVMCPU &llvmcpu = *patch.llvmcpu;
+  const Reg rcx = gateRCX;
+  const Reg rdx = gateRDX;
+
+  RelocatableInst::UniquePtrVec gate;
+  RelocatableInst::UniquePtrVec miss;
+  RelocatableInst::UniquePtrVec hit;
+  genGateExits(patch, cbk, data, position, miss, hit);
+
+  int missSize = 0;
+  for (const auto &inst : miss) {
+    missSize += inst->getSize(llvmcpu);
+  }
+
+  genGateEntry(llvmcpu, gate);
+  gate.push_back(LoadImm::unique(rdx, reinterpret_cast<rword>(armed)));
+  gate.push_back(Movrm(rcx, rdx, 0));
+  gate.push_back(LoadImm::unique(rdx, 1));
+  gate.push_back(Cmprr(rcx, rdx));
+  gate.push_back(Jae(missSize + 4));
+  append(gate, std::move(miss));
+  // target of the JAE
+  append(gate, std::move(hit));
+
+  return gate;
+}
+
+// CoverageEdge
+// ============
+
+RelocatableInst::UniquePtrVec
+CoverageEdge::generate(const Patch &patch, TempManager &temp_manager) const {
+  const LLVMCPU &llvmcpu = *patch.llvmcpu;
+  const Reg rcx = gateRCX;
+  const Reg rdx = gateRDX;
+  rword prevAddr = reinterpret_cast<rword>(coverage->prev);
+
+  RelocatableInst::UniquePtrVec edge;
+  genGateEntry(llvmcpu, edge);
+  edge.push_back(LoadImm::unique(rdx, prevAddr));
+  edge.push_back(Movrm(rcx, rdx, 0));
+  edge.push_back(LoadImm::unique(rdx, cur));
+  edge.push_back(Xorrr(rcx, rdx));
+  edge.push_back(
+      LoadImm::unique(rdx, reinterpret_cast<rword>(coverage->bitmap)));
+  edge.push_back(Inc8m(rdx, rcx));
+  edge.push_back(LoadImm::unique(rdx, prevAddr));
+  edge.push_back(LoadImm::unique(rcx, cur >> 1));
+  edge.push_back(Movmr(rdx, 0, rcx));
+  // restore the flags as the miss path of the gates
+  edge.push_back(AddALi8(0x7f));
+  edge.push_back(Sahf());
+  append(edge, LoadReg(gateRAX, Offset(gateRAX)).genReloc(llvmcpu));
+  append(edge, LoadReg(gateRCX, Offset(gateRCX)).genReloc(llvmcpu));
+  append(edge, LoadReg(gateRDX, Offset(gateRDX)).genReloc(llvmcpu));
+
+  return edge;
+}
+
+// InlineGate
+// ==========
+
+RelocatableInst::UniquePtrVec
+InlineGate::generate(const Patch &patch, TempManager &temp_manager) const {
+  const LLVMCPU &llvmcpu = *patch.llvmcpu;
+  const Reg rcx = gateRCX;
+  const Reg rdx = gateRDX;
+  bool hasCall = (not ops.empty()) and ops.back().opcode == INLINE_CALL;
+
+  // The code of each operation, without the jump of INLINE_SKIP
+  std::vector<RelocatableInst::UniquePtrVec> opsCode(ops.size());
+  std::vector<int> opsSize(ops.size(), 0);
+  for (size_t i = 0; i < ops.size(); i++) {
+    const InlineOp &op = ops[i];
+    RelocatableInst::UniquePtrVec &opCode = opsCode[i];
+    switch (op.opcode) {
+      case INLINE_LOAD_IMM:
+        opCode.push_back(LoadImm::unique(rcx, op.value));
+        break;
+      case INLINE_LOAD_REG: {
+        Reg reg = Reg(op.value);
+        if (reg == gateRAX or reg == gateRCX or reg == gateRDX) {
+          append(opCode, LoadReg(rcx, Offset(reg)).genReloc(llvmcpu));
+        } else {
+          opCode.push_back(MovReg::unique(rcx, reg));
+        }
+        break;
+      }
+      case INLINE_LOAD_READ_ADDRESS:
+        opCode.push_back(LoadShadow::unique(rcx, Shadow(readTag)));
+        break;
+      case INLINE_LOAD_WRITE_ADDRESS:
+        opCode.push_back(LoadShadow::unique(rcx, Shadow(writeTag)));
+        break;
+      case INLINE_LOAD_MEMORY:
+        opCode.push_back(LoadImm::unique(rdx, op.value));
+        opCode.push_back(Movrm(rcx, rdx, 0));
+        break;
+      case INLINE_ADD:
+        opCode.push_back(LoadImm::unique(rdx, op.value));
+        opCode.push_back(Lea(rcx, rcx, 1, rdx, 0, 0));
+        break;
+      case INLINE_STORE:
+        opCode.push_back(LoadImm::unique(rdx, op.value));
+        opCode.push_back(Movmr(rdx, 0, rcx));
+        break;
+      case INLINE_SKIP: {
+        // LEA keeps the flags of the comparison and the accumulator
+        rword start, size;
+        bool inside;
+        getPredicateRange(op.cmp, op.constant, op.constantEnd, start, size,
+                          inside);
+        if (start != 0) {
+          opCode.push_back(LoadImm::unique(rdx, -start));
+          opCode.push_back(Lea(rcx, rcx, 1, rdx, 0, 0));
+        }
+        opCode.push_back(LoadImm::unique(rdx, size));
+        opCode.push_back(Cmprr(rcx, rdx));
+        if (start != 0) {
+          opCode.push_back(LoadImm::unique(rdx, start));
+          opCode.push_back(Lea(rcx, rcx, 1, rdx, 0, 0));
+        }
+        // JB or JAE
+        opsSize[i] += 6;
+        break;
+      }
+      case INLINE_CALL:
+        // the end of the operations jumps to the hit
+        break;
+      default:
+        QBDI_ABORT("Unexpected inline operation {} {}",
+                   static_cast<int>(op.opcode), patch);
+    }
+    for (const auto &inst : opCode) {
+      opsSize[i] += inst->getSize(llvmcpu);
+    }
+  }
+
+  RelocatableInst::UniquePtrVec gate;
+  RelocatableInst::UniquePtrVec miss;
+  RelocatableInst::UniquePtrVec hit;
+  int missSize = 0;
+  if (hasCall) {
+    genGateExits(patch, cbk, data, position, miss, hit, true);
+    for (const auto &inst : miss) {
+      missSize += inst->getSize(llvmcpu);
+    }
+  }
+
+  genGateEntry(llvmcpu, gate);
+  gate.push_back(LoadImm::unique(rcx, 0));
+  for (size_t i = 0; i < ops.size(); i++) {
+    append(gate, std::move(opsCode[i]));
+    if (ops[i].opcode != INLINE_SKIP) {
+      continue;
+    }
+    // The jump skips the code of the next operations. Skipping INLINE_CALL
+    // also skips the jump to the hit.
+    size_t target = ops.size();
+    if (ops[i].value < ops.size() - i - 1) {
+      target = i + 1 + ops[i].value;
+    }
+    int offset = 0;
+    for (size_t j = i + 1; j < target; j++) {
+      offset += opsSize[j];
+    }
+    if (hasCall and target == ops.size()) {
+      offset += 5;
+    }
+    rword start, size;
+    bool inside;
+    getPredicateRange(ops[i].cmp, ops[i].constant, ops[i].constantEnd, start,
+                      size, inside);
+    if (inside) {
+      gate.push_back(Jb(offset + 4));
+    } else {
+      gate.push_back(Jae(offset + 4));
+    }
+  }
+  if (hasCall) {
+    gate.push_back(Jmp(missSize + 4));
+    // target of the skip of INLINE_CALL
+    append(gate, std::move(miss));
+    // target of the JMP
+    append(gate, std::move(hit));
+  } else {
+    // restore the flags as the miss path of the gates
+    gate.push_back(AddALi8(0x7f));
+    gate.push_back(Sahf());
+    append(gate, LoadReg(gateRAX, Offset(gateRAX)).genReloc(llvmcpu));
+    append(gate, LoadReg(gateRCX, Offset(gateRCX)).genReloc(llvmcpu));
+    append(gate, LoadReg(gateRDX, Offset(gateRDX)).genReloc(llvmcpu));
+  }
+
+  return gate;
+}
+
 } // namespace QBDI
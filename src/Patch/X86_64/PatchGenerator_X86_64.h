@@ -22,6 +22,8 @@
 #include <stddef.h>
 #include <vector>
 
+#include "QBDI/Callback.h"
+#include "QBDI/Range.h"
 #include "QBDI/State.h"
 #include "Patch/PatchGenerator.h"
 #include "Patch/PatchUtils.h"
@@ -31,6 +33,8 @@ namespace QBDI {
 class Patch;
 class RelocatableInst;
 class TempManager;
+struct CoverageBitmap;
+struct MemoryTrace;
 
 class GetPCOffset : public AutoClone<PatchGenerator, GetPCOffset> {
 
@@ -76,6 +80,50 @@ public:
   generate(const Patch &patch, TempManager &temp_manager) const override;
 };
 
+class GetChainSlot : public AutoClone<PatchGenerator, GetChainSlot> {
+
+  Temp temp;
+  Constant cst;
+  Operand op;
+  enum {
+    ConstantType,
+    OperandType,
+  } type;
+
+public:
+  /*! Allocate a chain slot for the RIP relative target described by a
+   * constant and copy the current value of the slot in a temporary. The value
+   * is the JIT address of the target sequence if the slot is linked, or the
+   * address of the epilogue.
+   *
+   * @param[in] temp     A temporary where the value will be copied.
+   * @param[in] cst      The constant to be used.
+   */
+  GetChainSlot(Temp temp, Constant cst)
+      : temp(temp), cst(cst), op(0), type(ConstantType) {}
+
+  /*! Allocate a chain slot for the RIP relative target described by an
+   * operand and copy the current value of the slot in a temporary.
+   *
+   * @param[in] temp     A temporary where the value will be copied.
+   * @param[in] op       The  operand index (relative to the instruction
+   *                     LLVM MCInst representation) to be used.
+   */
+  GetChainSlot(Temp temp, Operand op)
+      : temp(temp), cst(0), op(op), type(OperandType) {}
+
+  /*! Output:
+   *
+   * If cst:
+   * MOV REG64 temp, MEM64 DataBlock[ChainSlot(cst + address + instSize)]
+   *
+   * If op is an immediate:
+   * MOV REG64 temp, MEM64 DataBlock[ChainSlot(op + address + instSize)]
+   */
+  std::vector<std::unique_ptr<RelocatableInst>>
+  generate(const Patch &patch, TempManager &temp_manager) const override;
+};
+
 class SimulateCall : public AutoClone<PatchGenerator, SimulateCall> {
 
   Temp temp;
@@ -133,6 +181,65 @@ public:
   bool modifyPC() const override { return true; }
 };
 
+class ReturnStackPush : public AutoClone<PatchGenerator, ReturnStackPush> {
+
+  Temp temp1;
+  Temp temp2;
+
+public:
+  /*! Push the return address of a call instruction on the return stack of the
+   * ExecBlock, with the address of a chain slot allocated for the return
+   * address. The generator doesn't modify the flags.
+   *
+   * @param[in] temp1   Any unused temporary, overwritten by this generator.
+   * @param[in] temp2   Any unused temporary, overwritten by this generator.
+   */
+  ReturnStackPush(Temp temp1, Temp temp2) : temp1(temp1), temp2(temp2) {}
+
+  /*! Output:
+   *
+   * MOVZX REG64 temp1, MEM8 DataBlock[Offset(ReturnStack.top)]
+   * LEA REG64 temp1, [temp1 + sizeof(entry)]
+   * MOV MEM64 DataBlock[Offset(ReturnStack.top)], REG64 temp1
+   * LEA REG64 temp2, DataBlock[Offset(ReturnStack.entries)]
+   * LEA REG64 temp2, [temp2 + temp1]
+   * MOV REG64 temp1, IMM64 (address + InstSize)
+   * MOV MEM64 [temp2], REG64 temp1
+   * LEA REG64 temp1, DataBlock[ChainSlot(address + InstSize)]
+   * MOV MEM64 [temp2 + 8], REG64 temp1
+   */
+  std::vector<std::unique_ptr<RelocatableInst>>
+  generate(const Patch &patch, TempManager &temp_manager) const override;
+};
+
+class ReturnStackPop : public AutoClone<PatchGenerator, ReturnStackPop> {
+
+  Temp temp1;
+  Temp temp2;
+
+public:
+  /*! Pop the top entry of the return stack of the ExecBlock. The address of the
+   * entry is kept in ReturnStack.entry for the dispatcher. The generator
+   * doesn't modify the flags.
+   *
+   * @param[in] temp1   Any unused temporary, overwritten by this generator.
+   * @param[in] temp2   Any unused temporary, overwritten by this generator.
+   */
+  ReturnStackPop(Temp temp1, Temp temp2) : temp1(temp1), temp2(temp2) {}
+
+  /*! Output:
+   *
+   * MOVZX REG64 temp1, MEM8 DataBlock[Offset(ReturnStack.top)]
+   * LEA REG64 temp2, [temp1 + 256 - sizeof(entry)]
+   * MOV MEM64 DataBlock[Offset(ReturnStack.top)], REG64 temp2
+   * LEA REG64 temp2, DataBlock[Offset(ReturnStack.entries)]
+   * LEA REG64 temp2, [temp2 + temp1]
+   * MOV MEM64 DataBlock[Offset(ReturnStack.entry)], REG64 temp2
+   */
+  std::vector<std::unique_ptr<RelocatableInst>>
+  generate(const Patch &patch, TempManager &temp_manager) const override;
+};
+
 class GetReadAddress : public AutoClone<PatchGenerator, GetReadAddress> {
 
   Temp temp;
@@ -235,6 +342,414 @@ public:
   generate(const Patch &patch, TempManager &temp_manager) const override;
 };
 
+class WriteMemoryTrace : public AutoClone<PatchGenerator, WriteMemoryTrace> {
+
+  Temp address;
+  Temp value;
+  Temp temp;
+  MemoryTrace *trace;
+  uint16_t size;
+  MemoryAccessType type;
+  MemoryAccessFlags flags;
+
+public:
+  /*! Write a memory access of the instruction at the cursor of a memory trace,
+   * and decrement the number of free accesses. The generator doesn't modify
+   * the flags.
+   *
+   * @param[in] address  A temporary with the address of the access.
+   * @param[in] value    A temporary with the value of the access, overwritten
+   *                     by this generator. Unused with MEMORY_UNKNOWN_VALUE.
+   * @param[in] temp     Any unused temporary, overwritten by this generator.
+   * @param[in] trace    The memory trace.
+   * @param[in] size     The size of the access.
+   * @param[in] type     The type of the access.
+   * @param[in] flags    The flags of the access.
+   */
+  WriteMemoryTrace(Temp address, Temp value, Temp temp, MemoryTrace *trace,
+                   uint16_t size, MemoryAccessType type,
+                   MemoryAccessFlags flags)
+      : address(address), value(value), temp(temp), trace(trace), size(size),
+        type(type), flags(flags) {}
+
+  /*! Output:
+   *
+   * MOV REG64 temp, IMM64 &trace->cursor
+   * MOV REG64 temp, MEM64 [temp]
+   * MOV MEM64 [temp + 8], REG64 address
+   * MOV REG64 value, IMM64 0             # if MEMORY_UNKNOWN_VALUE
+   * MOV MEM64 [temp + 16], REG64 value
+   * MOV REG64 value, IMM64 instAddress
+   * MOV MEM64 [temp], REG64 value
+   * MOV REG64 value, IMM64 (size | type << 32)
+   * MOV MEM64 [temp + 24], REG64 value
+   * MOV REG64 value, IMM64 flags
+   * MOV MEM64 [temp + 32], REG64 value
+   * LEA REG64 temp, [temp + sizeof(MemoryAccess)]
+   * MOV REG64 value, IMM64 &trace->cursor
+   * MOV MEM64 [value], REG64 temp
+   * LEA REG64 value, [value + 8]
+   * MOV REG64 temp, MEM64 [value]
+   * LEA REG64 temp, [temp - 1]
+   * MOV MEM64 [value], REG64 temp
+   */
+  std::vector<std::unique_ptr<RelocatableInst>>
+  generate(const Patch &patch, TempManager &temp_manager) const override;
+};
+
+class FlushMemoryTrace : public AutoClone<PatchGenerator, FlushMemoryTrace> {
+
+  MemoryTrace *trace;
+
+public:
+  /*! Break to the host to flush a memory trace when its buffer is full. The
+   * generator saves RCX in the context instead of using a temporary, and
+   * must be used after the temporaries of the accesses have been restored.
+   * The flags aren't modified.
+   *
+   * @param[in] trace    The memory trace.
+   */
+  FlushMemoryTrace(MemoryTrace *trace) : trace(trace) {}
+
+  /*! Output:
+   *
+   * MOV MEM64 DataBlock[Offset(RCX)], REG64 RCX
+   * MOV REG64 RCX, IMM64 &trace->remaining
+   * MOV REG64 RCX, MEM64 [RCX]
+   * JRCXZ full
+   * MOV REG64 RCX, MEM64 DataBlock[Offset(RCX)]
+   * JMP end
+   * full:
+   * MOV REG64 RCX, IMM64 memoryTraceFullCB
+   * MOV MEM64 DataBlock[Offset(hostState.callback)], REG64 RCX
+   * MOV REG64 RCX, IMM64 trace
+   * MOV MEM64 DataBlock[Offset(hostState.data)], REG64 RCX
+   * MOV REG64 RCX, IMM64 instID
+   * MOV MEM64 DataBlock[Offset(hostState.origin)], REG64 RCX
+   * <break to host with RCX>
+   * end:
+   */
+  std::vector<std::unique_ptr<RelocatableInst>>
+  generate(const Patch &patch, TempManager &temp_manager) const override;
+};
+
+/*! A comparison of a memory gate: the access of the last shadow with the tag
+ * and the size is compared with the ranges.
+ */
+struct MemRangeCheck {
+  uint16_t tag;
+  uint16_t size;
+  std::vector<Range<rword>> ranges;
+};
+
+class MemRangeGate : public AutoClone<PatchGenerator, MemRangeGate> {
+
+  std::vector<MemRangeCheck> checks;
+  InstCallback cbk;
+  void *data;
+  InstPosition position;
+
+public:
+  /*! Break to the host to call a callback when an access overlaps a range.
+   * The comparison is done in the JIT code, and the other instructions don't
+   * leave the ExecBlock. The generator saves RAX, RCX and RDX in the context
+   * instead of using temporaries, and keeps the flags in AH:AL with LAHF and
+   * SETO.
+   *
+   * @param[in] checks    The accesses and the ranges to compare.
+   * @param[in] cbk       The callback to call on a hit.
+   * @param[in] data      The data pointer to give to the callback.
+   * @param[in] position  The position of the instrumentation.
+   */
+  MemRangeGate(std::vector<MemRangeCheck> checks, InstCallback cbk,
+               void *data, InstPosition position)
+      : checks(std::move(checks)), cbk(cbk), data(data), position(position) {}
+
+  /*! Output:
+   *
+   * MOV MEM64 DataBlock[Offset(RAX)], REG64 RAX
+   * MOV MEM64 DataBlock[Offset(RCX)], REG64 RCX
+   * MOV MEM64 DataBlock[Offset(RDX)], REG64 RDX
+   * SETO AL
+   * LAHF
+   * # for each range of each check:
+   * MOV REG64 RCX, MEM64 Shadow(tag)
+   * MOV REG64 RDX, IMM64 (size - 1 - range.start)
+   * LEA REG64 RCX, [RCX + RDX]
+   * MOV REG64 RDX, IMM64 (range.end - range.start + size - 1)
+   * CMP REG64 RCX, REG64 RDX
+   * JB hit
+   * # miss:
+   * ADD AL, 0x7f
+   * SAHF
+   * MOV REG64 RAX, MEM64 DataBlock[Offset(RAX)]
+   * MOV REG64 RCX, MEM64 DataBlock[Offset(RCX)]
+   * MOV REG64 RDX, MEM64 DataBlock[Offset(RDX)]
+   * JMP end
+   * hit:
+   * ADD AL, 0x7f
+   * SAHF
+   * MOV REG64 RAX, MEM64 DataBlock[Offset(RAX)]
+   * MOV REG64 RDX, MEM64 DataBlock[Offset(RDX)]
+   * MOV REG64 RCX, IMM64 address      # PREINST or if PC isn't modified
+   * MOV MEM64 DataBlock[Offset(RIP)], REG64 RCX
+   * MOV REG64 RCX, IMM64 cbk
+   * MOV MEM64 DataBlock[Offset(hostState.callback)], REG64 RCX
+   * MOV REG64 RCX, IMM64 data
+   * MOV MEM64 DataBlock[Offset(hostState.data)], REG64 RCX
+   * MOV REG64 RCX, IMM64 instID
+   * MOV MEM64 DataBlock[Offset(hostState.origin)], REG64 RCX
+   * <break to host with RCX>
+   * end:
+   */
+  std::vector<std::unique_ptr<RelocatableInst>>
+  generate(const Patch &patch, TempManager &temp_manager) const override;
+};
+
+class PredicateGate : public AutoClone<PatchGenerator, PredicateGate> {
+
+  CallbackPredicate predicate;
+  InstCallback cbk;
+  void *data;
+  InstPosition position;
+
+public:
+  /*! Break to the host to call a callback when a predicate holds. The
+   * predicate is evaluated in the JIT code with the same registers as
+   * MemRangeGate. The flags are read from AH:AL: only CF, PF, AF, ZF, SF and
+   * OF can be compared.
+   *
+   * @param[in] predicate  The predicate of the callback.
+   * @param[in] cbk        The callback to call when the predicate holds.
+   * @param[in] data       The data pointer to give to the callback.
+   * @param[in] position   The position of the instrumentation.
+   */
+  PredicateGate(const CallbackPredicate &predicate, InstCallback cbk,
+                void *data, InstPosition position)
+      : predicate(predicate), cbk(cbk), data(data), position(position) {}
+
+  /*! Output:
+   *
+   * MOV MEM64 DataBlock[Offset(RAX)], REG64 RAX
+   * MOV MEM64 DataBlock[Offset(RCX)], REG64 RCX
+   * MOV MEM64 DataBlock[Offset(RDX)], REG64 RDX
+   * SETO AL
+   * LAHF
+   * # PREDICATE_GPR and PREDICATE_MEMORY:
+   * MOV REG64 RCX, REG64 reg          # or DataBlock[Offset(reg)] for
+   *                                   # RAX, RCX and RDX, or IMM64 address
+   * MOV REG64 RCX, MEM64 [RCX + offset]   # PREDICATE_MEMORY
+   * # PREDICATE_FLAG:
+   * MOVZX REG32 ECX, REG8 AH          # or AL for OF
+   * SHR REG64 RCX, IMM8 reg
+   * AND REG64 RCX, IMM8 1
+   * # the predicate holds if (value - start) < size, or >= size
+   * MOV REG64 RDX, IMM64 (-start)
+   * LEA REG64 RCX, [RCX + RDX]
+   * MOV REG64 RDX, IMM64 size
+   * CMP REG64 RCX, REG64 RDX
+   * JB hit                            # or JAE
+   * # miss and hit as MemRangeGate
+   */
+  std::vector<std::unique_ptr<RelocatableInst>>
+  generate(const Patch &patch, TempManager &temp_manager) const override;
+};
+
+class CountdownGate : public AutoClone<PatchGenerator, CountdownGate> {
+
+  rword *countdown;
+  rword step;
+  InstCallback cbk;
+  void *data;
+  InstPosition position;
+
+public:
+  /*! Break to the host to call a callback when a countdown expires. The
+   * countdown is decremented by step in the JIT code with the same registers
+   * as MemRangeGate, and expires when it reaches zero or wraps. The callback
+   * must reload it.
+   *
+   * @param[in] countdown  The countdown, shared by the callsites.
+   * @param[in] step       The value to subtract from the countdown.
+   * @param[in] cbk        The callback to call when the countdown expires.
+   * @param[in] data       The data pointer to give to the callback.
+   * @param[in] position   The position of the instrumentation.
+   */
+  CountdownGate(rword *countdown, rword step, InstCallback cbk, void *data,
+                InstPosition position)
+      : countdown(countdown), step(step), cbk(cbk), data(data),
+        position(position) {}
+
+  /*! Output:
+   *
+   * MOV MEM64 DataBlock[Offset(RAX)], REG64 RAX
+   * MOV MEM64 DataBlock[Offset(RCX)], REG64 RCX
+   * MOV MEM64 DataBlock[Offset(RDX)], REG64 RDX
+   * SETO AL
+   * LAHF
+   * MOV REG64 RDX, IMM64 countdown
+   * MOV REG64 RCX, MEM64 [RDX]
+   * LEA REG64 RCX, [RCX - step]
+   * MOV MEM64 [RDX], REG64 RCX
+   * # expired if (countdown - 1) >= -(step + 1)
+   * LEA REG64 RCX, [RCX - 1]
+   * MOV REG64 RDX, IMM64 -(step + 1)
+   * CMP REG64 RCX, REG64 RDX
+   * JAE hit
+   * # miss and hit as MemRangeGate
+   */
+  std::vector<std::unique_ptr<RelocatableInst>>
+  generate(const Patch &patch, TempManager &temp_manager) const override;
+};
+
+class SlotGate : public AutoClone<PatchGenerator, SlotGate> {
+
+  rword *armed;
+  InstCallback cbk;
+  void *data;
+  InstPosition position;
+
+public:
+  /*! Break to the host to call a callback when a slot is armed. The slot is
+   * read in the JIT code with the same registers as MemRangeGate.
+   *
+   * @param[in] armed     The slot, armed if not zero.
+   * @param[in] cbk       The callback to call when the slot is armed.
+   * @param[in] data      The data pointer to give to the callback.
+   * @param[in] position  The position of the instrumentation.
+   */
+  SlotGate(rword *armed, InstCallback cbk, void *data, InstPosition position)
+      : armed(armed), cbk(cbk), data(data), position(position) {}
+
+  /*! Output:
+   *
+   * MOV MEM64 DataBlock[Offset(RAX)], REG64 RAX
+   * MOV MEM64 DataBlock[Offset(RCX)], REG64 RCX
+   * MOV MEM64 DataBlock[Offset(RDX)], REG64 RDX
+   * SETO AL
+   * LAHF
+   * MOV REG64 RDX, IMM64 armed
+   * MOV REG64 RCX, MEM64 [RDX]
+   * MOV REG64 RDX, IMM64 1
+   * CMP REG64 RCX, REG64 RDX
+   * JAE hit
+   * # miss and hit as MemRangeGate
+   */
+  std::vector<std::unique_ptr<RelocatableInst>>
+  generate(const Patch &patch, TempManager &temp_manager) const override;
+};
+
+class CoverageEdge : public AutoClone<PatchGenerator, CoverageEdge> {
+
+  CoverageBitmap *coverage;
+  rword cur;
+
+public:
+  /*! Increment the counter of the edge between the previous basic block and
+   * this one in the bitmap of the edge coverage, with the same registers as
+   * MemRangeGate. The counter wraps as in AFL.
+   *
+   * @param[in] coverage  The edge coverage.
+   * @param[in] cur       The location of this basic block, lower or equal to
+   *                      the mask of the bitmap.
+   */
+  CoverageEdge(CoverageBitmap *coverage, rword cur)
+      : coverage(coverage), cur(cur) {}
+
+  /*! Output:
+   *
+   * MOV MEM64 DataBlock[Offset(RAX)], REG64 RAX
+   * MOV MEM64 DataBlock[Offset(RCX)], REG64 RCX
+   * MOV MEM64 DataBlock[Offset(RDX)], REG64 RDX
+   * SETO AL
+   * LAHF
+   * MOV REG64 RDX, IMM64 coverage->prev
+   * MOV REG64 RCX, MEM64 [RDX]
+   * MOV REG64 RDX, IMM64 cur
+   * XOR REG64 RCX, REG64 RDX
+   * MOV REG64 RDX, IMM64 coverage->bitmap
+   * INC MEM8 [RDX + RCX]
+   * MOV REG64 RDX, IMM64 coverage->prev
+   * MOV REG64 RCX, IMM64 (cur >> 1)
+   * MOV MEM64 [RDX], REG64 RCX
+   * ADD AL, 0x7f
+   * SAHF
+   * MOV REG64 RAX, MEM64 DataBlock[Offset(RAX)]
+   * MOV REG64 RCX, MEM64 DataBlock[Offset(RCX)]
+   * MOV REG64 RDX, MEM64 DataBlock[Offset(RDX)]
+   */
+  std::vector<std::unique_ptr<RelocatableInst>>
+  generate(const Patch &patch, TempManager &temp_manager) const override;
+};
+
+class InlineGate : public AutoClone<PatchGenerator, InlineGate> {
+
+  std::vector<InlineOp> ops;
+  uint16_t readTag;
+  uint16_t writeTag;
+  InstCallback cbk;
+  void *data;
+  InstPosition position;
+
+public:
+  /*! Execute the operations of an inline instrumentation in the JIT code.
+   * The accumulator is RCX, with the same registers as MemRangeGate. The
+   * operations must have been resolved for the instruction (no
+   * INLINE_LOAD_OPERAND and no PC). INLINE_CALL calls the callback with the
+   * stub of the fast callbacks.
+   *
+   * @param[in] ops       The operations.
+   * @param[in] readTag   The tag of the shadow of the read address.
+   * @param[in] writeTag  The tag of the shadow of the write address.
+   * @param[in] cbk       The callback of INLINE_CALL.
+   * @param[in] data      The data pointer to give to the callback.
+   * @param[in] position  The position of the instrumentation.
+   */
+  InlineGate(std::vector<InlineOp> ops, uint16_t readTag, uint16_t writeTag,
+             InstCallback cbk, void *data, InstPosition position)
+      : ops(std::move(ops)), readTag(readTag), writeTag(writeTag), cbk(cbk),
+        data(data), position(position) {}
+
+  /*! Output:
+   *
+   * MOV MEM64 DataBlock[Offset(RAX)], REG64 RAX
+   * MOV MEM64 DataBlock[Offset(RCX)], REG64 RCX
+   * MOV MEM64 DataBlock[Offset(RDX)], REG64 RDX
+   * SETO AL
+   * LAHF
+   * MOV REG64 RCX, IMM64 0
+   * # for each operation:
+   * MOV REG64 RCX, IMM64 value                # INLINE_LOAD_IMM
+   * MOV REG64 RCX, REG64 reg                  # INLINE_LOAD_REG, or
+   *                                           # DataBlock[Offset(reg)]
+   * MOV REG64 RCX, MEM64 Shadow(tag)          # INLINE_LOAD_*_ADDRESS
+   * MOV REG64 RDX, IMM64 value                # INLINE_LOAD_MEMORY
+   * MOV REG64 RCX, MEM64 [RDX]
+   * MOV REG64 RDX, IMM64 value                # INLINE_ADD
+   * LEA REG64 RCX, [RCX + RDX]
+   * MOV REG64 RDX, IMM64 value                # INLINE_STORE
+   * MOV MEM64 [RDX], REG64 RCX
+   * MOV REG64 RDX, IMM64 (-start)             # INLINE_SKIP
+   * LEA REG64 RCX, [RCX + RDX]
+   * MOV REG64 RDX, IMM64 size
+   * CMP REG64 RCX, REG64 RDX
+   * MOV REG64 RDX, IMM64 start
+   * LEA REG64 RCX, [RCX + RDX]
+   * JB next                                   # or JAE
+   * # without INLINE_CALL:
+   * ADD AL, 0x7f
+   * SAHF
+   * MOV REG64 RAX, MEM64 DataBlock[Offset(RAX)]
+   * MOV REG64 RCX, MEM64 DataBlock[Offset(RCX)]
+   * MOV REG64 RDX, MEM64 DataBlock[Offset(RDX)]
+   * # with INLINE_CALL:
+   * JMP hit
+   * # miss and hit as MemRangeGate, with a fast call to the host
+   */
+  std::vector<std::unique_ptr<RelocatableInst>>
+  generate(const Patch &patch, TempManager &temp_manager) const override;
+};
+
 } // namespace QBDI
 
 #endif
@@ -50,6 +50,7 @@ enum PatchGeneratorFlagsX86_64 {
 
 std::vector<PatchRule> getDefaultPatchRules(Options opts) {
   std::vector<PatchRule> rules;
+  const bool chaining = (opts & Options::OPT_ENABLE_BLOCK_CHAINING) != 0;
 
   /* Rule #0: Avoid instrumenting instruction prefixes.
    * Target:  X86 prefixes (LOCK, REP and other REX prefixes).
@@ -97,17 +98,24 @@ std::vector<PatchRule> getDefaultPatchRules(Options opts) {
    * Patch:   Temp(0) := RIP + Constant(0)
    *          CALL *[RIP + IMM] --> MOV Temp(1), [Temp(0) + IMM]
    *          SimulateCall(Temp(1))
+   *
+   * With block chaining:
+   *          ReturnStackPush(Temp(0), Temp(1))
    */
+  PatchGenerator::UniquePtrVec callRIPGenerator = conv_unique<PatchGenerator>(
+      GetPCOffset::unique(Temp(0), Constant(0)),
+      ModifyInstruction::unique(conv_unique<InstTransform>(
+          SubstituteWithTemp::unique(Reg(REG_PC), Temp(0)),
+          SetOpcode::unique(llvm::X86::MOV64rm),
+          AddOperand::unique(Operand(0), Temp(1)))),
+      SimulateCall::unique(Temp(1)));
+  if (chaining) {
+    callRIPGenerator.push_back(ReturnStackPush::unique(Temp(0), Temp(1)));
+  }
   rules.emplace_back(
       And::unique(conv_unique<PatchCondition>(OpIs::unique(llvm::X86::CALL64m),
                                               UseReg::unique(Reg(REG_PC)))),
-      conv_unique<PatchGenerator>(
-          GetPCOffset::unique(Temp(0), Constant(0)),
-          ModifyInstruction::unique(conv_unique<InstTransform>(
-              SubstituteWithTemp::unique(Reg(REG_PC), Temp(0)),
-              SetOpcode::unique(llvm::X86::MOV64rm),
-              AddOperand::unique(Operand(0), Temp(1)))),
-          SimulateCall::unique(Temp(1))));
+      std::move(callRIPGenerator));
 
   /* Rule #3: Generic RIP patching.
    * Target:  Any instruction with RIP as operand, e.g. LEA RAX, [RIP + 1]
@@ -140,29 +148,46 @@ std::vector<PatchRule> getDefaultPatchRules(Options opts) {
    * Target:  CALL MEM
    * Patch:   CALL MEM --> MOV Temp(0), MEM
    *          SimulateCall(Temp(1))
+   *
+   * With block chaining:
+   *          ReturnStackPush(Temp(0), Temp(1))
    */
+  PatchGenerator::UniquePtrVec callMemGenerator = conv_unique<PatchGenerator>(
+      ModifyInstruction::unique(conv_unique<InstTransform>(
+          SetOpcode::unique(is_x86 ? llvm::X86::MOV32rm : llvm::X86::MOV64rm),
+          AddOperand::unique(Operand(0), Temp(0)))),
+      SimulateCall::unique(Temp(0)));
+  if (chaining) {
+    callMemGenerator.push_back(ReturnStackPush::unique(Temp(0), Temp(1)));
+  }
   rules.emplace_back(
       Or::unique(conv_unique<PatchCondition>(OpIs::unique(llvm::X86::CALL32m),
                                              OpIs::unique(llvm::X86::CALL64m))),
-      conv_unique<PatchGenerator>(
-          ModifyInstruction::unique(conv_unique<InstTransform>(
-              SetOpcode::unique(is_x86 ? llvm::X86::MOV32rm
-                                       : llvm::X86::MOV64rm),
-              AddOperand::unique(Operand(0), Temp(0)))),
-          SimulateCall::unique(Temp(0))));
+      std::move(callMemGenerator));
 
   /* Rule #6: Simulate JMP to constant value.
    * Target:  JMP IMM
    * Patch:   Temp(0) := RIP + Operand(0)
    *          DataBlock[Offset(RIP)] := Temp(0)
+   *
+   * With block chaining:
+   *          Temp(0) := ChainSlot(RIP + Operand(0))
+   *          DataBlock[Shadow(CHAIN_EXIT_TAG)] := Temp(0)
    */
+  PatchGenerator::UniquePtrVec jmpGenerator = conv_unique<PatchGenerator>(
+      GetPCOffset::unique(Temp(0), Operand(0)),
+      WriteTemp::unique(Temp(0), Offset(Reg(REG_PC))));
+  if (chaining) {
+    append(jmpGenerator,
+           conv_unique<PatchGenerator>(
+               GetChainSlot::unique(Temp(0), Operand(0)),
+               WriteTemp::unique(Temp(0), Shadow(CHAIN_EXIT_TAG))));
+  }
   rules.emplace_back(
       Or::unique(conv_unique<PatchCondition>(OpIs::unique(llvm::X86::JMP_1),
                                              OpIs::unique(llvm::X86::JMP_2),
                                              OpIs::unique(llvm::X86::JMP_4))),
-      conv_unique<PatchGenerator>(
-          GetPCOffset::unique(Temp(0), Operand(0)),
-          WriteTemp::unique(Temp(0), Offset(Reg(REG_PC)))));
+      std::move(jmpGenerator));
 
   /* Rule #7: Simulate JMP to register value.
    * Target:  JMP REG
@@ -180,12 +205,82 @@ std::vector<PatchRule> getDefaultPatchRules(Options opts) {
    * Target:  CALL REG
    * Patch:   Temp(0) := Operand(0)
    *          SimulateCall(Temp(0))
+   *
+   * With block chaining:
+   *          ReturnStackPush(Temp(0), Temp(1))
    */
+  PatchGenerator::UniquePtrVec callRegGenerator = conv_unique<PatchGenerator>(
+      GetOperand::unique(Temp(0), Operand(0)), SimulateCall::unique(Temp(0)));
+  if (chaining) {
+    callRegGenerator.push_back(ReturnStackPush::unique(Temp(0), Temp(1)));
+  }
   rules.emplace_back(
       Or::unique(conv_unique<PatchCondition>(OpIs::unique(llvm::X86::CALL32r),
                                              OpIs::unique(llvm::X86::CALL64r))),
-      conv_unique<PatchGenerator>(GetOperand::unique(Temp(0), Operand(0)),
-                                  SimulateCall::unique(Temp(0))));
+      std::move(callRegGenerator));
+
+  // With block chaining, the following rules replace the rules #9, #10 and #11
+  if (chaining) {
+    /* Rule #9: Simulate Jcc IMM8 with block chaining.
+     * Target:  Jcc IMM8
+     * Patch:     Temp(0) := RIP + Operand(0)
+     *            Temp(1) := ChainSlot(RIP + Operand(0))
+     *         ---Jcc IMM8 --> Jcc END
+     *         |  Temp(0) := RIP + Constant(0)
+     *         |  Temp(1) := ChainSlot(RIP + Constant(0))
+     *         -->END: DataBlock[Offset(RIP)] := Temp(0)
+     *                 DataBlock[Shadow(CHAIN_EXIT_TAG)] := Temp(1)
+     */
+    rules.emplace_back(
+        Or::unique(conv_unique<PatchCondition>(
+            OpIs::unique(llvm::X86::JCC_1), OpIs::unique(llvm::X86::LOOP),
+            OpIs::unique(llvm::X86::LOOPE), OpIs::unique(llvm::X86::LOOPNE),
+            OpIs::unique(llvm::X86::JRCXZ), OpIs::unique(llvm::X86::JECXZ),
+            OpIs::unique(llvm::X86::JCXZ))),
+        conv_unique<PatchGenerator>(
+            GetPCOffset::unique(Temp(0), Operand(0)),
+            GetChainSlot::unique(Temp(1), Operand(0)),
+            ModifyInstruction::unique(conv_unique<InstTransform>(
+                SetOperand::unique(Operand(0),
+                                   // Offset to jump the next loads.
+                                   Constant(is_x86 ? 12 : 18)))),
+            GetPCOffset::unique(Temp(0), Constant(0)),
+            GetChainSlot::unique(Temp(1), Constant(0)),
+            WriteTemp::unique(Temp(0), Offset(Reg(REG_PC))),
+            WriteTemp::unique(Temp(1), Shadow(CHAIN_EXIT_TAG))));
+
+    /* Rule #10: Simulate Jcc IMM16 with block chaining.
+     * Target:  Jcc IMM16
+     * Patch:   Same as Rule #9 with a 16 bits offset
+     */
+    rules.emplace_back(
+        OpIs::unique(llvm::X86::JCC_2),
+        conv_unique<PatchGenerator>(
+            GetPCOffset::unique(Temp(0), Operand(0)),
+            GetChainSlot::unique(Temp(1), Operand(0)),
+            ModifyInstruction::unique(conv_unique<InstTransform>(
+                SetOperand::unique(Operand(0), Constant(is_x86 ? 13 : 19)))),
+            GetPCOffset::unique(Temp(0), Constant(0)),
+            GetChainSlot::unique(Temp(1), Constant(0)),
+            WriteTemp::unique(Temp(0), Offset(Reg(REG_PC))),
+            WriteTemp::unique(Temp(1), Shadow(CHAIN_EXIT_TAG))));
+
+    /* Rule #11: Simulate Jcc IMM32 with block chaining.
+     * Target:  Jcc IMM32
+     * Patch:   Same as Rule #9 with a 32 bits offset
+     */
+    rules.emplace_back(
+        OpIs::unique(llvm::X86::JCC_4),
+        conv_unique<PatchGenerator>(
+            GetPCOffset::unique(Temp(0), Operand(0)),
+            GetChainSlot::unique(Temp(1), Operand(0)),
+            ModifyInstruction::unique(conv_unique<InstTransform>(
+                SetOperand::unique(Operand(0), Constant(is_x86 ? 15 : 21)))),
+            GetPCOffset::unique(Temp(0), Constant(0)),
+            GetChainSlot::unique(Temp(1), Constant(0)),
+            WriteTemp::unique(Temp(0), Offset(Reg(REG_PC))),
+            WriteTemp::unique(Temp(1), Shadow(CHAIN_EXIT_TAG))));
+  }
 
   /* Rule #9: Simulate Jcc IMM8.
    * Target:  Jcc IMM8
@@ -246,25 +341,46 @@ std::vector<PatchRule> getDefaultPatchRules(Options opts) {
    * Target:   CALL IMM
    * Patch:    Temp(0) := RIP + Operand(0)
    *           SimulateCall(Temp(0))
+   *
+   * With block chaining:
+   *           ReturnStackPush(Temp(0), Temp(1))
+   *           Temp(0) := ChainSlot(RIP + Operand(0))
+   *           DataBlock[Shadow(CHAIN_EXIT_TAG)] := Temp(0)
    */
+  PatchGenerator::UniquePtrVec callGenerator = conv_unique<PatchGenerator>(
+      GetPCOffset::unique(Temp(0), Operand(0)), SimulateCall::unique(Temp(0)));
+  if (chaining) {
+    append(callGenerator,
+           conv_unique<PatchGenerator>(
+               ReturnStackPush::unique(Temp(0), Temp(1)),
+               GetChainSlot::unique(Temp(0), Operand(0)),
+               WriteTemp::unique(Temp(0), Shadow(CHAIN_EXIT_TAG))));
+  }
   rules.emplace_back(
       Or::unique(
           conv_unique<PatchCondition>(OpIs::unique(llvm::X86::CALL64pcrel32),
                                       OpIs::unique(llvm::X86::CALLpcrel16),
                                       OpIs::unique(llvm::X86::CALLpcrel32))),
-      conv_unique<PatchGenerator>(GetPCOffset::unique(Temp(0), Operand(0)),
-                                  SimulateCall::unique(Temp(0))));
+      std::move(callGenerator));
 
   /* Rule #13: Simulate return.
    * Target:   RET
    * Patch:    SimulateRet(Temp(0))
+   *
+   * With block chaining:
+   *           ReturnStackPop(Temp(0), Temp(1))
    */
+  PatchGenerator::UniquePtrVec retGenerator =
+      conv_unique<PatchGenerator>(SimulateRet::unique(Temp(0)));
+  if (chaining) {
+    retGenerator.push_back(ReturnStackPop::unique(Temp(0), Temp(1)));
+  }
   rules.emplace_back(
       Or::unique(conv_unique<PatchCondition>(
           OpIs::unique(llvm::X86::RET32), OpIs::unique(llvm::X86::RET64),
           OpIs::unique(llvm::X86::RET16), OpIs::unique(llvm::X86::RETI32),
           OpIs::unique(llvm::X86::RETI64), OpIs::unique(llvm::X86::RETI16))),
-      conv_unique<PatchGenerator>(SimulateRet::unique(Temp(0))));
+      std::move(retGenerator));
 
   /* Rule #14: Default rule for every other instructions.
    * Target:   *
@@ -297,7 +413,10 @@ bool PatchRuleAssembly::changeOptions(Options opts) {
                                Options::OPT_ENABLE_FS_GS |
 #endif
                                Options::OPT_DISABLE_OPTIONAL_FPR |
-                               Options::OPT_DISABLE_MEMORYACCESS_VALUE;
+                               Options::OPT_DISABLE_MEMORYACCESS_VALUE |
+                               Options::OPT_ENABLE_BLOCK_CHAINING |
+                               Options::OPT_ENABLE_SHARED_CONTEXT |
+                               Options::OPT_ENABLE_DUAL_MAPPING;
   if ((opts & needRecreate) != (options & needRecreate)) {
     patchRules = getDefaultPatchRules(opts);
     options = opts;
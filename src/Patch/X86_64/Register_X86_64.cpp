@@ -103,6 +103,24 @@ const std::map<RegLLVM, int16_t> FPR_ID = {
     {llvm::X86::XMM14, -1},
     {llvm::X86::XMM15, -1},
 #endif
+#if defined(QBDI_ARCH_X86_64)
+    {llvm::X86::XMM16, offsetof(FPRState, zmm16)},
+    {llvm::X86::XMM17, offsetof(FPRState, zmm17)},
+    {llvm::X86::XMM18, offsetof(FPRState, zmm18)},
+    {llvm::X86::XMM19, offsetof(FPRState, zmm19)},
+    {llvm::X86::XMM20, offsetof(FPRState, zmm20)},
+    {llvm::X86::XMM21, offsetof(FPRState, zmm21)},
+    {llvm::X86::XMM22, offsetof(FPRState, zmm22)},
+    {llvm::X86::XMM23, offsetof(FPRState, zmm23)},
+    {llvm::X86::XMM24, offsetof(FPRState, zmm24)},
+    {llvm::X86::XMM25, offsetof(FPRState, zmm25)},
+    {llvm::X86::XMM26, offsetof(FPRState, zmm26)},
+    {llvm::X86::XMM27, offsetof(FPRState, zmm27)},
+    {llvm::X86::XMM28, offsetof(FPRState, zmm28)},
+    {llvm::X86::XMM29, offsetof(FPRState, zmm29)},
+    {llvm::X86::XMM30, offsetof(FPRState, zmm30)},
+    {llvm::X86::XMM31, offsetof(FPRState, zmm31)},
+#elif defined(QBDI_ARCH_X86)
     {llvm::X86::XMM16, -1},
     {llvm::X86::XMM17, -1},
     {llvm::X86::XMM18, -1},
@@ -119,6 +137,7 @@ const std::map<RegLLVM, int16_t> FPR_ID = {
     {llvm::X86::XMM29, -1},
     {llvm::X86::XMM30, -1},
     {llvm::X86::XMM31, -1},
+#endif
     {llvm::X86::YMM0, offsetof(FPRState, ymm0)},
     {llvm::X86::YMM1, offsetof(FPRState, ymm1)},
     {llvm::X86::YMM2, offsetof(FPRState, ymm2)},
@@ -146,6 +165,56 @@ const std::map<RegLLVM, int16_t> FPR_ID = {
     {llvm::X86::YMM14, -1},
     {llvm::X86::YMM15, -1},
 #endif
+#if defined(QBDI_ARCH_X86_64)
+    {llvm::X86::YMM16, offsetof(FPRState, zmm16)},
+    {llvm::X86::YMM17, offsetof(FPRState, zmm17)},
+    {llvm::X86::YMM18, offsetof(FPRState, zmm18)},
+    {llvm::X86::YMM19, offsetof(FPRState, zmm19)},
+    {llvm::X86::YMM20, offsetof(FPRState, zmm20)},
+    {llvm::X86::YMM21, offsetof(FPRState, zmm21)},
+    {llvm::X86::YMM22, offsetof(FPRState, zmm22)},
+    {llvm::X86::YMM23, offsetof(FPRState, zmm23)},
+    {llvm::X86::YMM24, offsetof(FPRState, zmm24)},
+    {llvm::X86::YMM25, offsetof(FPRState, zmm25)},
+    {llvm::X86::YMM26, offsetof(FPRState, zmm26)},
+    {llvm::X86::YMM27, offsetof(FPRState, zmm27)},
+    {llvm::X86::YMM28, offsetof(FPRState, zmm28)},
+    {llvm::X86::YMM29, offsetof(FPRState, zmm29)},
+    {llvm::X86::YMM30, offsetof(FPRState, zmm30)},
+    {llvm::X86::YMM31, offsetof(FPRState, zmm31)},
+    {llvm::X86::ZMM0, offsetof(FPRState, zmm0)},
+    {llvm::X86::ZMM1, offsetof(FPRState, zmm1)},
+    {llvm::X86::ZMM2, offsetof(FPRState, zmm2)},
+    {llvm::X86::ZMM3, offsetof(FPRState, zmm3)},
+    {llvm::X86::ZMM4, offsetof(FPRState, zmm4)},
+    {llvm::X86::ZMM5, offsetof(FPRState, zmm5)},
+    {llvm::X86::ZMM6, offsetof(FPRState, zmm6)},
+    {llvm::X86::ZMM7, offsetof(FPRState, zmm7)},
+    {llvm::X86::ZMM8, offsetof(FPRState, zmm8)},
+    {llvm::X86::ZMM9, offsetof(FPRState, zmm9)},
+    {llvm::X86::ZMM10, offsetof(FPRState, zmm10)},
+    {llvm::X86::ZMM11, offsetof(FPRState, zmm11)},
+    {llvm::X86::ZMM12, offsetof(FPRState, zmm12)},
+    {llvm::X86::ZMM13, offsetof(FPRState, zmm13)},
+    {llvm::X86::ZMM14, offsetof(FPRState, zmm14)},
+    {llvm::X86::ZMM15, offsetof(FPRState, zmm15)},
+    {llvm::X86::ZMM16, offsetof(FPRState, zmm16)},
+    {llvm::X86::ZMM17, offsetof(FPRState, zmm17)},
+    {llvm::X86::ZMM18, offsetof(FPRState, zmm18)},
+    {llvm::X86::ZMM19, offsetof(FPRState, zmm19)},
+    {llvm::X86::ZMM20, offsetof(FPRState, zmm20)},
+    {llvm::X86::ZMM21, offsetof(FPRState, zmm21)},
+    {llvm::X86::ZMM22, offsetof(FPRState, zmm22)},
+    {llvm::X86::ZMM23, offsetof(FPRState, zmm23)},
+    {llvm::X86::ZMM24, offsetof(FPRState, zmm24)},
+    {llvm::X86::ZMM25, offsetof(FPRState, zmm25)},
+    {llvm::X86::ZMM26, offsetof(FPRState, zmm26)},
+    {llvm::X86::ZMM27, offsetof(FPRState, zmm27)},
+    {llvm::X86::ZMM28, offsetof(FPRState, zmm28)},
+    {llvm::X86::ZMM29, offsetof(FPRState, zmm29)},
+    {llvm::X86::ZMM30, offsetof(FPRState, zmm30)},
+    {llvm::X86::ZMM31, offsetof(FPRState, zmm31)},
+#elif defined(QBDI_ARCH_X86)
     {llvm::X86::YMM16, -1},
     {llvm::X86::YMM17, -1},
     {llvm::X86::YMM18, -1},
@@ -194,6 +263,7 @@ const std::map<RegLLVM, int16_t> FPR_ID = {
     {llvm::X86::ZMM29, -1},
     {llvm::X86::ZMM30, -1},
     {llvm::X86::ZMM31, -1},
+#endif
 };
 
 const unsigned int size_GPR_ID = sizeof(GPR_ID) / sizeof(RegLLVM);
@@ -95,9 +95,11 @@ llvm::MCInst LoadDataBlock::reloc(ExecBlock *execBlock, CPUMode cpumode) const {
 
   if constexpr (is_x86_64) {
     return mov64rm(reg, Reg(REG_PC), 1, 0,
-                   execBlock->getDataBlockOffset() + offset - 7, 0);
+                   execBlock->getDataBlockAddress(offset) -
+                       execBlock->getCurrentPC() - 7,
+                   0);
   } else {
-    return mov32rm(reg, 0, 0, 0, execBlock->getDataBlockBase() + offset, 0);
+    return mov32rm(reg, 0, 0, 0, execBlock->getDataBlockAddress(offset), 0);
   }
 }
 
@@ -117,9 +119,11 @@ llvm::MCInst StoreDataBlock::reloc(ExecBlock *execBlock,
 
   if constexpr (is_x86_64) {
     return mov64mr(Reg(REG_PC), 1, 0,
-                   execBlock->getDataBlockOffset() + offset - 7, 0, reg);
+                   execBlock->getDataBlockAddress(offset) -
+                       execBlock->getCurrentPC() - 7,
+                   0, reg);
   } else {
-    return mov32mr(0, 0, 0, execBlock->getDataBlockBase() + offset, 0, reg);
+    return mov32mr(0, 0, 0, execBlock->getDataBlockAddress(offset), 0, reg);
   }
 }
 
@@ -232,7 +236,9 @@ llvm::MCInst DataBlockRel::reloc(ExecBlock *execBlock, CPUMode cpumode) const {
   QBDI_REQUIRE_ABORT(opn < res.getNumOperands(), "Invalid operand {}", opn);
   QBDI_REQUIRE_ABORT(res.getOperand(opn).isImm(), "Unexpected operand type");
 
-  res.getOperand(opn).setImm(offset + execBlock->getDataBlockOffset());
+  // The offset is relative to the end of the instruction
+  res.getOperand(opn).setImm(execBlock->getDataBlockAddress(offset + size) -
+                             size - execBlock->getCurrentPC());
   return res;
 }
 
@@ -245,8 +251,75 @@ llvm::MCInst DataBlockAbsRel::reloc(ExecBlock *execBlock,
   QBDI_REQUIRE_ABORT(opn < res.getNumOperands(), "Invalid operand {}", opn);
   QBDI_REQUIRE_ABORT(res.getOperand(opn).isImm(), "Unexpected operand type");
 
-  res.getOperand(opn).setImm(execBlock->getDataBlockBase() + offset);
+  res.getOperand(opn).setImm(execBlock->getDataBlockAddress(offset));
   return res;
 }
 
+// LoadChainSlot
+// =============
+
+llvm::MCInst LoadChainSlot::reloc(ExecBlock *execBlock,
+                                  CPUMode cpumode) const {
+  uint16_t id = execBlock->newChainSlot(target);
+  unsigned int shadowOffset = execBlock->getShadowOffset(id);
+
+  if constexpr (is_x86_64) {
+    return mov64rm(reg, Reg(REG_PC), 1, 0,
+                   execBlock->getDataBlockOffset() + shadowOffset - 7, 0);
+  } else {
+    return mov32rm(reg, 0, 0, 0, execBlock->getDataBlockBase() + shadowOffset,
+                   0);
+  }
+}
+
+int LoadChainSlot::getSize(const LLVMCPU &llvmcpu) const {
+  if constexpr (is_x86_64) {
+    return 7;
+  } else {
+    return 6;
+  }
+}
+
+// OnceSlotJump
+// ============
+
+llvm::MCInst OnceSlotJump::reloc(ExecBlock *execBlock, CPUMode cpumode) const {
+  // The slot holds the address of the stub until the first call
+  rword stub = execBlock->getCurrentPC() + 6;
+  uint16_t id = execBlock->newOnceSlot(stub, stub + stubSize);
+  unsigned int shadowOffset = execBlock->getShadowOffset(id);
+
+  if constexpr (is_x86_64) {
+    return jmp64m(Reg(REG_PC),
+                  execBlock->getDataBlockOffset() + shadowOffset - 6);
+  } else {
+    return jmp32m(0, execBlock->getDataBlockBase() + shadowOffset);
+  }
+}
+
+// LoadChainSlotAddress
+// ====================
+
+llvm::MCInst LoadChainSlotAddress::reloc(ExecBlock *execBlock,
+                                         CPUMode cpumode) const {
+  uint16_t id = execBlock->newChainSlot(target);
+  unsigned int shadowOffset = execBlock->getShadowOffset(id);
+
+  if constexpr (is_x86_64) {
+    return lea64(reg, Reg(REG_PC), 1, 0,
+                 execBlock->getDataBlockOffset() + shadowOffset - 7, 0);
+  } else {
+    return lea32(reg, 0, 1, 0, execBlock->getDataBlockBase() + shadowOffset,
+                 0);
+  }
+}
+
+int LoadChainSlotAddress::getSize(const LLVMCPU &llvmcpu) const {
+  if constexpr (is_x86_64) {
+    return 7;
+  } else {
+    return 6;
+  }
+}
+
 } // namespace QBDI
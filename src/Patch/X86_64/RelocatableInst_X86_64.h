@@ -106,6 +106,49 @@ public:
   int getSize(const LLVMCPU &llvmcpu) const override { return size; }
 };
 
+class LoadChainSlot : public AutoClone<RelocatableInst, LoadChainSlot> {
+  RegLLVM reg;
+  rword target;
+
+public:
+  LoadChainSlot(RegLLVM reg, rword target)
+      : AutoClone<RelocatableInst, LoadChainSlot>(), reg(reg), target(target) {}
+
+  // allocate a new chain slot for target and load its value in reg
+  llvm::MCInst reloc(ExecBlock *execBlock, CPUMode cpumode) const override;
+
+  int getSize(const LLVMCPU &llvmcpu) const override;
+};
+
+class OnceSlotJump : public AutoClone<RelocatableInst, OnceSlotJump> {
+  rword stubSize;
+
+public:
+  OnceSlotJump(rword stubSize)
+      : AutoClone<RelocatableInst, OnceSlotJump>(), stubSize(stubSize) {}
+
+  // allocate a new once slot for the next stubSize bytes and jump to its value
+  llvm::MCInst reloc(ExecBlock *execBlock, CPUMode cpumode) const override;
+
+  int getSize(const LLVMCPU &llvmcpu) const override { return 6; }
+};
+
+class LoadChainSlotAddress
+    : public AutoClone<RelocatableInst, LoadChainSlotAddress> {
+  RegLLVM reg;
+  rword target;
+
+public:
+  LoadChainSlotAddress(RegLLVM reg, rword target)
+      : AutoClone<RelocatableInst, LoadChainSlotAddress>(), reg(reg),
+        target(target) {}
+
+  // allocate a new chain slot for target and load its address in reg
+  llvm::MCInst reloc(ExecBlock *execBlock, CPUMode cpumode) const override;
+
+  int getSize(const LLVMCPU &llvmcpu) const override;
+};
+
 } // namespace QBDI
 
 #endif
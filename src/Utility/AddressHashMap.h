@@ -0,0 +1,162 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2025 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef AddressHashMap_H
+#define AddressHashMap_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "QBDI/State.h"
+
+namespace QBDI {
+
+/*! Open addressing hash map indexed by an address. The entries are stored
+ * inline in a power of two table with linear probing, so a lookup usually
+ * reads one cache line. The load factor is kept under 1/2 and the deletion
+ * shifts back the following entries instead of leaving tombstones.
+ */
+template <typename T>
+class AddressHashMap {
+private:
+  struct Entry {
+    rword key;
+    bool used;
+    T value;
+  };
+
+  static constexpr size_t MIN_CAPACITY = 64;
+
+  std::vector<Entry> table;
+  size_t mask;
+  size_t nbEntries;
+
+  inline size_t hash(rword key) const {
+    // Fibonacci hashing, the high bits of the product are the most mixed ones
+    return static_cast<size_t>(
+               (static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull) >> 32) &
+           mask;
+  }
+
+  void rehash(size_t capacity) {
+    std::vector<Entry> old(capacity);
+    table.swap(old);
+    mask = capacity - 1;
+    for (Entry &e : old) {
+      if (e.used) {
+        size_t i = hash(e.key);
+        while (table[i].used) {
+          i = (i + 1) & mask;
+        }
+        table[i].key = e.key;
+        table[i].used = true;
+        table[i].value = std::move(e.value);
+      }
+    }
+  }
+
+  inline const Entry *lookup(rword key) const {
+    if (nbEntries == 0) {
+      return nullptr;
+    }
+    for (size_t i = hash(key); table[i].used; i = (i + 1) & mask) {
+      if (table[i].key == key) {
+        return &table[i];
+      }
+    }
+    return nullptr;
+  }
+
+public:
+  AddressHashMap()
+      : table(MIN_CAPACITY), mask(MIN_CAPACITY - 1), nbEntries(0) {}
+
+  inline size_t size() const { return nbEntries; }
+
+  inline T *find(rword key) {
+    const Entry *e = lookup(key);
+    return e != nullptr ? const_cast<T *>(&e->value) : nullptr;
+  }
+
+  inline const T *find(rword key) const {
+    const Entry *e = lookup(key);
+    return e != nullptr ? &e->value : nullptr;
+  }
+
+  /*! Insert a value, or replace the value already associated to the key.
+   *
+   * @param[in] key    The key of the value.
+   * @param[in] value  The value.
+   */
+  void insert(rword key, const T &value) {
+    if ((nbEntries + 1) * 2 > table.size()) {
+      rehash(table.size() * 2);
+    }
+    size_t i = hash(key);
+    while (table[i].used) {
+      if (table[i].key == key) {
+        table[i].value = value;
+        return;
+      }
+      i = (i + 1) & mask;
+    }
+    table[i].key = key;
+    table[i].used = true;
+    table[i].value = value;
+    nbEntries++;
+  }
+
+  /*! Remove the value associated to a key.
+   *
+   * @param[in] key  The key to remove.
+   *
+   * @return True if the key was in the map.
+   */
+  bool erase(rword key) {
+    const Entry *e = lookup(key);
+    if (e == nullptr) {
+      return false;
+    }
+    size_t hole = e - table.data();
+    // Shift back the entries of the cluster that would not be reachable
+    // anymore from their hash slot.
+    for (size_t i = (hole + 1) & mask; table[i].used; i = (i + 1) & mask) {
+      size_t home = hash(table[i].key);
+      if (((i - home) & mask) >= ((i - hole) & mask)) {
+        table[hole].key = table[i].key;
+        table[hole].value = std::move(table[i].value);
+        hole = i;
+      }
+    }
+    table[hole].used = false;
+    table[hole].value = T();
+    nbEntries--;
+    return true;
+  }
+
+  void clear() {
+    std::vector<Entry>(MIN_CAPACITY).swap(table);
+    mask = MIN_CAPACITY - 1;
+    nbEntries = 0;
+  }
+};
+
+} // namespace QBDI
+
+#endif
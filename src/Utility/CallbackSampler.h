@@ -0,0 +1,74 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2025 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef CALLBACKSAMPLER_H
+#define CALLBACKSAMPLER_H
+
+#include <stdint.h>
+
+#include "QBDI/State.h"
+
+namespace QBDI {
+
+/*! The sampling of a callback, called once every period executions. The
+ * countdown of an instrumentation rule is shared by all its callsites: the JIT
+ * code decrements it and only breaks to the host when it reaches zero. The
+ * period can be changed without clearing the cache.
+ */
+struct CallbackSampler {
+  rword countdown = 1;
+  uint32_t period = 1;
+  bool randomized = false;
+  uint64_t seed = 0x9e3779b97f4a7c15;
+
+  /*! Change the period. A randomized period is drawn uniformly between 1 and
+   * (2 * period - 1), for the same average period.
+   */
+  inline void setPeriod(uint32_t period_, bool randomized_) {
+    period = (period_ == 0) ? 1 : period_;
+    randomized = randomized_;
+    countdown = nextPeriod();
+  }
+
+  inline rword nextPeriod() {
+    if (not randomized or period == 1) {
+      return period;
+    }
+    // xorshift64
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return 1 + (seed % (2 * static_cast<uint64_t>(period) - 1));
+  }
+
+  /*! Count an execution in the host.
+   *
+   * @return True if the callback must be called. The countdown is reloaded.
+   */
+  inline bool sample() {
+    // The JIT code may already have decremented the countdown to zero
+    if (countdown != 0 and --countdown != 0) {
+      return false;
+    }
+    countdown = nextPeriod();
+    return true;
+  }
+};
+
+} // namespace QBDI
+
+#endif
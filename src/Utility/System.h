@@ -32,6 +32,20 @@ llvm::sys::MemoryBlock
 allocateMappedMemory(size_t NumBytes,
                      const llvm::sys::MemoryBlock *const NearBlock,
                      unsigned PFlags, std::error_code &EC);
+// Allocate a block whose first hugeSize bytes are aligned on a huge page and
+// backed by a transparent huge page if possible (Linux and Android only)
+llvm::sys::MemoryBlock
+allocateHugeMappedMemory(size_t numBytes, size_t hugeSize,
+                         const llvm::sys::MemoryBlock *const nearBlock,
+                         unsigned pFlags, std::error_code &ec);
+// Allocate a read write block whose first codeSize bytes are remapped read
+// execute from a memfd. The same bytes are mapped read write in writeBlock.
+// Return an empty block if not supported (Linux and Android only).
+llvm::sys::MemoryBlock
+allocateDualMappedMemory(size_t numBytes, size_t codeSize,
+                         const llvm::sys::MemoryBlock *const nearBlock,
+                         llvm::sys::MemoryBlock &writeBlock,
+                         std::error_code &ec);
 void releaseMappedMemory(llvm::sys::MemoryBlock &block);
 const std::string getHostCPUName();
 const std::vector<std::string> getHostCPUFeatures();
@@ -17,6 +17,7 @@
  */
 #include <algorithm>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string>
 #include <system_error>
@@ -32,6 +33,17 @@
 #include "Utility/LogSys.h"
 #include "Utility/System.h"
 
+#if defined(QBDI_PLATFORM_LINUX) || defined(QBDI_PLATFORM_ANDROID)
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#endif
+
 namespace QBDI {
 
 bool isRWXSupported() { return false; }
@@ -46,6 +58,84 @@ allocateMappedMemory(size_t numBytes,
                                                  ec);
 }
 
+llvm::sys::MemoryBlock
+allocateHugeMappedMemory(size_t numBytes, size_t hugeSize,
+                         const llvm::sys::MemoryBlock *const nearBlock,
+                         unsigned pFlags, std::error_code &ec) {
+#if defined(QBDI_PLATFORM_LINUX) || defined(QBDI_PLATFORM_ANDROID)
+  // Allocate an extra huge page to align the block, and unmap the head and
+  // the tail
+  llvm::sys::MemoryBlock block = llvm::sys::Memory::allocateMappedMemory(
+      numBytes + hugeSize, nearBlock, pFlags, ec);
+  if (block.base() == nullptr) {
+    return block;
+  }
+  uintptr_t base = reinterpret_cast<uintptr_t>(block.base());
+  uintptr_t end = base + block.allocatedSize();
+  uintptr_t aligned = (base + hugeSize - 1) & ~(hugeSize - 1);
+  if (aligned != base) {
+    munmap(block.base(), aligned - base);
+  }
+  if (aligned + numBytes != end) {
+    munmap(reinterpret_cast<void *>(aligned + numBytes),
+           end - aligned - numBytes);
+  }
+  // Only a hint, the kernel may not support the transparent huge pages
+  if (madvise(reinterpret_cast<void *>(aligned), hugeSize, MADV_HUGEPAGE) !=
+      0) {
+    QBDI_DEBUG("Fail to advise the huge pages at 0x{:x}", aligned);
+  }
+  return llvm::sys::MemoryBlock(reinterpret_cast<void *>(aligned), numBytes);
+#else
+  return allocateMappedMemory(numBytes, nearBlock, pFlags, ec);
+#endif
+}
+
+llvm::sys::MemoryBlock
+allocateDualMappedMemory(size_t numBytes, size_t codeSize,
+                         const llvm::sys::MemoryBlock *const nearBlock,
+                         llvm::sys::MemoryBlock &writeBlock,
+                         std::error_code &ec) {
+#if defined(QBDI_PLATFORM_LINUX) || defined(QBDI_PLATFORM_ANDROID)
+  llvm::sys::MemoryBlock block = llvm::sys::Memory::allocateMappedMemory(
+      numBytes, nearBlock,
+      llvm::sys::Memory::MF_READ | llvm::sys::Memory::MF_WRITE, ec);
+  if (block.base() == nullptr) {
+    return block;
+  }
+  // memfd_create isn't exported by the old libc
+  int fd = static_cast<int>(syscall(SYS_memfd_create, "qbdi", MFD_CLOEXEC));
+  void *execView = MAP_FAILED;
+  void *writeView = MAP_FAILED;
+  if (fd >= 0 and ftruncate(fd, codeSize) == 0) {
+    // Replace the beginning of the block to keep the data block after the code
+    execView = mmap(block.base(), codeSize, PROT_READ | PROT_EXEC,
+                    MAP_SHARED | MAP_FIXED, fd, 0);
+    writeView = mmap(nullptr, codeSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     fd, 0);
+  }
+  ec = std::error_code(errno, std::generic_category());
+  if (fd >= 0) {
+    // The mappings keep the memfd alive
+    close(fd);
+  }
+  if (execView == MAP_FAILED or writeView == MAP_FAILED) {
+    QBDI_DEBUG("Fail to map the memfd twice: {}", ec.message());
+    if (writeView != MAP_FAILED) {
+      munmap(writeView, codeSize);
+    }
+    llvm::sys::Memory::releaseMappedMemory(block);
+    return llvm::sys::MemoryBlock();
+  }
+  ec = std::error_code();
+  writeBlock = llvm::sys::MemoryBlock(writeView, codeSize);
+  return block;
+#else
+  ec = std::make_error_code(std::errc::not_supported);
+  return llvm::sys::MemoryBlock();
+#endif
+}
+
 void releaseMappedMemory(llvm::sys::MemoryBlock &block) {
   llvm::sys::Memory::releaseMappedMemory(block);
 }
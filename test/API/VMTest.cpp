@@ -17,6 +17,7 @@
  */
 #include <algorithm>
 #include <catch2/catch_test_macros.hpp>
+#include <chrono>
 #include <set>
 #include "APITest.h"
 
@@ -62,6 +63,14 @@ QBDI_DISABLE_ASAN QBDI_NOINLINE int dummyFun8(int arg0, int arg1, int arg2,
   return arg0 + arg1 + arg2 + arg3 + arg4 + arg5 + arg6 + arg7;
 }
 
+QBDI_DISABLE_ASAN QBDI_NOINLINE int spinLoop(volatile int *flag) {
+  int n = 0;
+  while (*flag != 0) {
+    n++;
+  }
+  return n;
+}
+
 QBDI_DISABLE_ASAN QBDI_NOINLINE int dummyFunCall(int arg0) {
   // use simple BUT multiplatform functions to test external calls
   uint8_t *useless = (uint8_t *)QBDI::alignedAlloc(256, 16);
@@ -209,6 +218,867 @@ TEST_CASE_METHOD(APITest, "VMTest-Breakpoint") {
   SUCCEED();
 }
 
+TEST_CASE_METHOD(APITest, "VMTest-FastCallback") {
+  uint32_t counter = 0;
+  uint32_t fastCounter = 0;
+  QBDI::rword retval = 0;
+
+  uint32_t instrId = vm.addCodeCB(QBDI::InstPosition::PREINST,
+                                  countInstruction, &counter);
+  REQUIRE(instrId != QBDI::INVALID_EVENTID);
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  REQUIRE(retval == (QBDI::rword)36);
+  REQUIRE(vm.deleteInstrumentation(instrId));
+
+  instrId = vm.addCodeCB(QBDI::InstPosition::PREINST, countInstruction,
+                         &fastCounter, QBDI::CALLBACK_FAST);
+  REQUIRE(instrId != QBDI::INVALID_EVENTID);
+  retval = 0;
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  REQUIRE(retval == (QBDI::rword)36);
+  REQUIRE(fastCounter == counter);
+  REQUIRE(vm.deleteInstrumentation(instrId));
+
+#if defined(QBDI_ARCH_X86_64)
+  // the callbacks change RDI before the first instruction. The second sequence
+  // uses the FPU and fallbacks to a break to host.
+  QBDI::rword leaAddr = genASM("lea 1(%rdi), %rax\n");
+  QBDI::rword paddAddr = genASM("movq %rdi, %xmm0\n"
+                                "paddq %xmm0, %xmm0\n"
+                                "movq %xmm0, %rax\n");
+  QBDI::InstCallback setRDI = [](QBDI::VMInstanceRef vm,
+                                 QBDI::GPRState *gprState,
+                                 QBDI::FPRState *fprState,
+                                 void *data) -> QBDI::VMAction {
+    *static_cast<uint32_t *>(data) += 1;
+    gprState->rdi = 5;
+    return QBDI::VMAction::CONTINUE;
+  };
+
+  for (QBDI::Options opt :
+       {QBDI::Options::NO_OPT, QBDI::Options::OPT_DISABLE_OPTIONAL_FPR}) {
+    vm.setOptions(opt);
+    fastCounter = 0;
+
+    uint32_t cbID1 = vm.addCodeAddrCB(leaAddr, QBDI::PREINST, setRDI,
+                                      &fastCounter, QBDI::CALLBACK_FAST);
+    REQUIRE(cbID1 != QBDI::INVALID_EVENTID);
+    uint32_t cbID2 = vm.addCodeAddrCB(paddAddr, QBDI::PREINST, setRDI,
+                                      &fastCounter, QBDI::CALLBACK_FAST);
+    REQUIRE(cbID2 != QBDI::INVALID_EVENTID);
+
+    REQUIRE(vm.call(&retval, leaAddr, {1}));
+    CHECK(retval == 6);
+    REQUIRE(vm.call(&retval, paddAddr, {1}));
+    CHECK(retval == 10);
+    CHECK(fastCounter == 2);
+
+    vm.deleteInstrumentation(cbID1);
+    vm.deleteInstrumentation(cbID2);
+  }
+#endif
+
+  SUCCEED();
+}
+
+TEST_CASE_METHOD(APITest, "VMTest-OnceCallback") {
+  uint32_t counter = 0;
+  uint32_t onceCounter = 0;
+  QBDI::rword retval = 0;
+
+  uint32_t countId = vm.addCodeCB(QBDI::InstPosition::PREINST,
+                                  countInstruction, &counter);
+  REQUIRE(countId != QBDI::INVALID_EVENTID);
+  uint32_t instrId = vm.addCodeCB(QBDI::InstPosition::PREINST,
+                                  countInstruction, &onceCounter,
+                                  QBDI::CALLBACK_ONCE);
+  REQUIRE(instrId != QBDI::INVALID_EVENTID);
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  REQUIRE(retval == (QBDI::rword)36);
+  REQUIRE(onceCounter == counter);
+
+  // The cached code doesn't call the callback again
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  REQUIRE(retval == (QBDI::rword)36);
+  CHECK(onceCounter * 2 == counter);
+
+  // A new translation of the code calls it once more
+  vm.clearAllCache();
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  CHECK(onceCounter * 3 == counter * 2);
+  REQUIRE(vm.deleteInstrumentation(instrId));
+
+  counter = 0;
+  onceCounter = 0;
+  instrId = vm.addCodeCB(QBDI::InstPosition::PREINST, countInstruction,
+                         &onceCounter,
+                         QBDI::CALLBACK_FAST | QBDI::CALLBACK_ONCE);
+  REQUIRE(instrId != QBDI::INVALID_EVENTID);
+  for (int i = 0; i < 3; i++) {
+    REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+    REQUIRE(retval == (QBDI::rword)36);
+  }
+  CHECK(onceCounter * 3 == counter);
+  CHECK_FALSE(vm.setCallbackSampling(instrId, 2));
+  REQUIRE(vm.deleteInstrumentation(instrId));
+  REQUIRE(vm.deleteInstrumentation(countId));
+
+  SUCCEED();
+}
+
+QBDI::VMAction countEvent(QBDI::VMInstanceRef vm, const QBDI::VMState *vmState,
+                          QBDI::GPRState *gprState, QBDI::FPRState *fprState,
+                          void *data) {
+  *((uint32_t *)data) += 1;
+  return QBDI::VMAction::CONTINUE;
+}
+
+TEST_CASE_METHOD(APITest, "VMTest-SampledCallback") {
+  uint32_t counter = 0;
+  uint32_t sampled = 0;
+  QBDI::rword retval = 0;
+
+  uint32_t countId = vm.addCodeCB(QBDI::InstPosition::PREINST,
+                                  countInstruction, &counter);
+  REQUIRE(countId != QBDI::INVALID_EVENTID);
+  uint32_t instrId = vm.addCodeCB(QBDI::InstPosition::PREINST,
+                                  countInstruction, &sampled);
+  REQUIRE(instrId != QBDI::INVALID_EVENTID);
+  REQUIRE(vm.setCallbackSampling(instrId, 3));
+
+  for (int i = 0; i < 5; i++) {
+    REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+    REQUIRE(retval == (QBDI::rword)36);
+  }
+  REQUIRE(counter > 3u);
+  CHECK(sampled == counter / 3);
+
+  // The new period is used by the cached code
+  REQUIRE(vm.setCallbackSampling(instrId, 1));
+  counter = 0;
+  sampled = 0;
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  CHECK(sampled == counter);
+
+  REQUIRE(vm.setCallbackSampling(instrId, 4, true));
+  counter = 0;
+  sampled = 0;
+  for (int i = 0; i < 5; i++) {
+    REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  }
+  CHECK(sampled > 0u);
+  CHECK(sampled < counter);
+  REQUIRE(vm.deleteInstrumentation(instrId));
+  REQUIRE(vm.deleteInstrumentation(countId));
+
+  uint32_t events = 0;
+  uint32_t sampledEvents = 0;
+  REQUIRE(vm.addVMEventCB(QBDI::BASIC_BLOCK_ENTRY, countEvent, &events) !=
+          QBDI::INVALID_EVENTID);
+  uint32_t eventId =
+      vm.addVMEventCB(QBDI::BASIC_BLOCK_ENTRY, countEvent, &sampledEvents);
+  REQUIRE(eventId != QBDI::INVALID_EVENTID);
+  REQUIRE(vm.setCallbackSampling(eventId, 2));
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  REQUIRE(events > 0u);
+  CHECK(sampledEvents == events / 2);
+
+  CHECK_FALSE(vm.setCallbackSampling(0x4242, 2));
+
+  SUCCEED();
+}
+
+TEST_CASE_METHOD(APITest, "VMTest-InstrumentationEnabled") {
+  uint32_t counter = 0;
+  uint32_t counter2 = 0;
+  QBDI::rword retval = 0;
+
+  uint32_t instrId = vm.addCodeCB(QBDI::InstPosition::PREINST,
+                                  countInstruction, &counter);
+  REQUIRE(instrId != QBDI::INVALID_EVENTID);
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  REQUIRE(counter > 0u);
+  uint32_t expected = counter;
+
+  // The slot is read by the cached code
+  REQUIRE(vm.setInstrumentationEnabled(instrId, false));
+  counter = 0;
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  REQUIRE(retval == (QBDI::rword)36);
+  CHECK(counter == 0u);
+
+  REQUIRE(vm.setInstrumentationEnabled(instrId, true));
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  CHECK(counter == expected);
+
+  REQUIRE(vm.setInstrumentationData(instrId, &counter2));
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  CHECK(counter == expected);
+  CHECK(counter2 == expected);
+  REQUIRE(vm.deleteInstrumentation(instrId));
+
+  uint32_t events = 0;
+  uint32_t eventId =
+      vm.addVMEventCB(QBDI::BASIC_BLOCK_ENTRY, countEvent, &events);
+  REQUIRE(eventId != QBDI::INVALID_EVENTID);
+  REQUIRE(vm.setInstrumentationEnabled(eventId, false));
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  CHECK(events == 0u);
+  REQUIRE(vm.setInstrumentationEnabled(eventId, true));
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  CHECK(events > 0u);
+
+  uint32_t lambdaId = vm.addCodeCB(
+      QBDI::InstPosition::PREINST,
+      [](QBDI::VMInstanceRef, QBDI::GPRState *, QBDI::FPRState *) {
+        return QBDI::VMAction::CONTINUE;
+      });
+  CHECK_FALSE(vm.setInstrumentationData(lambdaId, &counter));
+  CHECK_FALSE(vm.setInstrumentationEnabled(0x4242, false));
+  REQUIRE(vm.deleteInstrumentation(lambdaId));
+  REQUIRE(vm.deleteInstrumentation(eventId));
+
+  // A CALLBACK_SLOT callback is never retranslated
+  counter = 0;
+  instrId = vm.addCodeCB(QBDI::InstPosition::PREINST, countInstruction,
+                         &counter, QBDI::CALLBACK_SLOT);
+  REQUIRE(instrId != QBDI::INVALID_EVENTID);
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  CHECK(counter == expected);
+  uint32_t newBlocks = 0;
+  REQUIRE(vm.addVMEventCB(QBDI::BASIC_BLOCK_NEW, countEvent, &newBlocks) !=
+          QBDI::INVALID_EVENTID);
+  counter = 0;
+  REQUIRE(vm.setInstrumentationEnabled(instrId, false));
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  CHECK(counter == 0u);
+  REQUIRE(vm.setInstrumentationEnabled(instrId, true));
+  REQUIRE(vm.setInstrumentationData(instrId, &counter2));
+  counter2 = 0;
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  CHECK(counter2 == expected);
+  CHECK(newBlocks == 0u);
+
+  SUCCEED();
+}
+
+#if defined(QBDI_ARCH_X86_64)
+bool evalPredicate(const QBDI::CallbackPredicate &predicate,
+                   const QBDI::GPRState *gprState) {
+  QBDI::rword value = QBDI_GPR_GET(gprState, predicate.reg);
+  if (predicate.source == QBDI::PREDICATE_MEMORY) {
+    value = *reinterpret_cast<const QBDI::rword *>(value + predicate.offset);
+  } else if (predicate.source == QBDI::PREDICATE_FLAG) {
+    value = (gprState->eflags >> predicate.reg) & 1;
+  }
+  switch (predicate.op) {
+    case QBDI::PREDICATE_EQ:
+      return value == predicate.constant;
+    case QBDI::PREDICATE_NE:
+      return value != predicate.constant;
+    case QBDI::PREDICATE_LT:
+      return value < predicate.constant;
+    case QBDI::PREDICATE_LE:
+      return value <= predicate.constant;
+    case QBDI::PREDICATE_GT:
+      return value > predicate.constant;
+    case QBDI::PREDICATE_GE:
+      return value >= predicate.constant;
+    case QBDI::PREDICATE_IN_RANGE:
+      return predicate.constant <= value and value < predicate.constantEnd;
+    default:
+      return false;
+  }
+}
+
+TEST_CASE_METHOD(APITest, "VMTest-PredicatedCallback") {
+
+  QBDI::rword start = genASM("xor %ecx, %ecx\n"
+                             "mov %rcx, 8(%rdi)\n"
+                             "add $5, %rcx\n"
+                             "mov %rcx, 8(%rdi)\n"
+                             "add $-6, %rcx\n"
+                             "mov %rcx, 8(%rdi)\n"
+                             "add $1, %rcx\n"
+                             "movabs $0x7fffffffffffffff, %rcx\n"
+                             "add $1, %rcx\n"
+                             "mov $7, %ecx\n"
+                             "mov %rcx, 8(%rdi)\n"
+                             "std\n"
+                             "cld\n"
+                             "lea 1(%rcx), %rax\n");
+  const uint32_t nbInst = 15;
+
+  QBDI::rword buffer[2] = {0};
+  const QBDI::rword rcx = 2;
+  const QBDI::rword rdi = 5;
+  // ZF, CF, SF and OF are compared in the JIT code, DF by the host
+  const std::vector<QBDI::CallbackPredicate> predicates = {
+      {QBDI::PREDICATE_GPR, rcx, 0, QBDI::PREDICATE_EQ, 0, 0},
+      {QBDI::PREDICATE_GPR, rcx, 0, QBDI::PREDICATE_NE, 0, 0},
+      {QBDI::PREDICATE_GPR, rcx, 0, QBDI::PREDICATE_LT, 5, 0},
+      {QBDI::PREDICATE_GPR, rcx, 0, QBDI::PREDICATE_LE, 5, 0},
+      {QBDI::PREDICATE_GPR, rcx, 0, QBDI::PREDICATE_GT, 5, 0},
+      {QBDI::PREDICATE_GPR, rcx, 0, QBDI::PREDICATE_GE, 5, 0},
+      {QBDI::PREDICATE_GPR, rcx, 0, QBDI::PREDICATE_IN_RANGE, 5, 8},
+      {QBDI::PREDICATE_GPR, rcx, 0, QBDI::PREDICATE_GT, (QBDI::rword)-1, 0},
+      {QBDI::PREDICATE_GPR, rcx, 0, QBDI::PREDICATE_LE, (QBDI::rword)-1, 0},
+      {QBDI::PREDICATE_GPR, QBDI::REG_PC, 0, QBDI::PREDICATE_EQ, start, 0},
+      {QBDI::PREDICATE_MEMORY, rdi, 8, QBDI::PREDICATE_EQ, 5, 0},
+      {QBDI::PREDICATE_MEMORY, rdi, 8, QBDI::PREDICATE_GT, 4, 0},
+      {QBDI::PREDICATE_FLAG, 6, 0, QBDI::PREDICATE_EQ, 1, 0},
+      {QBDI::PREDICATE_FLAG, 0, 0, QBDI::PREDICATE_EQ, 1, 0},
+      {QBDI::PREDICATE_FLAG, 7, 0, QBDI::PREDICATE_NE, 0, 0},
+      {QBDI::PREDICATE_FLAG, 11, 0, QBDI::PREDICATE_EQ, 1, 0},
+      {QBDI::PREDICATE_FLAG, 10, 0, QBDI::PREDICATE_EQ, 1, 0},
+  };
+
+  // an empty range can't be reversed
+  CHECK(vm.addCodeCB(QBDI::PREINST, countInstruction, nullptr,
+                     {QBDI::PREDICATE_GPR, rcx, 0, QBDI::PREDICATE_IN_RANGE, 5,
+                      4}) == QBDI::INVALID_EVENTID);
+
+  for (QBDI::InstPosition pos : {QBDI::PREINST, QBDI::POSTINST}) {
+    std::vector<uint32_t> counters(predicates.size(), 0);
+    std::vector<uint32_t> expected(predicates.size(), 0);
+    std::vector<uint32_t> ids;
+
+    for (size_t i = 0; i < predicates.size(); i++) {
+      uint32_t id =
+          vm.addCodeCB(pos, countInstruction, &counters[i], predicates[i]);
+      REQUIRE(id != QBDI::INVALID_EVENTID);
+      ids.push_back(id);
+    }
+    // the predicates evaluated in the callback
+    QBDI::InstCbLambda reference = [&](QBDI::VMInstanceRef vm,
+                                       QBDI::GPRState *gprState,
+                                       QBDI::FPRState *fprState) {
+      for (size_t i = 0; i < predicates.size(); i++) {
+        if (evalPredicate(predicates[i], gprState)) {
+          expected[i]++;
+        }
+      }
+      return QBDI::VMAction::CONTINUE;
+    };
+    ids.push_back(vm.addCodeCB(pos, reference));
+
+    uint32_t nbAddrCB = 0;
+    uint32_t nbMnemonicCB = 0;
+    ids.push_back(vm.addCodeAddrCB(
+        start, pos, countInstruction, &nbAddrCB,
+        {QBDI::PREDICATE_GPR, rdi, 0, QBDI::PREDICATE_EQ, (QBDI::rword)buffer,
+         0}));
+    ids.push_back(vm.addMnemonicCB(
+        "ADD64ri", QBDI::POSTINST, countInstruction, &nbMnemonicCB,
+        {QBDI::PREDICATE_FLAG, 6, 0, QBDI::PREDICATE_EQ, 1, 0}));
+
+    QBDI::rword retval;
+    buffer[1] = 0;
+    REQUIRE(vm.call(&retval, start, {(QBDI::rword)buffer}));
+    CHECK(retval == 8);
+
+    for (size_t i = 0; i < predicates.size(); i++) {
+      CHECK(counters[i] == expected[i]);
+    }
+    CHECK(expected[0] > 0);
+    CHECK(expected[7] == 0);
+    CHECK(expected[8] == nbInst);
+    CHECK(expected[16] > 0);
+    CHECK(nbAddrCB == 1);
+    // only the ADD that sets RCX to 0
+    CHECK(nbMnemonicCB == 1);
+
+    for (uint32_t id : ids) {
+      vm.deleteInstrumentation(id);
+    }
+  }
+
+  SUCCEED();
+}
+#endif
+
+struct InlineValueCheck {
+  QBDI::InlineOp op;
+  QBDI::rword value;
+  uint32_t nbChecks;
+  uint32_t nbErrors;
+};
+
+// Compare the value stored by an inline instrumentation of a higher priority
+// with the value computed by the host for the same instruction.
+QBDI::VMAction checkInlineValue(QBDI::VMInstanceRef vm,
+                                QBDI::GPRState *gprState,
+                                QBDI::FPRState *fprState, void *data) {
+  InlineValueCheck *check = static_cast<InlineValueCheck *>(data);
+  QBDI::rword expected = 0;
+  switch (check->op.opcode) {
+    case QBDI::INLINE_LOAD_REG:
+      expected = QBDI_GPR_GET(gprState, check->op.value);
+      break;
+    case QBDI::INLINE_LOAD_OPERAND: {
+      const QBDI::InstAnalysis *ana = vm->getInstAnalysis(
+          QBDI::ANALYSIS_INSTRUCTION | QBDI::ANALYSIS_OPERANDS);
+      if (check->op.value < ana->numOperands) {
+        const QBDI::OperandAnalysis &operand = ana->operands[check->op.value];
+        if (operand.type == QBDI::OPERAND_GPR and operand.regCtxIdx >= 0) {
+          expected = QBDI_GPR_GET(gprState, operand.regCtxIdx);
+        } else if (operand.type == QBDI::OPERAND_IMM) {
+          expected = operand.value;
+        }
+      }
+      break;
+    }
+    case QBDI::INLINE_LOAD_READ_ADDRESS:
+    case QBDI::INLINE_LOAD_WRITE_ADDRESS: {
+      const QBDI::MemoryAccessType type =
+          (check->op.opcode == QBDI::INLINE_LOAD_READ_ADDRESS)
+              ? QBDI::MEMORY_READ
+              : QBDI::MEMORY_WRITE;
+      for (const QBDI::MemoryAccess &access : vm->getInstMemoryAccess()) {
+        if (access.type & type) {
+          expected = access.accessAddress;
+          break;
+        }
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  check->nbChecks++;
+  if (check->value != expected) {
+    check->nbErrors++;
+  }
+  return QBDI::VMAction::CONTINUE;
+}
+
+TEST_CASE_METHOD(APITest, "VMTest-InlineCallback") {
+  uint32_t counter = 0;
+  uint32_t counter2 = 0;
+  QBDI::rword inlineCounter = 0;
+  QBDI::rword retval = 0;
+
+  vm.addCodeCB(QBDI::InstPosition::PREINST, countInstruction, &counter);
+  // counter += 1 without leaving the ExecBlock
+  uint32_t instrId = vm.addInlineCB(
+      QBDI::InstPosition::PREINST,
+      {{QBDI::INLINE_LOAD_MEMORY, (QBDI::rword)&inlineCounter,
+        QBDI::PREDICATE_EQ, 0, 0},
+       {QBDI::INLINE_ADD, 1, QBDI::PREDICATE_EQ, 0, 0},
+       {QBDI::INLINE_STORE, (QBDI::rword)&inlineCounter, QBDI::PREDICATE_EQ,
+        0, 0}});
+  REQUIRE(instrId != QBDI::INVALID_EVENTID);
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  REQUIRE(retval == (QBDI::rword)36);
+  REQUIRE(counter > 0u);
+  CHECK(inlineCounter == counter);
+  vm.deleteAllInstrumentations();
+
+  // saturating counter
+  inlineCounter = 0;
+  instrId = vm.addInlineCB(
+      QBDI::InstPosition::POSTINST,
+      {{QBDI::INLINE_LOAD_MEMORY, (QBDI::rword)&inlineCounter,
+        QBDI::PREDICATE_EQ, 0, 0},
+       {QBDI::INLINE_SKIP, 2, QBDI::PREDICATE_GE, 10, 0},
+       {QBDI::INLINE_ADD, 1, QBDI::PREDICATE_EQ, 0, 0},
+       {QBDI::INLINE_STORE, (QBDI::rword)&inlineCounter, QBDI::PREDICATE_EQ,
+        0, 0}});
+  REQUIRE(instrId != QBDI::INVALID_EVENTID);
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  REQUIRE(retval == (QBDI::rword)36);
+  CHECK(inlineCounter == 10u);
+  vm.deleteAllInstrumentations();
+
+  // INLINE_CALL is only reached when the skip doesn't hold
+  counter = 0;
+  instrId = vm.addInlineCB(
+      QBDI::InstPosition::PREINST,
+      {{QBDI::INLINE_LOAD_IMM, 5, QBDI::PREDICATE_EQ, 0, 0},
+       {QBDI::INLINE_SKIP, 1, QBDI::PREDICATE_LT, 3, 0},
+       {QBDI::INLINE_CALL, 0, QBDI::PREDICATE_EQ, 0, 0}},
+      countInstruction, &counter);
+  REQUIRE(instrId != QBDI::INVALID_EVENTID);
+  vm.addInlineCB(QBDI::InstPosition::PREINST,
+                 {{QBDI::INLINE_LOAD_IMM, 1, QBDI::PREDICATE_EQ, 0, 0},
+                  {QBDI::INLINE_SKIP, 1, QBDI::PREDICATE_LT, 3, 0},
+                  {QBDI::INLINE_CALL, 0, QBDI::PREDICATE_EQ, 0, 0}},
+                 countInstruction, &counter2);
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  REQUIRE(retval == (QBDI::rword)36);
+  CHECK(counter > 0u);
+  CHECK(counter2 == 0u);
+  vm.deleteAllInstrumentations();
+
+  // the value of each load, compiled or interpreted by the host (satanicFun
+  // has a CMPSB, which reads twice)
+  std::vector<QBDI::InlineOp> loads;
+  for (QBDI::rword reg = 0; reg < QBDI::NUM_GPR; reg++) {
+    loads.push_back({QBDI::INLINE_LOAD_REG, reg, QBDI::PREDICATE_EQ, 0, 0});
+  }
+  if (QBDI::REG_PC >= QBDI::NUM_GPR) {
+    loads.push_back(
+        {QBDI::INLINE_LOAD_REG, QBDI::REG_PC, QBDI::PREDICATE_EQ, 0, 0});
+  }
+  for (QBDI::rword operand = 0; operand < 4; operand++) {
+    loads.push_back(
+        {QBDI::INLINE_LOAD_OPERAND, operand, QBDI::PREDICATE_EQ, 0, 0});
+  }
+  loads.push_back(
+      {QBDI::INLINE_LOAD_READ_ADDRESS, 0, QBDI::PREDICATE_EQ, 0, 0});
+  loads.push_back(
+      {QBDI::INLINE_LOAD_WRITE_ADDRESS, 0, QBDI::PREDICATE_EQ, 0, 0});
+  for (QBDI::InstPosition pos : {QBDI::PREINST, QBDI::POSTINST}) {
+    for (const QBDI::InlineOp &load : loads) {
+      InlineValueCheck check = {load, 0, 0, 0};
+      REQUIRE(vm.addInlineCB(pos,
+                             {load,
+                              {QBDI::INLINE_STORE, (QBDI::rword)&check.value,
+                               QBDI::PREDICATE_EQ, 0, 0}},
+                             nullptr, nullptr, 1) != QBDI::INVALID_EVENTID);
+      vm.addCodeCB(pos, checkInlineValue, &check);
+      REQUIRE(vm.call(&retval, (QBDI::rword)satanicFun, {42}));
+      REQUIRE(retval == (QBDI::rword)satanicFun(42));
+      INFO("opcode " << load.opcode << " value " << load.value << " pos "
+                     << pos);
+      CHECK(check.nbChecks > 0u);
+      CHECK(check.nbErrors == 0u);
+      vm.deleteAllInstrumentations();
+    }
+  }
+
+#if defined(QBDI_ARCH_X86_64)
+  // RAX, RCX and RDX are used by the gate and reloaded from the context
+  QBDI::rword regs[3] = {0};
+  for (unsigned i = 0; i < 3; i++) {
+    const std::vector<QBDI::InlineOp> ops = {
+        {QBDI::INLINE_LOAD_REG, i, QBDI::PREDICATE_EQ, 0, 0},
+        {QBDI::INLINE_STORE, (QBDI::rword)&regs[i], QBDI::PREDICATE_EQ, 0, 0}};
+    REQUIRE(vm.addInlineCB(QBDI::PREINST, ops) != QBDI::INVALID_EVENTID);
+  }
+  REQUIRE(runOnASM(&retval, "mov $0x1111, %rax\n"
+                            "mov $0x2222, %rcx\n"
+                            "mov $0x3333, %rdx\n"));
+  CHECK(regs[0] == 0x1111u);
+  CHECK(regs[1] == 0x2222u);
+  CHECK(regs[2] == 0x3333u);
+  vm.deleteAllInstrumentations();
+
+  // the REP and double read instructions are interpreted by the host
+  uint8_t src[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+  uint8_t dst[8] = {0};
+  QBDI::rword access[2] = {0};
+  QBDI::rword pc = 0;
+  QBDI::rword addr = genASM("cld\n"
+                            "rep movsb\n");
+  const std::vector<QBDI::InlineOp> repOps = {
+      {QBDI::INLINE_LOAD_READ_ADDRESS, 0, QBDI::PREDICATE_EQ, 0, 0},
+      {QBDI::INLINE_STORE, (QBDI::rword)&access[0], QBDI::PREDICATE_EQ, 0, 0},
+      {QBDI::INLINE_LOAD_WRITE_ADDRESS, 0, QBDI::PREDICATE_EQ, 0, 0},
+      {QBDI::INLINE_STORE, (QBDI::rword)&access[1], QBDI::PREDICATE_EQ, 0, 0},
+      {QBDI::INLINE_LOAD_REG, QBDI::REG_PC, QBDI::PREDICATE_EQ, 0, 0},
+      {QBDI::INLINE_STORE, (QBDI::rword)&pc, QBDI::PREDICATE_EQ, 0, 0}};
+  REQUIRE(vm.addInlineRangeCB(addr + 1, addr + 2, QBDI::POSTINST, repOps) !=
+          QBDI::INVALID_EVENTID);
+  state->rsi = (QBDI::rword)src;
+  state->rdi = (QBDI::rword)dst;
+  state->rcx = sizeof(src);
+  REQUIRE(vm.call(&retval, addr));
+  CHECK(dst[7] == src[7]);
+  CHECK(access[0] == (QBDI::rword)src);
+  CHECK(access[1] == (QBDI::rword)dst);
+  CHECK(pc == addr + 3);
+  vm.deleteAllInstrumentations();
+
+  access[0] = access[1] = 0xff;
+  pc = 0;
+  addr = genASM("cmpsb\n");
+  REQUIRE(vm.addInlineRangeCB(addr, addr + 1, QBDI::POSTINST, repOps) !=
+          QBDI::INVALID_EVENTID);
+  state->rsi = (QBDI::rword)src;
+  state->rdi = (QBDI::rword)dst;
+  REQUIRE(vm.call(&retval, addr));
+  CHECK(access[0] == (QBDI::rword)src);
+  CHECK(access[1] == 0u);
+  CHECK(pc == addr + 1);
+  vm.deleteAllInstrumentations();
+#endif
+
+  CHECK(vm.addInlineCB(QBDI::InstPosition::PREINST, {}) ==
+        QBDI::INVALID_EVENTID);
+  CHECK(vm.addInlineCB(QBDI::InstPosition::PREINST,
+                       {{QBDI::INLINE_CALL, 0, QBDI::PREDICATE_EQ, 0, 0}}) ==
+        QBDI::INVALID_EVENTID);
+  CHECK(vm.addInlineCB(QBDI::InstPosition::PREINST,
+                       {{QBDI::INLINE_CALL, 0, QBDI::PREDICATE_EQ, 0, 0},
+                        {QBDI::INLINE_ADD, 1, QBDI::PREDICATE_EQ, 0, 0}},
+                       countInstruction, &counter) == QBDI::INVALID_EVENTID);
+
+  SUCCEED();
+}
+
+TEST_CASE_METHOD(APITest, "VMTest-ExecBlockSize") {
+  uint32_t counter = 0;
+  QBDI::rword retval = 0;
+
+  vm.addCodeCB(QBDI::InstPosition::PREINST, countInstruction, &counter);
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  REQUIRE(retval == (QBDI::rword)36);
+  uint32_t expected = counter;
+
+  // not a multiple of the page size
+  CHECK_FALSE(vm.setExecBlockSize(1000));
+
+  // ARM only supports the default sizes
+  if (vm.setExecBlockSize(0x10000, 0x4000)) {
+    CHECK(vm.getNbExecBlock() == 0u);
+    counter = 0;
+    REQUIRE(
+        vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+    REQUIRE(retval == (QBDI::rword)36);
+    CHECK(counter == expected);
+    CHECK(vm.getNbExecBlock() > 0u);
+  }
+
+  REQUIRE(vm.setExecBlockSize(0, 0));
+  counter = 0;
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  REQUIRE(retval == (QBDI::rword)36);
+  CHECK(counter == expected);
+
+  SUCCEED();
+}
+
+TEST_CASE_METHOD(APITest, "VMTest-LargeExecBlock") {
+  const size_t instSize = (QBDI::is_arm || QBDI::is_aarch64) ? 4 : 1;
+  const uint32_t nbInst = 2048;
+
+  for (bool hugePages : {false, true}) {
+    // ARM only supports the default sizes, the huge pages are only supported
+    // on Linux and Android
+    if (not vm.setExecBlockSize(0x200000, 0x8000, hugePages)) {
+      continue;
+    }
+    uint32_t counter = 0;
+    QBDI::rword retval = 0;
+    uint32_t cbID =
+        vm.addCodeCB(QBDI::InstPosition::PREINST, countInstruction, &counter);
+    REQUIRE(cbID != QBDI::INVALID_EVENTID);
+
+    // a single basic block whose patches fill more than 64 KiB of code
+    QBDI::rword addr = genASM(".rept 2048\nnop\n.endr\n");
+    REQUIRE(vm.getNbExecBlock() == 1u);
+    REQUIRE(vm.call(&retval, addr));
+    CHECK(counter == nbInst + 1);
+    CHECK(vm.getNbExecBlock() == 1u);
+
+    QBDI::rword firstPatch = 0;
+    QBDI::rword lastPatch = 0;
+    for (uint32_t i = 0; i < nbInst; i++) {
+      const QBDI::rword address = addr + i * instSize;
+      const auto *ana = vm.getCachedInstAnalysis(
+          address, QBDI::AnalysisType::ANALYSIS_JIT |
+                       QBDI::AnalysisType::ANALYSIS_INSTRUCTION);
+      REQUIRE(ana != nullptr);
+      const QBDI::rword patchAddress = ana->patchAddress;
+      const QBDI::rword patchEnd = ana->patchAddress + ana->patchSize - 1;
+      if (i == 0) {
+        firstPatch = patchAddress;
+      }
+      lastPatch = patchAddress;
+
+      // the JIT address after 64 KiB finds its instruction
+      for (QBDI::rword jitAddress : {patchAddress, patchEnd}) {
+        const auto *anaJit = vm.getJITInstAnalysis(
+            jitAddress, QBDI::AnalysisType::ANALYSIS_JIT |
+                            QBDI::AnalysisType::ANALYSIS_INSTRUCTION);
+        REQUIRE(anaJit != nullptr);
+        CHECK(anaJit->address == address);
+      }
+    }
+    CHECK(lastPatch - firstPatch > 0x10000);
+
+    vm.deleteInstrumentation(cbID);
+  }
+  REQUIRE(vm.setExecBlockSize(0, 0));
+
+  SUCCEED();
+}
+
+TEST_CASE_METHOD(APITest, "VMTest-RecycleExecBlock") {
+  uint32_t counter = 0;
+  uint32_t fastCounter = 0;
+  QBDI::rword retval = 0;
+
+  vm.addCodeCB(QBDI::InstPosition::PREINST, countInstruction, &counter);
+  vm.addCodeCB(QBDI::InstPosition::PREINST, countInstruction, &fastCounter,
+               QBDI::CALLBACK_FAST);
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  REQUIRE(retval == (QBDI::rword)36);
+  uint32_t expected = counter;
+  uint32_t nbExecBlock = vm.getNbExecBlock();
+  CHECK(fastCounter == expected);
+
+  // the ExecBlocks of the flushed cache are reused
+  for (int i = 0; i < 3; i++) {
+    vm.clearAllCache();
+    CHECK(vm.getNbExecBlock() == 0u);
+    counter = 0;
+    fastCounter = 0;
+    retval = 0;
+    REQUIRE(
+        vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+    REQUIRE(retval == (QBDI::rword)36);
+    CHECK(counter == expected);
+    CHECK(fastCounter == expected);
+    CHECK(vm.getNbExecBlock() == nbExecBlock);
+  }
+
+  vm.reduceCacheTo(0);
+  counter = 0;
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  REQUIRE(retval == (QBDI::rword)36);
+  CHECK(counter == expected);
+
+  SUCCEED();
+}
+
+TEST_CASE_METHOD(APITest, "VMTest-DualMapping") {
+  uint32_t counter = 0;
+  QBDI::rword retval = 0;
+
+  vm.addCodeCB(QBDI::InstPosition::PREINST, countInstruction, &counter);
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  REQUIRE(retval == (QBDI::rword)36);
+  uint32_t expected = counter;
+
+  // ignored on the platforms without memfd
+  vm.setOptions(vm.getOptions() | QBDI::Options::OPT_ENABLE_DUAL_MAPPING);
+  for (int i = 0; i < 2; i++) {
+    counter = 0;
+    retval = 0;
+    REQUIRE(
+        vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+    REQUIRE(retval == (QBDI::rword)36);
+    CHECK(counter == expected);
+    vm.clearAllCache();
+  }
+
+  SUCCEED();
+}
+
+TEST_CASE_METHOD(APITest, "VMTest-PrecacheModule") {
+  uint32_t counter = 0;
+  QBDI::rword retval = 0;
+  std::string name;
+
+  for (const QBDI::MemoryMap &m : QBDI::getCurrentProcessMaps(true)) {
+    if (m.range.contains((QBDI::rword)dummyFun8)) {
+      name = m.name;
+    }
+  }
+  REQUIRE_FALSE(name.empty());
+  CHECK(vm.precacheModule("", QBDI::PRECACHE_RECURSIVE) == 0u);
+  CHECK(vm.precacheModule("qbdi_unknown_module") == 0u);
+
+  // dummyFun8 is a single basic block, the loop of spinLoop has successors
+  volatile int flag = 0;
+  vm.addCodeCB(QBDI::InstPosition::PREINST, countInstruction, &counter);
+  REQUIRE(vm.call(&retval, (QBDI::rword)spinLoop, {(QBDI::rword)&flag}));
+  REQUIRE(retval == (QBDI::rword)0);
+  uint32_t expected = counter;
+  vm.clearAllCache();
+
+#if defined(QBDI_PLATFORM_LINUX) || defined(QBDI_PLATFORM_ANDROID)
+  // the entry point of the executable
+  CHECK(vm.precacheModule(name, QBDI::PRECACHE_SYMBOLS) > 0u);
+  vm.clearAllCache();
+#endif
+  // the successors of the basic blocks in the cache are followed
+  REQUIRE(vm.precacheBasicBlock((QBDI::rword)spinLoop));
+  CHECK(vm.getNbExecBlock() > 0u);
+  CHECK(vm.precacheModule(name, QBDI::PRECACHE_RECURSIVE) > 0u);
+  CHECK(vm.precacheModule(name, QBDI::PRECACHE_RECURSIVE) == 0u);
+
+  // the run doesn't translate any new basic block
+  uint32_t newBlocks = 0;
+  REQUIRE(vm.addVMEventCB(QBDI::BASIC_BLOCK_NEW, countEvent, &newBlocks) !=
+          QBDI::INVALID_EVENTID);
+  counter = 0;
+  retval = 0xff;
+  REQUIRE(vm.call(&retval, (QBDI::rword)spinLoop, {(QBDI::rword)&flag}));
+  REQUIRE(retval == (QBDI::rword)0);
+  CHECK(counter == expected);
+  CHECK(newBlocks == 0u);
+
+  SUCCEED();
+}
+
+TEST_CASE_METHOD(APITest, "VMTest-RunBudget") {
+  uint32_t counter = 0;
+  QBDI::rword retval = 0;
+  volatile int flag = 1;
+
+  vm.addCodeCB(QBDI::InstPosition::PREINST, countInstruction, &counter);
+
+  if (vm.setInstructionBudget(100)) {
+    vm.call(&retval, (QBDI::rword)spinLoop, {(QBDI::rword)&flag});
+    REQUIRE(vm.isBudgetExhausted());
+    // the budget is decremented before the last instruction of a basic block
+    CHECK(counter >= 99u);
+    CHECK(counter < 150u);
+
+    // each run has its own budget
+    uint32_t total = 0;
+    counter = 0;
+    REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+    CHECK_FALSE(vm.isBudgetExhausted());
+    REQUIRE(retval == (QBDI::rword)36);
+    total = counter;
+    REQUIRE(vm.setInstructionBudget(total - 1));
+    counter = 0;
+    vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8});
+    CHECK(vm.isBudgetExhausted());
+    CHECK(counter < total);
+    REQUIRE(vm.setInstructionBudget(0));
+  }
+
+  vm.setTimeBudget(50);
+  vm.call(&retval, (QBDI::rword)spinLoop, {(QBDI::rword)&flag});
+  REQUIRE(vm.isBudgetExhausted());
+
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  CHECK_FALSE(vm.isBudgetExhausted());
+  REQUIRE(retval == (QBDI::rword)36);
+
+  // runWithStatus distinguishes the end of the budget
+  QBDI::simulateCall(state, FAKE_RET_ADDR, {(QBDI::rword)&flag});
+  CHECK(vm.runWithStatus((QBDI::rword)spinLoop, FAKE_RET_ADDR) ==
+        QBDI::RunStatus::RUN_BUDGET_EXHAUSTED);
+
+  QBDI::simulateCall(state, FAKE_RET_ADDR, {1, 2, 3, 4, 5, 6, 7, 8});
+  CHECK(vm.runWithStatus((QBDI::rword)dummyFun8, FAKE_RET_ADDR) ==
+        QBDI::RunStatus::RUN_STOPPED);
+
+  // Without callback, the loop only returns to the host when the countdown of
+  // a slice expires (X86 and X86_64)
+  vm.deleteAllInstrumentations();
+#if defined(QBDI_ARCH_X86) || defined(QBDI_ARCH_X86_64)
+  vm.setOptions(vm.getOptions() | QBDI::Options::OPT_ENABLE_BLOCK_CHAINING);
+#endif
+  auto begin = std::chrono::steady_clock::now();
+  vm.call(&retval, (QBDI::rword)spinLoop, {(QBDI::rword)&flag});
+  auto elapsed = std::chrono::steady_clock::now() - begin;
+  REQUIRE(vm.isBudgetExhausted());
+  CHECK(elapsed >= std::chrono::milliseconds(50));
+
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun8, {1, 2, 3, 4, 5, 6, 7, 8}));
+  CHECK_FALSE(vm.isBudgetExhausted());
+  REQUIRE(retval == (QBDI::rword)36);
+
+  SUCCEED();
+}
+
 TEST_CASE_METHOD(APITest, "VMTest-InstCallback") {
   QBDI::rword info[2] = {42, 0};
   QBDI::simulateCall(state, FAKE_RET_ADDR, {info[0]});
@@ -776,6 +1646,68 @@ TEST_CASE_METHOD(APITest, "VMTest-Priority") {
   SUCCEED();
 }
 
+struct CoalesceTestData {
+  QBDI::rword seen;
+  uint8_t cbfirst;
+  uint8_t cbsecond;
+  uint8_t cbthird;
+};
+
+static std::vector<QBDI::InstrRuleDataCBK>
+coalesceInstrCB(QBDI::VMInstanceRef vm, const QBDI::InstAnalysis *inst,
+                void *data_) {
+  std::vector<QBDI::InstrRuleDataCBK> r;
+
+  r.emplace_back(
+      QBDI::InstPosition::PREINST,
+      [](QBDI::VMInstanceRef vm, QBDI::GPRState *gprState,
+         QBDI::FPRState *fprState, void *data) -> QBDI::VMAction {
+        ((CoalesceTestData *)data)->cbsecond++;
+        ((CoalesceTestData *)data)->seen =
+            QBDI_GPR_GET(gprState, QBDI::REG_RETURN);
+        return QBDI::VMAction::CONTINUE;
+      },
+      data_, 0);
+
+  return r;
+}
+
+TEST_CASE_METHOD(APITest, "VMTest-CoalescedCallbacks") {
+  // The callbacks at the same position share a break to host. The changes
+  // of a callback must be visible by the next one.
+  CoalesceTestData data = {0};
+  QBDI::rword retval = 0;
+
+  vm.addCodeAddrCB(
+      (QBDI::rword)dummyFun0, QBDI::InstPosition::PREINST,
+      [](QBDI::VMInstanceRef vm, QBDI::GPRState *gprState,
+         QBDI::FPRState *fprState, void *data) -> QBDI::VMAction {
+        ((CoalesceTestData *)data)->cbfirst++;
+        QBDI_GPR_SET(gprState, QBDI::REG_RETURN, 0x1234);
+        return QBDI::VMAction::CONTINUE;
+      },
+      &data, 10);
+  vm.addCodeAddrCB(
+      (QBDI::rword)dummyFun0, QBDI::InstPosition::PREINST,
+      [](QBDI::VMInstanceRef vm, QBDI::GPRState *gprState,
+         QBDI::FPRState *fprState, void *data) -> QBDI::VMAction {
+        ((CoalesceTestData *)data)->cbthird++;
+        return QBDI::VMAction::CONTINUE;
+      },
+      &data, -10);
+  vm.addInstrRuleRange((QBDI::rword)dummyFun0, (QBDI::rword)dummyFun0 + 1,
+                       coalesceInstrCB, QBDI::ANALYSIS_INSTRUCTION, &data);
+
+  REQUIRE(vm.call(&retval, (QBDI::rword)dummyFun0));
+  REQUIRE(retval == (QBDI::rword)42);
+  REQUIRE(data.cbfirst == 1);
+  REQUIRE(data.cbsecond == 1);
+  REQUIRE(data.cbthird == 1);
+  REQUIRE(data.seen == (QBDI::rword)0x1234);
+
+  SUCCEED();
+}
+
 struct SkipTestData {
   uint8_t cbpre1;
   uint8_t cbpre2;
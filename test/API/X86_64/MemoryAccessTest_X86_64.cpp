@@ -1781,3 +1781,181 @@ TEST_CASE_METHOD(APITest, "MemoryAccessTest_X86_64-xsave") {
   for (auto &e : expectedPost.accesses)
     CHECK(e.see);
 }
+
+struct MemoryTraceInfo {
+  std::vector<size_t> flushes;
+  std::vector<QBDI::MemoryAccess> accesses;
+};
+
+static void traceFlush(QBDI::VMInstanceRef vm,
+                       const QBDI::MemoryAccess *accesses, size_t size,
+                       void *data) {
+  MemoryTraceInfo *info = static_cast<MemoryTraceInfo *>(data);
+  info->flushes.push_back(size);
+  info->accesses.insert(info->accesses.end(), accesses, accesses + size);
+}
+
+TEST_CASE_METHOD(APITest, "MemoryAccessTest_X86_64-memoryTrace") {
+
+  // the buffer is flushed between the DEC and the JNZ
+  const char source[] =
+      "xor %rsi, %rsi\n"
+      "1:\n"
+      "inc %rax\n"
+      "mov %rax, (%rbx)\n"
+      "dec %rdx\n"
+      "mov (%rbx), %rcx\n"
+      "lea (%rsi, %rcx), %rsi\n"
+      "jnz 1b\n"
+      "mov %rsi, %rax\n";
+
+  QBDI::rword v = 0;
+  QBDI::MemoryAccess buffer[3];
+  MemoryTraceInfo info;
+
+  REQUIRE(vm.setMemoryTrace(buffer, 3, traceFlush, &info));
+
+  QBDI::GPRState *state = vm.getGPRState();
+  state->rax = 0;
+  state->rbx = (QBDI::rword)&v;
+  state->rdx = 5;
+  vm.setGPRState(state);
+
+  QBDI::rword retval;
+  bool ran = runOnASM(&retval, source);
+
+  CHECK(ran);
+  CHECK(retval == 15);
+  vm.removeMemoryTrace();
+
+  // 5 writes and 5 reads of v, and the read of the RET
+  CHECK(info.flushes == std::vector<size_t>({3, 3, 3, 2}));
+  std::vector<QBDI::MemoryAccess> accesses;
+  for (const QBDI::MemoryAccess &a : info.accesses) {
+    if (a.accessAddress == (QBDI::rword)&v) {
+      accesses.push_back(a);
+    }
+  }
+  REQUIRE(accesses.size() == 10);
+  for (size_t i = 0; i < accesses.size(); i++) {
+    CHECK(accesses[i].value == i / 2 + 1);
+    CHECK(accesses[i].size == 8);
+    CHECK(accesses[i].type ==
+          (i % 2 == 0 ? QBDI::MEMORY_WRITE : QBDI::MEMORY_READ));
+    CHECK(accesses[i].flags == QBDI::MEMORY_NO_FLAGS);
+  }
+}
+
+static QBDI::VMAction countAccess(QBDI::VMInstanceRef vm,
+                                  QBDI::GPRState *gprState,
+                                  QBDI::FPRState *fprState, void *data) {
+  (*static_cast<int *>(data))++;
+  return QBDI::VMAction::CONTINUE;
+}
+
+static QBDI::VMAction countNewBlock(QBDI::VMInstanceRef vm,
+                                   const QBDI::VMState *vmState,
+                                   QBDI::GPRState *gprState,
+                                   QBDI::FPRState *fprState, void *data) {
+  (*static_cast<uint32_t *>(data))++;
+  return QBDI::VMAction::CONTINUE;
+}
+
+TEST_CASE_METHOD(APITest, "MemoryAccessTest_X86_64-memRangeGate") {
+
+  // Only the accesses at -7(%rbx) overlap the watched byte. The flags set by
+  // the CMP must be kept by the gates.
+  const char source[] =
+      "cmp %rax, %rax\n"
+      "mov %rax, -8(%rbx)\n"
+      "mov %rax, -7(%rbx)\n"
+      "mov %rax, 1(%rbx)\n"
+      "mov -8(%rbx), %rcx\n"
+      "mov -7(%rbx), %rcx\n"
+      "mov 1(%rbx), %rcx\n"
+      "mov $0, %eax\n"
+      "sete %al\n";
+
+  uint8_t buffer[32] = {0};
+  uint8_t other[64] = {0};
+  int nbRead = 0;
+  int nbWrite = 0;
+
+  vm.addMemAddrCB((QBDI::rword)&buffer[16], QBDI::MEMORY_READ, countAccess,
+                  &nbRead);
+  vm.addMemAddrCB((QBDI::rword)&buffer[16], QBDI::MEMORY_WRITE, countAccess,
+                  &nbWrite);
+
+  QBDI::GPRState *state = vm.getGPRState();
+  state->rbx = (QBDI::rword)&buffer[16];
+  vm.setGPRState(state);
+
+  QBDI::rword retval;
+  bool ran = runOnASM(&retval, source);
+
+  CHECK(ran);
+  CHECK(retval == 1);
+  CHECK(nbRead == 1);
+  CHECK(nbWrite == 1);
+
+  // More ranges than the JIT code compares: the gate compares them in the host
+  for (int i = 0; i < 4; i++) {
+    vm.addMemAddrCB((QBDI::rword)&other[i * 16], QBDI::MEMORY_READ,
+                    countAccess, &nbRead);
+  }
+  nbRead = 0;
+  nbWrite = 0;
+
+  state = vm.getGPRState();
+  state->rbx = (QBDI::rword)&buffer[16];
+  vm.setGPRState(state);
+
+  ran = runOnASM(&retval, source);
+
+  CHECK(ran);
+  CHECK(retval == 1);
+  CHECK(nbRead == 1);
+  CHECK(nbWrite == 1);
+
+  // The JIT code of a gate that compares its ranges in the host doesn't
+  // change when a range is added or removed: the cache is kept
+  QBDI::rword addr = genASM(source);
+  uint32_t newBlocks = 0;
+  REQUIRE(vm.addVMEventCB(QBDI::BASIC_BLOCK_NEW, countNewBlock, &newBlocks) !=
+          QBDI::INVALID_EVENTID);
+  uint32_t id = vm.addMemAddrCB((QBDI::rword)&other[4 * 16],
+                                QBDI::MEMORY_READ, countAccess, &nbRead);
+  REQUIRE(id != QBDI::INVALID_EVENTID);
+  for (int i = 0; i < 2; i++) {
+    if (i == 1) {
+      REQUIRE(vm.deleteInstrumentation(id));
+    }
+    nbRead = 0;
+    nbWrite = 0;
+    state = vm.getGPRState();
+    state->rbx = (QBDI::rword)&buffer[16];
+    vm.setGPRState(state);
+
+    REQUIRE(vm.call(&retval, addr));
+    CHECK(retval == 1);
+    CHECK(nbRead == 1);
+    CHECK(nbWrite == 1);
+    CHECK(newBlocks == 0u);
+  }
+
+  // The write gate compares its range in the JIT code, another range changes
+  // its code
+  vm.addMemAddrCB((QBDI::rword)&other[0], QBDI::MEMORY_WRITE, countAccess,
+                  &nbWrite);
+  nbRead = 0;
+  nbWrite = 0;
+  state = vm.getGPRState();
+  state->rbx = (QBDI::rword)&buffer[16];
+  vm.setGPRState(state);
+
+  REQUIRE(vm.call(&retval, addr));
+  CHECK(retval == 1);
+  CHECK(nbRead == 1);
+  CHECK(nbWrite == 1);
+  CHECK(newBlocks > 0u);
+}
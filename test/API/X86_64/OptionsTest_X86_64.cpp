@@ -19,13 +19,17 @@
 #include "API/OptionsTest.h"
 
 #include <algorithm>
+#include <set>
 #include <sstream>
 #include <string>
+#include <string.h>
 #include "inttypes.h"
 
 #include "QBDI/Memory.hpp"
 #include "QBDI/Platform.h"
 
+#include "Utility/System.h"
+
 TEST_CASE_METHOD(OptionsTest, "OptionsTest_X86_64-ATTSyntax") {
 
   InMemoryObject leaObj("leaq (%rax), %rbx\nret\n");
@@ -103,3 +107,613 @@ TEST_CASE_METHOD(OptionsTest, "OptionsTest_X86_64-setOption") {
 
   QBDI::alignedFree(fakestack);
 }
+
+static QBDI::VMAction countInstruction(QBDI::VMInstanceRef vm,
+                                       QBDI::GPRState *gprState,
+                                       QBDI::FPRState *fprState, void *data) {
+  *((uint64_t *)data) += 1;
+  return QBDI::VMAction::CONTINUE;
+}
+
+static QBDI::VMAction countSequence(QBDI::VMInstanceRef vm,
+                                    const QBDI::VMState *vmState,
+                                    QBDI::GPRState *gprState,
+                                    QBDI::FPRState *fprState, void *data) {
+  *((uint64_t *)data) += 1;
+  return QBDI::VMAction::CONTINUE;
+}
+
+TEST_CASE_METHOD(OptionsTest, "OptionsTest_X86_64-BlockChaining") {
+
+  InMemoryObject loopObj("  xor %rax, %rax\n"
+                         "  mov $100, %rcx\n"
+                         "loop:\n"
+                         "  add $3, %rax\n"
+                         "  dec %rcx\n"
+                         "  jnz loop\n"
+                         "  call func\n"
+                         "  ret\n"
+                         "func:\n"
+                         "  add $1, %rax\n"
+                         "  jmp end\n"
+                         "  nop\n"
+                         "end:\n"
+                         "  ret\n");
+  QBDI::rword addr = (QBDI::rword)loopObj.getCode().data();
+
+  uint8_t *fakestack;
+  QBDI::GPRState *state = vm.getGPRState();
+  bool ret = QBDI::allocateVirtualStack(state, 4096, &fakestack);
+  REQUIRE(ret == true);
+
+  vm.setOptions(QBDI::Options::OPT_ENABLE_BLOCK_CHAINING);
+  vm.addInstrumentedRange(addr, addr + (QBDI::rword)loopObj.getCode().size());
+
+  QBDI::rword retval;
+
+  // without instrumentation
+  REQUIRE(vm.call(&retval, addr, {}));
+  CHECK(retval == 301);
+
+  // every instruction must still be reached by the callbacks
+  uint64_t nbInst = 0;
+  vm.addCodeCB(QBDI::PREINST, countInstruction, &nbInst);
+  REQUIRE(vm.call(&retval, addr, {}));
+  CHECK(retval == 301);
+  CHECK(nbInst == 2 + 3 * 100 + 2 + 3);
+
+  // the sequence events disable the chaining
+  nbInst = 0;
+  uint64_t nbSeq = 0;
+  vm.addVMEventCB(QBDI::SEQUENCE_ENTRY, countSequence, &nbSeq);
+  REQUIRE(vm.call(&retval, addr, {}));
+  CHECK(retval == 301);
+  CHECK(nbInst == 2 + 3 * 100 + 2 + 3);
+  CHECK(nbSeq >= 100);
+
+  // the stop address isn't reached through a chain
+  vm.deleteAllInstrumentations();
+  nbInst = 0;
+  vm.addCodeCB(QBDI::PREINST, countInstruction, &nbInst);
+  state->rax = 0;
+  state->rcx = 5;
+  // the loop starts at offset 10
+  REQUIRE(vm.run(addr + 10, addr + 10));
+  CHECK(state->rax == 3);
+  CHECK(nbInst == 3);
+
+  QBDI::alignedFree(fakestack);
+}
+
+TEST_CASE_METHOD(OptionsTest, "OptionsTest_X86_64-IndirectCache") {
+
+  InMemoryObject loopObj("  xor %rax, %rax\n"
+                         "  mov $100, %rcx\n"
+                         "loop:\n"
+                         "  call func\n"
+                         "  dec %rcx\n"
+                         "  jnz loop\n"
+                         "  ret\n"
+                         "func:\n"
+                         "  add $2, %rax\n"
+                         "  ret\n");
+  QBDI::rword addr = (QBDI::rword)loopObj.getCode().data();
+
+  uint8_t *fakestack;
+  QBDI::GPRState *state = vm.getGPRState();
+  bool ret = QBDI::allocateVirtualStack(state, 4096, &fakestack);
+  REQUIRE(ret == true);
+
+  vm.addInstrumentedRange(addr, addr + (QBDI::rword)loopObj.getCode().size());
+
+  QBDI::rword retval;
+  uint64_t hits = 0, misses = 0;
+
+  // the cache isn't used without the block chaining
+  REQUIRE(vm.call(&retval, addr, {}));
+  CHECK(retval == 200);
+  vm.getIndirectCacheStats(&hits, &misses);
+  CHECK(hits == 0);
+  CHECK(misses == 0);
+
+  vm.setOptions(QBDI::Options::OPT_ENABLE_BLOCK_CHAINING);
+
+  // the return of func is resolved in the JIT after the first iteration
+  REQUIRE(vm.call(&retval, addr, {}));
+  CHECK(retval == 200);
+  vm.getIndirectCacheStats(&hits, &misses);
+  CHECK(hits >= 90);
+  CHECK(misses >= 1);
+
+  // every instruction must still be reached by the callbacks
+  uint64_t nbInst = 0;
+  vm.addCodeCB(QBDI::PREINST, countInstruction, &nbInst);
+  REQUIRE(vm.call(&retval, addr, {}));
+  CHECK(retval == 200);
+  CHECK(nbInst == 2 + 5 * 100 + 1);
+
+  // the sequence events disable the cache
+  uint64_t prevHits = 0;
+  vm.getIndirectCacheStats(&prevHits, nullptr);
+  uint64_t nbSeq = 0;
+  vm.addVMEventCB(QBDI::SEQUENCE_ENTRY, countSequence, &nbSeq);
+  REQUIRE(vm.call(&retval, addr, {}));
+  CHECK(retval == 200);
+  vm.getIndirectCacheStats(&hits, nullptr);
+  CHECK(hits == prevHits);
+  CHECK(nbSeq >= 300);
+
+  QBDI::alignedFree(fakestack);
+}
+
+TEST_CASE_METHOD(OptionsTest, "OptionsTest_X86_64-ReturnStack") {
+
+  // deep recursion, return address replaced and frames skipped by a
+  // longjmp-like stack restoration
+  InMemoryObject retObj("  xor %rax, %rax\n"
+                        "  mov $40, %rcx\n"
+                        "  call rec\n"
+                        "  call swap\n"
+                        "  add $100, %rax\n"
+                        "target:\n"
+                        "  mov %rsp, %rbx\n"
+                        "  call unwind\n"
+                        "  add $1000, %rax\n"
+                        "  ret\n"
+                        "rec:\n"
+                        "  add $1, %rax\n"
+                        "  dec %rcx\n"
+                        "  jz rec_end\n"
+                        "  call rec\n"
+                        "rec_end:\n"
+                        "  ret\n"
+                        "swap:\n"
+                        "  add $8, %rsp\n"
+                        "  lea target(%rip), %rdx\n"
+                        "  push %rdx\n"
+                        "  ret\n"
+                        "unwind:\n"
+                        "  call unwind2\n"
+                        "  add $10000, %rax\n"
+                        "  ret\n"
+                        "unwind2:\n"
+                        "  lea -8(%rbx), %rsp\n"
+                        "  ret\n");
+  QBDI::rword addr = (QBDI::rword)retObj.getCode().data();
+
+  uint8_t *fakestack;
+  QBDI::GPRState *state = vm.getGPRState();
+  bool ret = QBDI::allocateVirtualStack(state, 4096, &fakestack);
+  REQUIRE(ret == true);
+
+  vm.addInstrumentedRange(addr, addr + (QBDI::rword)retObj.getCode().size());
+  vm.setOptions(QBDI::Options::OPT_ENABLE_BLOCK_CHAINING);
+
+  QBDI::rword retval;
+  uint64_t hits = 0, prevHits = 0;
+
+  // the returns of the recursion are resolved by the return stack once the
+  // continuation is in the cache
+  for (int i = 0; i < 3; i++) {
+    REQUIRE(vm.call(&retval, addr, {}));
+    CHECK(retval == 1040);
+    vm.getIndirectCacheStats(&hits, nullptr);
+    CHECK(hits >= prevHits + 30);
+    prevHits = hits;
+  }
+
+  // the mismatches return to the host
+  uint64_t nbInst = 0;
+  vm.addCodeCB(QBDI::PREINST, countInstruction, &nbInst);
+  REQUIRE(vm.call(&retval, addr, {}));
+  CHECK(retval == 1040);
+  CHECK(nbInst == 3 + 39 * 4 + 3 + 40 + 1 + 4 + 2 + 1 + 2 + 2);
+
+  QBDI::alignedFree(fakestack);
+}
+
+struct PatchAddressRecord {
+  QBDI::rword address;
+  std::set<QBDI::rword> patchAddresses;
+};
+
+static QBDI::VMAction recordPatchAddress(QBDI::VMInstanceRef vm,
+                                         QBDI::GPRState *gprState,
+                                         QBDI::FPRState *fprState,
+                                         void *data) {
+  PatchAddressRecord *record = static_cast<PatchAddressRecord *>(data);
+  const QBDI::InstAnalysis *ana = vm->getInstAnalysis(
+      QBDI::ANALYSIS_INSTRUCTION | QBDI::ANALYSIS_JIT);
+  if (ana->address == record->address) {
+    record->patchAddresses.insert(ana->patchAddress);
+  }
+  return QBDI::VMAction::CONTINUE;
+}
+
+TEST_CASE_METHOD(OptionsTest, "OptionsTest_X86_64-TraceFormation") {
+
+  InMemoryObject loopObj("  xor %rax, %rax\n"
+                         "  mov $200, %rcx\n"
+                         "loop:\n"
+                         "  test $1, %cl\n"
+                         "  jz even\n"
+                         "  add $3, %rax\n"
+                         "  jmp next\n"
+                         "even:\n"
+                         "  add $1, %rax\n"
+                         "next:\n"
+                         "  dec %rcx\n"
+                         "  jnz loop\n"
+                         "  ret\n");
+  QBDI::rword addr = (QBDI::rword)loopObj.getCode().data();
+  // the loop starts at offset 10 and next at offset 25
+  QBDI::rword loopAddr = addr + 10;
+  QBDI::rword nextAddr = addr + 25;
+
+  uint8_t *fakestack;
+  QBDI::GPRState *state = vm.getGPRState();
+  bool ret = QBDI::allocateVirtualStack(state, 4096, &fakestack);
+  REQUIRE(ret == true);
+
+  vm.setOptions(QBDI::Options::OPT_ENABLE_BLOCK_CHAINING |
+                QBDI::Options::OPT_ENABLE_TRACE_FORMATION);
+  vm.addInstrumentedRange(addr, addr + (QBDI::rword)loopObj.getCode().size());
+
+  QBDI::rword retval;
+
+  // the trace of the loop is formed during the first call
+  for (int i = 0; i < 2; i++) {
+    REQUIRE(vm.call(&retval, addr, {}));
+    CHECK(retval == 400);
+  }
+
+  // the trace doesn't hide the stop address (the jump to next is removed
+  // from the trace)
+  state->rax = 0;
+  state->rcx = 5;
+  REQUIRE(vm.run(loopAddr, nextAddr));
+  CHECK(state->rax == 3);
+  CHECK(state->rcx == 5);
+
+  // every instruction must still be reached by the callbacks, and the head of
+  // the loop is executed from its sequence and from its trace
+  uint64_t nbInst = 0;
+  PatchAddressRecord record{loopAddr, {}};
+  vm.addCodeCB(QBDI::PREINST, countInstruction, &nbInst);
+  vm.addCodeAddrCB(loopAddr, QBDI::PREINST, recordPatchAddress, &record);
+  REQUIRE(vm.call(&retval, addr, {}));
+  CHECK(retval == 400);
+  CHECK(nbInst == 2 + 100 * 6 + 100 * 5 + 1);
+  CHECK(record.patchAddresses.size() == 2);
+
+  // without the trace formation, the head is only in its sequence
+  vm.setOptions(QBDI::Options::OPT_ENABLE_BLOCK_CHAINING);
+  nbInst = 0;
+  record.patchAddresses.clear();
+  REQUIRE(vm.call(&retval, addr, {}));
+  CHECK(retval == 400);
+  CHECK(nbInst == 2 + 100 * 6 + 100 * 5 + 1);
+  CHECK(record.patchAddresses.size() == 1);
+
+  QBDI::alignedFree(fakestack);
+}
+
+static QBDI::VMAction recordStatePointer(QBDI::VMInstanceRef vm,
+                                         QBDI::GPRState *gprState,
+                                         QBDI::FPRState *fprState,
+                                         void *data) {
+  static_cast<std::set<QBDI::GPRState *> *>(data)->insert(gprState);
+  return QBDI::VMAction::CONTINUE;
+}
+
+TEST_CASE_METHOD(OptionsTest, "OptionsTest_X86_64-SharedContext") {
+
+  InMemoryObject loopObj("  xor %rax, %rax\n"
+                         "  pxor %xmm1, %xmm1\n"
+                         "  mov $50, %rcx\n"
+                         "loop:\n"
+                         "  call *%r11\n"
+                         "  dec %rcx\n"
+                         "  jnz loop\n"
+                         "  cvttsd2si %xmm1, %rax\n"
+                         "  ret\n");
+  InMemoryObject funcObj("  add $2, %rax\n"
+                         "  cvtsi2sdq %rax, %xmm0\n"
+                         "  addsd %xmm0, %xmm1\n"
+                         "  ret\n");
+  QBDI::rword addr = (QBDI::rword)loopObj.getCode().data();
+  QBDI::rword funcAddr = (QBDI::rword)funcObj.getCode().data();
+
+  uint8_t *fakestack;
+  QBDI::GPRState *state = vm.getGPRState();
+  bool ret = QBDI::allocateVirtualStack(state, 4096, &fakestack);
+  REQUIRE(ret == true);
+
+  vm.addInstrumentedRange(addr, addr + (QBDI::rword)loopObj.getCode().size());
+  vm.addInstrumentedRange(funcAddr,
+                          funcAddr + (QBDI::rword)funcObj.getCode().size());
+
+  QBDI::rword retval;
+  std::set<QBDI::GPRState *> statePointers;
+  vm.addCodeCB(QBDI::PREINST, recordStatePointer, &statePointers);
+
+  const QBDI::Options options[] = {
+      QBDI::Options::NO_OPT,
+      QBDI::Options::OPT_ENABLE_SHARED_CONTEXT,
+      QBDI::Options::OPT_ENABLE_SHARED_CONTEXT |
+          QBDI::Options::OPT_ENABLE_BLOCK_CHAINING,
+  };
+  for (QBDI::Options opt : options) {
+    vm.setOptions(opt);
+    statePointers.clear();
+    state->r11 = funcAddr;
+    REQUIRE(vm.call(&retval, addr, {}));
+    CHECK(retval == 2550);
+    CHECK(state->r11 == funcAddr);
+    if ((opt & QBDI::Options::OPT_ENABLE_SHARED_CONTEXT) != 0) {
+      // the callbacks of all the ExecBlocks receive the same state
+      CHECK(statePointers.size() == 1);
+    }
+  }
+
+  QBDI::alignedFree(fakestack);
+}
+
+TEST_CASE_METHOD(OptionsTest, "OptionsTest_X86_64-AVXContextSwitch") {
+
+  if (!QBDI::isHostCPUFeaturePresent("avx")) {
+    WARN("Host doesn't support avx feature: SKIP");
+    return;
+  }
+
+  InMemoryObject storeObj("  vmovdqu %ymm1, (%rdi)\n"
+                          "  vpcmpeqd %ymm0, %ymm0, %ymm0\n"
+                          "  ret\n");
+  InMemoryObject clearObj("  vzeroupper\n"
+                          "  ret\n");
+  QBDI::rword storeAddr = (QBDI::rword)storeObj.getCode().data();
+  QBDI::rword clearAddr = (QBDI::rword)clearObj.getCode().data();
+
+  uint8_t *fakestack;
+  QBDI::GPRState *state = vm.getGPRState();
+  bool ret = QBDI::allocateVirtualStack(state, 4096, &fakestack);
+  REQUIRE(ret == true);
+
+  vm.addInstrumentedRange(storeAddr,
+                          storeAddr + (QBDI::rword)storeObj.getCode().size());
+  vm.addInstrumentedRange(clearAddr,
+                          clearAddr + (QBDI::rword)clearObj.getCode().size());
+
+  const QBDI::Options options[] = {
+      QBDI::Options::NO_OPT,
+      QBDI::Options::OPT_DISABLE_OPTIONAL_FPR,
+  };
+  for (QBDI::Options opt : options) {
+    vm.setOptions(opt);
+    QBDI::rword retval;
+    uint8_t buffer[32] = {0};
+
+    QBDI::FPRState *fprState = vm.getFPRState();
+    memset(fprState->xmm1, 0x11, sizeof(fprState->xmm1));
+    memset(fprState->ymm1, 0x22, sizeof(fprState->ymm1));
+    REQUIRE(vm.call(&retval, storeAddr, {(QBDI::rword)buffer}));
+    for (unsigned i = 0; i < 16; i++) {
+      CHECK(buffer[i] == 0x11);
+      CHECK(buffer[i + 16] == 0x22);
+    }
+    fprState = vm.getFPRState();
+    for (unsigned i = 0; i < 16; i++) {
+      CHECK((uint8_t)fprState->xmm0[i] == 0xff);
+      CHECK((uint8_t)fprState->ymm0[i] == 0xff);
+    }
+
+    // vzeroupper puts the AVX state in its initial state
+    REQUIRE(vm.call(&retval, clearAddr, {}));
+    fprState = vm.getFPRState();
+    for (unsigned i = 0; i < 16; i++) {
+      CHECK((uint8_t)fprState->xmm0[i] == 0xff);
+      CHECK(fprState->ymm0[i] == 0);
+    }
+
+    // the upper bits set by the user must be restored
+    memset(fprState->ymm1, 0x33, sizeof(fprState->ymm1));
+    REQUIRE(vm.call(&retval, storeAddr, {(QBDI::rword)buffer}));
+    for (unsigned i = 0; i < 16; i++) {
+      CHECK(buffer[i + 16] == 0x33);
+    }
+  }
+
+  QBDI::alignedFree(fakestack);
+}
+
+TEST_CASE_METHOD(OptionsTest, "OptionsTest_X86_64-XMMContextSwitch") {
+
+  InMemoryObject addObj("  movdqu (%rdi), %xmm1\n"
+                        "  paddd %xmm2, %xmm1\n"
+                        "  movdqu %xmm1, (%rdi)\n"
+                        "  ret\n");
+  QBDI::rword addAddr = (QBDI::rword)addObj.getCode().data();
+
+  uint8_t *fakestack;
+  QBDI::GPRState *state = vm.getGPRState();
+  bool ret = QBDI::allocateVirtualStack(state, 4096, &fakestack);
+  REQUIRE(ret == true);
+
+  vm.addInstrumentedRange(addAddr,
+                          addAddr + (QBDI::rword)addObj.getCode().size());
+
+  const QBDI::Options options[] = {
+      QBDI::Options::NO_OPT,
+      QBDI::Options::OPT_DISABLE_OPTIONAL_FPR,
+  };
+  for (QBDI::Options opt : options) {
+    vm.setOptions(opt);
+    QBDI::rword retval;
+    uint8_t buffer[16];
+
+    // only XMM1 and XMM2 are used by the sequence
+    memset(buffer, 0x02, sizeof(buffer));
+    QBDI::FPRState *fprState = vm.getFPRState();
+    memset(fprState->xmm1, 0x11, sizeof(fprState->xmm1));
+    memset(fprState->xmm2, 0x01, sizeof(fprState->xmm2));
+    memset(fprState->xmm3, 0x33, sizeof(fprState->xmm3));
+    REQUIRE(vm.call(&retval, addAddr, {(QBDI::rword)buffer}));
+    fprState = vm.getFPRState();
+    for (unsigned i = 0; i < 16; i++) {
+      CHECK(buffer[i] == 0x03);
+      CHECK(fprState->xmm1[i] == 0x03);
+      CHECK(fprState->xmm2[i] == 0x01);
+      CHECK(fprState->xmm3[i] == 0x33);
+    }
+
+    // a callback in the sequence reads and changes the FPRState
+    uint8_t xmm1Value = 0;
+    uint32_t cbID = vm.addMnemonicCB(
+        "PADDD*", QBDI::PREINST,
+        [](QBDI::VMInstanceRef vm, QBDI::GPRState *gprState,
+           QBDI::FPRState *fprState, void *data) -> QBDI::VMAction {
+          *static_cast<uint8_t *>(data) = fprState->xmm1[0];
+          memset(fprState->xmm2, 0x04, sizeof(fprState->xmm2));
+          return QBDI::VMAction::CONTINUE;
+        },
+        &xmm1Value);
+    REQUIRE(cbID != QBDI::INVALID_EVENTID);
+
+    memset(buffer, 0x02, sizeof(buffer));
+    REQUIRE(vm.call(&retval, addAddr, {(QBDI::rword)buffer}));
+    fprState = vm.getFPRState();
+    CHECK(xmm1Value == 0x02);
+    for (unsigned i = 0; i < 16; i++) {
+      CHECK(buffer[i] == 0x06);
+      CHECK(fprState->xmm1[i] == 0x06);
+      CHECK(fprState->xmm3[i] == 0x33);
+    }
+    vm.deleteInstrumentation(cbID);
+  }
+
+  QBDI::alignedFree(fakestack);
+}
+
+TEST_CASE_METHOD(OptionsTest, "OptionsTest_X86_64-BlockProfile") {
+
+  // the head of the loop is reached by the jump before the body, each basic
+  // block is written from its start
+  InMemoryObject obj("  xor %eax, %eax\n"
+                     "  jmp 2f\n"
+                     "1:\n"
+                     "  add %rdi, %rax\n"
+                     "  dec %rdi\n"
+                     "2:\n"
+                     "  test %rdi, %rdi\n"
+                     "  jnz 1b\n"
+                     "  ret\n");
+  QBDI::rword start = (QBDI::rword)obj.getCode().data();
+
+  uint8_t *fakestack;
+  QBDI::GPRState *state = vm.getGPRState();
+  bool ret = QBDI::allocateVirtualStack(state, 4096, &fakestack);
+  REQUIRE(ret == true);
+
+  vm.addInstrumentedRange(start, start + (QBDI::rword)obj.getCode().size());
+
+  const QBDI::Options options[] = {
+      QBDI::Options::OPT_ENABLE_BLOCK_PROFILE,
+      QBDI::Options::OPT_ENABLE_BLOCK_PROFILE |
+          QBDI::Options::OPT_ENABLE_BLOCK_CHAINING,
+      QBDI::Options::OPT_ENABLE_BLOCK_PROFILE |
+          QBDI::Options::OPT_ENABLE_SHARED_CONTEXT,
+  };
+  uint64_t nbRuns = 0;
+  for (QBDI::Options opt : options) {
+    // the counters are kept when the options change
+    vm.setOptions(opt);
+    QBDI::rword retval;
+
+    REQUIRE(vm.call(&retval, start, {3}));
+    CHECK(retval == 6);
+    // the counters are kept when the cache is cleared
+    vm.clearAllCache();
+    REQUIRE(vm.call(&retval, start, {3}));
+    CHECK(retval == 6);
+
+    std::vector<QBDI::BlockProfile> profile = vm.getBlockProfile();
+    REQUIRE(profile.size() == 4);
+    nbRuns += 2;
+    const uint64_t expected[] = {1, 3, 4, 1};
+    for (size_t i = 0; i < profile.size(); i++) {
+      CHECK(profile[i].count == nbRuns * expected[i]);
+    }
+    CHECK(profile[0].address == start);
+    CHECK(profile[3].address + profile[3].size ==
+          start + (QBDI::rword)obj.getCode().size());
+  }
+
+  QBDI::alignedFree(fakestack);
+}
+
+TEST_CASE_METHOD(OptionsTest, "OptionsTest_X86_64-CoverageBitmap") {
+
+  InMemoryObject obj("  xor %eax, %eax\n"
+                     "  jmp 2f\n"
+                     "1:\n"
+                     "  add %rdi, %rax\n"
+                     "  dec %rdi\n"
+                     "2:\n"
+                     "  test %rdi, %rdi\n"
+                     "  jnz 1b\n"
+                     "  ret\n");
+  QBDI::rword start = (QBDI::rword)obj.getCode().data();
+  // address of the labels 1 and 2
+  QBDI::rword body = start + 4;
+  QBDI::rword head = start + 10;
+
+  uint8_t *fakestack;
+  QBDI::GPRState *state = vm.getGPRState();
+  bool ret = QBDI::allocateVirtualStack(state, 4096, &fakestack);
+  REQUIRE(ret == true);
+
+  vm.addInstrumentedRange(start, start + (QBDI::rword)obj.getCode().size());
+
+  const size_t size = 1 << 16;
+  std::vector<uint8_t> bitmap(size);
+  CHECK_FALSE(vm.setCoverageBitmap(bitmap.data(), size - 1));
+  REQUIRE(vm.setCoverageBitmap(bitmap.data(), size));
+
+  auto location = [&](QBDI::rword address) {
+    return ((address >> 4) ^ (address << 8)) & (size - 1);
+  };
+
+  const QBDI::Options options[] = {
+      QBDI::Options::NO_OPT,
+      QBDI::Options::OPT_ENABLE_BLOCK_CHAINING,
+  };
+  for (QBDI::Options opt : options) {
+    vm.setOptions(opt);
+    std::fill(bitmap.begin(), bitmap.end(), 0);
+    QBDI::rword retval;
+
+    REQUIRE(vm.call(&retval, start, {3}));
+    CHECK(retval == 6);
+
+    // one increment for each of the 9 basic blocks executed
+    uint32_t total = 0;
+    for (uint8_t v : bitmap) {
+      total += v;
+    }
+    CHECK(total == 9);
+    CHECK(bitmap[location(start)] >= 1);
+    CHECK(bitmap[location(body) ^ (location(head) >> 1)] >= 3);
+    CHECK(bitmap[location(head) ^ (location(body) >> 1)] >= 3);
+  }
+
+  // the edges aren't written after the removal
+  vm.removeCoverageBitmap();
+  std::fill(bitmap.begin(), bitmap.end(), 0);
+  QBDI::rword retval;
+  REQUIRE(vm.call(&retval, start, {3}));
+  CHECK(retval == 6);
+  CHECK(std::all_of(bitmap.begin(), bitmap.end(),
+                    [](uint8_t v) { return v == 0; }));
+
+  QBDI::alignedFree(fakestack);
+}
@@ -0,0 +1,109 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2025 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string>
+
+#include <QBDI.h>
+
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "ExecBlock/PatchEmpty.h"
+
+#include "Engine/LLVMCPU.h"
+#include "ExecBlock/Context.h"
+#include "ExecBlock/ExecBlock.h"
+#include "Patch/ExecBlockPatch.h"
+#include "Patch/Patch.h"
+#include "Patch/RelocatableInst.h"
+
+// The benchmark runs a sequence of an ExecBlock that only returns to the
+// host, with the execute flags of a sequence that uses no FPU register, one
+// XMM register, the whole FPU state and the AVX state, with the XSAVE and the
+// FXSAVE context switches.
+#if defined(QBDI_ARCH_X86_64)
+
+#include "ExecBlock/X86_64/XSave_X86_64.h"
+#include "Patch/X86_64/ExecBlockFlags_X86_64.h"
+
+namespace {
+
+uint16_t writeEmptySequence(QBDI::ExecBlock &execBlock,
+                            const QBDI::LLVMCPUs &llvmcpus,
+                            QBDI::rword address, uint32_t execblockFlags) {
+  const QBDI::LLVMCPU &llvmcpu = llvmcpus.getCPU(QBDI::CPUMode::DEFAULT);
+  QBDI::Patch::Vec seq;
+  seq.push_back(generateEmptyPatch(address, llvmcpus));
+  seq[0].append(QBDI::getTerminator(llvmcpu, address));
+  seq[0].metadata.modifyPC = true;
+  seq[0].metadata.execblockFlags = execblockFlags;
+  QBDI::SeqWriteResult res = execBlock.writeSequence(seq.begin(), seq.end());
+  REQUIRE(res.seqID != QBDI::EXEC_BLOCK_FULL);
+  return res.seqID;
+}
+
+} // namespace
+
+TEST_CASE("Benchmark_ContextSwitch") {
+
+  QBDI::LLVMCPUs llvmcpus;
+  QBDI::VM vm;
+
+  const struct {
+    const char *name;
+    uint32_t flags;
+  } configs[] = {
+      {"no FPU", 0},
+      {"XMM0", QBDI::ExecBlockFlags::needFPU | QBDI::ExecBlockFlags::needXMM0},
+      {"full FPU",
+       QBDI::ExecBlockFlags::needFPU | QBDI::ExecBlockFlags::needFullFPU},
+      {"full FPU and AVX", QBDI::ExecBlockFlags::needFPU |
+                               QBDI::ExecBlockFlags::needFullFPU |
+                               QBDI::ExecBlockFlags::needAVX},
+  };
+
+  // The FXSAVE context switch is forced on the hosts that support XSAVE, to
+  // compare both of them on the same host.
+  for (bool fxsave : {false, true}) {
+    if (not fxsave and QBDI::getXSaveMask() == 0) {
+      continue;
+    }
+    QBDI::forceFXSave(fxsave);
+    const std::string mode = fxsave ? " with FXSAVE" : " with XSAVE";
+
+    QBDI::ExecBlock execBlock(llvmcpus, &vm);
+    *execBlock.getFPRState() = *vm.getFPRState();
+
+    QBDI::rword address = 0x42424240;
+    for (const auto &config : configs) {
+      uint16_t seqID =
+          writeEmptySequence(execBlock, llvmcpus, address++, config.flags);
+
+      BENCHMARK(std::string("ExecBlock::run, ") + config.name + mode) {
+        execBlock.selectSeq(seqID);
+        execBlock.run();
+        return QBDI_GPR_GET(&execBlock.getContext()->gprState, QBDI::REG_PC);
+      };
+    }
+  }
+  QBDI::forceFXSave(false);
+}
+
+#endif // QBDI_ARCH_X86_64
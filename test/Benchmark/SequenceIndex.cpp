@@ -0,0 +1,105 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2025 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <QBDI.h>
+
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "ExecBlock/PatchEmpty.h"
+
+#include "Engine/LLVMCPU.h"
+#include "ExecBlock/ExecBlockManager.h"
+#include "Patch/Patch.h"
+
+namespace {
+
+static const size_t NB_LOOKUP = 4096;
+
+std::vector<QBDI::rword> getSequenceAddresses(size_t nb) {
+  std::mt19937 gen(nb);
+  std::uniform_int_distribution<QBDI::rword> dist(2, 64);
+  std::vector<QBDI::rword> addrs;
+  addrs.reserve(nb);
+  QBDI::rword addr = 0x400000;
+  for (size_t i = 0; i < nb; i++) {
+    addrs.push_back(addr);
+    addr += dist(gen);
+  }
+  return addrs;
+}
+
+std::vector<QBDI::rword> getLookups(const std::vector<QBDI::rword> &addrs,
+                                    QBDI::rword offset) {
+  std::mt19937 gen(addrs.size() + 1);
+  std::uniform_int_distribution<size_t> dist(0, addrs.size() - 1);
+  std::vector<QBDI::rword> lookups;
+  lookups.reserve(NB_LOOKUP);
+  for (size_t i = 0; i < NB_LOOKUP; i++) {
+    lookups.push_back(addrs[dist(gen)] + offset);
+  }
+  return lookups;
+}
+
+} // namespace
+
+TEST_CASE("Benchmark_SequenceIndex") {
+
+  QBDI::LLVMCPUs llvmcpus;
+  QBDI::VM vm;
+
+  for (size_t nb : {10000, 100000, 1000000}) {
+    QBDI::ExecBlockManager execBlockManager(llvmcpus, &vm);
+    std::vector<QBDI::rword> addrs = getSequenceAddresses(nb);
+
+    for (QBDI::rword addr : addrs) {
+      QBDI::Patch::Vec bb;
+      bb.push_back(generateEmptyPatch(addr, llvmcpus));
+      execBlockManager.writeBasicBlock(std::move(bb), 1);
+    }
+
+    // A hit is resolved by the sequence index
+    std::vector<QBDI::rword> hits = getLookups(addrs, 0);
+    BENCHMARK(std::to_string(nb) + " sequences, hit") {
+      size_t found = 0;
+      for (QBDI::rword addr : hits) {
+        found += execBlockManager.getProgrammedExecBlock(
+                     addr, QBDI::CPUMode::DEFAULT) != nullptr;
+      }
+      return found;
+    };
+
+    // A miss falls back to the search of the region
+    std::vector<QBDI::rword> misses = getLookups(addrs, 1);
+    BENCHMARK(std::to_string(nb) + " sequences, miss") {
+      size_t found = 0;
+      for (QBDI::rword addr : misses) {
+        found += execBlockManager.getProgrammedExecBlock(
+                     addr, QBDI::CPUMode::DEFAULT) != nullptr;
+      }
+      return found;
+    };
+  }
+}
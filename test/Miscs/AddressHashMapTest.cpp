@@ -0,0 +1,73 @@
+/*
+ * This file is part of QBDI.
+ *
+ * Copyright 2017 - 2025 Quarkslab
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <catch2/catch_test_macros.hpp>
+#include <map>
+
+#include "Utility/AddressHashMap.h"
+
+TEST_CASE("AddressHashMapTest-InsertFind") {
+  QBDI::AddressHashMap<int> map;
+
+  CHECK(map.find(0x1000) == nullptr);
+  map.insert(0x1000, 1);
+  map.insert(0x2000, 2);
+  REQUIRE(map.find(0x1000) != nullptr);
+  CHECK(*map.find(0x1000) == 1);
+  CHECK(*map.find(0x2000) == 2);
+  CHECK(map.find(0x3000) == nullptr);
+
+  map.insert(0x1000, 3);
+  CHECK(*map.find(0x1000) == 3);
+  CHECK(map.size() == 2);
+
+  map.clear();
+  CHECK(map.size() == 0);
+  CHECK(map.find(0x1000) == nullptr);
+}
+
+TEST_CASE("AddressHashMapTest-GrowAndErase") {
+  QBDI::AddressHashMap<QBDI::rword> map;
+  std::map<QBDI::rword, QBDI::rword> ref;
+
+  for (QBDI::rword i = 0; i < 10000; i++) {
+    QBDI::rword key = 0x400000 + i * 7;
+    map.insert(key, i);
+    ref[key] = i;
+  }
+  CHECK(map.size() == ref.size());
+
+  // erase one key over three, the remaining ones must stay reachable
+  for (QBDI::rword i = 0; i < 10000; i += 3) {
+    QBDI::rword key = 0x400000 + i * 7;
+    CHECK(map.erase(key));
+    ref.erase(key);
+  }
+  CHECK_FALSE(map.erase(0x10));
+  CHECK(map.size() == ref.size());
+
+  for (QBDI::rword i = 0; i < 10000; i++) {
+    QBDI::rword key = 0x400000 + i * 7;
+    const QBDI::rword *v = map.find(key);
+    if (ref.count(key) == 0) {
+      CHECK(v == nullptr);
+    } else {
+      REQUIRE(v != nullptr);
+      CHECK(*v == i);
+    }
+  }
+}
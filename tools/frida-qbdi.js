@@ -309,11 +309,17 @@ var QBDI_C = Object.freeze({
     addInstrRule: _qbdibinder.bind('qbdi_addInstrRule', 'uint32', ['pointer', 'pointer', 'uint32', 'pointer']),
     addInstrRuleRange: _qbdibinder.bind('qbdi_addInstrRuleRange', 'uint32', ['pointer', rword, rword, 'pointer', 'uint32', 'pointer']),
     addInstrRuleData: _qbdibinder.bind('qbdi_addInstrRuleData', 'void', ['pointer', 'uint32', 'pointer', 'pointer', 'int32']),
+    addInstrRuleDataOnce: _qbdibinder.bind('qbdi_addInstrRuleDataOnce', 'void', ['pointer', 'uint32', 'pointer', 'pointer', 'int32']),
     addMemAddrCB: _qbdibinder.bind('qbdi_addMemAddrCB', 'uint32', ['pointer', rword, 'uint32', 'pointer', 'pointer']),
     addMemRangeCB: _qbdibinder.bind('qbdi_addMemRangeCB', 'uint32', ['pointer', rword, rword, 'uint32', 'pointer', 'pointer']),
     addCodeCB: _qbdibinder.bind('qbdi_addCodeCB', 'uint32', ['pointer', 'uint32', 'pointer', 'pointer', 'int32']),
     addCodeAddrCB: _qbdibinder.bind('qbdi_addCodeAddrCB', 'uint32', ['pointer', rword, 'uint32', 'pointer', 'pointer', 'int32']),
     addCodeRangeCB: _qbdibinder.bind('qbdi_addCodeRangeCB', 'uint32', ['pointer', rword, rword, 'uint32', 'pointer', 'pointer', 'int32']),
+    addCodeCBWithType: _qbdibinder.bind('qbdi_addCodeCBWithType', 'uint32', ['pointer', 'uint32', 'pointer', 'pointer', 'uint32', 'int32']),
+    addCodeAddrCBWithType: _qbdibinder.bind('qbdi_addCodeAddrCBWithType', 'uint32', ['pointer', rword, 'uint32', 'pointer', 'pointer', 'uint32', 'int32']),
+    addCodeRangeCBWithType: _qbdibinder.bind('qbdi_addCodeRangeCBWithType', 'uint32', ['pointer', rword, rword, 'uint32', 'pointer', 'pointer', 'uint32', 'int32']),
+    addInlineCB: _qbdibinder.bind('qbdi_addInlineCB', 'uint32', ['pointer', 'uint32', 'pointer', 'size_t', 'pointer', 'pointer', 'int32']),
+    addInlineRangeCB: _qbdibinder.bind('qbdi_addInlineRangeCB', 'uint32', ['pointer', rword, rword, 'uint32', 'pointer', 'size_t', 'pointer', 'pointer', 'int32']),
     addVMEventCB: _qbdibinder.bind('qbdi_addVMEventCB', 'uint32', ['pointer', 'uint32', 'pointer', 'pointer']),
     deleteInstrumentation: _qbdibinder.bind('qbdi_deleteInstrumentation', 'uchar', ['pointer', 'uint32']),
     deleteAllInstrumentations: _qbdibinder.bind('qbdi_deleteAllInstrumentations', 'void', ['pointer']),
@@ -341,10 +347,14 @@ var QBDI_C = Object.freeze({
     getOperandAnalysisStructDesc: _qbdibinder.bind('qbdi_getOperandAnalysisStructDesc', 'pointer', []),
     getInstAnalysisStructDesc: _qbdibinder.bind('qbdi_getInstAnalysisStructDesc', 'pointer', []),
     precacheBasicBlock: _qbdibinder.bind('qbdi_precacheBasicBlock', 'uchar', ['pointer', rword]),
+    precacheModule: _qbdibinder.bind('qbdi_precacheModule', 'uint32', ['pointer', 'pointer', 'uint32']),
     clearCache: _qbdibinder.bind('qbdi_clearCache', 'void', ['pointer', rword, rword]),
     clearAllCache: _qbdibinder.bind('qbdi_clearAllCache', 'void', ['pointer']),
     getNbExecBlock: _qbdibinder.bind('qbdi_getNbExecBlock', 'uint32', ['pointer']),
     reduceCacheTo: _qbdibinder.bind('qbdi_reduceCacheTo', 'void', ['pointer', 'uint32']),
+    setExecBlockSize: _qbdibinder.bind('qbdi_setExecBlockSize', 'uchar', ['pointer', 'uint32', 'uint32', 'uchar']),
+    getIndirectCacheStats: _qbdibinder.bind('qbdi_getIndirectCacheStats', 'void', ['pointer', 'pointer', 'pointer']),
+    getBlockProfile: _qbdibinder.bind('qbdi_getBlockProfile', 'pointer', ['pointer', 'pointer']),
 });
 
 // Init some globals
@@ -499,6 +509,131 @@ export var CallbackPriority = Object.freeze({
     PRIORITY_MEMACCESS_LIMIT: 0x1000000
 });
 
+/**
+ * Type of callback
+ *
+ * @enum {number}
+ * @readonly
+ */
+export var CallbackType = Object.freeze({
+    /**
+     * The callback is called by the VM.
+     */
+    CALLBACK_DEFAULT: 0,
+    /**
+     * The callback is called from the instrumented code.
+     */
+    CALLBACK_FAST: 1,
+    /**
+     * The callback is only called at the first execution of an instruction.
+     */
+    CALLBACK_ONCE: 2
+});
+
+/**
+ * Comparison of the INLINE_SKIP operation. The comparisons are unsigned.
+ *
+ * @enum {number}
+ * @readonly
+ */
+export var PredicateOperator = Object.freeze({
+    /**
+     * value == constant
+     */
+    PREDICATE_EQ: 0,
+    /**
+     * value != constant
+     */
+    PREDICATE_NE: 1,
+    /**
+     * value < constant
+     */
+    PREDICATE_LT: 2,
+    /**
+     * value <= constant
+     */
+    PREDICATE_LE: 3,
+    /**
+     * value > constant
+     */
+    PREDICATE_GT: 4,
+    /**
+     * value >= constant
+     */
+    PREDICATE_GE: 5,
+    /**
+     * constant <= value < constantEnd
+     */
+    PREDICATE_IN_RANGE: 6
+});
+
+/**
+ * Operation of an inline instrumentation. The operations work on an
+ * accumulator which is zero at the beginning of the instrumentation.
+ *
+ * @enum {number}
+ * @readonly
+ */
+export var InlineOpcode = Object.freeze({
+    /**
+     * accumulator = value
+     */
+    INLINE_LOAD_IMM: 0,
+    /**
+     * accumulator = the GPR with the index value
+     */
+    INLINE_LOAD_REG: 1,
+    /**
+     * accumulator = the operand with the index value in the InstAnalysis
+     */
+    INLINE_LOAD_OPERAND: 2,
+    /**
+     * accumulator = the address of the read access, or zero
+     */
+    INLINE_LOAD_READ_ADDRESS: 3,
+    /**
+     * accumulator = the address of the write access (POSTINST only), or zero
+     */
+    INLINE_LOAD_WRITE_ADDRESS: 4,
+    /**
+     * accumulator = the word at the address value
+     */
+    INLINE_LOAD_MEMORY: 5,
+    /**
+     * accumulator += value
+     */
+    INLINE_ADD: 6,
+    /**
+     * the word at the address value = accumulator
+     */
+    INLINE_STORE: 7,
+    /**
+     * skip the next value operations when the comparison of the accumulator holds
+     */
+    INLINE_SKIP: 8,
+    /**
+     * call the callback of the instrumentation (last operation only)
+     */
+    INLINE_CALL: 9
+});
+
+/**
+ * Strategy to discover the basic blocks of a module with :js:func:`VM.precacheModule`
+ *
+ * @enum {number}
+ * @readonly
+ */
+export var PrecacheStrategy = Object.freeze({
+    /**
+     * Cache the entry point and the functions exported by the module.
+     */
+    PRECACHE_SYMBOLS: 0,
+    /**
+     * Also cache the basic blocks reached by the direct branches and calls of the module.
+     */
+    PRECACHE_RECURSIVE: 1
+});
+
 /**
  * Events triggered by the virtual machine.
  *
@@ -821,6 +956,27 @@ export var Options = {
      * Don't save and restore errno.
      */
     OPT_DISABLE_ERRNO_BACKUP : 1 << 3,
+    /**
+     * Link the cached sequences together (X86 and X86_64 only).
+     */
+    OPT_ENABLE_BLOCK_CHAINING : 1 << 4,
+    /**
+     * Form the hot traces across the sequences (X86 and X86_64 only).
+     */
+    OPT_ENABLE_TRACE_FORMATION : 1 << 5,
+    /**
+     * Share the guest state between the ExecBlocks (X86 and X86_64 only).
+     */
+    OPT_ENABLE_SHARED_CONTEXT : 1 << 6,
+    /**
+     * Count the executions of each basic block (X86_64 only).
+     */
+    OPT_ENABLE_BLOCK_PROFILE : 1 << 7,
+    /**
+     * Map the code of the ExecBlocks twice instead of changing its permissions
+     * (Linux and Android only).
+     */
+    OPT_ENABLE_DUAL_MAPPING : 1 << 8,
 };
 if (Process.arch === 'x64') {
     /**
@@ -879,12 +1035,33 @@ export class InstrRuleDataCBK {
      * @param {InstCallback} cbk       A **native** InstCallback returned by :js:func:`VM.newInstCallback`.
      * @param {Object|null}       data      User defined data passed to the callback.
      * @param {Int}          priority  The priority of the callback.
+     * @param {Boolean}      once      Only call the callback at the first execution of the instruction.
      */
-    constructor(pos, cbk, data, priority = CallbackPriority.PRIORITY_DEFAULT) {
+    constructor(pos, cbk, data, priority = CallbackPriority.PRIORITY_DEFAULT, once = false) {
         this.position = pos;
         this.cbk = cbk;
         this.data = data;
         this.priority = priority;
+        this.once = once;
+    }
+}
+
+export class InlineOp {
+    /**
+     * Operation of an inline instrumentation, for :js:func:`VM.addInlineCB` and :js:func:`VM.addInlineRangeCB`
+     *
+     * @param {InlineOpcode}                opcode       The operation.
+     * @param {String|Number|NativePointer} value        Immediate, GPR or operand index, address, or number of skipped operations.
+     * @param {PredicateOperator}           cmp          Comparison of INLINE_SKIP.
+     * @param {String|Number|NativePointer} constant     The constant of INLINE_SKIP, or the start of the range.
+     * @param {String|Number|NativePointer} constantEnd  The end of the range, excluded (PREDICATE_IN_RANGE).
+     */
+    constructor(opcode, value = 0, cmp = PredicateOperator.PREDICATE_EQ, constant = 0, constantEnd = 0) {
+        this.opcode = opcode;
+        this.value = value;
+        this.cmp = cmp;
+        this.constant = constant;
+        this.constantEnd = constantEnd;
     }
 }
 
@@ -1324,6 +1501,22 @@ export class VM {
         return QBDI_C.precacheBasicBlock(this.#vm, pc) == true
     }
 
+    /**
+     * Pre-cache the basic blocks of a module, discovered from its entry point
+     * and its exported functions (ELF modules only). The basic blocks are
+     * translated synchronously. This method mustn't be called when the VM
+     * runs.
+     *
+     * @param {String}           name      The name of the module.
+     * @param {PrecacheStrategy} strategy  The strategy to discover the basic blocks.
+     *
+     * @return {Integer} The number of basic blocks inserted in the cache.
+     */
+    precacheModule(name, strategy = PrecacheStrategy.PRECACHE_RECURSIVE) {
+        var namePtr = Memory.allocUtf8String(name);
+        return QBDI_C.precacheModule(this.#vm, namePtr, strategy);
+    }
+
     /**
      * Clear a specific address range from the translation cache.
      *
@@ -1342,7 +1535,8 @@ export class VM {
     }
 
     /**
-     * Get the number of ExecBlock in the cache. Each block uses 2 memory pages
+     * Get the number of ExecBlock in the cache. Each block uses a code and a
+     * data block (one page each by default, see :js:func:`VM.setExecBlockSize`)
      * and some heap allocations.
      *
      * @return {Integer} The number of ExecBlock in the cache.
@@ -1363,6 +1557,68 @@ export class VM {
         return QBDI_C.reduceCacheTo(this.#vm, nb)
     }
 
+    /**
+     * Set the size of the code and the data blocks of the ExecBlocks. The
+     * cache is cleared. This method mustn't be called when the VM runs.
+     *
+     * @param {Integer} codeSize   The size of the code blocks, a multiple of
+     *                             the page size (0 for one page).
+     * @param {Integer} dataSize   The size of the data blocks, a multiple of
+     *                             the page size (0 for the default).
+     * @param {bool}    hugePages  Back each code block with a 2 MiB
+     *                             transparent huge page (Linux and Android
+     *                             only).
+     *
+     * @return {bool} True if the sizes are supported, False if not.
+     */
+    setExecBlockSize(codeSize, dataSize = 0, hugePages = false) {
+        return QBDI_C.setExecBlockSize(this.#vm, codeSize, dataSize, hugePages ? 1 : 0) == true;
+    }
+
+    /**
+     * Get the counters of the indirect branch target cache. This cache is
+     * used with the option OPT_ENABLE_BLOCK_CHAINING to resolve the target of
+     * the indirect branches without returning to the host.
+     *
+     * @return {Object} An object with the fields ``hits`` and ``misses``.
+     */
+    getIndirectCacheStats() {
+        var hitsPtr = Memory.alloc(8);
+        var missesPtr = Memory.alloc(8);
+        QBDI_C.getIndirectCacheStats(this.#vm, hitsPtr, missesPtr);
+        return {hits: hitsPtr.readU64(), misses: missesPtr.readU64()};
+    }
+
+    /**
+     * Get the execution counters of the basic blocks, counted with the option
+     * OPT_ENABLE_BLOCK_PROFILE (X86_64 only).
+     *
+     * @return {Object[]} An array of objects with the fields ``address``,
+     *                    ``size`` and ``count``.
+     */
+    getBlockProfile() {
+        var profile = [];
+        var sizePtr = Memory.alloc(Process.pointerSize);
+        var profilePtr = QBDI_C.getBlockProfile(this.#vm, sizePtr);
+        if (profilePtr.isNull()) {
+            return [];
+        }
+        var cnt = sizePtr.readU32();
+        // BlockProfile: rword address, rword size, uint64_t count
+        var sSize = 2 * Process.pointerSize + 8;
+        var p = profilePtr;
+        for (var i = 0; i < cnt; i++) {
+            profile.push({
+                address: p.readRword(),
+                size: p.add(Process.pointerSize).readRword(),
+                count: p.add(2 * Process.pointerSize).readU64()
+            });
+            p = p.add(sSize);
+        }
+        System.free(profilePtr);
+        return profile;
+    }
+
     /**
      * Register a callback event if the instruction matches the mnemonic.
      *
@@ -1477,13 +1733,14 @@ export class VM {
      * @param {InstCallback} cbk       A **native** InstCallback returned by :js:func:`VM.newInstCallback`.
      * @param {Object|null}       data      User defined data passed to the callback.
      * @param {Int}          priority  The priority of the callback.
+     * @param {CallbackType} type      The type of the callback.
      *
      * @return {Number} The id of the registered instrumentation (or VMError.INVALID_EVENTID in case of failure).
      */
-    addCodeCB(pos, cbk, data, priority = CallbackPriority.PRIORITY_DEFAULT) {
+    addCodeCB(pos, cbk, data, priority = CallbackPriority.PRIORITY_DEFAULT, type = CallbackType.CALLBACK_DEFAULT) {
         var vm = this.#vm;
         return this._retainUserData(data, function (dataPtr) {
-            return QBDI_C.addCodeCB(vm, pos, cbk, dataPtr, priority);
+            return QBDI_C.addCodeCBWithType(vm, pos, cbk, dataPtr, type, priority);
         });
     }
 
@@ -1495,13 +1752,14 @@ export class VM {
      * @param {InstCallback}  cbk       A **native** InstCallback returned by :js:func:`VM.newInstCallback`.
      * @param {Object|null}        data      User defined data passed to the callback.
      * @param {Int}           priority  The priority of the callback.
+     * @param {CallbackType}  type      The type of the callback.
      *
      * @return {Number} The id of the registered instrumentation (or VMError.INVALID_EVENTID in case of failure).
      */
-    addCodeAddrCB(addr, pos, cbk, data, priority = CallbackPriority.PRIORITY_DEFAULT) {
+    addCodeAddrCB(addr, pos, cbk, data, priority = CallbackPriority.PRIORITY_DEFAULT, type = CallbackType.CALLBACK_DEFAULT) {
         var vm = this.#vm;
         return this._retainUserData(data, function (dataPtr) {
-            return QBDI_C.addCodeAddrCB(vm, addr.toRword(), pos, cbk, dataPtr, priority);
+            return QBDI_C.addCodeAddrCBWithType(vm, addr.toRword(), pos, cbk, dataPtr, type, priority);
         });
     }
 
@@ -1514,13 +1772,57 @@ export class VM {
      * @param {InstCallback}  cbk       A **native** InstCallback returned by :js:func:`VM.newInstCallback`.
      * @param {Object|null}        data      User defined data passed to the callback.
      * @param {Int}           priority  The priority of the callback.
+     * @param {CallbackType}  type      The type of the callback.
      *
      * @return {Number} The id of the registered instrumentation (or VMError.INVALID_EVENTID in case of failure).
      */
-    addCodeRangeCB(start, end, pos, cbk, data, priority = CallbackPriority.PRIORITY_DEFAULT) {
+    addCodeRangeCB(start, end, pos, cbk, data, priority = CallbackPriority.PRIORITY_DEFAULT, type = CallbackType.CALLBACK_DEFAULT) {
         var vm = this.#vm;
         return this._retainUserData(data, function (dataPtr) {
-            return QBDI_C.addCodeRangeCB(vm, start.toRword(), end.toRword(), pos, cbk, dataPtr, priority);
+            return QBDI_C.addCodeRangeCBWithType(vm, start.toRword(), end.toRword(), pos, cbk, dataPtr, type, priority);
+        });
+    }
+
+    /**
+     * Register an inline instrumentation on every instruction. The operations are compiled in the instrumented code
+     * on X86 and X86_64, and interpreted by the host on the other architectures.
+     *
+     * @param {InstPosition}  pos       Relative position of the instrumentation (PreInst / PostInst).
+     * @param {InlineOp[]}    ops       The operations of the instrumentation.
+     * @param {InstCallback}  cbk       A **native** InstCallback returned by :js:func:`VM.newInstCallback`, for the INLINE_CALL operation.
+     * @param {Object|null}   data      User defined data passed to the callback.
+     * @param {Int}           priority  The priority of the instrumentation.
+     *
+     * @return {Number} The id of the registered instrumentation (or VMError.INVALID_EVENTID in case of failure).
+     */
+    addInlineCB(pos, ops, cbk = null, data = null, priority = CallbackPriority.PRIORITY_DEFAULT) {
+        var vm = this.#vm;
+        var opsPtr = this._writeInlineOps(ops);
+        var cbkPtr = cbk === null ? NULL : cbk;
+        return this._retainUserData(data, function (dataPtr) {
+            return QBDI_C.addInlineCB(vm, pos, opsPtr, ops.length, cbkPtr, dataPtr, priority);
+        });
+    }
+
+    /**
+     * Register an inline instrumentation for a specific address range (see :js:func:`VM.addInlineCB`).
+     *
+     * @param {String|Number|NativePointer} start     Start of the address range.
+     * @param {String|Number|NativePointer} end       End of the address range.
+     * @param {InstPosition}  pos       Relative position of the instrumentation (PreInst / PostInst).
+     * @param {InlineOp[]}    ops       The operations of the instrumentation.
+     * @param {InstCallback}  cbk       A **native** InstCallback returned by :js:func:`VM.newInstCallback`, for the INLINE_CALL operation.
+     * @param {Object|null}   data      User defined data passed to the callback.
+     * @param {Int}           priority  The priority of the instrumentation.
+     *
+     * @return {Number} The id of the registered instrumentation (or VMError.INVALID_EVENTID in case of failure).
+     */
+    addInlineRangeCB(start, end, pos, ops, cbk = null, data = null, priority = CallbackPriority.PRIORITY_DEFAULT) {
+        var vm = this.#vm;
+        var opsPtr = this._writeInlineOps(ops);
+        var cbkPtr = cbk === null ? NULL : cbk;
+        return this._retainUserData(data, function (dataPtr) {
+            return QBDI_C.addInlineRangeCB(vm, start.toRword(), end.toRword(), pos, opsPtr, ops.length, cbkPtr, dataPtr, priority);
         });
     }
 
@@ -1777,7 +2079,11 @@ export class VM {
             }
             for (var i = 0; i < res.length; i++) {
                 var d = vm._retainUserDataForInstrRuleCB2(res[i].data, data.id);
-                QBDI_C.addInstrRuleData(cbksPtr, res[i].position, res[i].cbk, d, res[i].priority);
+                if (res[i].once) {
+                    QBDI_C.addInstrRuleDataOnce(cbksPtr, res[i].position, res[i].cbk, d, res[i].priority);
+                } else {
+                    QBDI_C.addInstrRuleData(cbksPtr, res[i].position, res[i].cbk, d, res[i].priority);
+                }
             }
         }
         return new NativeCallback(jcbk, 'void', ['pointer', 'pointer', 'pointer', 'pointer']);
@@ -1985,6 +2291,27 @@ export class VM {
         return iid;
     }
 
+    // Write an array of InlineOp in a native buffer.
+    _writeInlineOps(ops) {
+        if (!Array.isArray(ops) || ops.length === 0) {
+            throw new TypeError('Invalid InlineOp Array');
+        }
+        // InlineOp: uint32 opcode, rword value, uint32 cmp, rword constant,
+        // rword constantEnd. The enums are padded to the size of a rword.
+        var sSize = 5 * Process.pointerSize;
+        var opsPtr = Memory.alloc(ops.length * sSize);
+        for (var i = 0; i < ops.length; i++) {
+            var op = ops[i];
+            var p = opsPtr.add(i * sSize);
+            p.writeU32(op.opcode);
+            p.add(Process.pointerSize).writeRword(op.value.toRword());
+            p.add(2 * Process.pointerSize).writeU32(op.cmp);
+            p.add(3 * Process.pointerSize).writeRword(op.constant.toRword());
+            p.add(4 * Process.pointerSize).writeRword(op.constantEnd.toRword());
+        }
+        return opsPtr;
+    }
+
     _retainUserDataForInstrRuleCB(data, fn) {
         this.#userDataPointer += 1;
         var dataPtr = ptr("0").add(this.#userDataPointer);
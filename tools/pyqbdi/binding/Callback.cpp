@@ -52,6 +52,27 @@ void init_binding_Callback(py::module_ &m) {
              "to return early.")
       .export_values();
 
+  py::enum_<RunStatus>(m, "RunStatus", "The reason of the end of a run.")
+      .value("RUN_NOT_EXECUTED", RunStatus::RUN_NOT_EXECUTED,
+             "No block has been executed.")
+      .value("RUN_STOPPED", RunStatus::RUN_STOPPED,
+             "The stop address has been reached or a callback stopped the "
+             "execution.")
+      .value("RUN_BUDGET_EXHAUSTED", RunStatus::RUN_BUDGET_EXHAUSTED,
+             "The instruction budget or the time budget of the run is "
+             "exhausted.")
+      .export_values();
+
+  py::enum_<PrecacheStrategy>(
+      m, "PrecacheStrategy",
+      "Strategy to discover the basic blocks of a module with precacheModule.")
+      .value("PRECACHE_SYMBOLS", PrecacheStrategy::PRECACHE_SYMBOLS,
+             "Cache the entry point and the functions exported by the module.")
+      .value("PRECACHE_RECURSIVE", PrecacheStrategy::PRECACHE_RECURSIVE,
+             "Also cache the basic blocks reached by the direct branches and "
+             "calls of the module.")
+      .export_values();
+
   py::enum_<InstPosition>(m, "InstPosition",
                           "Position relative to an instruction.")
       .value("PREINST", InstPosition::PREINST,
@@ -69,6 +90,129 @@ void init_binding_Callback(py::module_ &m) {
              "is used in the callback.")
       .export_values();
 
+  enum_int_flag_<CallbackType>(m, "CallbackType", "Type of callback.",
+                               py::arithmetic())
+      .value("CALLBACK_DEFAULT", CallbackType::CALLBACK_DEFAULT,
+             "The callback is called by the VM.")
+      .value("CALLBACK_FAST", CallbackType::CALLBACK_FAST,
+             "The callback is called from the instrumented code.")
+      .value("CALLBACK_ONCE", CallbackType::CALLBACK_ONCE,
+             "The callback is only called at the first execution of an "
+             "instruction.")
+      .export_values()
+      .def_invert()
+      .def_repr_str();
+
+  py::enum_<PredicateSource>(m, "PredicateSource",
+                             "Value compared by the predicate of a callback.")
+      .value("PREDICATE_GPR", PredicateSource::PREDICATE_GPR,
+             "The value of a GPR.")
+      .value("PREDICATE_MEMORY", PredicateSource::PREDICATE_MEMORY,
+             "The word at the address in a GPR plus an offset.")
+      .value("PREDICATE_FLAG", PredicateSource::PREDICATE_FLAG,
+             "A bit of the flags register (0 or 1).")
+      .export_values();
+
+  py::enum_<PredicateOperator>(
+      m, "PredicateOperator",
+      "Comparison of the predicate of a callback. The comparisons are "
+      "unsigned.")
+      .value("PREDICATE_EQ", PredicateOperator::PREDICATE_EQ,
+             "value == constant")
+      .value("PREDICATE_NE", PredicateOperator::PREDICATE_NE,
+             "value != constant")
+      .value("PREDICATE_LT", PredicateOperator::PREDICATE_LT,
+             "value < constant")
+      .value("PREDICATE_LE", PredicateOperator::PREDICATE_LE,
+             "value <= constant")
+      .value("PREDICATE_GT", PredicateOperator::PREDICATE_GT,
+             "value > constant")
+      .value("PREDICATE_GE", PredicateOperator::PREDICATE_GE,
+             "value >= constant")
+      .value("PREDICATE_IN_RANGE", PredicateOperator::PREDICATE_IN_RANGE,
+             "constant <= value < constantEnd")
+      .export_values();
+
+  py::class_<CallbackPredicate>(m, "CallbackPredicate",
+                                "Condition of a predicated callback.")
+      .def(py::init([](PredicateSource source, uint32_t reg,
+                       PredicateOperator op, rword constant, sword offset,
+                       rword constantEnd) {
+             CallbackPredicate predicate;
+             predicate.source = source;
+             predicate.reg = reg;
+             predicate.offset = offset;
+             predicate.op = op;
+             predicate.constant = constant;
+             predicate.constantEnd = constantEnd;
+             return predicate;
+           }),
+           "source"_a, "reg"_a, "op"_a, "constant"_a, "offset"_a = 0,
+           "constantEnd"_a = 0)
+      .def_readwrite("source", &CallbackPredicate::source,
+                     "Source of the compared value.")
+      .def_readwrite("reg", &CallbackPredicate::reg,
+                     "Index of the GPR (PREDICATE_GPR and PREDICATE_MEMORY) or "
+                     "of the bit of the flags register (PREDICATE_FLAG).")
+      .def_readwrite("offset", &CallbackPredicate::offset,
+                     "Offset added to the GPR (PREDICATE_MEMORY).")
+      .def_readwrite("op", &CallbackPredicate::op,
+                     "Comparison with the constant.")
+      .def_readwrite("constant", &CallbackPredicate::constant,
+                     "The constant, or the start of the range.")
+      .def_readwrite("constantEnd", &CallbackPredicate::constantEnd,
+                     "The end of the range, excluded (PREDICATE_IN_RANGE).");
+
+  py::enum_<InlineOpcode>(m, "InlineOpcode",
+                          "Operation of an inline instrumentation.")
+      .value("INLINE_LOAD_IMM", InlineOpcode::INLINE_LOAD_IMM,
+             "accumulator = value")
+      .value("INLINE_LOAD_REG", InlineOpcode::INLINE_LOAD_REG,
+             "accumulator = the GPR with the index value")
+      .value("INLINE_LOAD_OPERAND", InlineOpcode::INLINE_LOAD_OPERAND,
+             "accumulator = the operand with the index value in the "
+             "InstAnalysis")
+      .value("INLINE_LOAD_READ_ADDRESS", InlineOpcode::INLINE_LOAD_READ_ADDRESS,
+             "accumulator = the address of the read access, or zero")
+      .value("INLINE_LOAD_WRITE_ADDRESS",
+             InlineOpcode::INLINE_LOAD_WRITE_ADDRESS,
+             "accumulator = the address of the write access (POSTINST only), "
+             "or zero")
+      .value("INLINE_LOAD_MEMORY", InlineOpcode::INLINE_LOAD_MEMORY,
+             "accumulator = the word at the address value")
+      .value("INLINE_ADD", InlineOpcode::INLINE_ADD, "accumulator += value")
+      .value("INLINE_STORE", InlineOpcode::INLINE_STORE,
+             "the word at the address value = accumulator")
+      .value("INLINE_SKIP", InlineOpcode::INLINE_SKIP,
+             "skip the next value operations when the comparison of the "
+             "accumulator holds")
+      .value("INLINE_CALL", InlineOpcode::INLINE_CALL,
+             "call the callback of the instrumentation (last operation only)")
+      .export_values();
+
+  py::class_<InlineOp>(m, "InlineOp", "Operation of an inline instrumentation.")
+      .def(py::init([](InlineOpcode opcode, rword value, PredicateOperator cmp,
+                       rword constant, rword constantEnd) {
+             InlineOp op;
+             op.opcode = opcode;
+             op.value = value;
+             op.cmp = cmp;
+             op.constant = constant;
+             op.constantEnd = constantEnd;
+             return op;
+           }),
+           "opcode"_a, "value"_a = 0, "cmp"_a = PredicateOperator::PREDICATE_EQ,
+           "constant"_a = 0, "constantEnd"_a = 0)
+      .def_readwrite("opcode", &InlineOp::opcode, "The operation.")
+      .def_readwrite("value", &InlineOp::value,
+                     "Immediate, GPR or operand index, address, or number of "
+                     "skipped operations.")
+      .def_readwrite("cmp", &InlineOp::cmp, "Comparison of INLINE_SKIP.")
+      .def_readwrite("constant", &InlineOp::constant,
+                     "The constant of INLINE_SKIP, or the start of the range.")
+      .def_readwrite("constantEnd", &InlineOp::constantEnd,
+                     "The end of the range, excluded (PREDICATE_IN_RANGE).");
+
   enum_int_flag_<VMEvent>(m, "VMEvent", py::arithmetic())
       .value("SEQUENCE_ENTRY", VMEvent::SEQUENCE_ENTRY,
              "Triggered when the execution enters a sequence.")
@@ -199,8 +343,10 @@ void init_binding_Callback(py::module_ &m) {
           }));
 
   py::class_<InstrRuleDataCBKPython>(m, "InstrRuleDataCBK")
-      .def(py::init<PyInstCallback &, py::object &, InstPosition, int>(),
-           "cbk"_a, "data"_a, "position"_a, "priority"_a = PRIORITY_DEFAULT)
+      .def(py::init<PyInstCallback &, py::object &, InstPosition, int,
+                    bool>(),
+           "cbk"_a, "data"_a, "position"_a, "priority"_a = PRIORITY_DEFAULT,
+           "once"_a = false)
       .def_readwrite(
           "cbk", &InstrRuleDataCBKPython::cbk,
           "Address of the function to call when the instruction is executed")
@@ -210,7 +356,10 @@ void init_binding_Callback(py::module_ &m) {
           "position", &InstrRuleDataCBKPython::position,
           "Relative position of the event callback (PREINST / POSTINST).")
       .def_readwrite("priority", &InstrRuleDataCBKPython::priority,
-                     "Priority of the callback.");
+                     "Priority of the callback.")
+      .def_readwrite("once", &InstrRuleDataCBKPython::once,
+                     "Only call the callback at the first execution of the "
+                     "instruction (see CALLBACK_ONCE).");
 }
 
 } // namespace pyQBDI
@@ -128,7 +128,7 @@ trampoline_InstrRuleCallback(VMInstanceRef vm, const InstAnalysis *analysis,
         new TrampData<PyInstCallback>(cb.cbk, cb.data)};
     data->id = cbk->id;
     res.emplace_back(cb.position, trampoline_InstCallback,
-                     static_cast<void *>(data.get()), cb.priority);
+                     static_cast<void *>(data.get()), cb.priority, cb.once);
     vec.push_back(std::move(data));
   }
 
@@ -190,6 +190,9 @@ void init_binding_VM(py::module_ &m) {
            "Remove all instrumented ranges.")
       .def("run", &VM::run, "Start the execution by the DBI.", "start"_a,
            "stop"_a)
+      .def("runWithStatus", &VM::runWithStatus,
+           "Start the execution by the DBI and return the reason of its end.",
+           "start"_a, "stop"_a)
       .def(
           "call",
           [](VM &vm, rword function, std::vector<rword> &args) {
@@ -241,6 +244,40 @@ void init_binding_VM(py::module_ &m) {
           "Register a callback event if the instruction matches the mnemonic.",
           "mnemonic"_a, "pos"_a, "cbk"_a, "data"_a,
           "priority"_a = PRIORITY_DEFAULT)
+      .def(
+          "addMnemonicCB",
+          [](VM &vm, const char *mnemonic, InstPosition pos,
+             PyInstCallback &cbk, py::object &obj,
+             const CallbackPredicate &predicate, int priority) {
+            std::unique_ptr<TrampData<PyInstCallback>> data{
+                new TrampData<PyInstCallback>(cbk, obj)};
+            uint32_t n =
+                vm.addMnemonicCB(mnemonic, pos, &trampoline_InstCallback,
+                                 static_cast<void *>(data.get()), predicate,
+                                 priority);
+            data->id = n;
+            return addTrampData(n, InstCallbackMap, std::move(data));
+          },
+          "Register a callback event if the instruction matches the mnemonic, "
+          "called only when a predicate holds.",
+          "mnemonic"_a, "pos"_a, "cbk"_a, "data"_a, "predicate"_a,
+          "priority"_a = PRIORITY_DEFAULT)
+      .def(
+          "addCodeCB",
+          [](VM &vm, InstPosition pos, PyInstCallback &cbk, py::object &obj,
+             CallbackType type, int priority) {
+            std::unique_ptr<TrampData<PyInstCallback>> data{
+                new TrampData<PyInstCallback>(cbk, obj)};
+            uint32_t n =
+                vm.addCodeCB(pos, &trampoline_InstCallback,
+                             static_cast<void *>(data.get()), type, priority);
+            data->id = n;
+            return addTrampData(n, InstCallbackMap, std::move(data));
+          },
+          "Register a callback event for every instruction executed, with a "
+          "callback type.",
+          "pos"_a, "cbk"_a, "data"_a, "type"_a,
+          "priority"_a = PRIORITY_DEFAULT)
       .def(
           "addCodeCB",
           [](VM &vm, InstPosition pos, PyInstCallback &cbk, py::object &obj,
@@ -255,6 +292,39 @@ void init_binding_VM(py::module_ &m) {
           },
           "Register a callback event for every instruction executed.", "pos"_a,
           "cbk"_a, "data"_a, "priority"_a = PRIORITY_DEFAULT)
+      .def(
+          "addCodeCB",
+          [](VM &vm, InstPosition pos, PyInstCallback &cbk, py::object &obj,
+             const CallbackPredicate &predicate, int priority) {
+            std::unique_ptr<TrampData<PyInstCallback>> data{
+                new TrampData<PyInstCallback>(cbk, obj)};
+            uint32_t n = vm.addCodeCB(pos, &trampoline_InstCallback,
+                                      static_cast<void *>(data.get()),
+                                      predicate, priority);
+            data->id = n;
+            return addTrampData(n, InstCallbackMap, std::move(data));
+          },
+          "Register a callback event for every instruction executed, called "
+          "only when a predicate holds.",
+          "pos"_a, "cbk"_a, "data"_a, "predicate"_a,
+          "priority"_a = PRIORITY_DEFAULT)
+      .def(
+          "addCodeAddrCB",
+          [](VM &vm, rword address, InstPosition pos, PyInstCallback &cbk,
+             py::object &obj, CallbackType type, int priority) {
+            std::unique_ptr<TrampData<PyInstCallback>> data{
+                new TrampData<PyInstCallback>(cbk, obj)};
+            uint32_t n =
+                vm.addCodeAddrCB(address, pos, &trampoline_InstCallback,
+                                 static_cast<void *>(data.get()), type,
+                                 priority);
+            data->id = n;
+            return addTrampData(n, InstCallbackMap, std::move(data));
+          },
+          "Register a callback for when a specific address is executed, with a "
+          "callback type.",
+          "address"_a, "pos"_a, "cbk"_a, "data"_a, "type"_a,
+          "priority"_a = PRIORITY_DEFAULT)
       .def(
           "addCodeAddrCB",
           [](VM &vm, rword address, InstPosition pos, PyInstCallback &cbk,
@@ -270,6 +340,42 @@ void init_binding_VM(py::module_ &m) {
           "Register a callback for when a specific address is executed.",
           "address"_a, "pos"_a, "cbk"_a, "data"_a,
           "priority"_a = PRIORITY_DEFAULT)
+      .def(
+          "addCodeAddrCB",
+          [](VM &vm, rword address, InstPosition pos, PyInstCallback &cbk,
+             py::object &obj, const CallbackPredicate &predicate,
+             int priority) {
+            std::unique_ptr<TrampData<PyInstCallback>> data{
+                new TrampData<PyInstCallback>(cbk, obj)};
+            uint32_t n =
+                vm.addCodeAddrCB(address, pos, &trampoline_InstCallback,
+                                 static_cast<void *>(data.get()), predicate,
+                                 priority);
+            data->id = n;
+            return addTrampData(n, InstCallbackMap, std::move(data));
+          },
+          "Register a callback for when a specific address is executed, called "
+          "only when a predicate holds.",
+          "address"_a, "pos"_a, "cbk"_a, "data"_a, "predicate"_a,
+          "priority"_a = PRIORITY_DEFAULT)
+      .def(
+          "addCodeRangeCB",
+          [](VM &vm, rword start, rword end, InstPosition pos,
+             PyInstCallback &cbk, py::object &obj, CallbackType type,
+             int priority) {
+            std::unique_ptr<TrampData<PyInstCallback>> data{
+                new TrampData<PyInstCallback>(cbk, obj)};
+            uint32_t n =
+                vm.addCodeRangeCB(start, end, pos, &trampoline_InstCallback,
+                                  static_cast<void *>(data.get()), type,
+                                  priority);
+            data->id = n;
+            return addTrampData(n, InstCallbackMap, std::move(data));
+          },
+          "Register a callback for when a specific address range is executed, "
+          "with a callback type.",
+          "start"_a, "end"_a, "pos"_a, "cbk"_a, "data"_a, "type"_a,
+          "priority"_a = PRIORITY_DEFAULT)
       .def(
           "addCodeRangeCB",
           [](VM &vm, rword start, rword end, InstPosition pos,
@@ -337,6 +443,47 @@ void init_binding_VM(py::module_ &m) {
           "gate callback triggered on every memory access. This incurs a high "
           "performance cost.",
           "start"_a, "end"_a, "type"_a, "cbk"_a, "data"_a)
+      .def(
+          "addInlineCB",
+          [](VM &vm, InstPosition pos, const std::vector<InlineOp> &ops,
+             PyInstCallback &cbk, py::object &obj, int priority) {
+            if (!cbk) {
+              return py::cast(
+                  vm.addInlineCB(pos, ops, nullptr, nullptr, priority));
+            }
+            std::unique_ptr<TrampData<PyInstCallback>> data{
+                new TrampData<PyInstCallback>(cbk, obj)};
+            uint32_t n =
+                vm.addInlineCB(pos, ops, &trampoline_InstCallback,
+                               static_cast<void *>(data.get()), priority);
+            data->id = n;
+            return addTrampData(n, InstCallbackMap, std::move(data));
+          },
+          "Register an inline instrumentation on every instruction. The "
+          "callback is only needed by the INLINE_CALL operation.",
+          "pos"_a, "ops"_a, "cbk"_a = py::none(), "data"_a = py::none(),
+          "priority"_a = PRIORITY_DEFAULT)
+      .def(
+          "addInlineRangeCB",
+          [](VM &vm, rword start, rword end, InstPosition pos,
+             const std::vector<InlineOp> &ops, PyInstCallback &cbk,
+             py::object &obj, int priority) {
+            if (!cbk) {
+              return py::cast(vm.addInlineRangeCB(start, end, pos, ops, nullptr,
+                                                  nullptr, priority));
+            }
+            std::unique_ptr<TrampData<PyInstCallback>> data{
+                new TrampData<PyInstCallback>(cbk, obj)};
+            uint32_t n =
+                vm.addInlineRangeCB(start, end, pos, ops,
+                                    &trampoline_InstCallback,
+                                    static_cast<void *>(data.get()), priority);
+            data->id = n;
+            return addTrampData(n, InstCallbackMap, std::move(data));
+          },
+          "Register an inline instrumentation for a specific address range.",
+          "start"_a, "end"_a, "pos"_a, "ops"_a, "cbk"_a = py::none(),
+          "data"_a = py::none(), "priority"_a = PRIORITY_DEFAULT)
       .def(
           "addVMEventCB",
           [](VM &vm, VMEvent mask, PyVMCallback &cbk, py::object &obj) {
@@ -422,16 +569,54 @@ void init_binding_VM(py::module_ &m) {
            py::return_value_policy::copy)
       .def("precacheBasicBlock", &VM::precacheBasicBlock,
            "Pre-cache a known basic block", "pc"_a)
+      .def("precacheModule", &VM::precacheModule,
+           "Pre-cache the basic blocks of a module, discovered from its entry "
+           "point and its exported functions (ELF modules only). Return the "
+           "number of basic blocks inserted in the cache.",
+           "name"_a, "strategy"_a = PrecacheStrategy::PRECACHE_RECURSIVE)
       .def("clearCache", &VM::clearCache,
            "Clear a specific address range from the translation cache.",
            "start"_a, "end"_a)
       .def("clearAllCache", &VM::clearAllCache,
            "Clear the entire translation cache.")
       .def("getNbExecBlock", &VM::getNbExecBlock,
-           "Get the number of ExecBlock in the cache. Each block uses 2 memory "
-           "pages and some heap allocations.")
+           "Get the number of ExecBlock in the cache. Each block uses a code "
+           "and a data block (one page each by default, see setExecBlockSize) "
+           "and some heap allocations.")
       .def("reduceCacheTo", &VM::reduceCacheTo,
-           "Reduce the cache to X ExecBlock.", "nb"_a);
+           "Reduce the cache to X ExecBlock.", "nb"_a)
+      .def("setExecBlockSize", &VM::setExecBlockSize,
+           "Set the size of the code and the data blocks of the ExecBlocks. "
+           "The cache is cleared. Return False if the sizes aren't supported.",
+           "codeSize"_a, "dataSize"_a = 0, "hugePages"_a = false)
+      .def(
+          "getIndirectCacheStats",
+          [](const VM &vm) {
+            uint64_t hits, misses;
+            vm.getIndirectCacheStats(&hits, &misses);
+            return std::make_tuple(hits, misses);
+          },
+          "Get the counters (hits, misses) of the indirect branch target "
+          "cache.")
+      .def(
+          "getBlockProfile",
+          [](const VM &vm) {
+            std::vector<std::tuple<rword, rword, uint64_t>> profile;
+            for (const BlockProfile &p : vm.getBlockProfile()) {
+              profile.emplace_back(p.address, p.size, p.count);
+            }
+            return profile;
+          },
+          "Get the execution counters (address, size, count) of the basic "
+          "blocks counted with the option OPT_ENABLE_BLOCK_PROFILE.")
+      .def("setInstructionBudget", &VM::setInstructionBudget,
+           "Stop each run after a number of instructions (0 for no limit).",
+           "instructions"_a)
+      .def("setTimeBudget", &VM::setTimeBudget,
+           "Stop each run after a delay in milliseconds (0 for no limit).",
+           "milliseconds"_a)
+      .def("isBudgetExhausted", &VM::isBudgetExhausted,
+           "Check if the last run has been stopped by its budget.");
 }
 
 } // namespace pyQBDI
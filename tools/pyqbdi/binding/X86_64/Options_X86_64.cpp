@@ -37,6 +37,19 @@ void init_binding_Options(py::module_ &m) {
              "Don't load memory access value")
       .value("OPT_DISABLE_ERRNO_BACKUP", Options::OPT_DISABLE_ERRNO_BACKUP,
              "Don't save and restore errno")
+      .value("OPT_ENABLE_BLOCK_CHAINING", Options::OPT_ENABLE_BLOCK_CHAINING,
+             "Link the cached sequences together (X86 and X86_64 only)")
+      .value("OPT_ENABLE_TRACE_FORMATION",
+             Options::OPT_ENABLE_TRACE_FORMATION,
+             "Form the hot traces across the sequences (X86 and X86_64 only)")
+      .value("OPT_ENABLE_SHARED_CONTEXT", Options::OPT_ENABLE_SHARED_CONTEXT,
+             "Share the guest state between the ExecBlocks (X86 and X86_64 "
+             "only)")
+      .value("OPT_ENABLE_BLOCK_PROFILE", Options::OPT_ENABLE_BLOCK_PROFILE,
+             "Count the executions of each basic block (X86_64 only)")
+      .value("OPT_ENABLE_DUAL_MAPPING", Options::OPT_ENABLE_DUAL_MAPPING,
+             "Map the code of the ExecBlocks twice instead of changing its "
+             "permissions (Linux and Android only)")
       .value("OPT_ATT_SYNTAX", Options::OPT_ATT_SYNTAX,
              "Used the AT&T syntax for instruction disassembly")
       .value("OPT_ENABLE_FS_GS", Options::OPT_ENABLE_FS_GS,
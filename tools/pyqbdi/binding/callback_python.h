@@ -34,10 +34,13 @@ struct InstrRuleDataCBKPython {
   py::object data;
   InstPosition position;
   int priority;
+  bool once;
 
   InstrRuleDataCBKPython(PyInstCallback &cbk, py::object &data,
-                         InstPosition position, int priority = PRIORITY_DEFAULT)
-      : cbk(cbk), data(data), position(position), priority(priority) {}
+                         InstPosition position, int priority = PRIORITY_DEFAULT,
+                         bool once = false)
+      : cbk(cbk), data(data), position(position), priority(priority),
+        once(once) {}
 };
 
 using PyInstrRuleCallback = std::function<std::vector<InstrRuleDataCBKPython>(